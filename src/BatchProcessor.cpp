@@ -0,0 +1,615 @@
+#include "BatchProcessor.h"
+#include "FileManager.h"
+#include "GzipBlockIndex.h"
+#include "NiftiHeaderScanner.h"
+#include "OrthogonalSlicer.h"
+#include "VolumeStatistics.h"
+#include "VoxelStream.h"
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const double BYTES_PER_MB = 1024.0 * 1024.0;
+const qint64 DEFAULT_MEMORY_BUDGET_MB = 2048;            // Decoded bytes in flight across all jobs
+const qint64 STREAM_RESERVE_BYTES = 4LL * 1024 * 1024;   // Buffers of a header read or recompression
+const int BUFFER_SIZE = 1 << 20;                         // Decoded bytes per step while streaming
+const double THUMBNAIL_LOW_PERCENTILE = 0.01;            // Maps to black
+const double THUMBNAIL_HIGH_PERCENTILE = 0.99;           // Maps to white
+
+const char *COMMAND_NAMES[] = { "header", "stats", "thumbnail", "recompress", "index" };
+const int COMMAND_COUNT = 5;
+
+int commandIndex(const QString &argument)
+{
+    for (int i = 0; i < COMMAND_COUNT; ++i) {
+        if (argument == QLatin1String(COMMAND_NAMES[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QJsonArray toJsonArray(const double *values, int count)
+{
+    QJsonArray array;
+    for (int i = 0; i < count; ++i) {
+        array.append(values[i]);
+    }
+    return array;
+}
+
+/**
+ * File name without the .nii or .nii.gz extension
+ */
+QString volumeBaseName(const QString &filePath)
+{
+    QString name = QFileInfo(filePath).fileName();
+    for (const char *extension : { ".nii.gz", ".nii" }) {
+        if (name.endsWith(QLatin1String(extension), Qt::CaseInsensitive)) {
+            name.chop(static_cast<int>(qstrlen(extension)));
+            break;
+        }
+    }
+    return name;
+}
+
+} // namespace
+
+bool BatchProcessor::isCommand(const QString &argument)
+{
+    return commandIndex(argument) >= 0;
+}
+
+/**
+ * Parses the command line, expands directories and runs the command
+ * 
+ * Returns 0 when every file succeeded, 1 when any failed and 2 for a
+ * usage error.
+ */
+int BatchProcessor::run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless batch processing of NIfTI files.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("command", "header, stats, thumbnail, recompress or index.");
+    parser.addPositionalArgument("paths", "NIfTI files or directories of them.", "<paths...>");
+    
+    QCommandLineOption outputOption({"o", "output-dir"}, "Directory for thumbnails and recompressed files.", "dir");
+    QCommandLineOption jobsOption({"j", "jobs"}, "Files processed in parallel (default: all cores).", "n");
+    QCommandLineOption memoryOption("memory-budget", "Decoded megabytes in flight across all jobs (default 2048).", "mb");
+    QCommandLineOption sizeOption("size", "Longest thumbnail edge in pixels (default 256).", "px");
+    QCommandLineOption planeOption("plane", "Thumbnail plane: axial, coronal or sagittal (default axial).", "plane");
+    QCommandLineOption levelOption("level", "Compression level 1-9 of recompressed files (default 6).", "n");
+    parser.addOptions({outputOption, jobsOption, memoryOption, sizeOption, planeOption, levelOption});
+    parser.process(arguments);
+    
+    const QStringList positional = parser.positionalArguments();
+    if (positional.size() < 2 || !isCommand(positional.first())) {
+        std::fprintf(stderr, "%s\n", qPrintable(parser.helpText()));
+        return 2;
+    }
+    
+    Options options;
+    options.command = static_cast<Command>(commandIndex(positional.first()));
+    options.outputDirectory = parser.value(outputOption);
+    options.jobs = parser.isSet(jobsOption) ? parser.value(jobsOption).toInt() : QThread::idealThreadCount();
+    options.memoryBudget = static_cast<qint64>((parser.isSet(memoryOption) ? parser.value(memoryOption).toDouble()
+                                                                           : DEFAULT_MEMORY_BUDGET_MB) * BYTES_PER_MB);
+    if (parser.isSet(sizeOption)) {
+        options.thumbnailSize = parser.value(sizeOption).toInt();
+    }
+    if (parser.isSet(levelOption)) {
+        options.compressionLevel = parser.value(levelOption).toInt();
+    }
+    const QString plane = parser.value(planeOption).toLower();
+    if (plane == "sagittal") {
+        options.thumbnailPlane = OrthogonalSlicer::SAGITTAL_PLANE;
+    } else if (plane == "coronal") {
+        options.thumbnailPlane = OrthogonalSlicer::CORONAL_PLANE;
+    } else if (!plane.isEmpty() && plane != "axial") {
+        std::fprintf(stderr, "Unknown plane: %s\n", qPrintable(plane));
+        return 2;
+    }
+    
+    if (options.jobs < 1 || options.memoryBudget <= 0 || options.thumbnailSize < 1 ||
+        options.compressionLevel < 1 || options.compressionLevel > 9) {
+        std::fprintf(stderr, "Invalid --jobs, --memory-budget, --size or --level value\n");
+        return 2;
+    }
+    
+    // Outputs only go where asked, never next to the inputs by accident
+    if (options.command == THUMBNAIL || options.command == RECOMPRESS) {
+        if (options.outputDirectory.isEmpty()) {
+            std::fprintf(stderr, "%s needs --output-dir\n", COMMAND_NAMES[options.command]);
+            return 2;
+        }
+        if (!QDir().mkpath(options.outputDirectory)) {
+            std::fprintf(stderr, "Cannot create %s\n", qPrintable(options.outputDirectory));
+            return 2;
+        }
+    }
+    
+    const QStringList files = expandPaths(positional.mid(1));
+    if (files.isEmpty()) {
+        std::fprintf(stderr, "No NIfTI files found\n");
+        return 2;
+    }
+    
+    BatchProcessor processor(options);
+    return processor.process(files) == 0 ? 0 : 1;
+}
+
+BatchProcessor::BatchProcessor(const Options &options)
+    : m_options(options)
+    , m_cancelFlag(std::make_shared<std::atomic_bool>(false))
+    , m_bytesInFlight(0)
+    , m_failures(0)
+{
+}
+
+/**
+ * Runs every file on a pool of m_options.jobs threads and waits for all
+ * 
+ * Each job holds its share of the memory budget from before the decode
+ * until its record is printed.
+ */
+int BatchProcessor::process(const QStringList &filePaths)
+{
+    QElapsedTimer timer;
+    timer.start();
+    
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_options.jobs);
+    for (const QString &filePath : filePaths) {
+        pool.start([this, filePath]() {
+            const qint64 reserved = reserveBytes(filePath);
+            acquire(reserved);
+            
+            QJsonObject record;
+            QString error;
+            const bool succeeded = processFile(filePath, record, error);
+            
+            release(reserved);
+            if (succeeded) {
+                printRecord(record);
+            } else {
+                printError(filePath, error);
+            }
+        });
+    }
+    pool.waitForDone();
+    
+    const int failures = m_failures.load();
+    std::fprintf(stderr, "%s: %lld files, %d failed, %.1f s\n", COMMAND_NAMES[m_options.command],
+                 static_cast<long long>(filePaths.size()), failures, timer.elapsed() / 1000.0);
+    return failures;
+}
+
+bool BatchProcessor::processFile(const QString &filePath, QJsonObject &record, QString &error)
+{
+    record.insert("file", filePath);
+    switch (m_options.command) {
+    case HEADER:
+        return dumpHeader(filePath, record, error);
+    case STATS:
+        return computeStats(filePath, record, error);
+    case THUMBNAIL:
+        return writeThumbnail(filePath, record, error);
+    case RECOMPRESS:
+        return recompress(filePath, record, error);
+    case INDEX:
+        return writeIndex(filePath, record, error);
+    }
+    return false;
+}
+
+bool BatchProcessor::dumpHeader(const QString &filePath, QJsonObject &record, QString &error)
+{
+    const NiftiHeaderScanner::Entry entry = NiftiHeaderScanner::scanFile(filePath);
+    if (!entry.errorString.isEmpty()) {
+        error = entry.errorString;
+        return false;
+    }
+    
+    const NiftiHeader &header = entry.header;
+    QJsonArray dims;
+    for (int i = 1; i <= std::min<int64_t>(header.dim[0], 7); ++i) {
+        dims.append(static_cast<double>(header.dim[i]));
+    }
+    QJsonArray srow;
+    for (int row = 0; row < 3; ++row) {
+        srow.append(toJsonArray(header.srow[row], 4));
+    }
+    
+    record.insert("fileBytes", static_cast<double>(entry.fileBytes));
+    record.insert("version", header.version);
+    record.insert("datatype", QString::fromLatin1(header.datatypeName()));
+    record.insert("bitpix", header.bitpix);
+    record.insert("dim", dims);
+    record.insert("pixdim", toJsonArray(header.pixdim + 1, 4));
+    record.insert("volumes", static_cast<double>(header.volumeCount()));
+    record.insert("sclSlope", header.sclSlope);
+    record.insert("sclInter", header.sclInter);
+    record.insert("qform", QString::fromLatin1(NiftiHeader::xformName(header.qformCode)));
+    record.insert("sform", QString::fromLatin1(NiftiHeader::xformName(header.sformCode)));
+    record.insert("quatern", toJsonArray(header.quatern, 3));
+    record.insert("qoffset", toJsonArray(header.qoffset, 3));
+    record.insert("srow", srow);
+    record.insert("intentCode", header.intentCode);
+    record.insert("intentName", QString::fromLatin1(header.intentName));
+    record.insert("descrip", QString::fromLatin1(header.descrip));
+    return true;
+}
+
+/**
+ * Decodes the first volume and reports its statistics, computed on this
+ * worker thread with the header's intensity scaling
+ */
+bool BatchProcessor::computeStats(const QString &filePath, QJsonObject &record, QString &error)
+{
+    FileManager::LoadOptions options;
+    options.parallelDecompression = false;  // Files already run in parallel
+    options.lazyLoading = false;
+    options.compactStorage = false;         // Read once and dropped; narrowing would only add a pass
+    FileManager::LoadResult result = FileManager::readVolume(filePath, options, nullptr, m_cancelFlag, nullptr);
+    if (!result.imageData) {
+        error = result.errorMessage.isEmpty() ? QString("Failed to decode") : result.errorMessage;
+        return false;
+    }
+    
+    std::shared_ptr<VolumeStatistics> statistics =
+        VolumeStatistics::compute(result.imageData, result.sclSlope, result.sclInter);
+    if (!statistics) {
+        error = "Unsupported scalar type";
+        return false;
+    }
+    
+    int extent[6];
+    QJsonArray nonZeroExtent;
+    if (statistics->getNonZeroExtent(extent)) {
+        for (int value : extent) {
+            nonZeroExtent.append(value);
+        }
+    }
+    
+    record.insert("count", static_cast<double>(statistics->count()));
+    record.insert("nonFinite", static_cast<double>(statistics->nonFiniteCount()));
+    if (statistics->count() > 0) {
+        // Real-world values: scl_slope and scl_inter applied when the file is scaled
+        record.insert("scaled", statistics->isScaled());
+        record.insert("min", statistics->scaledMinimum());
+        record.insert("max", statistics->scaledMaximum());
+        record.insert("mean", statistics->scaledMean());
+        record.insert("std", statistics->scaledStandardDeviation());
+        record.insert("p01", statistics->scaledPercentile(0.01));
+        record.insert("p50", statistics->scaledPercentile(0.50));
+        record.insert("p99", statistics->scaledPercentile(0.99));
+    }
+    record.insert("nonZeroVoxels", static_cast<double>(statistics->nonZeroVoxels()));
+    record.insert("nonZeroExtent", nonZeroExtent);
+    record.insert("loadSeconds", result.seconds);
+    record.insert("statsSeconds", statistics->computeSeconds());
+    return true;
+}
+
+/**
+ * Writes the middle slice of the chosen plane as an 8-bit PNG
+ * 
+ * Grey levels span the 1st to 99th percentile of the whole volume, the
+ * same window as the viewer's default contrast. Rows are flipped so the
+ * image has the viewer's orientation, and the aspect follows the voxel
+ * spacing.
+ */
+bool BatchProcessor::writeThumbnail(const QString &filePath, QJsonObject &record, QString &error)
+{
+    FileManager::LoadOptions options;
+    options.parallelDecompression = false;  // Files already run in parallel
+    options.lazyLoading = false;
+    options.compactStorage = false;         // Read once and dropped; narrowing would only add a pass
+    FileManager::LoadResult result = FileManager::readVolume(filePath, options, nullptr, m_cancelFlag, nullptr);
+    if (!result.imageData) {
+        error = result.errorMessage.isEmpty() ? QString("Failed to decode") : result.errorMessage;
+        return false;
+    }
+    std::shared_ptr<VolumeStatistics> statistics = VolumeStatistics::compute(result.imageData);
+    std::shared_ptr<IntensityHistogram> histogram = statistics ? statistics->histogram() : nullptr;
+    if (!histogram) {
+        error = "No finite voxel values";
+        return false;
+    }
+    
+    int dims[3];
+    result.imageData->GetDimensions(dims);
+    const int cursor[3] = { dims[0] / 2, dims[1] / 2, dims[2] / 2 };
+    
+    const int planeIndex = m_options.thumbnailPlane;
+    OrthogonalSlicer slicer;
+    slicer.setVolume(result.imageData);
+    if (!slicer.extract(cursor, 1 << planeIndex)) {
+        error = "Failed to extract the slice";
+        return false;
+    }
+    vtkImageData *plane = slicer.plane(planeIndex);
+    vtkDataArray *scalars = plane->GetPointData()->GetScalars();
+    
+    double window = 1.0;
+    double level = 0.0;
+    histogram->percentileWindow(THUMBNAIL_LOW_PERCENTILE, THUMBNAIL_HIGH_PERCENTILE, window, level);
+    const double low = level - 0.5 * window;
+    
+    int planeDims[3];
+    double spacing[3];
+    plane->GetDimensions(planeDims);
+    plane->GetSpacing(spacing);
+    const int width = planeDims[0];
+    const int height = planeDims[1];
+    
+    // First component only; VTK row 0 is the bottom of the image
+    QImage image(width, height, QImage::Format_Grayscale8);
+    for (int y = 0; y < height; ++y) {
+        uchar *line = image.scanLine(height - 1 - y);
+        for (int x = 0; x < width; ++x) {
+            const double value = scalars->GetComponent(static_cast<vtkIdType>(y) * width + x, 0);
+            const double grey = std::isfinite(value) ? (value - low) / window * 255.0 : 0.0;
+            line[x] = static_cast<uchar>(std::max(0.0, std::min(255.0, grey)));
+        }
+    }
+    
+    // Physical aspect, then fit the longest edge to the requested size
+    const double physicalWidth = width * std::abs(spacing[0]);
+    const double physicalHeight = height * std::abs(spacing[1]);
+    const double scale = m_options.thumbnailSize / std::max(physicalWidth, physicalHeight);
+    const int thumbnailWidth = std::max(1, static_cast<int>(std::lround(physicalWidth * scale)));
+    const int thumbnailHeight = std::max(1, static_cast<int>(std::lround(physicalHeight * scale)));
+    image = image.scaled(thumbnailWidth, thumbnailHeight, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    
+    const QString target = outputPath(filePath, ".png");
+    if (!image.save(target, "PNG")) {
+        error = QString("Cannot write %1").arg(target);
+        return false;
+    }
+    
+    record.insert("output", target);
+    record.insert("width", thumbnailWidth);
+    record.insert("height", thumbnailHeight);
+    record.insert("window", window);
+    record.insert("level", level);
+    return true;
+}
+
+/**
+ * Rewrites a file as BGZF: independent gzip members of at most 64 KB
+ * 
+ * The result is still a valid .nii.gz for any reader, and the viewer
+ * inflates it on all cores (GzipBlockIndex) and seeks in it through the
+ * .gzi sidecar written next to it. The input is streamed, so
+ * memory use does not depend on the file size. QSaveFile only replaces
+ * the target once the whole file is written, which also makes it safe
+ * to recompress a file into its own directory.
+ */
+bool BatchProcessor::recompress(const QString &filePath, QJsonObject &record, QString &error)
+{
+    QElapsedTimer timer;
+    timer.start();
+    
+    QFile source(filePath);
+    if (!source.open(QIODevice::ReadOnly)) {
+        error = source.errorString();
+        return false;
+    }
+    
+    const QString target = outputPath(filePath, ".nii.gz");
+    QSaveFile output(target);
+    if (!output.open(QIODevice::WriteOnly)) {
+        error = output.errorString();
+        return false;
+    }
+    
+    GzipBlockDeflater deflater(m_options.compressionLevel);
+    GzipBlockIndex blockIndex;
+    std::vector<char> block(GzipBlockDeflater::MAX_BLOCK_BYTES);
+    int filled = 0;
+    qint64 uncompressedBytes = 0;
+    QByteArray member;
+    
+    auto writeBlock = [&]() {
+        member.clear();
+        if (!deflater.encode(block.data(), filled, member) || output.write(member) != member.size()) {
+            return false;
+        }
+        blockIndex.appendMember(member.size(), filled);
+        uncompressedBytes += filled;
+        filled = 0;
+        return true;
+    };
+    
+    // Cut the decoded stream into full blocks; only the last one may be short
+    auto sink = [&](const char *data, qint64 size) {
+        while (size > 0) {
+            const int take = static_cast<int>(std::min<qint64>(size, block.size() - filled));
+            std::copy(data, data + take, block.data() + filled);
+            filled += take;
+            data += take;
+            size -= take;
+            if (filled == static_cast<int>(block.size()) && !writeBlock()) {
+                return false;
+            }
+        }
+        return true;
+    };
+    
+    const bool gzip = filePath.endsWith(".gz", Qt::CaseInsensitive);
+    if (!streamDecoded(source, gzip, sink) || (filled > 0 && !writeBlock())) {
+        output.cancelWriting();
+        error = "Read, decompression or write failed";
+        return false;
+    }
+    
+    const QByteArray endOfFile = GzipBlockDeflater::endOfFile();
+    if (output.write(endOfFile) != endOfFile.size() || !output.commit()) {
+        error = QString("Cannot write %1").arg(target);
+        return false;
+    }
+    blockIndex.appendMember(endOfFile.size(), 0);
+    
+    record.insert("output", target);
+    record.insert("index", blockIndex.saveSidecar(target) ? GzipBlockIndex::sidecarPath(target) : QString());
+    record.insert("inputBytes", static_cast<double>(source.size()));
+    record.insert("outputBytes", static_cast<double>(QFileInfo(target).size()));
+    record.insert("uncompressedBytes", static_cast<double>(uncompressedBytes));
+    record.insert("seconds", timer.elapsed() / 1000.0);
+    return true;
+}
+
+/**
+ * Writes the .gzi sidecar of an existing BGZF file, as bgzip -r does
+ * 
+ * Files written by other BGZF tools can then be opened without a scan.
+ * The sidecar goes next to the file, where readers look for it.
+ */
+bool BatchProcessor::writeIndex(const QString &filePath, QJsonObject &record, QString &error)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+    const uchar *data = file.map(0, file.size());
+    GzipBlockIndex blockIndex;
+    if (!data || !blockIndex.scan(data, file.size())) {
+        error = "Not a block-compressed (BGZF) file; recompress it first";
+        return false;
+    }
+    
+    const QString target = GzipBlockIndex::sidecarPath(filePath);
+    if (!blockIndex.saveSidecar(filePath)) {
+        error = QString("Cannot write %1").arg(target);
+        return false;
+    }
+    
+    record.insert("output", target);
+    record.insert("blocks", blockIndex.blockCount());
+    record.insert("uncompressedBytes", static_cast<double>(blockIndex.uncompressedSize()));
+    return true;
+}
+
+/**
+ * Passes the uncompressed bytes of a .nii or .nii.gz to sink in pieces
+ * 
+ * Reads through VoxelStream, so concatenated gzip members (pigz, BGZF)
+ * are followed as in the reader. Stops and returns false when sink does.
+ */
+bool BatchProcessor::streamDecoded(QFile &source, bool gzip,
+                                   const std::function<bool(const char *, qint64)> &sink)
+{
+    VoxelStream stream(source, gzip);
+    if (!stream.open()) {
+        return false;
+    }
+    
+    std::vector<char> buffer(BUFFER_SIZE);
+    qint64 produced = 0;
+    qint64 n = 0;
+    while ((n = stream.read(buffer.data(), buffer.size())) > 0) {
+        produced += n;
+        if (!sink(buffer.data(), n)) {
+            return false;
+        }
+    }
+    
+    // A truncated gzip stream reads short without reaching its end
+    return n == 0 && stream.atEnd() && (!gzip || produced > 0);
+}
+
+/**
+ * Replaces each directory by its .nii and .nii.gz files, in name order
+ */
+QStringList BatchProcessor::expandPaths(const QStringList &paths)
+{
+    QStringList files;
+    for (const QString &path : paths) {
+        if (QFileInfo(path).isDir()) {
+            files << NiftiHeaderScanner::listFiles(path);
+        } else {
+            files << path;
+        }
+    }
+    return files;
+}
+
+QString BatchProcessor::outputPath(const QString &filePath, const QString &suffix) const
+{
+    return QDir(m_options.outputDirectory).filePath(volumeBaseName(filePath) + suffix);
+}
+
+/**
+ * Budget a job takes before it starts
+ * 
+ * Decoding commands hold the size of the first volume, read from the
+ * header alone; streaming commands only their buffers. Never more than
+ * the whole budget, so an oversized file waits for the pool to drain and
+ * then runs by itself.
+ */
+qint64 BatchProcessor::reserveBytes(const QString &filePath) const
+{
+    if (m_options.command == HEADER || m_options.command == RECOMPRESS || m_options.command == INDEX) {
+        return std::min(STREAM_RESERVE_BYTES, m_options.memoryBudget);
+    }
+    
+    const NiftiHeaderScanner::Entry entry = NiftiHeaderScanner::scanFile(filePath);
+    const qint64 volumeBytes = entry.errorString.isEmpty() ? entry.header.bytesPerVolume() : 0;
+    return std::min(std::max(volumeBytes, STREAM_RESERVE_BYTES), m_options.memoryBudget);
+}
+
+void BatchProcessor::acquire(qint64 bytes)
+{
+    std::unique_lock<std::mutex> lock(m_budgetMutex);
+    m_budgetReleased.wait(lock, [this, bytes]() {
+        return m_bytesInFlight + bytes <= m_options.memoryBudget;
+    });
+    m_bytesInFlight += bytes;
+}
+
+void BatchProcessor::release(qint64 bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_budgetMutex);
+        m_bytesInFlight -= bytes;
+    }
+    m_budgetReleased.notify_all();
+}
+
+void BatchProcessor::printRecord(const QJsonObject &record)
+{
+    const QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+    std::lock_guard<std::mutex> lock(m_outputMutex);
+    std::fwrite(line.constData(), 1, static_cast<size_t>(line.size()), stdout);
+    std::fputc('\n', stdout);
+    std::fflush(stdout);
+}
+
+void BatchProcessor::printError(const QString &filePath, const QString &error)
+{
+    m_failures.fetch_add(1);
+    std::lock_guard<std::mutex> lock(m_outputMutex);
+    std::fprintf(stderr, "%s: %s\n", qPrintable(filePath), qPrintable(error));
+    std::fflush(stderr);
+}
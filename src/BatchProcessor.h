@@ -0,0 +1,104 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+// Qt base classes for paths and JSON records
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+
+// Standard library for the memory budget and shared counters
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// Forward declarations
+class QFile;                // Source of a recompression
+
+/**
+ * BatchProcessor - Headless processing of many NIfTI files from the command line
+ * 
+ * Runs when the first argument of NiftiViewer is a command instead of a
+ * file, so the same binary serves QC jobs on nodes without a display:
+ * 
+ *   NiftiViewer header     <files or directories>
+ *   NiftiViewer stats      <files or directories>
+ *   NiftiViewer thumbnail  -o <dir> [--size N] [--plane axial|coronal|sagittal] <...>
+ *   NiftiViewer recompress -o <dir> [--level N] <...>
+ *   NiftiViewer index      <files or directories>
+ * 
+ * Volumes are decoded through FileManager::readVolume(), the worker
+ * behind the viewer's own loads, so both see the same voxels and
+ * statistics. Files are processed in parallel on a thread pool; before a
+ * job decodes anything it reserves its volume size from a shared memory
+ * budget and waits while the budget is used up, which bounds the decoded
+ * bytes in flight however many threads run. A file larger than the whole
+ * budget runs alone.
+ * 
+ * Each processed file prints one JSON object per line on stdout; errors
+ * go to stderr and make the exit code non-zero.
+ */
+class BatchProcessor
+{
+public:
+    enum Command {
+        HEADER,                // Print the parsed header
+        STATS,                 // Decode and print VolumeStatistics
+        THUMBNAIL,             // Write a PNG of the middle slice
+        RECOMPRESS,            // Rewrite as block-compressed (BGZF) .nii.gz
+        INDEX                  // Write the .gzi sidecar of BGZF files
+    };
+    
+    /**
+     * Parsed command line
+     */
+    struct Options {
+        Command command = HEADER;                // What to do with each file
+        QString outputDirectory;                 // Target of thumbnails and recompressed files
+        int jobs = 1;                            // Files processed at the same time
+        qint64 memoryBudget = 0;                 // Decoded bytes in flight across all jobs
+        int thumbnailSize = 256;                 // Longest thumbnail edge in pixels
+        int thumbnailPlane = 0;                  // OrthogonalSlicer::Plane of the thumbnail
+        int compressionLevel = 6;                // zlib level of recompressed files
+    };
+    
+    static bool isCommand(const QString &argument);      // Whether argv[1] selects batch mode
+    static int run(const QStringList &arguments);        // Parse, process, and return the exit code
+    
+    explicit BatchProcessor(const Options &options);
+    int process(const QStringList &filePaths);           // Run every file; returns the failure count
+
+private:
+    // Per-file work - runs on a pool thread, fills record or error
+    bool processFile(const QString &filePath, QJsonObject &record, QString &error);
+    bool dumpHeader(const QString &filePath, QJsonObject &record, QString &error);
+    bool computeStats(const QString &filePath, QJsonObject &record, QString &error);
+    bool writeThumbnail(const QString &filePath, QJsonObject &record, QString &error);
+    bool recompress(const QString &filePath, QJsonObject &record, QString &error);
+    bool writeIndex(const QString &filePath, QJsonObject &record, QString &error);
+    
+    // Helpers
+    static bool streamDecoded(QFile &source, bool gzip,
+                              const std::function<bool(const char *, qint64)> &sink); // Feed the uncompressed bytes of a file
+    static QStringList expandPaths(const QStringList &paths); // Directories become their NIfTI files
+    QString outputPath(const QString &filePath, const QString &suffix) const; // Target beside other outputs
+    qint64 reserveBytes(const QString &filePath) const;  // Budget a job holds while it runs
+    void acquire(qint64 bytes);                          // Wait until bytes fit the budget
+    void release(qint64 bytes);                          // Return bytes and wake waiting jobs
+    void printRecord(const QJsonObject &record);         // One JSON line on stdout
+    void printError(const QString &filePath, const QString &error); // One line on stderr
+    
+    Options m_options;                                   // Command and limits
+    std::shared_ptr<std::atomic_bool> m_cancelFlag;      // Never set; readVolume() requires one
+    
+    // Memory budget shared by the pool threads
+    std::mutex m_budgetMutex;                            // Guards m_bytesInFlight
+    std::condition_variable m_budgetReleased;            // Signalled by release()
+    qint64 m_bytesInFlight;                              // Bytes reserved by running jobs
+    
+    std::mutex m_outputMutex;                            // Keeps lines from interleaving
+    std::atomic<int> m_failures;                         // Files that failed
+};
+
+#endif // BATCHPROCESSOR_H
@@ -0,0 +1,239 @@
+#include "BrickedVolume.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSetGet.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+
+namespace {
+
+const int BRICK_MASK = BrickedVolume::BRICK_SIZE - 1;
+const vtkIdType BRICK_VOXELS = static_cast<vtkIdType>(BrickedVolume::BRICK_SIZE) *
+                               BrickedVolume::BRICK_SIZE * BrickedVolume::BRICK_SIZE;
+
+/**
+ * Morton offsets inside a brick, one table per axis
+ * 
+ * The offset of a voxel is the OR of its three entries: bit i of the
+ * local coordinate along an axis lands on bit 3i + axis, so x, y and z
+ * bits interleave and every cache line holds a small cube of voxels.
+ */
+struct MortonTable {
+    int offset[3][BrickedVolume::BRICK_SIZE];
+    
+    MortonTable()
+    {
+        for (int axis = 0; axis < 3; ++axis) {
+            for (int local = 0; local < BrickedVolume::BRICK_SIZE; ++local) {
+                int code = 0;
+                for (int bit = 0; bit < BrickedVolume::BRICK_SHIFT; ++bit) {
+                    code |= ((local >> bit) & 1) << (3 * bit + axis);
+                }
+                offset[axis][local] = code;
+            }
+        }
+    }
+};
+
+const MortonTable MORTON;
+
+/**
+ * Copies the volume into bricks, one z layer of bricks per task
+ * 
+ * The source is read row by row, front to back, and each voxel is
+ * scattered to its Morton offset in a brick that stays in L1. The cancel
+ * flag is checked per layer.
+ */
+template <typename T>
+void fillBricks(const T *src, const int *dims, const int *brickCounts, int components, T *dst,
+                const std::atomic_bool *cancelFlag)
+{
+    const int size = BrickedVolume::BRICK_SIZE;
+    vtkSMPTools::For(0, brickCounts[2], 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType bz = begin; bz < end; ++bz) {
+            if (cancelFlag && cancelFlag->load()) {
+                return;
+            }
+            for (int by = 0; by < brickCounts[1]; ++by) {
+                for (int bx = 0; bx < brickCounts[0]; ++bx) {
+                    const vtkIdType brick = bx + static_cast<vtkIdType>(brickCounts[0]) *
+                                                 (by + static_cast<vtkIdType>(brickCounts[1]) * bz);
+                    T *out = dst + brick * BRICK_VOXELS * components;
+                    const int width = std::min(size, dims[0] - bx * size);
+                    
+                    for (int lz = 0; lz < size; ++lz) {
+                        const int z = static_cast<int>(bz) * size + lz;
+                        for (int ly = 0; ly < size; ++ly) {
+                            const int y = by * size + ly;
+                            if (z >= dims[2] || y >= dims[1]) {
+                                continue;
+                            }
+                            const T *row = src + ((static_cast<vtkIdType>(z) * dims[1] + y) * dims[0] +
+                                                  bx * size) * components;
+                            const int inner = MORTON.offset[2][lz] | MORTON.offset[1][ly];
+                            for (int lx = 0; lx < width; ++lx) {
+                                T *voxel = out + static_cast<vtkIdType>(inner | MORTON.offset[0][lx]) * components;
+                                for (int c = 0; c < components; ++c) {
+                                    voxel[c] = row[lx * components + c];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+/**
+ * Copies plane rows out of the bricks
+ * 
+ * Rows are taken a brick row at a time, and each brick crossed by it is
+ * emptied of all its voxels in the plane before moving to the next, so
+ * every brick is fetched once. Voxels are gathered through the Morton
+ * tables of the plane's axes.
+ */
+template <typename T>
+void copyRows(const T *bricks, const int *dims, const int *brickCounts, int components,
+              int normalAxis, int normalIndex, int columnAxis, int rowAxis, int rowBegin, int rowEnd, T *dst)
+{
+    const int size = BrickedVolume::BRICK_SIZE;
+    const vtkIdType brickStride[3] = {
+        1,
+        brickCounts[0],
+        static_cast<vtkIdType>(brickCounts[0]) * brickCounts[1]
+    };
+    const int width = dims[columnAxis];
+    const int *columnOffset = MORTON.offset[columnAxis];
+    const int *rowOffset = MORTON.offset[rowAxis];
+    const vtkIdType normalBrick = brickStride[normalAxis] * (normalIndex >> BrickedVolume::BRICK_SHIFT);
+    const int normalInner = MORTON.offset[normalAxis][normalIndex & BRICK_MASK];
+    
+    int row = rowBegin;
+    while (row < rowEnd) {
+        // Rows up to the end of the current brick row
+        const int blockEnd = std::min(rowEnd, (row & ~BRICK_MASK) + size);
+        const vtkIdType rowBrick = normalBrick + brickStride[rowAxis] * (row >> BrickedVolume::BRICK_SHIFT);
+        
+        for (int column = 0; column < width; column += size) {
+            const vtkIdType brick = rowBrick + brickStride[columnAxis] * (column >> BrickedVolume::BRICK_SHIFT);
+            const T *in = bricks + brick * BRICK_VOXELS * components;
+            const int count = std::min(size, width - column);
+            
+            for (int r = row; r < blockEnd; ++r) {
+                const int inner = normalInner | rowOffset[r & BRICK_MASK];
+                T *out = dst + (static_cast<vtkIdType>(r) * width + column) * components;
+                if (components == 1) {
+                    for (int i = 0; i < count; ++i) {
+                        out[i] = in[inner | columnOffset[i]];
+                    }
+                    continue;
+                }
+                for (int i = 0; i < count; ++i) {
+                    const T *voxel = in + static_cast<vtkIdType>(inner | columnOffset[i]) * components;
+                    for (int c = 0; c < components; ++c) {
+                        out[c] = voxel[c];
+                    }
+                    out += components;
+                }
+            }
+        }
+        row = blockEnd;
+    }
+}
+
+} // namespace
+
+BrickedVolume::BrickedVolume()
+    : m_bytes(0)
+    , m_components(0)
+    , m_dataType(0)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        m_dimensions[axis] = 0;
+        m_brickCounts[axis] = 0;
+    }
+}
+
+/**
+ * Copies a volume into bricks on all cores
+ * 
+ * Costs one pass over the volume and roughly its size again in memory.
+ */
+std::shared_ptr<BrickedVolume> BrickedVolume::build(vtkSmartPointer<vtkImageData> volume,
+                                                    std::shared_ptr<std::atomic_bool> cancelFlag)
+{
+    if (!volume || !volume->GetPointData() || !volume->GetPointData()->GetScalars()) {
+        return nullptr;
+    }
+    
+    std::shared_ptr<BrickedVolume> bricked(new BrickedVolume());
+    bricked->m_source = volume;
+    volume->GetDimensions(bricked->m_dimensions);
+    
+    vtkDataArray *scalars = volume->GetPointData()->GetScalars();
+    bricked->m_components = scalars->GetNumberOfComponents();
+    bricked->m_dataType = scalars->GetDataType();
+    
+    qint64 brickTotal = 1;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (bricked->m_dimensions[axis] < 1) {
+            return nullptr;
+        }
+        bricked->m_brickCounts[axis] = (bricked->m_dimensions[axis] + BRICK_SIZE - 1) >> BRICK_SHIFT;
+        brickTotal *= bricked->m_brickCounts[axis];
+    }
+    bricked->m_bytes = brickTotal * BRICK_VOXELS * bricked->m_components * volume->GetScalarSize();
+    bricked->m_data.reset(new unsigned char[bricked->m_bytes]);
+    
+    switch (bricked->m_dataType) {
+        vtkTemplateMacro(fillBricks(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)),
+                                    bricked->m_dimensions, bricked->m_brickCounts, bricked->m_components,
+                                    reinterpret_cast<VTK_TT *>(bricked->m_data.get()), cancelFlag.get()));
+        default:
+            return nullptr;
+    }
+    
+    if (cancelFlag && cancelFlag->load()) {
+        return nullptr;
+    }
+    return bricked;
+}
+
+/**
+ * Fills rows of a plane image from the bricks
+ * 
+ * The axes and output layout follow OrthogonalSlicer: columns run along
+ * columnAxis, and row r starts r full rows into destination. Rows are
+ * independent, so callers may split a plane across threads.
+ */
+bool BrickedVolume::copyPlaneRows(int normalAxis, int normalIndex, int columnAxis, int rowAxis,
+                                  int rowBegin, int rowEnd, void *destination) const
+{
+    if (normalIndex < 0 || normalIndex >= m_dimensions[normalAxis] ||
+        rowBegin < 0 || rowEnd > m_dimensions[rowAxis]) {
+        return false;
+    }
+    
+    switch (m_dataType) {
+        vtkTemplateMacro(copyRows(reinterpret_cast<const VTK_TT *>(m_data.get()), m_dimensions, m_brickCounts,
+                                  m_components, normalAxis, normalIndex, columnAxis, rowAxis, rowBegin, rowEnd,
+                                  static_cast<VTK_TT *>(destination)));
+        default:
+            return false;
+    }
+    return true;
+}
+
+vtkImageData *BrickedVolume::source() const
+{
+    return m_source;
+}
+
+qint64 BrickedVolume::bytes() const
+{
+    return m_bytes;
+}
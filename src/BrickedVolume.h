@@ -0,0 +1,61 @@
+#ifndef BRICKEDVOLUME_H
+#define BRICKEDVOLUME_H
+
+// Qt types for byte counts
+#include <QtGlobal>
+
+// VTK smart pointer for the source volume
+#include <vtkSmartPointer.h>
+
+// Standard library for the brick storage and the cancellation flag
+#include <atomic>
+#include <memory>
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * BrickedVolume - A copy of a volume stored as small cubic bricks
+ * 
+ * NIfTI voxels are x-fastest, so an axial plane is one contiguous run
+ * while a sagittal plane touches a new cache line, and every few rows a
+ * new page, for each voxel. Here the volume is cut into BRICK_SIZE^3
+ * bricks that are each contiguous and Morton-ordered inside, with the
+ * bricks themselves in x-fastest order. Every cache line then holds a
+ * small cube of voxels and every brick fits in L1, so a plane of any
+ * orientation reads about the same amount of memory.
+ * 
+ * Edge bricks are padded to full size so addressing needs no bounds
+ * checks; the padding is never read. build() is meant for a worker
+ * thread; a finished copy is read-only and may be shared between threads.
+ */
+class BrickedVolume
+{
+public:
+    static const int BRICK_SHIFT = 3;                    // log2 of the brick edge
+    static const int BRICK_SIZE = 1 << BRICK_SHIFT;      // Voxels along each brick edge
+    
+    static std::shared_ptr<BrickedVolume> build(vtkSmartPointer<vtkImageData> volume,
+                                                std::shared_ptr<std::atomic_bool> cancelFlag); // Null if cancelled or unsupported
+    
+    // Plane access - same row-major, x-fastest output as OrthogonalSlicer's plane images
+    bool copyPlaneRows(int normalAxis, int normalIndex, int columnAxis, int rowAxis,
+                       int rowBegin, int rowEnd, void *destination) const; // Fill rows [rowBegin, rowEnd) of a plane
+    
+    // Properties
+    vtkImageData *source() const;                        // Volume the bricks were copied from
+    qint64 bytes() const;                                // Memory held by the bricks, padding included
+
+private:
+    vtkSmartPointer<vtkImageData> m_source;              // Volume the copy was made from
+    std::unique_ptr<unsigned char[]> m_data;             // Bricks, each BRICK_SIZE^3 voxels
+    qint64 m_bytes;                                      // Size of m_data
+    int m_dimensions[3];                                 // Voxels along each axis
+    int m_brickCounts[3];                                // Bricks along each axis
+    int m_components;                                    // Scalar components per voxel
+    int m_dataType;                                      // VTK scalar type
+    
+    BrickedVolume();
+};
+
+#endif // BRICKEDVOLUME_H
@@ -0,0 +1,156 @@
+#include "ContactSheet.h"
+
+#include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QHBoxLayout>
+#include <QPixmap>
+#include <QThread>
+#include <QVBoxLayout>
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace {
+
+const int TILE_SIZE = 128;                               // Edge of one plane tile in pixels
+const qint64 CACHE_SIZE = 64LL * 1024 * 1024;            // Disk space for cached strips, a few thousand scans
+
+} // namespace
+
+ContactSheet::ContactSheet(QWidget *parent)
+    : QWidget(parent)
+    , m_directoryLabel(nullptr)
+    , m_chooseButton(nullptr)
+    , m_grid(nullptr)
+    , m_summaryLabel(nullptr)
+    , m_cacheDirectory(ThumbnailService::defaultCacheDirectory())
+    , m_thumbnailWatcher(nullptr)
+    , m_cachedCount(0)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    
+    // Folder selection
+    QHBoxLayout *folderLayout = new QHBoxLayout();
+    m_directoryLabel = new QLabel("No folder selected");
+    m_chooseButton = new QPushButton("Choose Folder...");
+    folderLayout->addWidget(m_directoryLabel, 1);
+    folderLayout->addWidget(m_chooseButton);
+    layout->addLayout(folderLayout);
+    
+    // Grid of strips - uniform cells keep hundreds of scans cheap to lay out
+    m_grid = new QListWidget();
+    m_grid->setViewMode(QListView::IconMode);
+    m_grid->setIconSize(QSize(3 * TILE_SIZE, TILE_SIZE));
+    m_grid->setResizeMode(QListView::Adjust);
+    m_grid->setMovement(QListView::Static);
+    m_grid->setUniformItemSizes(true);
+    m_grid->setSpacing(4);
+    layout->addWidget(m_grid, 1);
+    
+    m_summaryLabel = new QLabel();
+    layout->addWidget(m_summaryLabel);
+    
+    m_thumbnailPool.setMaxThreadCount(QThread::idealThreadCount());
+    
+    m_thumbnailWatcher = new QFutureWatcher<ThumbnailService::Entry>(this);
+    connect(m_thumbnailWatcher, &QFutureWatcher<ThumbnailService::Entry>::resultsReadyAt,
+            this, &ContactSheet::onResultsReady);
+    connect(m_thumbnailWatcher, &QFutureWatcher<ThumbnailService::Entry>::finished,
+            this, &ContactSheet::onPassFinished);
+    connect(m_chooseButton, &QPushButton::clicked, this, &ContactSheet::chooseDirectory);
+    connect(m_grid, &QListWidget::itemActivated, this, &ContactSheet::onItemActivated);
+}
+
+ContactSheet::~ContactSheet()
+{
+    m_thumbnailWatcher->cancel();
+    m_thumbnailWatcher->waitForFinished();
+}
+
+void ContactSheet::setDirectory(const QString &directory)
+{
+    // A pass over the previous folder stops scheduling new files right away
+    m_thumbnailWatcher->cancel();
+    m_thumbnailWatcher->waitForFinished();
+    
+    m_directory = directory;
+    m_directoryLabel->setText(QDir(directory).dirName());
+    m_directoryLabel->setToolTip(directory);
+    
+    // Cells exist up front in name order; results fill them by index
+    const QStringList files = NiftiHeaderScanner::listFiles(directory);
+    m_grid->clear();
+    for (const QString &filePath : files) {
+        QListWidgetItem *item = new QListWidgetItem(QFileInfo(filePath).fileName());
+        item->setData(Qt::UserRole, filePath);
+        item->setToolTip(filePath);
+        item->setSizeHint(QSize(3 * TILE_SIZE + 8, TILE_SIZE + m_grid->fontMetrics().height() + 12));
+        m_grid->addItem(item);
+    }
+    m_summaryLabel->setText(QString("Rendering %1 thumbnails...").arg(files.size()));
+    
+    m_cachedCount = 0;
+    m_passTimer.start();
+    const QString cacheDirectory = m_cacheDirectory;
+    m_thumbnailWatcher->setFuture(QtConcurrent::mapped(&m_thumbnailPool, files,
+        [cacheDirectory](const QString &filePath) {
+            return ThumbnailService::thumbnail(filePath, TILE_SIZE, cacheDirectory);
+        }));
+}
+
+QString ContactSheet::directory() const
+{
+    return m_directory;
+}
+
+void ContactSheet::chooseDirectory()
+{
+    QString directory = QFileDialog::getExistingDirectory(
+        this,
+        "Select Folder",
+        m_directory.isEmpty() ? QDir::homePath() : m_directory
+    );
+    
+    if (!directory.isEmpty()) {
+        setDirectory(directory);
+    }
+}
+
+void ContactSheet::onResultsReady(int begin, int end)
+{
+    for (int i = begin; i < end; ++i) {
+        const ThumbnailService::Entry entry = m_thumbnailWatcher->resultAt(i);
+        QListWidgetItem *item = m_grid->item(i);
+        if (!item) {
+            continue;
+        }
+        if (entry.image.isNull()) {
+            item->setText(QFileInfo(entry.filePath).fileName() + " (unreadable)");
+            item->setToolTip(entry.filePath + "\n" + entry.errorString);
+            continue;
+        }
+        item->setIcon(QIcon(QPixmap::fromImage(entry.image)));
+        if (entry.cached) {
+            ++m_cachedCount;
+        }
+    }
+}
+
+void ContactSheet::onPassFinished()
+{
+    if (m_thumbnailWatcher->isCanceled()) {
+        return;
+    }
+    
+    m_summaryLabel->setText(QString("%1 scans, %2 from cache, %3 ms")
+                                .arg(m_grid->count())
+                                .arg(m_cachedCount)
+                                .arg(m_passTimer.elapsed()));
+    
+    // Between passes nothing writes to the cache
+    ThumbnailService::trimCache(m_cacheDirectory, CACHE_SIZE);
+}
+
+void ContactSheet::onItemActivated(QListWidgetItem *item)
+{
+    emit fileActivated(item->data(Qt::UserRole).toString());
+}
@@ -0,0 +1,64 @@
+#ifndef CONTACTSHEET_H
+#define CONTACTSHEET_H
+
+// Qt Widgets for the thumbnail grid
+#include <QWidget>
+#include <QLabel>
+#include <QPushButton>
+#include <QListWidget>
+
+// Qt concurrency for the background thumbnail pass
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <QThreadPool>
+
+#include "ThumbnailService.h"
+
+/**
+ * ContactSheet - Grid of middle-slice thumbnails of every scan in a folder
+ * 
+ * Each cell shows the axial, sagittal and coronal middle slice of one
+ * file, rendered by ThumbnailService on a private thread pool with one
+ * thread per core. Cells are laid out in name order up front and filled
+ * as thumbnails arrive; unchanged files come straight from the on-disk
+ * thumbnail cache. Activating a cell asks for the file to be opened.
+ */
+class ContactSheet : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ContactSheet(QWidget *parent = nullptr);
+    ~ContactSheet();
+    
+    void setDirectory(const QString &directory);         // Thumbnail a folder, replacing the current one
+    QString directory() const;                           // Folder being shown
+
+public slots:
+    void chooseDirectory();                              // Ask the user for a folder
+
+signals:
+    void fileActivated(const QString &filePath);         // Emitted when a cell is opened
+
+private slots:
+    void onResultsReady(int begin, int end);             // Fill cells for newly rendered thumbnails
+    void onPassFinished();                               // Report the time and trim the cache
+    void onItemActivated(QListWidgetItem *item);         // Forward the cell's file
+
+private:
+    // UI components
+    QLabel *m_directoryLabel;       // Folder being shown
+    QPushButton *m_chooseButton;    // Opens the folder dialog
+    QListWidget *m_grid;            // One cell per file
+    QLabel *m_summaryLabel;         // File count, cache hits and time
+    
+    // Thumbnail state
+    QString m_directory;                                 // Folder being shown
+    QString m_cacheDirectory;                            // Where rendered strips are kept
+    QThreadPool m_thumbnailPool;                         // Keeps thumbnails off the global pool used by loads
+    QFutureWatcher<ThumbnailService::Entry> *m_thumbnailWatcher; // Delivers thumbnails as they are made
+    QElapsedTimer m_passTimer;                           // Measures the current pass
+    int m_cachedCount;                                   // Thumbnails of the pass read from the cache
+};
+
+#endif // CONTACTSHEET_H
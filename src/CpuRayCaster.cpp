@@ -0,0 +1,513 @@
+#include "CpuRayCaster.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSetGet.h>
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const int BRICK_SIZE = 8;                         // Voxels per macrocell edge
+const int TABLE_SHIFT = 4;                        // 16-bit values index 4096 table entries
+const int TABLE_SIZE = 65536 >> TABLE_SHIFT;      // Transfer function resolution
+const float OPAQUE_ALPHA = 0.98f;                 // Composite rays stop at this opacity
+const float MAX_VALUE = 65535.0f;                 // MIP rays stop at the volume maximum
+const double SAMPLE_DISTANCE = 1.0;               // Ray step in units of the smallest voxel spacing
+const vtkIdType ROWS_PER_TASK = 4;                // Image rows per parallel task
+const double DEGREES_TO_RADIANS = 3.14159265358979323846 / 180.0;
+
+/**
+ * Scales the first component of every voxel into 0..65535
+ */
+template <typename T>
+void normalizeScalars(const T *src, int components, vtkIdType count,
+                      double minimum, double scale, uint16_t *dst)
+{
+    vtkSMPTools::For(0, count, 1 << 16, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i) {
+            double value = (static_cast<double>(src[i * components]) - minimum) * scale;
+            dst[i] = static_cast<uint16_t>(std::min(65535.0, std::max(0.0, value + 0.5)));
+        }
+    });
+}
+
+/**
+ * Radius of the sphere around the voxel centres; rays start on it
+ */
+double boundingRadius(const int *dims, const double *spacing)
+{
+    double extent[3];
+    double minSpacing = spacing[0];
+    for (int axis = 0; axis < 3; ++axis) {
+        extent[axis] = (dims[axis] - 1) * spacing[axis];
+        minSpacing = std::min(minSpacing, spacing[axis]);
+    }
+    return std::max(0.5 * minSpacing,
+        0.5 * std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]));
+}
+
+double clamp01(double value)
+{
+    return std::min(1.0, std::max(0.0, value));
+}
+
+/**
+ * Colour of a position t in 0..1 across the transfer function window
+ */
+void colorAt(CpuRayCaster::ColorMap colorMap, double t, float *rgb)
+{
+    switch (colorMap) {
+        case CpuRayCaster::HOT:
+            rgb[0] = static_cast<float>(clamp01(3.0 * t));
+            rgb[1] = static_cast<float>(clamp01(3.0 * t - 1.0));
+            rgb[2] = static_cast<float>(clamp01(3.0 * t - 2.0));
+            break;
+        case CpuRayCaster::BONE:
+            // Grayscale with a reversed hot tint, as in the classic bone map
+            rgb[0] = static_cast<float>(0.875 * t + 0.125 * clamp01(3.0 * t - 2.0));
+            rgb[1] = static_cast<float>(0.875 * t + 0.125 * clamp01(3.0 * t - 1.0));
+            rgb[2] = static_cast<float>(0.875 * t + 0.125 * clamp01(3.0 * t));
+            break;
+        default:
+            rgb[0] = rgb[1] = rgb[2] = static_cast<float>(t);
+            break;
+    }
+}
+
+} // namespace
+
+CpuRayCaster::CpuRayCaster()
+    : m_blendMode(MAXIMUM_INTENSITY)
+    , m_lastRenderSeconds(0.0)
+    , m_lastSampleCount(0)
+    , m_lastSkippedBricks(0)
+{
+    m_dims[0] = m_dims[1] = m_dims[2] = 0;
+    m_spacing[0] = m_spacing[1] = m_spacing[2] = 1.0;
+    m_range[0] = m_range[1] = 0.0;
+    m_bricks[0] = m_bricks[1] = m_bricks[2] = 0;
+    buildTables();
+}
+
+CpuRayCaster::~CpuRayCaster()
+{
+}
+
+/**
+ * Copies the volume into the caster's normalized layout
+ * 
+ * The copy is 2 bytes per voxel regardless of the input type; values are
+ * scaled from the volume's scalar range so the transfer function works on
+ * the same 0..1 scale for every datatype. A reduced copy of a volume
+ * passes the full volume's range so both render with the same colours.
+ */
+bool CpuRayCaster::setVolume(vtkImageData *volume, const double *range)
+{
+    clearVolume();
+    if (!volume || !volume->GetPointData() || !volume->GetPointData()->GetScalars()) {
+        return false;
+    }
+    
+    vtkDataArray *scalars = volume->GetPointData()->GetScalars();
+    volume->GetDimensions(m_dims);
+    volume->GetSpacing(m_spacing);
+    const vtkIdType count = static_cast<vtkIdType>(m_dims[0]) * m_dims[1] * m_dims[2];
+    if (count <= 0 || scalars->GetNumberOfTuples() < count) {
+        return false;
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        if (!(m_spacing[axis] > 0.0)) {
+            m_spacing[axis] = 1.0;
+        }
+    }
+    
+    if (range) {
+        m_range[0] = range[0];
+        m_range[1] = range[1];
+    } else {
+        scalars->GetRange(m_range, 0);
+    }
+    const double scale = m_range[1] > m_range[0] ? 65535.0 / (m_range[1] - m_range[0]) : 0.0;
+    const int components = scalars->GetNumberOfComponents();
+    
+    m_voxels.resize(static_cast<size_t>(count));
+    switch (scalars->GetDataType()) {
+        vtkTemplateMacro(normalizeScalars(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)),
+                                          components, count, m_range[0], scale, m_voxels.data()));
+        default:
+            clearVolume();
+            return false;
+    }
+    
+    buildBricks();
+    return true;
+}
+
+void CpuRayCaster::getScalarRange(double range[2]) const
+{
+    range[0] = m_range[0];
+    range[1] = m_range[1];
+}
+
+bool CpuRayCaster::hasVolume() const
+{
+    return !m_voxels.empty();
+}
+
+void CpuRayCaster::clearVolume()
+{
+    std::vector<uint16_t>().swap(m_voxels);
+    std::vector<uint16_t>().swap(m_brickMin);
+    std::vector<uint16_t>().swap(m_brickMax);
+    m_dims[0] = m_dims[1] = m_dims[2] = 0;
+    m_bricks[0] = m_bricks[1] = m_bricks[2] = 0;
+}
+
+void CpuRayCaster::setBlendMode(BlendMode mode)
+{
+    m_blendMode = mode;
+}
+
+CpuRayCaster::BlendMode CpuRayCaster::blendMode() const
+{
+    return m_blendMode;
+}
+
+void CpuRayCaster::setTransferFunction(const TransferFunction &transferFunction)
+{
+    m_transferFunction = transferFunction;
+    buildTables();
+}
+
+CpuRayCaster::TransferFunction CpuRayCaster::transferFunction() const
+{
+    return m_transferFunction;
+}
+
+void CpuRayCaster::setCamera(const Camera &camera)
+{
+    m_camera = camera;
+    m_camera.elevation = std::min(89.0, std::max(-89.0, camera.elevation));
+    m_camera.zoom = std::max(0.01, camera.zoom);
+}
+
+CpuRayCaster::Camera CpuRayCaster::camera() const
+{
+    return m_camera;
+}
+
+/**
+ * Casts one orthographic ray per pixel
+ * 
+ * Row 0 of the image is the bottom of the view, matching VTK's image
+ * orientation, so the result can be shown by a vtkImageActor unchanged.
+ */
+vtkImageData *CpuRayCaster::render(int width, int height)
+{
+    if (!hasVolume() || width < 1 || height < 1) {
+        return nullptr;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    if (!m_output || m_output->GetDimensions()[0] != width || m_output->GetDimensions()[1] != height) {
+        m_output = vtkSmartPointer<vtkImageData>::New();
+        m_output->SetDimensions(width, height, 1);
+        m_output->AllocateScalars(VTK_UNSIGNED_CHAR, 4);
+    }
+    unsigned char *pixels = static_cast<unsigned char *>(m_output->GetScalarPointer());
+    
+    // Orbit camera basis: view direction, right and up. At zero angles the
+    // camera sits on the -y side with +x to the right and +z up, like the
+    // coronal slice view.
+    const double azimuth = m_camera.azimuth * DEGREES_TO_RADIANS;
+    const double elevation = m_camera.elevation * DEGREES_TO_RADIANS;
+    const double view[3] = {std::sin(azimuth) * std::cos(elevation),
+                            std::cos(azimuth) * std::cos(elevation),
+                            -std::sin(elevation)};
+    const double right[3] = {std::cos(azimuth), -std::sin(azimuth), 0.0};
+    const double up[3] = {right[1] * view[2] - right[2] * view[1],
+                          right[2] * view[0] - right[0] * view[2],
+                          right[0] * view[1] - right[1] * view[0]};
+    
+    // Physical size of the volume; rays start on its bounding sphere
+    double extent[3];
+    double minSpacing = m_spacing[0];
+    for (int axis = 0; axis < 3; ++axis) {
+        extent[axis] = (m_dims[axis] - 1) * m_spacing[axis];
+        minSpacing = std::min(minSpacing, m_spacing[axis]);
+    }
+    const double radius = boundingRadius(m_dims, m_spacing);
+    const double pixelSize = 2.0 * radius / (std::min(width, height) * m_camera.zoom);
+    const double step = SAMPLE_DISTANCE * minSpacing;
+    
+    // Ray direction in voxel units per mm travelled
+    double direction[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        direction[axis] = view[axis] / m_spacing[axis];
+    }
+    
+    const int dims[3] = {m_dims[0], m_dims[1], m_dims[2]};
+    const int bricks[3] = {m_bricks[0], m_bricks[1], m_bricks[2]};
+    const int64_t strideY = dims[0];
+    const int64_t strideZ = static_cast<int64_t>(dims[0]) * dims[1];
+    const int64_t stepX = dims[0] > 1 ? 1 : 0;
+    const int64_t stepY = dims[1] > 1 ? strideY : 0;
+    const int64_t stepZ = dims[2] > 1 ? strideZ : 0;
+    const int maxCorner[3] = {std::max(0, dims[0] - 2), std::max(0, dims[1] - 2), std::max(0, dims[2] - 2)};
+    const uint16_t *voxels = m_voxels.data();
+    const bool composite = m_blendMode == COMPOSITE;
+    
+    std::atomic<long long> totalSamples(0);
+    std::atomic<long long> totalSkipped(0);
+    
+    vtkSMPTools::For(0, height, ROWS_PER_TASK, [&](vtkIdType rowBegin, vtkIdType rowEnd) {
+        long long samples = 0;
+        long long skipped = 0;
+        
+        for (vtkIdType row = rowBegin; row < rowEnd; ++row) {
+            for (int column = 0; column < width; ++column) {
+                unsigned char *pixel = pixels + 4 * (row * static_cast<int64_t>(width) + column);
+                pixel[3] = 255;
+                
+                // Ray origin in voxel coordinates
+                const double screenX = (column + 0.5 - 0.5 * width) * pixelSize;
+                const double screenY = (row + 0.5 - 0.5 * height) * pixelSize;
+                double origin[3];
+                for (int axis = 0; axis < 3; ++axis) {
+                    double world = screenX * right[axis] + screenY * up[axis] - radius * view[axis];
+                    origin[axis] = (world + 0.5 * extent[axis]) / m_spacing[axis];
+                }
+                
+                // Clip the ray to the voxel box
+                double tNear = 0.0;
+                double tFar = 2.0 * radius;
+                for (int axis = 0; axis < 3 && tNear <= tFar; ++axis) {
+                    if (std::abs(direction[axis]) < 1e-12) {
+                        if (origin[axis] < 0.0 || origin[axis] > dims[axis] - 1) {
+                            tNear = tFar + 1.0;
+                        }
+                        continue;
+                    }
+                    double t1 = -origin[axis] / direction[axis];
+                    double t2 = (dims[axis] - 1 - origin[axis]) / direction[axis];
+                    tNear = std::max(tNear, std::min(t1, t2));
+                    tFar = std::min(tFar, std::max(t1, t2));
+                }
+                if (tNear > tFar) {
+                    pixel[0] = pixel[1] = pixel[2] = 0;
+                    continue;
+                }
+                
+                float maximum = 0.0f;
+                float color[3] = {0.0f, 0.0f, 0.0f};
+                float alpha = 0.0f;
+                int64_t currentBrick = -1;
+                
+                for (double t = tNear; t <= tFar;) {
+                    const double x = origin[0] + t * direction[0];
+                    const double y = origin[1] + t * direction[1];
+                    const double z = origin[2] + t * direction[2];
+                    
+                    // Empty-space skipping, decided once per brick entered
+                    const int bx = std::min(static_cast<int>(x) / BRICK_SIZE, bricks[0] - 1);
+                    const int by = std::min(static_cast<int>(y) / BRICK_SIZE, bricks[1] - 1);
+                    const int bz = std::min(static_cast<int>(z) / BRICK_SIZE, bricks[2] - 1);
+                    const int64_t brick = bx + static_cast<int64_t>(bricks[0]) * (by + static_cast<int64_t>(bricks[1]) * bz);
+                    if (brick != currentBrick) {
+                        const bool empty = composite ? brickIsTransparent(brick) : m_brickMax[brick] <= maximum;
+                        if (empty) {
+                            // Jump to the first sample past the brick, staying on the step lattice
+                            const int cell[3] = {bx, by, bz};
+                            double tExit = tFar;
+                            for (int axis = 0; axis < 3; ++axis) {
+                                if (direction[axis] > 1e-12) {
+                                    tExit = std::min(tExit, ((cell[axis] + 1) * BRICK_SIZE - origin[axis]) / direction[axis]);
+                                } else if (direction[axis] < -1e-12) {
+                                    tExit = std::min(tExit, (cell[axis] * BRICK_SIZE - origin[axis]) / direction[axis]);
+                                }
+                            }
+                            double next = tNear + std::ceil((tExit - tNear) / step) * step;
+                            t = next > t ? next : t + step;
+                            ++skipped;
+                            continue;
+                        }
+                        currentBrick = brick;
+                    }
+                    
+                    // Trilinear sample
+                    const int x0 = std::min(static_cast<int>(x), maxCorner[0]);
+                    const int y0 = std::min(static_cast<int>(y), maxCorner[1]);
+                    const int z0 = std::min(static_cast<int>(z), maxCorner[2]);
+                    const float fx = static_cast<float>(std::min(1.0, std::max(0.0, x - x0)));
+                    const float fy = static_cast<float>(std::min(1.0, std::max(0.0, y - y0)));
+                    const float fz = static_cast<float>(std::min(1.0, std::max(0.0, z - z0)));
+                    const uint16_t *corner = voxels + x0 + y0 * strideY + z0 * strideZ;
+                    const float c00 = corner[0] + fx * (corner[stepX] - corner[0]);
+                    const float c10 = corner[stepY] + fx * (corner[stepY + stepX] - corner[stepY]);
+                    const float c01 = corner[stepZ] + fx * (corner[stepZ + stepX] - corner[stepZ]);
+                    const float c11 = corner[stepZ + stepY] + fx * (corner[stepZ + stepY + stepX] - corner[stepZ + stepY]);
+                    const float c0 = c00 + fy * (c10 - c00);
+                    const float c1 = c01 + fy * (c11 - c01);
+                    const float value = c0 + fz * (c1 - c0);
+                    ++samples;
+                    
+                    if (composite) {
+                        const int entry = static_cast<int>(value) >> TABLE_SHIFT;
+                        const float sampleAlpha = m_opacityTable[entry];
+                        if (sampleAlpha > 0.0f) {
+                            const float weight = (1.0f - alpha) * sampleAlpha;
+                            color[0] += weight * m_colorTable[3 * entry];
+                            color[1] += weight * m_colorTable[3 * entry + 1];
+                            color[2] += weight * m_colorTable[3 * entry + 2];
+                            alpha += weight;
+                            if (alpha >= OPAQUE_ALPHA) {
+                                break;  // Early ray termination
+                            }
+                        }
+                    } else if (value > maximum) {
+                        maximum = value;
+                        if (maximum >= MAX_VALUE) {
+                            break;  // Nothing brighter can follow
+                        }
+                    }
+                    t += step;
+                }
+                
+                if (!composite) {
+                    const int entry = static_cast<int>(maximum) >> TABLE_SHIFT;
+                    color[0] = m_colorTable[3 * entry];
+                    color[1] = m_colorTable[3 * entry + 1];
+                    color[2] = m_colorTable[3 * entry + 2];
+                }
+                for (int channel = 0; channel < 3; ++channel) {
+                    pixel[channel] = static_cast<unsigned char>(std::min(255.0f, color[channel] * 255.0f + 0.5f));
+                }
+            }
+        }
+        
+        totalSamples += samples;
+        totalSkipped += skipped;
+    });
+    
+    m_output->Modified();
+    m_lastSampleCount = totalSamples.load();
+    m_lastSkippedBricks = totalSkipped.load();
+    m_lastRenderSeconds = timer.elapsed() / 1000.0;
+    return m_output;
+}
+
+/**
+ * Millimetres covered by one image pixel when rendering volume
+ * 
+ * Every level of a VolumePyramid gives nearly the same answer, so this
+ * can pick a level before any of them is handed to the caster.
+ */
+double CpuRayCaster::pixelSpacing(vtkImageData *volume, const Camera &camera, int width, int height)
+{
+    int dims[3];
+    double spacing[3];
+    volume->GetDimensions(dims);
+    volume->GetSpacing(spacing);
+    return 2.0 * boundingRadius(dims, spacing) / (std::max(1, std::min(width, height)) * std::max(0.01, camera.zoom));
+}
+
+double CpuRayCaster::lastRenderSeconds() const
+{
+    return m_lastRenderSeconds;
+}
+
+long long CpuRayCaster::lastSampleCount() const
+{
+    return m_lastSampleCount;
+}
+
+long long CpuRayCaster::lastSkippedBricks() const
+{
+    return m_lastSkippedBricks;
+}
+
+/**
+ * Records the value range each brick's samples can produce
+ * 
+ * A brick covers voxels [b * 8, b * 8 + 8] inclusive, one voxel more than
+ * its own cell, because a trilinear sample near the far face reads the
+ * neighbouring voxel too. Interpolated values never leave this range.
+ */
+void CpuRayCaster::buildBricks()
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        m_bricks[axis] = std::max(1, (m_dims[axis] - 1 + BRICK_SIZE - 1) / BRICK_SIZE);
+    }
+    const int64_t brickCount = static_cast<int64_t>(m_bricks[0]) * m_bricks[1] * m_bricks[2];
+    m_brickMin.assign(static_cast<size_t>(brickCount), 0);
+    m_brickMax.assign(static_cast<size_t>(brickCount), 0);
+    
+    const int64_t strideY = m_dims[0];
+    const int64_t strideZ = static_cast<int64_t>(m_dims[0]) * m_dims[1];
+    
+    vtkSMPTools::For(0, m_bricks[2], 1, [&](vtkIdType bzBegin, vtkIdType bzEnd) {
+        for (vtkIdType bz = bzBegin; bz < bzEnd; ++bz) {
+            for (int by = 0; by < m_bricks[1]; ++by) {
+                for (int bx = 0; bx < m_bricks[0]; ++bx) {
+                    uint16_t low = 65535;
+                    uint16_t high = 0;
+                    const int zEnd = std::min(static_cast<int>(bz) * BRICK_SIZE + BRICK_SIZE, m_dims[2] - 1);
+                    const int yEnd = std::min(by * BRICK_SIZE + BRICK_SIZE, m_dims[1] - 1);
+                    const int xEnd = std::min(bx * BRICK_SIZE + BRICK_SIZE, m_dims[0] - 1);
+                    for (int z = static_cast<int>(bz) * BRICK_SIZE; z <= zEnd; ++z) {
+                        for (int y = by * BRICK_SIZE; y <= yEnd; ++y) {
+                            const uint16_t *row = m_voxels.data() + y * strideY + z * strideZ;
+                            for (int x = bx * BRICK_SIZE; x <= xEnd; ++x) {
+                                low = std::min(low, row[x]);
+                                high = std::max(high, row[x]);
+                            }
+                        }
+                    }
+                    const int64_t brick = bx + m_bricks[0] * (by + static_cast<int64_t>(m_bricks[1]) * bz);
+                    m_brickMin[brick] = low;
+                    m_brickMax[brick] = high;
+                }
+            }
+        }
+    });
+}
+
+void CpuRayCaster::buildTables()
+{
+    const double lower = clamp01(m_transferFunction.lower);
+    const double upper = std::max(lower + 1e-6, clamp01(m_transferFunction.upper));
+    const double opacity = clamp01(m_transferFunction.opacity);
+    
+    m_colorTable.resize(3 * TABLE_SIZE);
+    m_opacityTable.resize(TABLE_SIZE);
+    m_opaquePrefix.assign(TABLE_SIZE + 1, 0);
+    
+    for (int entry = 0; entry < TABLE_SIZE; ++entry) {
+        const double position = (entry + 0.5) / TABLE_SIZE;
+        const double t = clamp01((position - lower) / (upper - lower));
+        colorAt(m_transferFunction.colorMap, t, &m_colorTable[3 * entry]);
+        
+        // Opacity is specified per voxel length; correct it for the step size
+        const double sampleOpacity = 1.0 - std::pow(1.0 - t * opacity, SAMPLE_DISTANCE);
+        m_opacityTable[entry] = static_cast<float>(sampleOpacity);
+        m_opaquePrefix[entry + 1] = m_opaquePrefix[entry] + (sampleOpacity > 0.0 ? 1 : 0);
+    }
+}
+
+bool CpuRayCaster::brickIsTransparent(int64_t brick) const
+{
+    const int low = m_brickMin[brick] >> TABLE_SHIFT;
+    const int high = m_brickMax[brick] >> TABLE_SHIFT;
+    return m_opaquePrefix[high + 1] == m_opaquePrefix[low];
+}
@@ -0,0 +1,121 @@
+#ifndef CPURAYCASTER_H
+#define CPURAYCASTER_H
+
+// VTK smart pointer for the rendered image
+#include <vtkSmartPointer.h>
+
+// Standard library for the voxel, macrocell and transfer function tables
+#include <cstdint>
+#include <vector>
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * CpuRayCaster - Multi-threaded software volume renderer
+ * 
+ * Renders a 3D volume into an RGBA image with orthographic rays, without
+ * any GPU or OpenGL context, so 3D views work on headless review nodes.
+ * 
+ * setVolume() normalizes the first scalar component into a contiguous
+ * 16-bit copy and builds a grid of 8x8x8 macrocells holding each brick's
+ * value range. render() then casts one ray per pixel, image rows split
+ * across vtkSMPTools threads:
+ * - Maximum intensity projection skips bricks whose maximum cannot beat
+ *   the ray's current maximum, and stops once the volume maximum is hit.
+ * - Composite blending skips bricks the transfer function makes fully
+ *   transparent, and terminates rays once they are nearly opaque.
+ * 
+ * The transfer function is a window over the normalized intensity range:
+ * a colour map across the window and an opacity ramp for compositing.
+ */
+class CpuRayCaster
+{
+public:
+    enum BlendMode {
+        MAXIMUM_INTENSITY = 0, // Brightest sample along each ray
+        COMPOSITE = 1          // Front-to-back alpha blending
+    };
+    
+    enum ColorMap {
+        GRAYSCALE = 0,         // Black to white
+        HOT = 1,               // Black, red, yellow, white
+        BONE = 2               // Blue-tinted grayscale
+    };
+    
+    /**
+     * Intensity window and opacity of the rendering, on a 0..1 scale of the volume's range
+     */
+    struct TransferFunction {
+        double lower = 0.15;               // Transparent and darkest at or below this
+        double upper = 0.85;               // Brightest (and most opaque) at or above this
+        double opacity = 0.08;             // Composite opacity per voxel-length sample at the top of the ramp
+        ColorMap colorMap = GRAYSCALE;     // Colours across the window
+    };
+    
+    /**
+     * Orbit camera around the volume centre
+     */
+    struct Camera {
+        double azimuth = 0.0;              // Degrees around the z axis, 0 = viewed like the coronal slice
+        double elevation = 0.0;            // Degrees above the xy plane, clamped to +-89
+        double zoom = 1.0;                 // 1 fits the whole volume in the image
+    };
+    
+    CpuRayCaster();
+    ~CpuRayCaster();
+    
+    // Volume setup - copies and normalizes the scalars
+    bool setVolume(vtkImageData *volume, const double *range = nullptr); // Normalizes over range, default the volume's own; false if empty
+    void getScalarRange(double range[2]) const;          // Range mapped to 0..65535
+    bool hasVolume() const;                              // Whether render() has data
+    void clearVolume();                                  // Release the normalized copy
+    
+    // Rendering parameters
+    void setBlendMode(BlendMode mode);                   // MIP or composite
+    BlendMode blendMode() const;                         // Current blend mode
+    void setTransferFunction(const TransferFunction &transferFunction); // Window, opacity and colours
+    TransferFunction transferFunction() const;           // Current transfer function
+    void setCamera(const Camera &camera);                // View direction and zoom
+    Camera camera() const;                               // Current camera
+    
+    // Rendering
+    vtkImageData *render(int width, int height);         // RGBA image owned by the caster, null without a volume
+    double lastRenderSeconds() const;                    // Wall-clock time of the last render
+    long long lastSampleCount() const;                   // Samples taken by the last render
+    long long lastSkippedBricks() const;                 // Empty bricks jumped over by the last render
+    static double pixelSpacing(vtkImageData *volume, const Camera &camera, int width, int height); // mm per image pixel
+
+private:
+    // Normalized volume
+    std::vector<uint16_t> m_voxels;                      // First component scaled to 0..65535, x fastest
+    int m_dims[3];                                       // Voxels per axis
+    double m_spacing[3];                                 // Voxel spacing in mm
+    double m_range[2];                                   // Scalar range of the normalization
+    
+    // Macrocells for empty-space skipping
+    std::vector<uint16_t> m_brickMin;                    // Lowest value touched by each brick's samples
+    std::vector<uint16_t> m_brickMax;                    // Highest value touched by each brick's samples
+    int m_bricks[3];                                     // Bricks per axis
+    
+    // Transfer function tables, indexed by value >> TABLE_SHIFT
+    std::vector<float> m_colorTable;                     // RGB per entry
+    std::vector<float> m_opacityTable;                   // Composite opacity per entry
+    std::vector<int> m_opaquePrefix;                     // Running count of entries with non-zero opacity
+    
+    BlendMode m_blendMode;                               // Current blend mode
+    TransferFunction m_transferFunction;                 // Current transfer function
+    Camera m_camera;                                     // Current camera
+    
+    vtkSmartPointer<vtkImageData> m_output;              // Reused RGBA image
+    double m_lastRenderSeconds;                          // Time of the last render
+    long long m_lastSampleCount;                         // Samples of the last render
+    long long m_lastSkippedBricks;                       // Bricks skipped by the last render
+    
+    // Private helper methods
+    void buildBricks();                                  // Value range of every macrocell
+    void buildTables();                                  // Colour, opacity and prefix tables
+    bool brickIsTransparent(int64_t brick) const;        // Composite sees nothing inside the brick
+};
+
+#endif // CPURAYCASTER_H
@@ -0,0 +1,190 @@
+#include "DirectoryBrowser.h"
+
+#include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace {
+
+const int SCAN_THREADS = 4;      // Header reads are tiny and mostly wait on the disk
+
+// Columns of the file list
+enum Column {
+    NAME_COLUMN = 0,
+    DIMENSIONS_COLUMN,
+    TYPE_COLUMN,
+    SPACING_COLUMN,
+    SIZE_COLUMN,
+    TRANSFORM_COLUMN,
+    INTENT_COLUMN
+};
+
+} // namespace
+
+DirectoryBrowser::DirectoryBrowser(QWidget *parent)
+    : QWidget(parent)
+    , m_directoryLabel(nullptr)
+    , m_chooseButton(nullptr)
+    , m_fileList(nullptr)
+    , m_summaryLabel(nullptr)
+    , m_scanWatcher(nullptr)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    
+    // Folder selection
+    QHBoxLayout *folderLayout = new QHBoxLayout();
+    m_directoryLabel = new QLabel("No folder selected");
+    m_chooseButton = new QPushButton("Choose Folder...");
+    folderLayout->addWidget(m_directoryLabel, 1);
+    folderLayout->addWidget(m_chooseButton);
+    layout->addLayout(folderLayout);
+    
+    // File list - uniform rows keep thousands of entries cheap to lay out
+    m_fileList = new QTreeWidget();
+    m_fileList->setHeaderLabels({"File", "Dimensions", "Type", "Voxel (mm)", "Size (MB)", "Transform", "Intent"});
+    m_fileList->setRootIsDecorated(false);
+    m_fileList->setUniformRowHeights(true);
+    m_fileList->setAlternatingRowColors(true);
+    layout->addWidget(m_fileList, 1);
+    
+    m_summaryLabel = new QLabel();
+    layout->addWidget(m_summaryLabel);
+    
+    m_scanPool.setMaxThreadCount(SCAN_THREADS);
+    
+    m_scanWatcher = new QFutureWatcher<NiftiHeaderScanner::Entry>(this);
+    connect(m_scanWatcher, &QFutureWatcher<NiftiHeaderScanner::Entry>::resultsReadyAt,
+            this, &DirectoryBrowser::onResultsReady);
+    connect(m_scanWatcher, &QFutureWatcher<NiftiHeaderScanner::Entry>::finished,
+            this, &DirectoryBrowser::onScanFinished);
+    connect(m_chooseButton, &QPushButton::clicked, this, &DirectoryBrowser::chooseDirectory);
+    connect(m_fileList, &QTreeWidget::itemActivated, this, &DirectoryBrowser::onItemActivated);
+}
+
+DirectoryBrowser::~DirectoryBrowser()
+{
+    m_scanWatcher->cancel();
+    m_scanWatcher->waitForFinished();
+}
+
+void DirectoryBrowser::setDirectory(const QString &directory)
+{
+    // A scan of the previous folder stops scheduling new files right away
+    m_scanWatcher->cancel();
+    m_scanWatcher->waitForFinished();
+    
+    m_directory = directory;
+    m_directoryLabel->setText(QDir(directory).dirName());
+    m_directoryLabel->setToolTip(directory);
+    
+    m_fileList->setSortingEnabled(false);
+    m_fileList->clear();
+    
+    QStringList files = NiftiHeaderScanner::listFiles(directory);
+    m_summaryLabel->setText(QString("Reading %1 headers...").arg(files.size()));
+    
+    m_scanTimer.start();
+    m_scanWatcher->setFuture(QtConcurrent::mapped(&m_scanPool, files, &NiftiHeaderScanner::scanFile));
+}
+
+QString DirectoryBrowser::directory() const
+{
+    return m_directory;
+}
+
+void DirectoryBrowser::chooseDirectory()
+{
+    QString directory = QFileDialog::getExistingDirectory(
+        this,
+        "Select Folder",
+        m_directory.isEmpty() ? QDir::homePath() : m_directory
+    );
+    
+    if (!directory.isEmpty()) {
+        setDirectory(directory);
+    }
+}
+
+void DirectoryBrowser::onResultsReady(int begin, int end)
+{
+    for (int i = begin; i < end; ++i) {
+        addEntry(m_scanWatcher->resultAt(i));
+    }
+}
+
+void DirectoryBrowser::onScanFinished()
+{
+    if (m_scanWatcher->isCanceled()) {
+        return;
+    }
+    
+    // Rows arrive in completion order; sort once everything is in
+    m_fileList->setSortingEnabled(true);
+    m_fileList->sortByColumn(NAME_COLUMN, Qt::AscendingOrder);
+    for (int column = 0; column < m_fileList->columnCount(); ++column) {
+        m_fileList->resizeColumnToContents(column);
+    }
+    
+    m_summaryLabel->setText(QString("%1 files, headers read in %2 ms")
+                                .arg(m_fileList->topLevelItemCount())
+                                .arg(m_scanTimer.elapsed()));
+}
+
+void DirectoryBrowser::onItemActivated(QTreeWidgetItem *item, int column)
+{
+    Q_UNUSED(column);
+    emit fileActivated(item->data(NAME_COLUMN, Qt::UserRole).toString());
+}
+
+void DirectoryBrowser::addEntry(const NiftiHeaderScanner::Entry &entry)
+{
+    const NiftiHeader &header = entry.header;
+    
+    QTreeWidgetItem *item = new QTreeWidgetItem();
+    item->setText(NAME_COLUMN, QFileInfo(entry.filePath).fileName());
+    item->setData(NAME_COLUMN, Qt::UserRole, entry.filePath);
+    item->setToolTip(NAME_COLUMN, header.descrip[0] ? entry.filePath + "\n" + QString::fromLatin1(header.descrip)
+                                                    : entry.filePath);
+    item->setText(SIZE_COLUMN, QString::number(entry.fileBytes / (1024.0 * 1024.0), 'f', 1));
+    item->setTextAlignment(SIZE_COLUMN, Qt::AlignRight | Qt::AlignVCenter);
+    
+    if (header.version == 0) {
+        item->setText(DIMENSIONS_COLUMN, "unreadable");
+        item->setToolTip(DIMENSIONS_COLUMN, entry.errorString);
+        m_fileList->addTopLevelItem(item);
+        return;
+    }
+    
+    QStringList dimensions;
+    for (int i = 1; i <= header.dim[0]; ++i) {
+        dimensions << QString::number(header.dim[i]);
+    }
+    item->setText(DIMENSIONS_COLUMN, dimensions.join(" x "));
+    item->setText(TYPE_COLUMN, QString("%1 (NIfTI-%2)").arg(header.datatypeName()).arg(header.version));
+    item->setText(SPACING_COLUMN, QString("%1 x %2 x %3").arg(header.pixdim[1], 0, 'f', 2)
+                                                         .arg(header.pixdim[2], 0, 'f', 2)
+                                                         .arg(header.pixdim[3], 0, 'f', 2));
+    
+    item->setText(TRANSFORM_COLUMN, QString("q: %1, s: %2").arg(NiftiHeader::xformName(header.qformCode))
+                                                           .arg(NiftiHeader::xformName(header.sformCode)));
+    if (header.sformCode > 0) {
+        QString affine;
+        for (int row = 0; row < 3; ++row) {
+            affine += QString("%1 %2 %3 %4\n").arg(header.srow[row][0], 8, 'f', 3)
+                                              .arg(header.srow[row][1], 8, 'f', 3)
+                                              .arg(header.srow[row][2], 8, 'f', 3)
+                                              .arg(header.srow[row][3], 8, 'f', 2);
+        }
+        item->setToolTip(TRANSFORM_COLUMN, affine.trimmed());
+    }
+    
+    if (header.intentCode != 0) {
+        item->setText(INTENT_COLUMN, QString("%1 %2").arg(header.intentCode)
+                                                     .arg(QString::fromLatin1(header.intentName)).trimmed());
+    }
+    
+    m_fileList->addTopLevelItem(item);
+}
@@ -0,0 +1,64 @@
+#ifndef DIRECTORYBROWSER_H
+#define DIRECTORYBROWSER_H
+
+// Qt Widgets for the file list
+#include <QWidget>
+#include <QLabel>
+#include <QPushButton>
+#include <QTreeWidget>
+
+// Qt concurrency for the background header scan
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <QThreadPool>
+
+#include "NiftiHeaderScanner.h"
+
+/**
+ * DirectoryBrowser - Lists the NIfTI files of a folder with their metadata
+ * 
+ * Headers are scanned on a private thread pool with NiftiHeaderScanner,
+ * so rows appear as soon as their header is parsed and no voxel data is
+ * ever decoded. Activating a row (double-click or Enter) asks for the file
+ * to be opened.
+ */
+class DirectoryBrowser : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DirectoryBrowser(QWidget *parent = nullptr);
+    ~DirectoryBrowser();
+    
+    void setDirectory(const QString &directory);         // List and scan a folder, replacing the current one
+    QString directory() const;                           // Folder being shown
+
+public slots:
+    void chooseDirectory();                              // Ask the user for a folder
+
+signals:
+    void fileActivated(const QString &filePath);         // Emitted when a row is opened
+
+private slots:
+    void onResultsReady(int begin, int end);             // Append rows for newly scanned headers
+    void onScanFinished();                               // Report the scan time and allow sorting
+    void onItemActivated(QTreeWidgetItem *item, int column); // Forward the row's file
+
+private:
+    // UI components
+    QLabel *m_directoryLabel;       // Folder being shown
+    QPushButton *m_chooseButton;    // Opens the folder dialog
+    QTreeWidget *m_fileList;        // One row per file
+    QLabel *m_summaryLabel;         // File count and scan time
+    
+    // Scan state
+    QString m_directory;                                 // Folder being shown
+    QThreadPool m_scanPool;                              // Keeps scans off the global pool used by loads
+    QFutureWatcher<NiftiHeaderScanner::Entry> *m_scanWatcher; // Delivers headers as they are parsed
+    QElapsedTimer m_scanTimer;                           // Measures the current scan
+    
+    // Private helper methods
+    void addEntry(const NiftiHeaderScanner::Entry &entry); // Row for one scanned file
+};
+
+#endif // DIRECTORYBROWSER_H
@@ -0,0 +1,321 @@
+#include "DiskVolumeCache.h"
+#include "NiftiHeaderScanner.h"
+#include "VoxelStream.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkByteSwap.h>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QThread>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const qint64 BUFFER_SIZE = 1024 * 1024;   // Decompressed bytes per step
+
+} // namespace
+
+DiskVolumeCache::DiskVolumeCache(const QString &directory, qint64 sizeCap)
+    : m_directory(directory)
+    , m_sizeCap(sizeCap)
+    , m_hits(0)
+    , m_misses(0)
+    , m_stopping(false)
+{
+    QDir().mkpath(m_directory);
+    
+    // One writer keeps the copy off the critical path without competing for disk
+    m_writerPool.setMaxThreadCount(1);
+    m_writerPool.setThreadPriority(QThread::LowPriority);
+}
+
+DiskVolumeCache::~DiskVolumeCache()
+{
+    m_stopping = true;
+    m_writerPool.clear();
+    m_writerPool.waitForDone();
+}
+
+/**
+ * Finds the decoded copy of a compressed file
+ * 
+ * A hit bumps the copy's modification time, which is what eviction
+ * orders by, so recently opened files survive longest.
+ */
+QString DiskVolumeCache::lookup(const QString &filePath)
+{
+    const QString target = entryPath(filePath);
+    if (target.isEmpty() || !QFileInfo::exists(target)) {
+        ++m_misses;
+        return QString();
+    }
+    
+    QFile copy(target);
+    if (copy.open(QIODevice::ReadOnly)) {
+        copy.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+    ++m_hits;
+    return target;
+}
+
+void DiskVolumeCache::store(const QString &filePath, vtkSmartPointer<vtkImageData> volume)
+{
+    const QString target = entryPath(filePath);
+    if (target.isEmpty() || QFileInfo::exists(target) || m_sizeCap.load() <= 0) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_pending.insert(target).second) {
+            return;
+        }
+    }
+    
+    m_writerPool.start([this, filePath, target, volume]() {
+        bool written = writeEntry(filePath, target, volume);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending.erase(target);
+        }
+        if (written) {
+            evict(target);
+        }
+    });
+}
+
+QString DiskVolumeCache::directory() const
+{
+    return m_directory;
+}
+
+void DiskVolumeCache::setSizeCap(qint64 bytes)
+{
+    m_sizeCap = bytes;
+    evict(QString());
+}
+
+qint64 DiskVolumeCache::sizeCap() const
+{
+    return m_sizeCap.load();
+}
+
+qint64 DiskVolumeCache::usedBytes() const
+{
+    qint64 total = 0;
+    const QFileInfoList copies = QDir(m_directory).entryInfoList({"*.nii"}, QDir::Files);
+    for (const QFileInfo &copy : copies) {
+        total += copy.size();
+    }
+    return total;
+}
+
+qint64 DiskVolumeCache::hits() const
+{
+    return m_hits.load();
+}
+
+qint64 DiskVolumeCache::misses() const
+{
+    return m_misses.load();
+}
+
+void DiskVolumeCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const QFileInfoList copies = QDir(m_directory).entryInfoList({"*.nii"}, QDir::Files);
+    for (const QFileInfo &copy : copies) {
+        QFile::remove(copy.absoluteFilePath());
+    }
+}
+
+/**
+ * Names the cache file of a source
+ * 
+ * The name hashes canonical path, modification time and size, so a
+ * changed source never maps to an old copy. Returns an empty string when
+ * the source does not exist.
+ */
+QString DiskVolumeCache::entryPath(const QString &filePath) const
+{
+    QFileInfo info(filePath);
+    const QString canonicalPath = info.canonicalFilePath();
+    if (canonicalPath.isEmpty()) {
+        return QString();
+    }
+    
+    const QString key = QString("%1\n%2\n%3").arg(canonicalPath)
+                                             .arg(info.lastModified().toMSecsSinceEpoch())
+                                             .arg(info.size());
+    const QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1);
+    return m_directory + "/" + QString::fromLatin1(hash.toHex()) + ".nii";
+}
+
+/**
+ * Writes the plain .nii copy of a .nii.gz into the cache directory
+ * 
+ * QSaveFile writes to a temporary name and renames on commit, so readers
+ * never see a partial copy. The copy is abandoned if it grows past the
+ * size cap, the source is truncated or corrupt, or the cache is being
+ * destroyed.
+ */
+bool DiskVolumeCache::writeEntry(const QString &filePath, const QString &target,
+                                 vtkSmartPointer<vtkImageData> volume)
+{
+    // The volume stands in for the voxels only if it holds all of them; narrowing is lossless
+    const NiftiHeader header = NiftiHeaderScanner::scanFile(filePath).header;
+    const qint64 voxelBytes = header.bytesPerVolume();
+    const int fileType = header.vtkScalarType();
+    const int components = header.scalarComponents();
+    vtkDataArray *scalars = volume && volume->GetPointData() ? volume->GetPointData()->GetScalars() : nullptr;
+    if (!scalars || header.version == 0 || header.volumeCount() != 1 || fileType == VTK_VOID ||
+        scalars->GetNumberOfComponents() != components ||
+        static_cast<qint64>(scalars->GetNumberOfTuples()) * components *
+            vtkDataArray::GetDataTypeSize(fileType) != voxelBytes) {
+        scalars = nullptr;
+    }
+    
+    QFile source(filePath);
+    if (!source.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    QSaveFile copy(target);
+    if (!copy.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    
+    if (!scalars) {
+        if (inflateInto(source, copy, -1) <= 0) {
+            copy.cancelWriting();
+            return false;
+        }
+        return copy.commit();
+    }
+    
+    // Header and extensions from the file, then the voxels in the file's type and byte order
+    if (header.voxOffset + voxelBytes > m_sizeCap.load() ||
+        inflateInto(source, copy, header.voxOffset) != header.voxOffset) {
+        copy.cancelWriting();
+        return false;
+    }
+    const bool widen = scalars->GetDataType() != fileType;
+    const int unit = header.bytesPerSwapUnit();
+    const bool swap = header.byteSwapped && unit > 1;
+    vtkSmartPointer<vtkDataArray> staging;
+    if (widen) {
+        staging = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(fileType));
+        staging->SetNumberOfComponents(components);
+    }
+    std::vector<char> swapped(swap ? BUFFER_SIZE : 0);
+    
+    const qint64 tupleBytes = static_cast<qint64>(components) * vtkDataArray::GetDataTypeSize(fileType);
+    const vtkIdType tuplesPerChunk = static_cast<vtkIdType>(std::max<qint64>(1, BUFFER_SIZE / tupleBytes));
+    const vtkIdType tuples = scalars->GetNumberOfTuples();
+    for (vtkIdType first = 0; first < tuples; first += tuplesPerChunk) {
+        if (m_stopping.load()) {
+            copy.cancelWriting();
+            return false;
+        }
+        const vtkIdType count = std::min(tuplesPerChunk, tuples - first);
+        const qint64 chunk = count * tupleBytes;
+        const char *data = static_cast<const char *>(scalars->GetVoidPointer(first * components));
+        if (widen) {
+            staging->SetNumberOfTuples(count);
+            staging->InsertTuples(0, count, first, scalars);
+            data = static_cast<const char *>(staging->GetVoidPointer(0));
+        }
+        if (swap) {
+            if (static_cast<qint64>(swapped.size()) < chunk) {
+                swapped.resize(static_cast<size_t>(chunk));
+            }
+            std::memcpy(swapped.data(), data, static_cast<size_t>(chunk));
+            vtkByteSwap::SwapVoidRange(swapped.data(), static_cast<size_t>(chunk / unit), static_cast<size_t>(unit));
+            data = swapped.data();
+        }
+        if (copy.write(data, chunk) != chunk) {
+            copy.cancelWriting();
+            return false;
+        }
+    }
+    return copy.commit();
+}
+
+/**
+ * Inflates the source into the copy, limit bytes at most (-1 for all)
+ * 
+ * Without a limit the stream must end properly; a truncated source
+ * fails rather than leaving a short copy behind.
+ */
+qint64 DiskVolumeCache::inflateInto(QFile &source, QSaveFile &copy, qint64 limit)
+{
+    VoxelStream stream(source, true);
+    if (!stream.open()) {
+        return -1;
+    }
+    
+    std::vector<char> output(BUFFER_SIZE);
+    qint64 written = 0;
+    while (limit < 0 || written < limit) {
+        if (m_stopping.load()) {
+            return -1;
+        }
+        const qint64 request = limit < 0 ? BUFFER_SIZE : std::min(BUFFER_SIZE, limit - written);
+        const qint64 produced = stream.read(output.data(), request);
+        if (produced < 0) {
+            return -1;
+        }
+        if (produced == 0) {
+            break;
+        }
+        written += produced;
+        if (written > m_sizeCap.load() || copy.write(output.data(), produced) != produced) {
+            return -1;
+        }
+    }
+    
+    const bool complete = limit < 0 ? stream.atEnd() && written > 0 : written == limit;
+    return complete ? written : -1;
+}
+
+/**
+ * Deletes the least recently used copies until the total fits the cap
+ * 
+ * The copy just written is kept even if it alone exceeds what is left,
+ * since it is about to be used. Copies still mapped by a viewer stay
+ * readable on POSIX systems after removal; elsewhere removal fails and
+ * the file is retried on the next eviction.
+ */
+void DiskVolumeCache::evict(const QString &keep)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    // Newest first, so the tail is the least recently used
+    QFileInfoList copies = QDir(m_directory).entryInfoList({"*.nii"}, QDir::Files, QDir::Time);
+    qint64 total = 0;
+    for (const QFileInfo &copy : copies) {
+        total += copy.size();
+    }
+    
+    const qint64 cap = m_sizeCap.load();
+    const QString keepPath = keep.isEmpty() ? QString() : QFileInfo(keep).absoluteFilePath();
+    for (int i = copies.size() - 1; i >= 0 && total > cap; --i) {
+        const QString path = copies[i].absoluteFilePath();
+        if (path == keepPath || m_pending.count(path) > 0) {
+            continue;
+        }
+        if (QFile::remove(path)) {
+            total -= copies[i].size();
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef DISKVOLUMECACHE_H
+#define DISKVOLUMECACHE_H
+
+// Qt base classes for paths and background work
+#include <QString>
+#include <QThreadPool>
+
+// VTK smart pointer for volumes handed over by the loader
+#include <vtkSmartPointer.h>
+
+// Standard library for counters and the pending-write set
+#include <atomic>
+#include <mutex>
+#include <set>
+
+// Forward declarations
+class QFile;                // Compressed source
+class QSaveFile;            // Copy being written
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * DiskVolumeCache - Decompressed copies of .nii.gz files on local disk
+ * 
+ * The first open of a compressed file queues a background job that
+ * writes it into the cache directory as a plain .nii. Later opens read
+ * that copy instead, which takes the memory-mapped path of
+ * NiftiVolumeReader (and lets lazy loading and 4D playback seek freely),
+ * so no gunzip happens at all.
+ * 
+ * When the loader hands over the decoded volume of a 3D file, only the
+ * header and extensions are inflated again; the voxels are written from
+ * memory, widened back to the file's type if the loader narrowed them
+ * (narrowing is lossless) and swapped back to the file's byte order. A
+ * 4D file keeps only one frame in memory, so its whole source is
+ * inflated once more, at low priority.
+ * 
+ * Entries are named by a hash of canonical path, modification time and
+ * size; editing or replacing the source simply stops matching the old
+ * copy, which then ages out. Total size is capped; the least recently
+ * used copies are deleted first.
+ * 
+ * All methods are thread-safe.
+ */
+class DiskVolumeCache
+{
+public:
+    DiskVolumeCache(const QString &directory, qint64 sizeCap);
+    ~DiskVolumeCache();
+    
+    // Lookup and population
+    QString lookup(const QString &filePath);             // Path of a decoded copy, empty on a miss
+    void store(const QString &filePath,
+               vtkSmartPointer<vtkImageData> volume = nullptr); // Queue a background write into the cache
+    
+    // Management
+    QString directory() const;                           // Where copies are kept
+    void setSizeCap(qint64 bytes);                       // Evicts immediately when shrinking
+    qint64 sizeCap() const;                              // Upper bound in bytes
+    qint64 usedBytes() const;                            // Bytes on disk right now
+    qint64 hits() const;                                 // Lookups that found a copy
+    qint64 misses() const;                               // Lookups that did not
+    void clear();                                        // Delete every copy
+
+private:
+    QString m_directory;                                 // Cache directory
+    std::atomic<qint64> m_sizeCap;                       // Byte cap for all copies
+    std::atomic<qint64> m_hits;                          // Successful lookups
+    std::atomic<qint64> m_misses;                        // Failed lookups
+    std::atomic_bool m_stopping;                         // Abandon writes during destruction
+    
+    std::mutex m_mutex;                                  // Guards m_pending and directory scans
+    std::set<QString> m_pending;                         // Entries being written
+    QThreadPool m_writerPool;                            // Low-priority decode jobs
+    
+    // Private helper methods
+    QString entryPath(const QString &filePath) const;    // Cache file for a source, empty if missing
+    bool writeEntry(const QString &filePath, const QString &target,
+                    vtkSmartPointer<vtkImageData> volume); // Source (or its header plus volume) into target
+    qint64 inflateInto(QFile &source, QSaveFile &copy, qint64 limit); // Bytes written, -1 on failure
+    void evict(const QString &keep);                     // Delete LRU copies above the cap
+};
+
+#endif // DISKVOLUMECACHE_H
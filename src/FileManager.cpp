@@ -1,23 +1,144 @@
 #include "FileManager.h"
+#include "NiftiHeaderScanner.h"
+#include "VolumeNarrowing.h"
 #include <vtkNIFTIImageReader.h>
 #include <vtkImageData.h>
+#include <vtkDataArray.h>
+#include <vtkCallbackCommand.h>
+#include <vtkErrorCode.h>
 #include <QFileInfo>
 #include <QDebug>
-#include <QApplication>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+
+namespace {
+
+const qint64 PROGRESS_INTERVAL_MS = 50;  // Minimum spacing between progress signals
+const double BYTES_PER_MB = 1024.0 * 1024.0;
+const qint64 LAZY_THRESHOLD_BYTES = 512LL * 1024 * 1024;  // Smaller volumes are decoded up front
+const qint64 DEFAULT_CACHE_BUDGET = 2048LL * 1024 * 1024; // Memory for recently opened volumes
+const qint64 DEFAULT_DISK_CACHE_SIZE = 8192LL * 1024 * 1024; // Disk space for decoded .nii.gz copies
+const int DEFAULT_PREFETCH_COUNT = 3;                      // Sibling files decoded ahead
+const qint64 DEFAULT_PREFETCH_BUDGET = 1024LL * 1024 * 1024; // Decoded bytes per prefetch pass
+const int PYRAMID_COARSEST_SIZE = 64;                      // Longest axis of the smallest pyramid level
+const qint64 PYRAMID_MIN_BYTES = 32LL * 1024 * 1024;       // Smaller volumes render fast enough at full size
+const int MAX_RECENT_FILES = 10;                           // Entries in File > Open Recent
+const char *RECENT_FILES_KEY = "recentFiles";              // QSettings key of the recent list
+
+/**
+ * Progress observer attached to the reader on the worker thread
+ * 
+ * VTK polls AbortExecute between chunks, so flipping it here is the
+ * only way to stop a reader that is already inside Update().
+ */
+void abortReaderIfCancelled(vtkObject *caller, unsigned long, void *clientData, void *)
+{
+    auto *cancelFlag = static_cast<std::atomic_bool *>(clientData);
+    if (cancelFlag->load()) {
+        static_cast<vtkAlgorithm *>(caller)->AbortExecuteOn();
+    }
+}
+
+/**
+ * Datatype, transform and intent lines from a header-only read
+ * 
+ * Costs one small read, so it is safe to call on every info refresh.
+ */
+QString describeHeader(const QString &filePath)
+{
+    NiftiHeaderScanner::Entry entry = NiftiHeaderScanner::scanFile(filePath);
+    const NiftiHeader &header = entry.header;
+    if (header.version == 0) {
+        return QString();
+    }
+    
+    QString info;
+    info += QString("Datatype: %1 (NIfTI-%2)\n").arg(header.datatypeName()).arg(header.version);
+    info += QString("Transform: qform %1, sform %2\n").arg(NiftiHeader::xformName(header.qformCode))
+                                                      .arg(NiftiHeader::xformName(header.sformCode));
+    if (header.intentCode != 0) {
+        info += QString("Intent: %1 %2\n").arg(header.intentCode).arg(QString::fromLatin1(header.intentName));
+    }
+    return info;
+}
+
+} // namespace
 
 FileManager::FileManager(QObject *parent)
     : QObject(parent)
-    , m_reader(nullptr)
-    , m_imageData(nullptr)
+    , m_loadWatcher(nullptr)
+    , m_saveWatcher(nullptr)
+    , m_lastLoadBytes(0)
+    , m_lastLoadFileBytes(0)
+    , m_lastLoadSeconds(0.0)
+    , m_lastLoadMapped(false)
+    , m_lastLoadParallel(false)
+    , m_lastLoadCached(false)
+    , m_lastLoadDiskCached(false)
+    , m_lastLoadNarrowedFrom(0)
+    , m_prefetchEnabled(false)
+    , m_prefetchCount(DEFAULT_PREFETCH_COUNT)
+    , m_prefetchBudget(DEFAULT_PREFETCH_BUDGET)
+    , m_pyramidWatcher(nullptr)
+    , m_pyramidEnabled(true)
+    , m_bricksWatcher(nullptr)
+    , m_brickedLayoutEnabled(false)
+    , m_statisticsWatcher(nullptr)
+    , m_statisticsSlope(1.0)
+    , m_statisticsIntercept(0.0)
 {
-    m_reader = vtkNIFTIImageReader::New();
+    m_volumeCache = std::make_shared<VolumeCache>(DEFAULT_CACHE_BUDGET);
+    m_diskCache = std::make_shared<DiskVolumeCache>(
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/volumes",
+        DEFAULT_DISK_CACHE_SIZE);
+    
+    // Prefetching yields to the GUI and to foreground loads
+    m_prefetchPool.setMaxThreadCount(1);
+    m_prefetchPool.setThreadPriority(QThread::LowPriority);
+    
+    m_loadWatcher = new QFutureWatcher<LoadResult>(this);
+    connect(m_loadWatcher, &QFutureWatcher<LoadResult>::finished,
+            this, &FileManager::onLoadFinished);
+    
+    m_saveWatcher = new QFutureWatcher<SaveResult>(this);
+    connect(m_saveWatcher, &QFutureWatcher<SaveResult>::finished,
+            this, &FileManager::onSaveFinished);
+    
+    m_pyramidWatcher = new QFutureWatcher<std::shared_ptr<VolumePyramid>>(this);
+    connect(m_pyramidWatcher, &QFutureWatcher<std::shared_ptr<VolumePyramid>>::finished,
+            this, &FileManager::onPyramidFinished);
+    
+    m_bricksWatcher = new QFutureWatcher<std::shared_ptr<BrickedVolume>>(this);
+    connect(m_bricksWatcher, &QFutureWatcher<std::shared_ptr<BrickedVolume>>::finished,
+            this, &FileManager::onBricksFinished);
+    
+    m_statisticsWatcher = new QFutureWatcher<std::shared_ptr<VolumeStatistics>>(this);
+    connect(m_statisticsWatcher, &QFutureWatcher<std::shared_ptr<VolumeStatistics>>::finished,
+            this, &FileManager::onStatisticsFinished);
 }
 
 FileManager::~FileManager()
 {
-    if (m_reader) {
-        m_reader->Delete();
+    // Do not let a worker outlive the object it reports back to
+    if (m_cancelFlag) {
+        m_cancelFlag->store(true);
     }
+    m_loadWatcher->waitForFinished();
+    cancelSaving();
+    m_saveWatcher->waitForFinished();  // QSaveFile discards the partial file
+    cancelPrefetch();
+    m_prefetchPool.waitForDone();
+    cancelPyramid();
+    m_pyramidWatcher->waitForFinished();
+    cancelBricks();
+    m_bricksWatcher->waitForFinished();
+    cancelStatistics();
+    m_statisticsWatcher->waitForFinished();
 }
 
 QString FileManager::selectNiftiFile(QWidget *parent)
@@ -44,40 +165,419 @@ bool FileManager::loadNiftiFile(const QString &filePath)
         return false;
     }
     
+    // Opening a new file supersedes whatever is still streaming in, prefetches included
+    cancelLoading();
+    cancelPrefetch();
+    cancelPyramid();
+    cancelBricks();
+    cancelStatistics();
+    
+    // Recently viewed volumes come straight from memory
+    if (loadFromCache(filePath)) {
+        return true;
+    }
+    
+    m_pendingFile = filePath;
+    m_cancelFlag = std::make_shared<std::atomic_bool>(false);
+    
     emit fileLoadingStarted(QFileInfo(filePath).fileName());
+    emit fileLoadingProgress(0);
+    
+    // Runs on the worker thread and posts each update to the GUI thread, where
+    // the cancel flag is tested again: a load cancelled or superseded after
+    // the post, or a manager already destroyed, never hears from it.
+    // Updates are throttled so a fast local disk does not flood the event loop.
+    QElapsedTimer timer;
+    timer.start();
+    qint64 lastReportMs = -PROGRESS_INTERVAL_MS;
+    std::shared_ptr<std::atomic_bool> cancelFlag = m_cancelFlag;
+    QPointer<FileManager> guard(this);
+    NiftiVolumeReader::ProgressCallback progress =
+        [guard, cancelFlag, timer, lastReportMs](qint64 bytesDone, qint64 bytesTotal) mutable {
+            qint64 elapsedMs = timer.elapsed();
+            if (cancelFlag->load() ||
+                (bytesDone < bytesTotal && elapsedMs - lastReportMs < PROGRESS_INTERVAL_MS)) {
+                return;
+            }
+            lastReportMs = elapsedMs;
+            
+            double seconds = elapsedMs / 1000.0;
+            double megabytesPerSecond = seconds > 0.0 ? bytesDone / BYTES_PER_MB / seconds : 0.0;
+            double etaSeconds = bytesDone > 0 ? seconds * (bytesTotal - bytesDone) / bytesDone : -1.0;
+            
+            QMetaObject::invokeMethod(guard.data(), [guard, cancelFlag, bytesDone, bytesTotal, megabytesPerSecond, etaSeconds]() {
+                if (!guard || cancelFlag->load()) {
+                    return;
+                }
+                emit guard->fileLoadingProgress(bytesTotal > 0 ? static_cast<int>(bytesDone * 100 / bytesTotal) : 0);
+                emit guard->fileLoadingThroughput(bytesDone, bytesTotal, megabytesPerSecond, etaSeconds);
+            }, Qt::QueuedConnection);
+        };
+    
+    // The watcher drops the previous future, so a cancelled load never reports back
+    m_loadWatcher->setFuture(QtConcurrent::run(&FileManager::readVolume, filePath, m_loadOptions,
+                                                 m_diskCache, m_cancelFlag, progress));
+    return true;
+}
+
+void FileManager::cancelLoading()
+{
+    if (!isLoading()) {
+        return;
+    }
+    
+    m_cancelFlag->store(true);
+    emit fileLoadingCancelled(QFileInfo(m_pendingFile).fileName());
+}
+
+bool FileManager::isLoading() const
+{
+    return m_cancelFlag && !m_cancelFlag->load() && m_loadWatcher->isRunning();
+}
+
+void FileManager::setMemoryMappingEnabled(bool enabled)
+{
+    m_loadOptions.memoryMapping = enabled;
+}
+
+bool FileManager::isMemoryMappingEnabled() const
+{
+    return m_loadOptions.memoryMapping;
+}
+
+void FileManager::setParallelDecompressionEnabled(bool enabled)
+{
+    m_loadOptions.parallelDecompression = enabled;
+}
+
+bool FileManager::isParallelDecompressionEnabled() const
+{
+    return m_loadOptions.parallelDecompression;
+}
+
+void FileManager::setLazyLoadingEnabled(bool enabled)
+{
+    m_loadOptions.lazyLoading = enabled;
+}
+
+bool FileManager::isLazyLoadingEnabled() const
+{
+    return m_loadOptions.lazyLoading;
+}
+
+void FileManager::setCompactStorageEnabled(bool enabled)
+{
+    m_loadOptions.compactStorage = enabled;
+}
+
+bool FileManager::isCompactStorageEnabled() const
+{
+    return m_loadOptions.compactStorage;
+}
+
+/**
+ * Writes the decoded volume on a worker thread
+ * 
+ * The worker holds its own reference to the image, so opening another
+ * file meanwhile does not disturb the save. Progress is throttled like
+ * load progress and posted the same way. cancelSaving() stops the writer
+ * between batches.
+ */
+bool FileManager::saveNiftiFile(const QString &filePath, int compressionLevel)
+{
+    if (!canSave() || isSaving() || filePath.isEmpty()) {
+        emit fileSavingError(isSaving() ? QString("A save is already running") : QString("No decoded volume to save"));
+        return false;
+    }
+    
+    emit fileSavingStarted(QFileInfo(filePath).fileName());
+    emit fileSavingProgress(0);
+    
+    m_saveCancelFlag = std::make_shared<std::atomic_bool>(false);
+    
+    QElapsedTimer timer;
+    timer.start();
+    qint64 lastReportMs = -PROGRESS_INTERVAL_MS;
+    std::shared_ptr<std::atomic_bool> cancelFlag = m_saveCancelFlag;
+    QPointer<FileManager> guard(this);
+    NiftiVolumeWriter::ProgressCallback progress =
+        [guard, cancelFlag, timer, lastReportMs](qint64 bytesDone, qint64 bytesTotal) mutable {
+            if (cancelFlag->load()) {
+                return;
+            }
+            qint64 elapsedMs = timer.elapsed();
+            if (bytesDone < bytesTotal && elapsedMs - lastReportMs < PROGRESS_INTERVAL_MS) {
+                return;
+            }
+            lastReportMs = elapsedMs;
+            const int percentage = bytesTotal > 0 ? static_cast<int>(bytesDone * 100 / bytesTotal) : 0;
+            QMetaObject::invokeMethod(guard.data(), [guard, cancelFlag, percentage]() {
+                if (!guard || cancelFlag->load()) {
+                    return;
+                }
+                emit guard->fileSavingProgress(percentage);
+            }, Qt::QueuedConnection);
+        };
+    
+    m_saveWatcher->setFuture(QtConcurrent::run(&FileManager::writeVolume, filePath, m_imageData,
+                                                 m_lastLoadedFile, compressionLevel, m_saveCancelFlag, progress));
+    return true;
+}
+
+void FileManager::cancelSaving()
+{
+    if (m_saveCancelFlag) {
+        m_saveCancelFlag->store(true);
+    }
+}
+
+bool FileManager::isSaving() const
+{
+    return m_saveWatcher->isRunning();
+}
+
+bool FileManager::canSave() const
+{
+    return m_imageData != nullptr;
+}
+
+/**
+ * Worker side of saveNiftiFile(); the loaded file's header is re-read
+ * here for its transforms, scaling and description
+ */
+FileManager::SaveResult FileManager::writeVolume(const QString &filePath,
+                                                 vtkSmartPointer<vtkImageData> imageData,
+                                                 const QString &sourcePath,
+                                                 int compressionLevel,
+                                                 std::shared_ptr<std::atomic_bool> cancelFlag,
+                                                 NiftiVolumeWriter::ProgressCallback progress)
+{
+    QElapsedTimer timer;
+    timer.start();
+    
+    NiftiVolumeWriter writer(filePath);
+    const NiftiHeaderScanner::Entry source = NiftiHeaderScanner::scanFile(sourcePath);
+    if (source.errorString.isEmpty()) {
+        writer.setTemplateHeader(source.header);
+    }
+    writer.setCompressionLevel(compressionLevel);
+    writer.setProgressCallback(progress);
+    writer.setCancelFlag(cancelFlag.get());
+    
+    SaveResult result;
+    result.filePath = filePath;
+    if (!writer.write(imageData)) {
+        result.cancelled = writer.wasCancelled();
+        result.errorMessage = QString("Error saving file: %1").arg(writer.errorString());
+    }
+    result.fileBytes = writer.fileBytesWritten();
+    result.seconds = timer.elapsed() / 1000.0;
+    return result;
+}
+
+void FileManager::onSaveFinished()
+{
+    SaveResult result = m_saveWatcher->result();
+    if (result.cancelled) {
+        emit fileSavingCancelled(QFileInfo(result.filePath).fileName());
+        return;
+    }
+    if (!result.errorMessage.isEmpty()) {
+        emit fileSavingError(result.errorMessage);
+        return;
+    }
+    
+    qDebug() << "Saved" << result.filePath << "-" << result.fileBytes / BYTES_PER_MB << "MB in"
+             << result.seconds << "s";
+    
+    emit fileSavingProgress(100);
+    emit fileSavingCompleted(QFileInfo(result.filePath).fileName(), result.fileBytes, result.seconds);
+}
+
+FileManager::LoadResult FileManager::readVolume(const QString &filePath,
+                                                LoadOptions options,
+                                                std::shared_ptr<DiskVolumeCache> diskCache,
+                                                std::shared_ptr<std::atomic_bool> cancelFlag,
+                                                NiftiVolumeReader::ProgressCallback progress)
+{
+    QElapsedTimer timer;
+    timer.start();
+    
+    // A decoded copy turns a .nii.gz into a plain .nii: mapped, lazily sliceable, seekable
+    QString sourcePath = filePath;
+    if (options.diskCache && filePath.toLower().endsWith(".gz")) {
+        QString cachedPath = diskCache->lookup(filePath);
+        if (!cachedPath.isEmpty()) {
+            sourcePath = cachedPath;
+        }
+    }
+    const bool diskCached = sourcePath != filePath;
+    
+    // The streaming reader covers every scalar datatype; VTK handles the rest
+    NiftiVolumeReader niftiReader(sourcePath);
+    if (!niftiReader.readHeader() || !niftiReader.canRead()) {
+        LoadResult result = readVolumeWithVtk(filePath, cancelFlag);
+        result.seconds = timer.elapsed() / 1000.0;
+        return result;
+    }
+    
+    // Large volumes are served slice by slice when the file allows random access
+    if (options.lazyLoading && niftiReader.header().bytesPerVolume() >= LAZY_THRESHOLD_BYTES) {
+        auto lazySource = std::make_shared<LazyVolumeSource>(sourcePath);
+        if (lazySource->open()) {
+            LoadResult result;
+            result.lazySource = lazySource;
+            result.diskCached = diskCached;
+            result.seconds = timer.elapsed() / 1000.0;
+            return result;
+        }
+        qDebug() << "Lazy loading not possible, decoding whole volume:" << lazySource->errorString();
+    }
+    
+    niftiReader.setCancelFlag(cancelFlag.get());
+    niftiReader.setProgressCallback(progress);
+    niftiReader.setMemoryMappingEnabled(options.memoryMapping);
+    niftiReader.setParallelDecompressionEnabled(options.parallelDecompression);
+    
+    LoadResult result;
+    result.imageData = niftiReader.read();
+    result.cancelled = niftiReader.wasCancelled();
+    if (!result.imageData && !result.cancelled) {
+        result.errorMessage = QString("Error loading file: %1").arg(niftiReader.errorString());
+    }
+    result.bytesDecoded = niftiReader.header().bytesPerVolume();
+    result.fileBytes = niftiReader.fileBytesRead();
+    result.memoryMapped = niftiReader.isMemoryMapped();
+    result.parallelDecompressed = niftiReader.isParallelDecompressed();
+    result.diskCached = diskCached;
+    
+    // Wide voxels shrink when no value changes. Mappings cost no heap, and
+    // 4D files keep the type their frames are decoded in.
+    const NiftiHeader &header = niftiReader.header();
+    if (options.compactStorage && result.imageData && !result.memoryMapped && header.volumeCount() == 1) {
+        vtkSmartPointer<vtkImageData> narrowed = VolumeNarrowing::narrow(result.imageData);
+        if (narrowed) {
+            result.narrowedFromType = result.imageData->GetScalarType();
+            result.imageData = narrowed;
+            result.bytesDecoded = static_cast<qint64>(narrowed->GetNumberOfPoints()) *
+                                  narrowed->GetNumberOfScalarComponents() * narrowed->GetScalarSize();
+        }
+    }
+    
+    // Statistics are computed off the load path; scl_slope and scl_inter go to
+    // the summary, not to the voxels
+    if (header.hasScaling()) {
+        result.sclSlope = header.sclSlope;
+        result.sclInter = header.sclInter;
+    }
+    
+    // The first frame is on screen right away; the rest are decoded while playing
+    if (result.imageData && header.volumeCount() > 1) {
+        auto timeSeries = std::make_shared<TimeSeriesSource>(sourcePath);
+        if (timeSeries->open()) {
+            result.timeSeries = timeSeries;
+        } else {
+            qDebug() << "Time series not available:" << timeSeries->errorString();
+        }
+    }
+    
+    result.seconds = timer.elapsed() / 1000.0;
+    return result;
+}
+
+FileManager::LoadResult FileManager::readVolumeWithVtk(const QString &filePath,
+                                                       std::shared_ptr<std::atomic_bool> cancelFlag)
+{
+    LoadResult result;
+    
+    // Each load gets its own reader so a cancelled worker can finish independently
+    vtkSmartPointer<vtkNIFTIImageReader> reader = vtkSmartPointer<vtkNIFTIImageReader>::New();
+    reader->SetFileName(filePath.toStdString().c_str());
+    
+    vtkSmartPointer<vtkCallbackCommand> abortObserver = vtkSmartPointer<vtkCallbackCommand>::New();
+    abortObserver->SetCallback(abortReaderIfCancelled);
+    abortObserver->SetClientData(cancelFlag.get());
+    reader->AddObserver(vtkCommand::ProgressEvent, abortObserver);
     
     try {
-        // Set the file to read
-        m_reader->SetFileName(filePath.toStdString().c_str());
-        
-        // Update progress
-        emit fileLoadingProgress(30);
-        QApplication::processEvents();
-        
         // Read the file
-        m_reader->Update();
-        
-        emit fileLoadingProgress(70);
-        QApplication::processEvents();
-        
-        // Get the image data
-        m_imageData = m_reader->GetOutput();
-        
-        if (!m_imageData) {
-            emit fileLoadingError("Failed to read image data from file");
-            return false;
-        }
-        
-        emit fileLoadingProgress(100);
-        m_lastLoadedFile = filePath;
-        
-        emit fileLoadingCompleted(QFileInfo(filePath).fileName());
-        return true;
-        
+        reader->Update();
     } catch (const std::exception &e) {
-        emit fileLoadingError(QString("Error loading file: %1").arg(e.what()));
-        return false;
+        result.errorMessage = QString("Error loading file: %1").arg(e.what());
+        return result;
+    }
+    
+    if (cancelFlag->load()) {
+        result.cancelled = true;
+        return result;
+    }
+    
+    if (reader->GetErrorCode() != vtkErrorCode::NoError || !reader->GetOutput()) {
+        result.errorMessage = "Failed to read image data from file";
+        return result;
+    }
+    
+    // Detach the output from the reader's pipeline; the voxel buffer is shared, not copied
+    result.imageData = vtkSmartPointer<vtkImageData>::New();
+    result.imageData->ShallowCopy(reader->GetOutput());
+    result.bytesDecoded = static_cast<qint64>(result.imageData->GetNumberOfPoints()) *
+                          result.imageData->GetNumberOfScalarComponents() *
+                          result.imageData->GetScalarSize();
+    result.fileBytes = QFileInfo(filePath).size();
+    return result;
+}
+
+void FileManager::onLoadFinished()
+{
+    LoadResult result = m_loadWatcher->result();
+    
+    // A load that was cancelled, or superseded by a cache hit, must not replace the volume
+    if (result.cancelled || m_cancelFlag->load()) {
+        return;
+    }
+    
+    if (!result.imageData && !result.lazySource) {
+        emit fileLoadingError(result.errorMessage);
+        return;
     }
+    
+    m_imageData = result.imageData;
+    m_lazySource = result.lazySource;
+    m_timeSeries = result.timeSeries;
+    m_statistics.reset();
+    m_lastLoadedFile = m_pendingFile;
+    m_lastLoadBytes = result.bytesDecoded;
+    m_lastLoadFileBytes = result.fileBytes;
+    m_lastLoadSeconds = result.seconds;
+    m_lastLoadMapped = result.memoryMapped;
+    m_lastLoadParallel = result.parallelDecompressed;
+    m_lastLoadCached = false;
+    m_lastLoadDiskCached = result.diskCached;
+    m_lastLoadNarrowedFrom = result.narrowedFromType;
+    
+    // The next open of this file skips gunzip; the copy is written in the background
+    if (m_loadOptions.diskCache && !result.diskCached && m_lastLoadedFile.toLower().endsWith(".gz")) {
+        m_diskCache->store(m_lastLoadedFile, result.imageData);
+    }
+    
+    // Lazy sources are cheap to reopen; only decoded volumes are worth keeping
+    if (m_imageData) {
+        m_volumeCache->insert(m_lastLoadedFile, makeCacheEntry(result));
+    }
+    addRecentFile(m_lastLoadedFile);
+    m_statisticsSlope = result.sclSlope;
+    m_statisticsIntercept = result.sclInter;
+    startStatistics();
+    startPyramid();
+    cancelBricks();
+    m_bricks.reset();
+    startPrefetch(m_lastLoadedFile);
+    
+    qDebug() << "Loaded" << m_lastLoadedFile << "-" << m_lastLoadBytes / BYTES_PER_MB << "MB in"
+             << m_lastLoadSeconds << "s";
+    
+    emit fileLoadingProgress(100);
+    emit fileLoadingCompleted(QFileInfo(m_lastLoadedFile).fileName());
 }
 
 vtkImageData* FileManager::getImageData() const
@@ -85,6 +585,198 @@ vtkImageData* FileManager::getImageData() const
     return m_imageData;
 }
 
+std::shared_ptr<LazyVolumeSource> FileManager::getLazySource() const
+{
+    return m_lazySource;
+}
+
+std::shared_ptr<TimeSeriesSource> FileManager::getTimeSeries() const
+{
+    return m_timeSeries;
+}
+
+std::shared_ptr<VolumePyramid> FileManager::getPyramid() const
+{
+    return m_pyramid;
+}
+
+std::shared_ptr<VolumeStatistics> FileManager::getStatistics() const
+{
+    return m_statistics;
+}
+
+std::shared_ptr<IntensityHistogram> FileManager::getHistogram() const
+{
+    return m_statistics ? m_statistics->histogram() : nullptr;
+}
+
+void FileManager::setPyramidEnabled(bool enabled)
+{
+    m_pyramidEnabled = enabled;
+    if (!enabled) {
+        cancelPyramid();
+    }
+}
+
+bool FileManager::isPyramidEnabled() const
+{
+    return m_pyramidEnabled;
+}
+
+std::shared_ptr<BrickedVolume> FileManager::getBricks() const
+{
+    return m_bricks;
+}
+
+void FileManager::setBrickedLayoutEnabled(bool enabled)
+{
+    m_brickedLayoutEnabled = enabled;
+    if (!enabled) {
+        cancelBricks();
+        m_bricks.reset();
+    }
+}
+
+bool FileManager::isBrickedLayoutEnabled() const
+{
+    return m_brickedLayoutEnabled;
+}
+
+void FileManager::setVolumeCacheBudget(qint64 bytes)
+{
+    m_volumeCache->setBudget(bytes);
+}
+
+qint64 FileManager::getVolumeCacheBudget() const
+{
+    return m_volumeCache->budget();
+}
+
+bool FileManager::isVolumeCached(const QString &filePath) const
+{
+    return m_volumeCache->contains(filePath);
+}
+
+void FileManager::clearVolumeCache()
+{
+    m_volumeCache->clear();
+}
+
+QString FileManager::getVolumeCacheStatus() const
+{
+    return QString("%1 / %2 MB in %3 volumes, %4 hits, %5 misses")
+        .arg(m_volumeCache->usedBytes() / BYTES_PER_MB, 0, 'f', 0)
+        .arg(m_volumeCache->budget() / BYTES_PER_MB, 0, 'f', 0)
+        .arg(m_volumeCache->entryCount())
+        .arg(m_volumeCache->hits())
+        .arg(m_volumeCache->misses());
+}
+
+void FileManager::setDiskCacheEnabled(bool enabled)
+{
+    m_loadOptions.diskCache = enabled;
+}
+
+bool FileManager::isDiskCacheEnabled() const
+{
+    return m_loadOptions.diskCache;
+}
+
+void FileManager::setDiskCacheSize(qint64 bytes)
+{
+    m_diskCache->setSizeCap(bytes);
+}
+
+qint64 FileManager::getDiskCacheSize() const
+{
+    return m_diskCache->sizeCap();
+}
+
+void FileManager::clearDiskCache()
+{
+    m_diskCache->clear();
+}
+
+QString FileManager::getDiskCacheStatus() const
+{
+    return QString("%1 / %2 MB, %3 hits, %4 misses")
+        .arg(m_diskCache->usedBytes() / BYTES_PER_MB, 0, 'f', 0)
+        .arg(m_diskCache->sizeCap() / BYTES_PER_MB, 0, 'f', 0)
+        .arg(m_diskCache->hits())
+        .arg(m_diskCache->misses());
+}
+
+void FileManager::setPrefetchEnabled(bool enabled)
+{
+    m_prefetchEnabled = enabled;
+    if (!enabled) {
+        cancelPrefetch();
+    }
+}
+
+bool FileManager::isPrefetchEnabled() const
+{
+    return m_prefetchEnabled;
+}
+
+void FileManager::setPrefetchCount(int count)
+{
+    m_prefetchCount = std::max(0, count);
+}
+
+int FileManager::getPrefetchCount() const
+{
+    return m_prefetchCount;
+}
+
+void FileManager::setPrefetchBudget(qint64 bytes)
+{
+    m_prefetchBudget = std::max<qint64>(0, bytes);
+}
+
+qint64 FileManager::getPrefetchBudget() const
+{
+    return m_prefetchBudget;
+}
+
+void FileManager::cancelPrefetch()
+{
+    if (m_prefetchCancelFlag) {
+        m_prefetchCancelFlag->store(true);
+    }
+    m_prefetchPool.clear();
+}
+
+/**
+ * Lists the NIfTI files that follow a file in its directory
+ * 
+ * Uses the open dialog's filter and name order, so "next" means the
+ * file a user stepping through the folder would pick next.
+ */
+QStringList FileManager::getSiblingFiles(const QString &filePath, int count) const
+{
+    QFileInfo fileInfo(filePath);
+    QDir directory = fileInfo.absoluteDir();
+    const QStringList entries = directory.entryList({"*.nii", "*.nii.gz"}, QDir::Files, QDir::Name);
+    
+    QStringList siblings;
+    for (int i = entries.indexOf(fileInfo.fileName()) + 1;
+         i > 0 && i < entries.size() && siblings.size() < count; ++i) {
+        siblings << directory.absoluteFilePath(entries[i]);
+    }
+    return siblings;
+}
+
+QStringList FileManager::getRecentFiles() const
+{
+    return QSettings().value(RECENT_FILES_KEY).toStringList();
+}
+
+void FileManager::clearRecentFiles()
+{
+    QSettings().remove(RECENT_FILES_KEY);
+}
+
 QString FileManager::getLastLoadedFile() const
 {
     return m_lastLoadedFile;
@@ -92,6 +784,29 @@ QString FileManager::getLastLoadedFile() const
 
 QString FileManager::getFileInfo() const
 {
+    if (m_lazySource) {
+        double spacing[3];
+        m_lazySource->getSpacing(spacing);
+        
+        QString info;
+        info += QString("File: %1\n").arg(QFileInfo(m_lastLoadedFile).fileName());
+        info += QString("Dimensions: %1 x %2 x %3\n").arg(m_lazySource->dimension(0)).arg(m_lazySource->dimension(1)).arg(m_lazySource->dimension(2));
+        info += QString("Spacing: %1 x %2 x %3 mm\n").arg(spacing[0], 0, 'f', 2).arg(spacing[1], 0, 'f', 2).arg(spacing[2], 0, 'f', 2);
+        info += describeHeader(m_lastLoadedFile);
+        info += QString("Load: %1 MB decoded slice by slice on demand (opened in %2 s)\n")
+                    .arg(m_lazySource->header().bytesPerVolume() / BYTES_PER_MB, 0, 'f', 1)
+                    .arg(m_lastLoadSeconds, 0, 'f', 3);
+        info += QString("Slice cache: %1 / %2 MB, %3 hits, %4 misses\n")
+                    .arg(m_lazySource->cachedBytes() / BYTES_PER_MB, 0, 'f', 1)
+                    .arg(m_lazySource->cacheBudget() / BYTES_PER_MB, 0, 'f', 0)
+                    .arg(m_lazySource->cacheHits())
+                    .arg(m_lazySource->cacheMisses());
+        if (m_lastLoadDiskCached) {
+            info += "Source: decoded copy from the disk cache\n";
+        }
+        return info;
+    }
+    
     if (!m_imageData) {
         return "No file loaded";
     }
@@ -105,6 +820,96 @@ QString FileManager::getFileInfo() const
     info += QString("Dimensions: %1 x %2 x %3\n").arg(dimensions[0]).arg(dimensions[1]).arg(dimensions[2]);
     info += QString("Spacing: %1 x %2 x %3 mm\n").arg(spacing[0], 0, 'f', 2).arg(spacing[1], 0, 'f', 2).arg(spacing[2], 0, 'f', 2);
     info += QString("Origin: %1 x %2 x %3 mm\n").arg(origin[0], 0, 'f', 2).arg(origin[1], 0, 'f', 2).arg(origin[2], 0, 'f', 2);
+    info += describeHeader(m_lastLoadedFile);
+    if (m_timeSeries) {
+        double interval = m_timeSeries->frameInterval();
+        info += interval > 0.0 ? QString("Frames: %1 (%2 s apart)\n").arg(m_timeSeries->frameCount()).arg(interval, 0, 'f', 3)
+                               : QString("Frames: %1\n").arg(m_timeSeries->frameCount());
+    }
+    
+    // Built-in I/O probe: decoded size, time and throughput of the last open
+    if (m_lastLoadCached) {
+        info += QString("Load: %1 MB from the volume cache in %2 s\n")
+                    .arg(m_lastLoadBytes / BYTES_PER_MB, 0, 'f', 1)
+                    .arg(m_lastLoadSeconds, 0, 'f', 3);
+    } else if (m_lastLoadMapped) {
+        info += QString("Load: %1 MB memory-mapped in %2 s (paged in on demand)\n")
+                    .arg(m_lastLoadBytes / BYTES_PER_MB, 0, 'f', 1)
+                    .arg(m_lastLoadSeconds, 0, 'f', 3);
+    } else if (m_lastLoadSeconds > 0.0) {
+        info += QString("Load: %1 MB (%2 MB on disk) in %3 s, %4 MB/s\n")
+                    .arg(m_lastLoadBytes / BYTES_PER_MB, 0, 'f', 1)
+                    .arg(m_lastLoadFileBytes / BYTES_PER_MB, 0, 'f', 1)
+                    .arg(m_lastLoadSeconds, 0, 'f', 2)
+                    .arg(m_lastLoadBytes / BYTES_PER_MB / m_lastLoadSeconds, 0, 'f', 1);
+        if (m_lastLoadParallel) {
+            info += "Decompression: parallel (BGZF blocks)\n";
+        }
+    }
+    if (m_lastLoadDiskCached) {
+        info += "Source: decoded copy from the disk cache\n";
+    }
+    if (m_lastLoadNarrowedFrom != 0 && m_imageData) {
+        const int storedSize = vtkDataArray::GetDataTypeSize(m_lastLoadNarrowedFrom);
+        info += QString("Storage: %1 kept as %2, %3 MB instead of %4 MB\n")
+                    .arg(vtkImageScalarTypeNameMacro(m_lastLoadNarrowedFrom))
+                    .arg(m_imageData->GetScalarTypeAsString())
+                    .arg(m_lastLoadBytes / BYTES_PER_MB, 0, 'f', 1)
+                    .arg(m_lastLoadBytes * storedSize / m_imageData->GetScalarSize() / BYTES_PER_MB, 0, 'f', 1);
+    }
+    info += QString("Volume cache: %1\n").arg(getVolumeCacheStatus());
+    if (m_prefetchEnabled) {
+        const QStringList siblings = getSiblingFiles(m_lastLoadedFile, m_prefetchCount);
+        int ready = 0;
+        for (const QString &sibling : siblings) {
+            ready += isVolumeCached(sibling) ? 1 : 0;
+        }
+        info += QString("Prefetch: %1 of the next %2 files in memory\n").arg(ready).arg(siblings.size());
+    }
+    if (m_loadOptions.diskCache) {
+        info += QString("Disk cache: %1\n").arg(getDiskCacheStatus());
+    }
+    if (m_pyramid) {
+        info += QString("Pyramid: %1 levels, %2 MB\n")
+                    .arg(m_pyramid->levelCount())
+                    .arg(m_pyramid->reducedBytes() / BYTES_PER_MB, 0, 'f', 1);
+    } else if (m_pyramidWatcher->isRunning()) {
+        info += "Pyramid: building\n";
+    }
+    if (m_statistics) {
+        // Real-world values when the file is scaled
+        info += QString("Intensity%1: %2 to %3, mean %4, std %5\n")
+                    .arg(m_statistics->isScaled() ? " (scaled)" : "")
+                    .arg(m_statistics->scaledMinimum(), 0, 'g', 6)
+                    .arg(m_statistics->scaledMaximum(), 0, 'g', 6)
+                    .arg(m_statistics->scaledMean(), 0, 'g', 6)
+                    .arg(m_statistics->scaledStandardDeviation(), 0, 'g', 6);
+        info += QString("Percentiles 1/50/99: %1 / %2 / %3\n")
+                    .arg(m_statistics->scaledPercentile(0.01), 0, 'g', 6)
+                    .arg(m_statistics->scaledPercentile(0.5), 0, 'g', 6)
+                    .arg(m_statistics->scaledPercentile(0.99), 0, 'g', 6);
+        int box[6];
+        if (m_statistics->getNonZeroExtent(box)) {
+            info += QString("Non-zero: %1 voxels in [%2-%3, %4-%5, %6-%7]\n")
+                        .arg(m_statistics->nonZeroVoxels())
+                        .arg(box[0]).arg(box[1]).arg(box[2]).arg(box[3]).arg(box[4]).arg(box[5]);
+        } else {
+            info += "Non-zero: none\n";
+        }
+        if (m_statistics->nonFiniteCount() > 0) {
+            info += QString("Non-finite values: %1\n").arg(m_statistics->nonFiniteCount());
+        }
+        info += QString("Statistics: %1 ms\n").arg(m_statistics->computeSeconds() * 1000.0, 0, 'f', 1);
+    } else if (m_statisticsWatcher->isRunning() && !m_statisticsCancelFlag->load()) {
+        info += "Statistics: computing\n";
+    } else if (m_imageData && m_lastLoadMapped) {
+        info += "Statistics: not computed for memory-mapped volumes; choose a contrast preset\n";
+    }
+    if (m_bricks) {
+        info += QString("Bricked copy: %1 MB\n").arg(m_bricks->bytes() / BYTES_PER_MB, 0, 'f', 1);
+    } else if (m_bricksWatcher->isRunning()) {
+        info += "Bricked copy: building\n";
+    }
     
     return info;
 }
@@ -126,3 +931,346 @@ bool FileManager::validateFile(const QString &filePath)
     // Additional validation can be added here
     return true;
 }
+
+/**
+ * Serves a load from the volume cache without touching the file
+ * 
+ * The signals are the same as for a background load, emitted before
+ * returning, so callers need no special handling for cache hits.
+ */
+bool FileManager::loadFromCache(const QString &filePath)
+{
+    QElapsedTimer timer;
+    timer.start();
+    
+    VolumeCache::Entry entry;
+    if (!m_volumeCache->lookup(filePath, entry)) {
+        return false;
+    }
+    
+    m_pendingFile = filePath;
+    emit fileLoadingStarted(QFileInfo(filePath).fileName());
+    
+    m_imageData = entry.imageData;
+    m_lazySource.reset();
+    m_timeSeries = entry.timeSeries;
+    m_statistics = entry.statistics;
+    m_lastLoadedFile = filePath;
+    m_lastLoadBytes = entry.bytes - (entry.pyramid ? entry.pyramid->reducedBytes() : 0);
+    m_lastLoadFileBytes = 0;
+    m_lastLoadSeconds = timer.elapsed() / 1000.0;
+    m_lastLoadMapped = entry.memoryMapped;
+    m_lastLoadParallel = false;
+    m_lastLoadCached = true;
+    m_lastLoadDiskCached = false;
+    m_lastLoadNarrowedFrom = entry.narrowedFromType;
+    addRecentFile(filePath);
+    
+    // Statistics and a pyramid finished on an earlier visit come back with their volume
+    m_statisticsSlope = entry.sclSlope;
+    m_statisticsIntercept = entry.sclInter;
+    if (m_statistics) {
+        cancelStatistics();
+    } else {
+        startStatistics();
+    }
+    if (entry.pyramid) {
+        cancelPyramid();
+        m_pyramid = entry.pyramid;
+    } else {
+        startPyramid();
+    }
+    cancelBricks();
+    m_bricks.reset();
+    startPrefetch(filePath);
+    
+    qDebug() << "Loaded" << m_lastLoadedFile << "from the volume cache -"
+             << m_lastLoadBytes / BYTES_PER_MB << "MB";
+    
+    emit fileLoadingProgress(100);
+    emit fileLoadingCompleted(QFileInfo(m_lastLoadedFile).fileName());
+    return true;
+}
+
+void FileManager::addRecentFile(const QString &filePath)
+{
+    QString absolutePath = QFileInfo(filePath).absoluteFilePath();
+    
+    QSettings settings;
+    QStringList recentFiles = settings.value(RECENT_FILES_KEY).toStringList();
+    recentFiles.removeAll(absolutePath);
+    recentFiles.prepend(absolutePath);
+    while (recentFiles.size() > MAX_RECENT_FILES) {
+        recentFiles.removeLast();
+    }
+    settings.setValue(RECENT_FILES_KEY, recentFiles);
+}
+
+/**
+ * Starts building the pyramid of the current volume on the global pool
+ * 
+ * Lazy volumes have no decoded data to reduce, and small volumes already
+ * render interactively at full resolution, so neither gets a pyramid.
+ * Nor do memory-mapped volumes: reducing one reads every page of the
+ * file, which would undo the instant open that mapping buys, and the
+ * levels would take resident memory the mapping was chosen to avoid.
+ * Such volumes render at full resolution from the first frame instead.
+ */
+void FileManager::startPyramid()
+{
+    cancelPyramid();
+    m_pyramid.reset();
+    if (!m_pyramidEnabled || !m_imageData || m_lazySource || m_lastLoadMapped) {
+        return;
+    }
+    
+    const qint64 bytes = static_cast<qint64>(m_imageData->GetNumberOfPoints()) *
+                         m_imageData->GetNumberOfScalarComponents() * m_imageData->GetScalarSize();
+    if (bytes < PYRAMID_MIN_BYTES) {
+        return;
+    }
+    
+    m_pyramidCancelFlag = std::make_shared<std::atomic_bool>(false);
+    m_pyramidWatcher->setFuture(QtConcurrent::run(&VolumePyramid::build, m_imageData,
+                                                    PYRAMID_COARSEST_SIZE, m_pyramidCancelFlag));
+}
+
+void FileManager::cancelPyramid()
+{
+    if (m_pyramidCancelFlag) {
+        m_pyramidCancelFlag->store(true);
+    }
+}
+
+void FileManager::onPyramidFinished()
+{
+    std::shared_ptr<VolumePyramid> pyramid = m_pyramidWatcher->result();
+    
+    // A build for a volume that has since been replaced is of no use
+    if (!pyramid || m_pyramidCancelFlag->load() || pyramid->level(0) != m_imageData.GetPointer()) {
+        return;
+    }
+    
+    m_pyramid = pyramid;
+    m_volumeCache->attachPyramid(m_lastLoadedFile, m_pyramid);
+    
+    qDebug() << "Built pyramid of" << m_lastLoadedFile << "-" << m_pyramid->levelCount() << "levels,"
+             << m_pyramid->reducedBytes() / BYTES_PER_MB << "MB";
+    
+    emit pyramidReady();
+}
+
+/**
+ * Builds the bricked copy the first time a view asks for it
+ * 
+ * Only the tri-planar view slices off-axis, so a volume that is never
+ * shown there is never copied. Repeated requests while a build for the
+ * current volume is running, or after it finished, do nothing.
+ */
+void FileManager::requestBricks()
+{
+    const bool building = m_bricksWatcher->isRunning() && m_bricksCancelFlag && !m_bricksCancelFlag->load();
+    if (m_bricks || building) {
+        return;
+    }
+    startBricks();
+}
+
+/**
+ * Starts copying the current volume into bricks on the global pool
+ * 
+ * The copy is as large as the volume, so it is not kept in the volume
+ * cache; a reopened file is bricked again, which costs one pass over
+ * memory rather than a decode. Memory-mapped volumes are never copied:
+ * the copy would read the whole file in and hold it resident, the two
+ * costs mapping was chosen to avoid.
+ */
+void FileManager::startBricks()
+{
+    cancelBricks();
+    m_bricks.reset();
+    if (!m_brickedLayoutEnabled || !m_imageData || m_lazySource || m_lastLoadMapped) {
+        return;
+    }
+    
+    m_bricksCancelFlag = std::make_shared<std::atomic_bool>(false);
+    m_bricksWatcher->setFuture(QtConcurrent::run(&BrickedVolume::build, m_imageData, m_bricksCancelFlag));
+}
+
+void FileManager::cancelBricks()
+{
+    if (m_bricksCancelFlag) {
+        m_bricksCancelFlag->store(true);
+    }
+}
+
+void FileManager::onBricksFinished()
+{
+    std::shared_ptr<BrickedVolume> bricks = m_bricksWatcher->result();
+    
+    // A copy of a volume that has since been replaced is of no use
+    if (!bricks || m_bricksCancelFlag->load() || bricks->source() != m_imageData.GetPointer()) {
+        return;
+    }
+    
+    m_bricks = bricks;
+    qDebug() << "Built bricked copy of" << m_lastLoadedFile << "-" << m_bricks->bytes() / BYTES_PER_MB << "MB";
+    
+    emit bricksReady();
+}
+
+/**
+ * Starts summarising the current volume on the global pool
+ * 
+ * The info panel and auto-contrast pick the result up from
+ * statisticsReady, so the load never waits for the two passes. Memory-
+ * mapped volumes are skipped here, as for the pyramid and the bricked
+ * copy: the passes would read every page of the file. requestStatistics()
+ * computes them when a contrast preset is chosen.
+ */
+void FileManager::startStatistics()
+{
+    cancelStatistics();
+    m_statistics.reset();
+    if (!m_lastLoadMapped) {
+        requestStatistics();
+    }
+}
+
+void FileManager::cancelStatistics()
+{
+    if (m_statisticsCancelFlag) {
+        m_statisticsCancelFlag->store(true);
+    }
+}
+
+/**
+ * Summarises the current volume on demand, mapped or not
+ * 
+ * Does nothing while a computation for it is running or once it is done.
+ */
+void FileManager::requestStatistics()
+{
+    const bool computing = m_statisticsWatcher->isRunning() && m_statisticsCancelFlag &&
+                           !m_statisticsCancelFlag->load();
+    if (m_statistics || computing || !m_imageData) {
+        return;
+    }
+    
+    m_statisticsCancelFlag = std::make_shared<std::atomic_bool>(false);
+    m_statisticsWatcher->setFuture(QtConcurrent::run(&VolumeStatistics::compute, m_imageData, m_statisticsSlope,
+                                                     m_statisticsIntercept, m_statisticsCancelFlag));
+}
+
+void FileManager::onStatisticsFinished()
+{
+    std::shared_ptr<VolumeStatistics> statistics = m_statisticsWatcher->result();
+    
+    // A summary of a volume that has since been replaced is of no use
+    if (!statistics || m_statisticsCancelFlag->load()) {
+        return;
+    }
+    
+    m_statistics = statistics;
+    m_volumeCache->attachStatistics(m_lastLoadedFile, m_imageData, m_statistics);
+    
+    qDebug() << "Computed statistics of" << m_lastLoadedFile << "in" << m_statistics->computeSeconds() << "s";
+    
+    emit statisticsReady();
+}
+
+/**
+ * Starts decoding the files after filePath into the volume cache
+ * 
+ * The pass is capped at half the volume cache so prefetched files never
+ * push out everything the user has already opened.
+ */
+void FileManager::startPrefetch(const QString &filePath)
+{
+    if (!m_prefetchEnabled || m_prefetchCount <= 0) {
+        return;
+    }
+    
+    const QStringList siblings = getSiblingFiles(filePath, m_prefetchCount);
+    const qint64 budget = std::min(m_prefetchBudget, m_volumeCache->budget() / 2);
+    if (siblings.isEmpty() || budget <= 0) {
+        return;
+    }
+    
+    cancelPrefetch();
+    m_prefetchCancelFlag = std::make_shared<std::atomic_bool>(false);
+    
+    LoadOptions options = m_loadOptions;
+    std::shared_ptr<VolumeCache> volumeCache = m_volumeCache;
+    std::shared_ptr<DiskVolumeCache> diskCache = m_diskCache;
+    std::shared_ptr<std::atomic_bool> cancelFlag = m_prefetchCancelFlag;
+    m_prefetchPool.start([siblings, options, budget, volumeCache, diskCache, cancelFlag]() {
+        prefetchVolumes(siblings, options, budget, volumeCache, diskCache, cancelFlag);
+    });
+}
+
+/**
+ * Decodes files in order until the budget is spent or the pass is cancelled
+ * 
+ * Runs on the prefetch pool. Files that would be opened lazily, or that
+ * only VTK can read, are skipped; the first file that does not fit in
+ * what is left of the budget ends the pass.
+ */
+void FileManager::prefetchVolumes(const QStringList &filePaths,
+                                  LoadOptions options,
+                                  qint64 budget,
+                                  std::shared_ptr<VolumeCache> volumeCache,
+                                  std::shared_ptr<DiskVolumeCache> diskCache,
+                                  std::shared_ptr<std::atomic_bool> cancelFlag)
+{
+    // A background pass stays on its one thread instead of claiming every core
+    options.parallelDecompression = false;
+    options.lazyLoading = false;
+    
+    qint64 used = 0;
+    for (const QString &filePath : filePaths) {
+        if (cancelFlag->load()) {
+            return;
+        }
+        if (volumeCache->contains(filePath)) {
+            continue;
+        }
+        
+        NiftiVolumeReader probe(filePath);
+        if (!probe.readHeader() || !probe.canRead() ||
+            probe.header().bytesPerVolume() >= LAZY_THRESHOLD_BYTES) {
+            continue;
+        }
+        if (used + probe.header().bytesPerVolume() > budget) {
+            return;
+        }
+        
+        LoadResult result = readVolume(filePath, options, diskCache, cancelFlag, nullptr);
+        if (result.cancelled || cancelFlag->load() || !result.imageData) {
+            continue;
+        }
+        used += result.bytesDecoded;
+        volumeCache->insert(filePath, makeCacheEntry(result));
+        
+        if (options.diskCache && !result.diskCached && filePath.toLower().endsWith(".gz")) {
+            diskCache->store(filePath, result.imageData);
+        }
+        qDebug() << "Prefetched" << filePath << "-" << result.bytesDecoded / BYTES_PER_MB << "MB";
+    }
+}
+
+VolumeCache::Entry FileManager::makeCacheEntry(const LoadResult &result)
+{
+    VolumeCache::Entry entry;
+    entry.imageData = result.imageData;
+    entry.timeSeries = result.timeSeries;
+    entry.sclSlope = result.sclSlope;
+    entry.sclInter = result.sclInter;
+    entry.bytes = result.bytesDecoded;
+    entry.fileBytes = result.fileBytes;
+    entry.seconds = result.seconds;
+    entry.memoryMapped = result.memoryMapped;
+    entry.parallelDecompressed = result.parallelDecompressed;
+    entry.narrowedFromType = result.narrowedFromType;
+    return entry;
+}
\ No newline at end of file
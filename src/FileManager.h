@@ -3,14 +3,35 @@
 
 // Qt base classes for object management and string handling
 #include <QString>
+#include <QStringList>
 #include <QObject>
 
 // Qt dialogs for user interaction
 #include <QFileDialog>
 #include <QMessageBox>
 
+// Qt concurrency for background loading and prefetching
+#include <QFutureWatcher>
+#include <QThreadPool>
+
+// VTK smart pointer for image data handed between threads
+#include <vtkSmartPointer.h>
+
+// Standard library for the shared cancellation flag
+#include <atomic>
+#include <memory>
+
+#include "NiftiVolumeReader.h"
+#include "NiftiVolumeWriter.h"
+#include "LazyVolumeSource.h"
+#include "TimeSeriesSource.h"
+#include "VolumeCache.h"
+#include "DiskVolumeCache.h"
+#include "VolumePyramid.h"
+#include "BrickedVolume.h"
+#include "VolumeStatistics.h"
+
 // Forward declarations of VTK classes to avoid including headers
-class vtkNIFTIImageReader;  // VTK reader for NIfTI file format
 class vtkImageData;         // VTK data structure for image/volume data
 
 /**
@@ -18,7 +39,18 @@ class vtkImageData;         // VTK data structure for image/volume data
  * 
  * This class manages:
  * - File selection through dialogs
- * - NIfTI file loading and parsing
+ * - NIfTI file loading and parsing on a background thread
+ * - Cancellation of an in-flight load
+ * - Slice-on-demand access to volumes too large to decode up front
+ * - Frame access for 4D time series
+ * - An in-memory cache of recently decoded volumes and the recent files list
+ * - An optional on-disk cache of decompressed .nii.gz files
+ * - Optional prefetching of the next files in the same directory
+ * - A background-built resolution pyramid of large volumes
+ * - An optional bricked copy for fast off-axis slicing, built in the background on request
+ * - Intensity statistics and a histogram of each decoded volume, computed in the background after the load
+ * - Lossless narrowing of wide voxel types, with NIfTI intensity scaling applied to the statistics only
+ * - Saving the decoded volume as .nii or parallel-compressed .nii.gz in the background
  * - File validation and error handling
  * - Progress reporting during file operations
  * - Access to loaded image data
@@ -30,11 +62,112 @@ class FileManager : public QObject
 public:
     explicit FileManager(QObject *parent = nullptr);
     ~FileManager();
-
+    
+    /**
+     * Loader options, copied to the worker thread at the start of each load
+     */
+    struct LoadOptions {
+        bool memoryMapping = true;               // Zero-copy mmap for uncompressed files
+        bool parallelDecompression = true;       // Block-parallel inflate for BGZF files
+        bool lazyLoading = true;                 // Slice-on-demand for volumes above the threshold
+        bool diskCache = false;                  // Open .nii.gz files through decoded copies on disk
+        bool compactStorage = true;              // Keep voxels in the smallest type that holds them exactly
+    };
+    
+    /**
+     * Result of a load, returned from the worker thread or to a direct caller
+     */
+    struct LoadResult {
+        vtkSmartPointer<vtkImageData> imageData; // Loaded volume, null on failure or lazy open
+        std::shared_ptr<LazyVolumeSource> lazySource; // Slice source for a lazy open
+        std::shared_ptr<TimeSeriesSource> timeSeries; // Remaining frames of a 4D file
+        double sclSlope = 1.0;                   // NIfTI intensity scaling, applied to the statistics only
+        double sclInter = 0.0;                   // NIfTI intensity offset, applied to the statistics only
+        QString errorMessage;                    // Reason for failure, empty on success
+        bool cancelled = false;                  // True when the load was aborted
+        qint64 bytesDecoded = 0;                 // Voxel bytes produced
+        qint64 fileBytes = 0;                    // Bytes read from disk (compressed size for .nii.gz)
+        double seconds = 0.0;                    // Wall-clock load time
+        bool memoryMapped = false;               // Voxels are a file mapping, not a copy
+        bool parallelDecompressed = false;       // BGZF members were inflated in parallel
+        bool diskCached = false;                 // Read from a decoded copy in the disk cache
+        int narrowedFromType = 0;                // VTK type in the file when the voxels were narrowed, else 0
+    };
+    
+    // Synchronous load - the worker behind loadNiftiFile(), also used by the batch CLI
+    static LoadResult readVolume(const QString &filePath,
+                                 LoadOptions options,
+                                 std::shared_ptr<DiskVolumeCache> diskCache,
+                                 std::shared_ptr<std::atomic_bool> cancelFlag,
+                                 NiftiVolumeReader::ProgressCallback progress);
+    
     // File operations - core functionality
     QString selectNiftiFile(QWidget *parent);           // Open file dialog for NIfTI selection
-    bool loadNiftiFile(const QString &filePath);        // Load and parse NIfTI file
+    bool loadNiftiFile(const QString &filePath);        // Start loading a NIfTI file in the background
+    void cancelLoading();                               // Abort the in-flight load, if any
+    bool isLoading() const;                             // Whether a background load is running
+    
+    // Loader options - apply to the next load
+    void setMemoryMappingEnabled(bool enabled);         // Map uncompressed .nii files instead of copying
+    bool isMemoryMappingEnabled() const;                // Whether the zero-copy path is used
+    void setParallelDecompressionEnabled(bool enabled); // Inflate BGZF .nii.gz members on all cores
+    bool isParallelDecompressionEnabled() const;        // Whether parallel inflate is used
+    void setLazyLoadingEnabled(bool enabled);           // Serve large volumes slice by slice
+    bool isLazyLoadingEnabled() const;                  // Whether large volumes are opened lazily
+    void setCompactStorageEnabled(bool enabled);        // Narrow float64 and other wide voxels when lossless
+    bool isCompactStorageEnabled() const;               // Whether decoded volumes are narrowed
+    
+    // Saving - the decoded volume with the loaded file's transforms and metadata
+    bool saveNiftiFile(const QString &filePath, int compressionLevel); // Start writing .nii or BGZF .nii.gz in the background
+    void cancelSaving();                                // Abort the running save, leaving any existing file untouched
+    bool isSaving() const;                              // Whether a background save is running
+    bool canSave() const;                               // Whether a decoded volume is loaded
     vtkImageData* getImageData() const;                 // Get loaded image data for rendering
+    std::shared_ptr<LazyVolumeSource> getLazySource() const; // Slice source when opened lazily, else null
+    std::shared_ptr<TimeSeriesSource> getTimeSeries() const; // Frame source for 4D files, else null
+    std::shared_ptr<VolumePyramid> getPyramid() const;  // Reduced levels of the volume once built, else null
+    std::shared_ptr<BrickedVolume> getBricks() const;   // Bricked copy of the volume once built, else null
+    std::shared_ptr<VolumeStatistics> getStatistics() const; // Statistics of the decoded volume once computed, else null
+    std::shared_ptr<IntensityHistogram> getHistogram() const; // Histogram of the decoded volume once computed, else null
+    void requestStatistics();                           // Summarise a memory-mapped volume, which is not done on load
+    
+    // Resolution pyramid - 2x-downsampled levels built after each load
+    void setPyramidEnabled(bool enabled);               // Build pyramids for large volumes
+    bool isPyramidEnabled() const;                      // Whether pyramids are built
+    
+    // Bricked layout - cache-blocked copy built when the tri-planar view first needs it
+    void setBrickedLayoutEnabled(bool enabled);         // Build bricked copies of decoded volumes
+    bool isBrickedLayoutEnabled() const;                // Whether bricked copies are built
+    void requestBricks();                               // Build the current volume's copy unless built or building
+    
+    // Volume cache - recently decoded volumes reopen without I/O
+    void setVolumeCacheBudget(qint64 bytes);            // Memory for cached volumes (0 disables)
+    qint64 getVolumeCacheBudget() const;                // Current budget in bytes
+    bool isVolumeCached(const QString &filePath) const; // Whether reopening the file is instant
+    void clearVolumeCache();                            // Release all cached volumes
+    QString getVolumeCacheStatus() const;               // Usage, hits and misses as text
+    
+    // Disk cache - decompressed copies of .nii.gz files that reopen memory-mapped
+    void setDiskCacheEnabled(bool enabled);             // Read and fill the disk cache on later loads
+    bool isDiskCacheEnabled() const;                    // Whether compressed files go through the disk cache
+    void setDiskCacheSize(qint64 bytes);                // Disk space for decoded copies
+    qint64 getDiskCacheSize() const;                    // Current cap in bytes
+    void clearDiskCache();                              // Delete all decoded copies
+    QString getDiskCacheStatus() const;                 // Usage, hits and misses as text
+    
+    // Sibling prefetch - decode the next files in the folder into the volume cache
+    void setPrefetchEnabled(bool enabled);              // Prefetch after each successful load
+    bool isPrefetchEnabled() const;                     // Whether siblings are prefetched
+    void setPrefetchCount(int count);                   // Files after the current one to prefetch
+    int getPrefetchCount() const;                       // Current file count
+    void setPrefetchBudget(qint64 bytes);               // Decoded bytes one prefetch pass may add
+    qint64 getPrefetchBudget() const;                   // Current budget in bytes
+    void cancelPrefetch();                              // Stop the running pass, if any
+    QStringList getSiblingFiles(const QString &filePath, int count) const; // Next NIfTI files by name
+    
+    // Recent files - persisted across sessions
+    QStringList getRecentFiles() const;                 // Most recently opened first
+    void clearRecentFiles();                            // Forget the list
     
     // File information - metadata and validation
     QString getLastLoadedFile() const;                  // Get path of last successfully loaded file
@@ -44,18 +177,120 @@ public:
 signals:
     void fileLoadingStarted(const QString &fileName);    // Emitted when file loading begins
     void fileLoadingProgress(int percentage);            // Emitted during loading to update progress bar
+    void fileLoadingThroughput(qint64 bytesRead, qint64 bytesTotal,
+                               double megabytesPerSecond, double etaSeconds); // Emitted with each progress update
     void fileLoadingCompleted(const QString &fileName);  // Emitted when file successfully loads
+    void fileLoadingCancelled(const QString &fileName);  // Emitted when a load is aborted by the user
     void fileLoadingError(const QString &errorMessage);  // Emitted when file loading fails
+    void pyramidReady();                                 // Emitted when the current volume's pyramid is built
+    void bricksReady();                                  // Emitted when the current volume's bricked copy is built
+    void statisticsReady();                              // Emitted when the current volume's statistics are computed
+    void fileSavingStarted(const QString &fileName);     // Emitted when a save begins
+    void fileSavingProgress(int percentage);             // Emitted during a save to update the progress bar
+    void fileSavingCompleted(const QString &fileName, qint64 fileBytes, double seconds); // Emitted when the file is on disk
+    void fileSavingCancelled(const QString &fileName);   // Emitted once an aborted save has been discarded
+    void fileSavingError(const QString &errorMessage);   // Emitted when a save fails
+
+private slots:
+    void onLoadFinished();                       // Collect the worker result on the GUI thread
+    void onPyramidFinished();                    // Collect a built pyramid on the GUI thread
+    void onBricksFinished();                     // Collect a built bricked copy on the GUI thread
+    void onStatisticsFinished();                 // Collect computed statistics on the GUI thread
+    void onSaveFinished();                       // Report a finished save on the GUI thread
 
 private:
-    // VTK components for file reading
-    vtkNIFTIImageReader *m_reader;     // VTK reader for NIfTI format files
-    QString m_lastLoadedFile;          // Path to the most recently loaded file
-    vtkImageData *m_imageData;         // Currently loaded image data
+    /**
+     * Outcome of a background save
+     */
+    struct SaveResult {
+        QString filePath;                        // File written
+        QString errorMessage;                    // Reason for failure, empty on success
+        bool cancelled = false;                  // Stopped on the cancel flag; nothing was replaced
+        qint64 fileBytes = 0;                    // Size on disk
+        double seconds = 0.0;                    // Wall-clock write time
+    };
+    
+    // Worker entry points - run on a thread pool thread, never touch GUI state
+    static LoadResult readVolumeWithVtk(const QString &filePath,
+                                        std::shared_ptr<std::atomic_bool> cancelFlag);
+    static void prefetchVolumes(const QStringList &filePaths,
+                                LoadOptions options,
+                                qint64 budget,
+                                std::shared_ptr<VolumeCache> volumeCache,
+                                std::shared_ptr<DiskVolumeCache> diskCache,
+                                std::shared_ptr<std::atomic_bool> cancelFlag);
+    static VolumeCache::Entry makeCacheEntry(const LoadResult &result); // Volume cache slot for a load
+    static SaveResult writeVolume(const QString &filePath,
+                                  vtkSmartPointer<vtkImageData> imageData,
+                                  const QString &sourcePath,
+                                  int compressionLevel,
+                                  std::shared_ptr<std::atomic_bool> cancelFlag,
+                                  NiftiVolumeWriter::ProgressCallback progress);
+    
+    // Background loading state
+    QFutureWatcher<LoadResult> *m_loadWatcher;     // Delivers the worker result to the GUI thread
+    std::shared_ptr<std::atomic_bool> m_cancelFlag; // Cancellation flag shared with the current worker
+    QString m_pendingFile;                         // Path of the file being loaded
+    LoadOptions m_loadOptions;                     // Options for the next load
+    
+    // Background saving state
+    QFutureWatcher<SaveResult> *m_saveWatcher;     // Delivers the result of the running save
+    std::shared_ptr<std::atomic_bool> m_saveCancelFlag; // Cancellation flag shared with the running save
+    
+    QString m_lastLoadedFile;                      // Path to the most recently loaded file
+    vtkSmartPointer<vtkImageData> m_imageData;     // Currently loaded image data
+    std::shared_ptr<LazyVolumeSource> m_lazySource; // Currently open lazy volume
+    std::shared_ptr<TimeSeriesSource> m_timeSeries; // Frames of the current 4D file
+    std::shared_ptr<VolumeStatistics> m_statistics; // Statistics of m_imageData, null until computed
+    std::shared_ptr<VolumeCache> m_volumeCache;    // Recently decoded volumes
+    std::shared_ptr<DiskVolumeCache> m_diskCache;  // Decompressed copies of .nii.gz files
+    
+    // Sibling prefetch state
+    QThreadPool m_prefetchPool;                    // Single low-priority thread for prefetch passes
+    std::shared_ptr<std::atomic_bool> m_prefetchCancelFlag; // Cancellation flag of the running pass
+    bool m_prefetchEnabled;                        // Prefetch after each successful load
+    int m_prefetchCount;                           // Files after the current one to prefetch
+    qint64 m_prefetchBudget;                       // Decoded bytes per pass
+    
+    // Resolution pyramid state
+    QFutureWatcher<std::shared_ptr<VolumePyramid>> *m_pyramidWatcher; // Delivers the built pyramid
+    std::shared_ptr<std::atomic_bool> m_pyramidCancelFlag; // Cancellation flag of the running build
+    std::shared_ptr<VolumePyramid> m_pyramid;      // Levels of the current volume, null until built
+    bool m_pyramidEnabled;                         // Build pyramids after each load
+    
+    // Bricked layout state
+    QFutureWatcher<std::shared_ptr<BrickedVolume>> *m_bricksWatcher; // Delivers the built copy
+    std::shared_ptr<std::atomic_bool> m_bricksCancelFlag; // Cancellation flag of the running build
+    std::shared_ptr<BrickedVolume> m_bricks;       // Bricked copy of the current volume, null until built
+    bool m_brickedLayoutEnabled;                   // Build bricked copies on request
+    
+    // Statistics state
+    QFutureWatcher<std::shared_ptr<VolumeStatistics>> *m_statisticsWatcher; // Delivers the computed statistics
+    std::shared_ptr<std::atomic_bool> m_statisticsCancelFlag; // Cancellation flag of the running computation
+    double m_statisticsSlope;                      // scl_slope of the current volume, for its statistics
+    double m_statisticsIntercept;                  // scl_inter of the current volume, for its statistics
+    
+    // I/O statistics of the last successful load
+    qint64 m_lastLoadBytes;                        // Voxel bytes decoded
+    qint64 m_lastLoadFileBytes;                    // Bytes read from disk
+    double m_lastLoadSeconds;                      // Wall-clock load time
+    bool m_lastLoadMapped;                         // Voxels are memory-mapped
+    bool m_lastLoadParallel;                       // Decompressed on all cores
+    bool m_lastLoadCached;                         // Served from the volume cache
+    bool m_lastLoadDiskCached;                     // Read from a decoded copy on disk
+    int m_lastLoadNarrowedFrom;                    // VTK type in the file when narrowed, else 0
     
     // Private helper methods
     bool validateFile(const QString &filePath);  // Internal file validation
-    void updateProgress();                       // Update loading progress
+    bool loadFromCache(const QString &filePath); // Complete a load synchronously on a cache hit
+    void addRecentFile(const QString &filePath); // Move a file to the top of the recent list
+    void startPrefetch(const QString &filePath); // Queue a prefetch pass for the files after filePath
+    void startPyramid();                         // Build the current volume's pyramid in the background
+    void cancelPyramid();                        // Stop the running build, if any
+    void startBricks();                          // Build the current volume's bricked copy in the background
+    void cancelBricks();                         // Stop the running copy, if any
+    void startStatistics();                      // Summarise the current volume in the background
+    void cancelStatistics();                     // Stop the running computation, if any
 };
 
 #endif // FILEMANAGER_H
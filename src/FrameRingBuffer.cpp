@@ -0,0 +1,162 @@
+#include "FrameRingBuffer.h"
+#include "TimeSeriesSource.h"
+
+#include <vtkImageData.h>
+
+#include <algorithm>
+
+FrameRingBuffer::FrameRingBuffer(std::shared_ptr<TimeSeriesSource> source, int capacity)
+    : m_source(source)
+    , m_frameCount(source->frameCount())
+    , m_capacity(std::max(1, std::min(capacity, source->frameCount())))
+    , m_nextFrame(0)
+    , m_decodingFrame(-1)
+    , m_generation(0)
+    , m_running(false)
+    , m_failed(false)
+{
+    m_decoderPool.setMaxThreadCount(1);
+}
+
+FrameRingBuffer::~FrameRingBuffer()
+{
+    stop();
+}
+
+void FrameRingBuffer::start(int firstFrame)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        restartLocked(firstFrame);
+        m_failed = false;
+        if (!m_running) {
+            m_running = true;
+            m_decoderPool.start([this]() { decodeLoop(); });
+        }
+    }
+    m_changed.notify_all();
+}
+
+void FrameRingBuffer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_frames.clear();
+    }
+    m_changed.notify_all();
+    m_decoderPool.waitForDone();
+}
+
+/**
+ * Hands out a frame, dropping every buffered frame before it
+ * 
+ * Without wait the call never blocks: playback skips the tick instead of
+ * stalling the GUI when the decoder has fallen behind.
+ */
+vtkSmartPointer<vtkImageData> FrameRingBuffer::takeFrame(int frame, bool wait)
+{
+    if (frame < 0 || frame >= m_frameCount) {
+        return nullptr;
+    }
+    
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        int position = findFrameLocked(frame);
+        if (position >= 0) {
+            vtkSmartPointer<vtkImageData> image = m_frames[position].image;
+            m_frames.erase(m_frames.begin(), m_frames.begin() + position + 1);
+            lock.unlock();
+            m_changed.notify_all();
+            return image;
+        }
+        
+        if (!m_running) {
+            return nullptr;
+        }
+        
+        if (frame == m_decodingFrame || frame == m_nextFrame) {
+            // Everything still queued precedes the requested frame
+            m_frames.clear();
+        } else {
+            restartLocked(frame);
+        }
+        m_changed.notify_all();
+        
+        if (!wait) {
+            return nullptr;
+        }
+        m_changed.wait(lock);
+    }
+}
+
+int FrameRingBuffer::capacity() const
+{
+    return m_capacity;
+}
+
+int FrameRingBuffer::bufferedFrames() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<int>(m_frames.size());
+}
+
+bool FrameRingBuffer::hasFailed() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failed;
+}
+
+void FrameRingBuffer::decodeLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_changed.wait(lock, [this]() {
+            return !m_running || static_cast<int>(m_frames.size()) < m_capacity;
+        });
+        if (!m_running) {
+            return;
+        }
+        
+        const int frame = m_nextFrame;
+        const unsigned long long generation = m_generation;
+        m_decodingFrame = frame;
+        
+        // Decode without the lock so the consumer can take frames meanwhile
+        lock.unlock();
+        vtkSmartPointer<vtkImageData> image = m_source->readFrame(frame);
+        lock.lock();
+        
+        // A restart while decoding makes this frame stale; drop it
+        if (generation == m_generation) {
+            m_decodingFrame = -1;
+            if (!image) {
+                m_failed = true;
+                m_running = false;
+                m_changed.notify_all();
+                return;
+            }
+            m_frames.push_back({frame, image});
+            m_nextFrame = (frame + 1) % m_frameCount;
+        }
+        m_changed.notify_all();
+    }
+}
+
+void FrameRingBuffer::restartLocked(int firstFrame)
+{
+    m_frames.clear();
+    m_nextFrame = std::max(0, std::min(firstFrame, m_frameCount - 1));
+    m_decodingFrame = -1;
+    ++m_generation;
+}
+
+int FrameRingBuffer::findFrameLocked(int frame) const
+{
+    for (size_t i = 0; i < m_frames.size(); ++i) {
+        if (m_frames[i].index == frame) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
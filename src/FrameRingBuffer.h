@@ -0,0 +1,75 @@
+#ifndef FRAMERINGBUFFER_H
+#define FRAMERINGBUFFER_H
+
+// Qt thread pool for the decoder thread
+#include <QThreadPool>
+
+// VTK smart pointer for the buffered frames
+#include <vtkSmartPointer.h>
+
+// Standard library for the frame queue and its synchronization
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+// Forward declarations
+class vtkImageData;         // VTK data structure for image/volume data
+class TimeSeriesSource;     // Decodes the frames
+
+/**
+ * FrameRingBuffer - Decodes frames of a time series ahead of playback
+ * 
+ * A single background thread decodes frames in order (wrapping at the end
+ * of the series) into a bounded queue. The consumer takes frames from the
+ * front; once the queue is full the decoder sleeps until a slot frees up,
+ * so at most capacity() frames are ever resident.
+ * 
+ * Asking for a frame that is neither buffered nor next in line (a seek)
+ * drops the queue and restarts decoding at that frame.
+ */
+class FrameRingBuffer
+{
+public:
+    FrameRingBuffer(std::shared_ptr<TimeSeriesSource> source, int capacity);
+    ~FrameRingBuffer();
+    
+    void start(int firstFrame);                          // Decode from firstFrame on, dropping buffered frames
+    void stop();                                         // Stop the decoder and release buffered frames
+    vtkSmartPointer<vtkImageData> takeFrame(int frame, bool wait); // Null if not ready (or failed when waiting)
+    
+    int capacity() const;                                // Maximum frames held
+    int bufferedFrames() const;                          // Frames decoded and waiting
+    bool hasFailed() const;                              // Whether the decoder hit a read error
+
+private:
+    /**
+     * One decoded frame waiting in the queue
+     */
+    struct Frame {
+        int index;                                       // Position in the series
+        vtkSmartPointer<vtkImageData> image;             // Decoded volume
+    };
+    
+    std::shared_ptr<TimeSeriesSource> m_source;          // Only touched by the decoder thread
+    int m_frameCount;                                    // Frames in the series
+    int m_capacity;                                      // Queue bound
+    
+    mutable std::mutex m_mutex;                          // Guards everything below
+    std::condition_variable m_changed;                   // Signalled on every queue or state change
+    std::deque<Frame> m_frames;                          // Decoded frames in playback order
+    int m_nextFrame;                                     // Next frame the decoder will start
+    int m_decodingFrame;                                 // Frame being decoded, -1 if idle
+    unsigned long long m_generation;                     // Bumped on every restart
+    bool m_running;                                      // Decoder loop should keep going
+    bool m_failed;                                       // Decoder stopped on an error
+    
+    QThreadPool m_decoderPool;                           // Hosts the single decoder loop
+    
+    // Private helper methods
+    void decodeLoop();                                   // Decoder thread body
+    void restartLocked(int firstFrame);                  // Drop the queue and reposition; caller holds m_mutex
+    int findFrameLocked(int frame) const;                // Queue position of a frame, or -1
+};
+
+#endif // FRAMERINGBUFFER_H
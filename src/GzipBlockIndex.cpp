@@ -0,0 +1,419 @@
+#include "GzipBlockIndex.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+
+namespace {
+
+// gzip header flag bits (RFC 1952)
+const int FLAG_HCRC = 0x02;
+const int FLAG_EXTRA = 0x04;
+const int FLAG_NAME = 0x08;
+const int FLAG_COMMENT = 0x10;
+
+const int GZIP_TRAILER_SIZE = 8;  // CRC32 + ISIZE
+const int BGZF_HEADER_SIZE = 18;  // Fixed header plus the 6-byte "BC" extra field
+const int BGZF_MAX_MEMBER = 0x10000; // Largest member the 16-bit BSIZE field can describe
+const int GZI_ENTRY_SIZE = 16;    // Compressed and uncompressed offset, 8 bytes each
+
+quint32 readLE16(const uchar *p)
+{
+    return static_cast<quint32>(p[0]) | (static_cast<quint32>(p[1]) << 8);
+}
+
+quint32 readLE32(const uchar *p)
+{
+    return readLE16(p) | (readLE16(p + 2) << 16);
+}
+
+quint64 readLE64(const uchar *p)
+{
+    return static_cast<quint64>(readLE32(p)) | (static_cast<quint64>(readLE32(p + 4)) << 32);
+}
+
+void appendLE16(QByteArray &out, quint32 value)
+{
+    out.append(static_cast<char>(value & 0xff));
+    out.append(static_cast<char>((value >> 8) & 0xff));
+}
+
+void appendLE32(QByteArray &out, quint32 value)
+{
+    appendLE16(out, value & 0xffff);
+    appendLE16(out, value >> 16);
+}
+
+void appendLE64(QByteArray &out, quint64 value)
+{
+    appendLE32(out, static_cast<quint32>(value & 0xffffffffu));
+    appendLE32(out, static_cast<quint32>(value >> 32));
+}
+
+/**
+ * gzip member header with FEXTRA set and a single "BC" subfield holding
+ * the total member size minus one
+ */
+void appendBgzfHeader(QByteArray &out, int memberSize)
+{
+    static const char fixed[] = {
+        '\x1f', '\x8b', 8, 4,        // ID1 ID2, deflate, FEXTRA
+        0, 0, 0, 0,                  // MTIME
+        0, '\xff',                   // XFL, OS unknown
+        6, 0,                        // XLEN
+        'B', 'C', 2, 0               // Subfield id and length
+    };
+    out.append(fixed, sizeof(fixed));
+    appendLE16(out, static_cast<quint32>(memberSize - 1));
+}
+
+} // namespace
+
+bool GzipBlockIndex::scan(const uchar *data, qint64 size)
+{
+    m_blocks.clear();
+    
+    qint64 pos = 0;
+    qint64 outputOffset = 0;
+    while (pos < size) {
+        // Fixed 10-byte member header: ID1 ID2 CM FLG MTIME(4) XFL OS
+        if (size - pos < 12 || data[pos] != 0x1f || data[pos + 1] != 0x8b || data[pos + 2] != 8) {
+            break;
+        }
+        const int flags = data[pos + 3];
+        if (!(flags & FLAG_EXTRA)) {
+            break;
+        }
+        
+        // Look for the BGZF "BC" subfield that carries the member size
+        const qint64 extraLength = readLE16(data + pos + 10);
+        const qint64 extraStart = pos + 12;
+        const qint64 extraEnd = extraStart + extraLength;
+        if (extraEnd > size) {
+            break;
+        }
+        
+        qint64 memberSize = 0;
+        for (qint64 field = extraStart; field + 4 <= extraEnd;) {
+            const qint64 fieldLength = readLE16(data + field + 2);
+            if (data[field] == 'B' && data[field + 1] == 'C' && fieldLength == 2 &&
+                field + 6 <= extraEnd) {
+                memberSize = static_cast<qint64>(readLE16(data + field + 4)) + 1;
+            }
+            field += 4 + fieldLength;
+        }
+        if (memberSize == 0) {
+            break;
+        }
+        
+        // Optional fields are not written by bgzip but are legal
+        qint64 headerEnd = extraEnd;
+        if (flags & FLAG_NAME) {
+            while (headerEnd < size && data[headerEnd] != 0) ++headerEnd;
+            ++headerEnd;
+        }
+        if (flags & FLAG_COMMENT) {
+            while (headerEnd < size && data[headerEnd] != 0) ++headerEnd;
+            ++headerEnd;
+        }
+        if (flags & FLAG_HCRC) {
+            headerEnd += 2;
+        }
+        
+        const qint64 memberEnd = pos + memberSize;
+        if (memberEnd > size || headerEnd + GZIP_TRAILER_SIZE > memberEnd) {
+            break;
+        }
+        
+        GzipBlock block;
+        block.memberOffset = pos;
+        block.compressedOffset = headerEnd;
+        block.compressedSize = memberEnd - GZIP_TRAILER_SIZE - headerEnd;
+        block.uncompressedOffset = outputOffset;
+        block.uncompressedSize = readLE32(data + memberEnd - 4);
+        m_blocks.push_back(block);
+        
+        outputOffset += block.uncompressedSize;
+        pos = memberEnd;
+    }
+    
+    // Every byte must belong to a BGZF member, otherwise offsets cannot be trusted
+    if (pos != size || m_blocks.empty()) {
+        m_blocks.clear();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Rebuilds the table from a .gzi sidecar
+ * 
+ * The sidecar lists where members start, not where their payload starts,
+ * so members are taken to have the plain 18-byte BGZF header that bgzip
+ * and GzipBlockDeflater write. Only the first member's header is checked;
+ * a member that does not match fails its inflate later instead of
+ * producing wrong bytes. Without an entry at the end of the file, the
+ * last member's size comes from its trailer.
+ */
+bool GzipBlockIndex::load(const QByteArray &sidecar, const uchar *data, qint64 size)
+{
+    m_blocks.clear();
+    
+    const uchar *entries = reinterpret_cast<const uchar *>(sidecar.constData());
+    if (sidecar.size() < 8 || size < BGZF_HEADER_SIZE ||
+        data[0] != 0x1f || data[1] != 0x8b || data[2] != 8 || !(data[3] & FLAG_EXTRA) ||
+        readLE16(data + 10) != 6 || data[12] != 'B' || data[13] != 'C') {
+        return false;
+    }
+    const quint64 entryCount = readLE64(entries);
+    if (entryCount > static_cast<quint64>((sidecar.size() - 8) / GZI_ENTRY_SIZE) ||
+        8 + entryCount * GZI_ENTRY_SIZE != static_cast<quint64>(sidecar.size())) {
+        return false;
+    }
+    
+    // Each entry starts a member; the first member starts at (0, 0)
+    qint64 memberStart = 0;
+    qint64 outputStart = 0;
+    for (quint64 i = 0; i <= entryCount; ++i) {
+        qint64 memberEnd = size;
+        qint64 outputEnd = 0;
+        if (i < entryCount) {
+            const uchar *entry = entries + 8 + i * GZI_ENTRY_SIZE;
+            memberEnd = static_cast<qint64>(readLE64(entry));
+            outputEnd = static_cast<qint64>(readLE64(entry + 8));
+        } else if (memberStart == size) {
+            break;  // The last entry marks the end of the file
+        } else if (size - memberStart >= BGZF_HEADER_SIZE + GZIP_TRAILER_SIZE) {
+            outputEnd = outputStart + readLE32(data + size - 4);
+        }
+        
+        const qint64 memberSize = memberEnd - memberStart;
+        if (memberSize < BGZF_HEADER_SIZE + GZIP_TRAILER_SIZE || memberSize > BGZF_MAX_MEMBER ||
+            memberEnd > size || outputEnd < outputStart) {
+            m_blocks.clear();
+            return false;
+        }
+        
+        GzipBlock block;
+        block.memberOffset = memberStart;
+        block.compressedOffset = memberStart + BGZF_HEADER_SIZE;
+        block.compressedSize = memberSize - BGZF_HEADER_SIZE - GZIP_TRAILER_SIZE;
+        block.uncompressedOffset = outputStart;
+        block.uncompressedSize = outputEnd - outputStart;
+        m_blocks.push_back(block);
+        
+        memberStart = memberEnd;
+        outputStart = outputEnd;
+    }
+    return true;
+}
+
+/**
+ * Prefers the sidecar, which is only trusted when it is not older than
+ * the file it describes; a rewritten file falls back to scanning
+ */
+bool GzipBlockIndex::open(const QString &filePath, const uchar *data, qint64 size)
+{
+    const QFileInfo fileInfo(filePath);
+    const QFileInfo sidecarInfo(sidecarPath(filePath));
+    if (sidecarInfo.exists() && sidecarInfo.lastModified() >= fileInfo.lastModified()) {
+        QFile sidecar(sidecarInfo.filePath());
+        if (sidecar.open(QIODevice::ReadOnly) && load(sidecar.readAll(), data, size)) {
+            return true;
+        }
+    }
+    return scan(data, size);
+}
+
+QString GzipBlockIndex::sidecarPath(const QString &filePath)
+{
+    return filePath + ".gzi";
+}
+
+/**
+ * One entry per member boundary, as bgzip writes it: the start of every
+ * member after the first, plus the end of the file when the last member
+ * holds data (a file without the empty end-of-file member)
+ */
+QByteArray GzipBlockIndex::save() const
+{
+    QByteArray entries;
+    quint64 entryCount = 0;
+    for (size_t i = 0; i < m_blocks.size(); ++i) {
+        const GzipBlock &block = m_blocks[i];
+        if (i + 1 == m_blocks.size() && block.uncompressedSize == 0) {
+            break;
+        }
+        appendLE64(entries, static_cast<quint64>(block.compressedOffset + block.compressedSize + GZIP_TRAILER_SIZE));
+        appendLE64(entries, static_cast<quint64>(block.uncompressedOffset + block.uncompressedSize));
+        ++entryCount;
+    }
+    
+    QByteArray out;
+    appendLE64(out, entryCount);
+    return out + entries;
+}
+
+bool GzipBlockIndex::saveSidecar(const QString &filePath) const
+{
+    const QByteArray contents = save();
+    QSaveFile sidecar(sidecarPath(filePath));
+    return sidecar.open(QIODevice::WriteOnly) && sidecar.write(contents) == contents.size() && sidecar.commit();
+}
+
+void GzipBlockIndex::appendMember(qint64 memberSize, qint64 uncompressedSize)
+{
+    GzipBlock block;
+    if (!m_blocks.empty()) {
+        const GzipBlock &last = m_blocks.back();
+        block.memberOffset = last.compressedOffset + last.compressedSize + GZIP_TRAILER_SIZE;
+        block.uncompressedOffset = last.uncompressedOffset + last.uncompressedSize;
+    }
+    block.compressedOffset = block.memberOffset + BGZF_HEADER_SIZE;
+    block.compressedSize = memberSize - BGZF_HEADER_SIZE - GZIP_TRAILER_SIZE;
+    block.uncompressedSize = uncompressedSize;
+    m_blocks.push_back(block);
+}
+
+int GzipBlockIndex::blockCount() const
+{
+    return static_cast<int>(m_blocks.size());
+}
+
+const GzipBlock &GzipBlockIndex::block(int index) const
+{
+    return m_blocks[static_cast<size_t>(index)];
+}
+
+qint64 GzipBlockIndex::uncompressedSize() const
+{
+    return m_blocks.empty() ? 0 : m_blocks.back().uncompressedOffset + m_blocks.back().uncompressedSize;
+}
+
+int GzipBlockIndex::findBlock(qint64 uncompressedOffset) const
+{
+    // Last member whose output starts at or before the offset
+    auto it = std::upper_bound(m_blocks.begin(), m_blocks.end(), uncompressedOffset,
+                               [](qint64 offset, const GzipBlock &block) {
+                                   return offset < block.uncompressedOffset;
+                               });
+    if (it == m_blocks.begin()) {
+        return -1;
+    }
+    --it;
+    if (uncompressedOffset >= it->uncompressedOffset + it->uncompressedSize) {
+        return -1;
+    }
+    return static_cast<int>(it - m_blocks.begin());
+}
+
+GzipBlockInflater::GzipBlockInflater()
+    : m_initialized(false)
+{
+    m_stream = z_stream();
+    // Negative window bits: raw deflate, the gzip framing was parsed by scan()
+    m_initialized = inflateInit2(&m_stream, -MAX_WBITS) == Z_OK;
+}
+
+GzipBlockInflater::~GzipBlockInflater()
+{
+    if (m_initialized) {
+        inflateEnd(&m_stream);
+    }
+}
+
+bool GzipBlockInflater::decode(const uchar *fileData, const GzipBlock &block, char *dst)
+{
+    if (!m_initialized) {
+        return false;
+    }
+    if (block.uncompressedSize == 0) {
+        return true;  // BGZF end-of-file marker
+    }
+    
+    inflateReset(&m_stream);
+    m_stream.next_in = const_cast<Bytef *>(fileData + block.compressedOffset);
+    m_stream.avail_in = static_cast<uInt>(block.compressedSize);
+    m_stream.next_out = reinterpret_cast<Bytef *>(dst);
+    m_stream.avail_out = static_cast<uInt>(block.uncompressedSize);
+    
+    int code = inflate(&m_stream, Z_FINISH);
+    if (code != Z_STREAM_END || m_stream.avail_out != 0) {
+        return false;
+    }
+    
+    // Raw inflate skips the gzip trailer; check it as the sequential path does
+    const uchar *trailer = fileData + block.compressedOffset + block.compressedSize;
+    const uLong checksum = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(dst),
+                                 static_cast<uInt>(block.uncompressedSize));
+    return readLE32(trailer) == static_cast<quint32>(checksum) &&
+           readLE32(trailer + 4) == static_cast<quint32>(block.uncompressedSize & 0xffffffff);
+}
+
+GzipBlockDeflater::GzipBlockDeflater(int level)
+    : m_initialized(false)
+{
+    m_stream = z_stream();
+    // Negative window bits: raw deflate, the gzip framing is written by encode()
+    m_initialized = deflateInit2(&m_stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    m_payload.resize(static_cast<int>(deflateBound(&m_stream, MAX_BLOCK_BYTES)));
+}
+
+GzipBlockDeflater::~GzipBlockDeflater()
+{
+    if (m_initialized) {
+        deflateEnd(&m_stream);
+    }
+}
+
+/**
+ * Deflates one block and frames it as a BGZF member
+ * 
+ * MAX_BLOCK_BYTES leaves room for incompressible input, so every member fits
+ * the 64 KB that the 16-bit size field can describe.
+ */
+bool GzipBlockDeflater::encode(const char *src, int size, QByteArray &out)
+{
+    if (!m_initialized || size < 0 || size > MAX_BLOCK_BYTES) {
+        return false;
+    }
+    
+    deflateReset(&m_stream);
+    m_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(src));
+    m_stream.avail_in = static_cast<uInt>(size);
+    m_stream.next_out = reinterpret_cast<Bytef *>(m_payload.data());
+    m_stream.avail_out = static_cast<uInt>(m_payload.size());
+    if (deflate(&m_stream, Z_FINISH) != Z_STREAM_END) {
+        return false;
+    }
+    
+    const int payloadSize = m_payload.size() - static_cast<int>(m_stream.avail_out);
+    const int memberSize = BGZF_HEADER_SIZE + payloadSize + GZIP_TRAILER_SIZE;
+    if (memberSize > BGZF_MAX_MEMBER) {
+        return false;
+    }
+    
+    const uLong checksum = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(src), static_cast<uInt>(size));
+    appendBgzfHeader(out, memberSize);
+    out.append(m_payload.constData(), payloadSize);
+    appendLE32(out, static_cast<quint32>(checksum));
+    appendLE32(out, static_cast<quint32>(size));
+    return true;
+}
+
+/**
+ * The 28-byte empty member bgzip appends, which tells readers the file
+ * was not truncated
+ */
+QByteArray GzipBlockDeflater::endOfFile()
+{
+    QByteArray out;
+    const char emptyBlock[] = { 3, 0 };            // Final empty fixed-Huffman block
+    appendBgzfHeader(out, BGZF_HEADER_SIZE + static_cast<int>(sizeof(emptyBlock)) + GZIP_TRAILER_SIZE);
+    out.append(emptyBlock, sizeof(emptyBlock));
+    appendLE32(out, 0);
+    appendLE32(out, 0);
+    return out;
+}
@@ -0,0 +1,130 @@
+#ifndef GZIPBLOCKINDEX_H
+#define GZIPBLOCKINDEX_H
+
+// Qt fixed-width integer types, the encoded output and sidecar paths
+#include <QtGlobal>
+#include <QByteArray>
+#include <QString>
+
+// zlib as bundled with VTK (the same copy vtkNIFTIImageReader uses)
+#include <vtk_zlib.h>
+
+// Standard library for the block table
+#include <vector>
+
+/**
+ * GzipBlock - One independently decodable gzip member
+ */
+struct GzipBlock
+{
+    qint64 memberOffset = 0;         // Start of the member's gzip header in the file
+    qint64 compressedOffset = 0;     // Start of the deflate payload in the file
+    qint64 compressedSize = 0;       // Deflate payload size (header and trailer excluded)
+    qint64 uncompressedOffset = 0;   // Position of the member's output in the decompressed stream
+    qint64 uncompressedSize = 0;     // ISIZE from the member trailer
+};
+
+/**
+ * GzipBlockIndex - Table of gzip members in a BGZF-style multi-member file
+ * 
+ * BGZF (as written by bgzip and htslib) stores each member's total size in
+ * a "BC" extra field, so member boundaries can be found by hopping from
+ * header to header without inflating anything. Once the table exists,
+ * members can be inflated independently: in parallel for a full load, or
+ * one at a time for random access to a single slice.
+ * 
+ * Ordinary single-member .gz files have no such boundaries; scan() returns
+ * false for them and callers fall back to sequential inflate.
+ * 
+ * Scanning still reads one header per 64 KB member, which on a cold cache
+ * pulls most of a large file from disk before the first slice is shown.
+ * A .gzi sidecar (the format bgzip -i and htslib write: a little-endian
+ * count, then the compressed and uncompressed start of every member after
+ * the first) holds the same table in a few kilobytes; open() uses it when
+ * it is at least as new as the file, so only the members a slice needs
+ * are ever read.
+ */
+class GzipBlockIndex
+{
+public:
+    // Build the table from the raw file bytes; false if the file is not BGZF
+    bool scan(const uchar *data, qint64 size);
+    
+    // Build the table from .gzi contents, reading only the first and last member
+    bool load(const QByteArray &sidecar, const uchar *data, qint64 size);
+    
+    // The file's .gzi sidecar when it is current and fits, scan() otherwise
+    bool open(const QString &filePath, const uchar *data, qint64 size);
+    
+    // Sidecar output
+    static QString sidecarPath(const QString &filePath); // Where the .gzi of a file lives
+    QByteArray save() const;                             // Table in .gzi format
+    bool saveSidecar(const QString &filePath) const;     // Write the .gzi beside the file
+    
+    // Record a member just written by GzipBlockDeflater, after the previous ones
+    void appendMember(qint64 memberSize, qint64 uncompressedSize);
+    
+    int blockCount() const;                              // Number of members
+    const GzipBlock &block(int index) const;             // Member by position
+    qint64 uncompressedSize() const;                     // Total decompressed size
+    int findBlock(qint64 uncompressedOffset) const;      // Member containing an output offset, or -1
+
+private:
+    std::vector<GzipBlock> m_blocks;                     // Members in file order
+};
+
+/**
+ * GzipBlockInflater - Reusable raw-deflate decoder for single members
+ * 
+ * Keeps one zlib state alive across members; create one per thread.
+ */
+class GzipBlockInflater
+{
+public:
+    GzipBlockInflater();
+    ~GzipBlockInflater();
+    
+    // Inflate one member into dst, which must hold block.uncompressedSize bytes; false on a CRC or size mismatch
+    bool decode(const uchar *fileData, const GzipBlock &block, char *dst);
+
+private:
+    z_stream m_stream;                                   // Raw inflate state
+    bool m_initialized;                                  // Whether inflateInit2 succeeded
+    
+    // Non-copyable: the zlib state owns heap memory
+    GzipBlockInflater(const GzipBlockInflater &) = delete;
+    GzipBlockInflater &operator=(const GzipBlockInflater &) = delete;
+};
+
+/**
+ * GzipBlockDeflater - Reusable raw-deflate encoder producing BGZF members
+ * 
+ * The counterpart of GzipBlockInflater: each call compresses up to
+ * MAX_BLOCK_BYTES into one complete gzip member carrying the "BC" size
+ * field that GzipBlockIndex::scan() looks for, so the output decodes in
+ * parallel here and with bgzip/htslib elsewhere. Keeps one zlib state
+ * alive across members; create one per thread.
+ */
+class GzipBlockDeflater
+{
+public:
+    static const int MAX_BLOCK_BYTES = 0xff00;           // Uncompressed bytes per member, as bgzip writes
+    
+    explicit GzipBlockDeflater(int level = Z_DEFAULT_COMPRESSION); // zlib level 0-9
+    ~GzipBlockDeflater();
+    
+    // Append one member holding size bytes of src (at most MAX_BLOCK_BYTES) to out
+    bool encode(const char *src, int size, QByteArray &out);
+    static QByteArray endOfFile();                       // Empty member that ends a BGZF file
+
+private:
+    z_stream m_stream;                                   // Raw deflate state
+    bool m_initialized;                                  // Whether deflateInit2 succeeded
+    QByteArray m_payload;                                // Deflate output of the current member
+    
+    // Non-copyable: the zlib state owns heap memory
+    GzipBlockDeflater(const GzipBlockDeflater &) = delete;
+    GzipBlockDeflater &operator=(const GzipBlockDeflater &) = delete;
+};
+
+#endif // GZIPBLOCKINDEX_H
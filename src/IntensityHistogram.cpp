@@ -0,0 +1,79 @@
+#include "IntensityHistogram.h"
+
+#include <algorithm>
+#include <utility>
+
+IntensityHistogram::IntensityHistogram(double minimum, double maximum, std::vector<qint64> counts)
+    : m_minimum(minimum)
+    , m_maximum(maximum)
+    , m_total(0)
+    , m_counts(std::move(counts))
+{
+    m_counts.resize(BIN_COUNT, 0);
+    for (qint64 count : m_counts) {
+        m_total += count;
+    }
+}
+
+double IntensityHistogram::minimum() const
+{
+    return m_minimum;
+}
+
+double IntensityHistogram::maximum() const
+{
+    return m_maximum;
+}
+
+qint64 IntensityHistogram::total() const
+{
+    return m_total;
+}
+
+qint64 IntensityHistogram::count(int bin) const
+{
+    if (bin < 0 || bin >= BIN_COUNT) {
+        return 0;
+    }
+    return m_counts[bin];
+}
+
+double IntensityHistogram::binWidth() const
+{
+    return (m_maximum - m_minimum) / BIN_COUNT;
+}
+
+/**
+ * Walks the cumulative counts to the bin holding the fraction, then
+ * places the value within that bin by the share of its count needed
+ */
+double IntensityHistogram::percentile(double fraction) const
+{
+    fraction = std::max(0.0, std::min(1.0, fraction));
+    const double target = fraction * m_total;
+    
+    double cumulative = 0.0;
+    for (int bin = 0; bin < BIN_COUNT; ++bin) {
+        const double inBin = static_cast<double>(m_counts[bin]);
+        if (inBin > 0.0 && cumulative + inBin >= target) {
+            return m_minimum + (bin + (target - cumulative) / inBin) * binWidth();
+        }
+        cumulative += inBin;
+    }
+    return m_maximum;
+}
+
+/**
+ * Window from the lowFraction to the highFraction percentile
+ * 
+ * The window never collapses to zero, so a constant volume still maps
+ * to a valid grey ramp.
+ */
+void IntensityHistogram::percentileWindow(double lowFraction, double highFraction,
+                                          double &window, double &level) const
+{
+    const double low = percentile(lowFraction);
+    const double high = percentile(highFraction);
+    window = std::max(high - low, std::max(binWidth(), 1e-6));
+    level = 0.5 * (low + high);
+}
@@ -0,0 +1,47 @@
+#ifndef INTENSITYHISTOGRAM_H
+#define INTENSITYHISTOGRAM_H
+
+// Qt types for voxel counts
+#include <QtGlobal>
+
+// Standard library for the bins
+#include <vector>
+
+/**
+ * IntensityHistogram - Distribution of a volume's voxel values
+ * 
+ * Filled by VolumeStatistics in the same parallel passes as the other
+ * statistics, once per volume in the background after the load, so
+ * percentile queries such as auto-contrast windows cost a walk over
+ * BIN_COUNT bins instead of a pass over the voxels. Bins split [minimum, maximum]
+ * evenly; every scalar component counts, NaNs and infinities do not.
+ * 
+ * A histogram is read-only and may be shared between threads.
+ */
+class IntensityHistogram
+{
+public:
+    static const int BIN_COUNT = 4096;                   // Bins between the minimum and the maximum
+    
+    IntensityHistogram(double minimum, double maximum, std::vector<qint64> counts); // BIN_COUNT counts over [minimum, maximum]
+    
+    // Range and counts
+    double minimum() const;                              // Smallest finite value
+    double maximum() const;                              // Largest finite value
+    qint64 total() const;                                // Finite values counted
+    qint64 count(int bin) const;                         // Values in one bin
+    double binWidth() const;                             // Intensity span of one bin
+    
+    // Percentiles - linear within a bin
+    double percentile(double fraction) const;            // Value below which the fraction of values lies
+    void percentileWindow(double lowFraction, double highFraction,
+                          double &window, double &level) const; // Window/level spanning two percentiles
+
+private:
+    double m_minimum;                                    // Lower edge of bin 0
+    double m_maximum;                                    // Upper edge of the last bin
+    qint64 m_total;                                      // Sum of m_counts
+    std::vector<qint64> m_counts;                        // BIN_COUNT bins
+};
+
+#endif // INTENSITYHISTOGRAM_H
@@ -0,0 +1,475 @@
+#include "LazyVolumeSource.h"
+
+#include <vtkImageData.h>
+#include <vtkByteSwap.h>
+#include <vtkType.h>
+
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const int SLAB_PLANES = 8;                              // Planes decoded per slab
+const int PREFETCH_SLABS = 2;                           // Slabs decoded ahead of the slider
+const int BLOCK_CACHE_SIZE = 64;                        // Decoded BGZF blocks kept (~4 MB)
+const qint64 DEFAULT_CACHE_BUDGET = 256 * 1024 * 1024;  // Default slab cache size
+
+} // namespace
+
+LazyVolumeSource::LazyVolumeSource(const QString &filePath)
+    : m_filePath(filePath)
+    , m_file(filePath)
+    , m_fileData(nullptr)
+    , m_fileSize(0)
+    , m_compressed(false)
+    , m_cacheBudget(DEFAULT_CACHE_BUDGET)
+    , m_cachedBytes(0)
+    , m_cacheHits(0)
+    , m_cacheMisses(0)
+    , m_shuttingDown(false)
+{
+    // Prefetching must never compete with the GUI or a foreground load
+    m_prefetchPool.setMaxThreadCount(2);
+    m_prefetchPool.setThreadPriority(QThread::LowPriority);
+}
+
+LazyVolumeSource::~LazyVolumeSource()
+{
+    m_shuttingDown.store(true);
+    m_prefetchPool.clear();
+    m_prefetchPool.waitForDone();
+}
+
+bool LazyVolumeSource::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = QString("Cannot open file: %1").arg(m_file.errorString());
+        return false;
+    }
+    
+    m_fileSize = m_file.size();
+    m_fileData = m_file.map(0, m_fileSize);
+    if (!m_fileData) {
+        m_errorString = "Cannot map file";
+        return false;
+    }
+    
+    // Compressed files need a member table; the header lives in the first member
+    m_compressed = m_filePath.toLower().endsWith(".gz");
+    std::vector<char> headerBlock(NiftiHeader::NIFTI2_HEADER_SIZE);
+    qint64 headerBytes = std::min<qint64>(headerBlock.size(), m_fileSize);
+    if (m_compressed) {
+        if (!m_blockIndex.open(m_filePath, m_fileData, m_fileSize)) {
+            m_errorString = "Compressed file is not block-seekable (BGZF)";
+            return false;
+        }
+        headerBytes = std::min<qint64>(headerBlock.size(), m_blockIndex.uncompressedSize());
+        GzipBlockInflater inflater;
+        if (!readRange(0, headerBytes, headerBlock.data(), inflater)) {
+            m_errorString = "Cannot decode header block";
+            return false;
+        }
+    } else {
+        std::memcpy(headerBlock.data(), m_fileData, static_cast<size_t>(headerBytes));
+    }
+    
+    if (!m_header.parse(reinterpret_cast<const unsigned char *>(headerBlock.data()),
+                        static_cast<size_t>(headerBytes)) ||
+        m_header.vtkScalarType() == VTK_VOID || m_header.dim[5] != 1) {
+        m_errorString = "Unsupported NIfTI header";
+        return false;
+    }
+    
+    const qint64 available = m_compressed ? m_blockIndex.uncompressedSize() : m_fileSize;
+    if (available < m_header.voxOffset + m_header.bytesPerVolume()) {
+        m_errorString = "File is truncated";
+        return false;
+    }
+    
+    // Keep at least two slabs of the largest plane so paging back and forth never thrashes
+    qint64 largestSlab = 0;
+    for (int orientation = AXIAL; orientation <= CORONAL; ++orientation) {
+        largestSlab = std::max(largestSlab, planeBytes(orientation) * planesPerSlab());
+    }
+    m_cacheBudget = std::max(m_cacheBudget, 2 * largestSlab);
+    return true;
+}
+
+QString LazyVolumeSource::errorString() const
+{
+    return m_errorString;
+}
+
+const NiftiHeader &LazyVolumeSource::header() const
+{
+    return m_header;
+}
+
+QString LazyVolumeSource::filePath() const
+{
+    return m_filePath;
+}
+
+int LazyVolumeSource::dimension(int axis) const
+{
+    return static_cast<int>(m_header.dim[axis + 1]);
+}
+
+void LazyVolumeSource::getSpacing(double spacing[3]) const
+{
+    for (int i = 0; i < 3; ++i) {
+        spacing[i] = m_header.pixdim[i + 1] != 0.0 ? std::abs(m_header.pixdim[i + 1]) : 1.0;
+    }
+}
+
+int LazyVolumeSource::sliceCount(int orientation) const
+{
+    switch (orientation) {
+        case SAGITTAL: return dimension(0);
+        case CORONAL:  return dimension(1);
+        default:       return dimension(2);
+    }
+}
+
+/**
+ * Returns one plane as a single-slice vtkImageData
+ * 
+ * The extent places the plane at its true position in the volume, so the
+ * image viewer's slice index and camera behave exactly as for a full
+ * volume.
+ */
+vtkSmartPointer<vtkImageData> LazyVolumeSource::slice(int orientation, int index)
+{
+    if (index < 0 || index >= sliceCount(orientation)) {
+        return nullptr;
+    }
+    
+    const int slab = index / planesPerSlab();
+    SlabPointer slabData = acquireSlab(orientation, slab, true);
+    if (!slabData) {
+        return nullptr;
+    }
+    
+    const int nx = dimension(0);
+    const int ny = dimension(1);
+    const int nz = dimension(2);
+    
+    vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+    switch (orientation) {
+        case SAGITTAL:
+            image->SetExtent(index, index, 0, ny - 1, 0, nz - 1);
+            break;
+        case CORONAL:
+            image->SetExtent(0, nx - 1, index, index, 0, nz - 1);
+            break;
+        default:
+            image->SetExtent(0, nx - 1, 0, ny - 1, index, index);
+            break;
+    }
+    
+    double spacing[3];
+    getSpacing(spacing);
+    image->SetSpacing(spacing);
+    image->SetOrigin(0.0, 0.0, 0.0);
+    image->AllocateScalars(m_header.vtkScalarType(), m_header.scalarComponents());
+    
+    const qint64 bytes = planeBytes(orientation);
+    const qint64 planeInSlab = index - slab * planesPerSlab();
+    std::memcpy(image->GetScalarPointer(), slabData->data.data() + planeInSlab * bytes,
+                static_cast<size_t>(bytes));
+    return image;
+}
+
+/**
+ * Queues the next slabs in the direction of travel for background decode
+ * 
+ * Work that was queued for an earlier slider position and has not started
+ * yet is dropped first, so the pool always works on what is needed next.
+ */
+void LazyVolumeSource::prefetch(int orientation, int index, int direction)
+{
+    m_prefetchPool.clear();
+    
+    const int slab = index / planesPerSlab();
+    const int slabCount = (sliceCount(orientation) + planesPerSlab() - 1) / planesPerSlab();
+    
+    std::vector<int> targets;
+    for (int step = 1; step <= PREFETCH_SLABS; ++step) {
+        if (direction >= 0) {
+            targets.push_back(slab + step);
+        }
+        if (direction <= 0) {
+            targets.push_back(slab - step);
+        }
+    }
+    
+    for (int target : targets) {
+        if (target < 0 || target >= slabCount) {
+            continue;
+        }
+        m_prefetchPool.start([this, orientation, target]() {
+            if (!m_shuttingDown.load()) {
+                acquireSlab(orientation, target, false);
+            }
+        });
+    }
+}
+
+void LazyVolumeSource::setCacheBudget(qint64 bytes)
+{
+    std::lock_guard<std::mutex> lock(m_slabMutex);
+    m_cacheBudget = bytes;
+}
+
+qint64 LazyVolumeSource::cacheBudget() const
+{
+    std::lock_guard<std::mutex> lock(m_slabMutex);
+    return m_cacheBudget;
+}
+
+qint64 LazyVolumeSource::cachedBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_slabMutex);
+    return m_cachedBytes;
+}
+
+qint64 LazyVolumeSource::cacheHits() const
+{
+    std::lock_guard<std::mutex> lock(m_slabMutex);
+    return m_cacheHits;
+}
+
+qint64 LazyVolumeSource::cacheMisses() const
+{
+    std::lock_guard<std::mutex> lock(m_slabMutex);
+    return m_cacheMisses;
+}
+
+qint64 LazyVolumeSource::slabKey(int orientation, int slab)
+{
+    return (static_cast<qint64>(orientation) << 32) | static_cast<quint32>(slab);
+}
+
+int LazyVolumeSource::planesPerSlab() const
+{
+    return SLAB_PLANES;
+}
+
+qint64 LazyVolumeSource::planeBytes(int orientation) const
+{
+    const qint64 nx = m_header.dim[1];
+    const qint64 ny = m_header.dim[2];
+    const qint64 nz = m_header.dim[3];
+    const qint64 voxelBytes = m_header.bytesPerVoxel();
+    
+    switch (orientation) {
+        case SAGITTAL: return ny * nz * voxelBytes;
+        case CORONAL:  return nx * nz * voxelBytes;
+        default:       return nx * ny * voxelBytes;
+    }
+}
+
+/**
+ * Returns a cached slab, waiting for or performing its decode as needed
+ * 
+ * A slab is decoded by at most one thread; a second request for the same
+ * slab (GUI catching up with a prefetch) waits for the first to finish.
+ */
+LazyVolumeSource::SlabPointer LazyVolumeSource::acquireSlab(int orientation, int slab, bool countStatistics)
+{
+    const qint64 key = slabKey(orientation, slab);
+    
+    {
+        std::unique_lock<std::mutex> lock(m_slabMutex);
+        m_slabDecoded.wait(lock, [this, key]() { return m_inFlight.count(key) == 0; });
+        
+        auto it = m_slabs.find(key);
+        if (it != m_slabs.end()) {
+            m_slabLru.remove(key);
+            m_slabLru.push_front(key);
+            if (countStatistics) {
+                ++m_cacheHits;
+            }
+            return it->second;
+        }
+        
+        if (countStatistics) {
+            ++m_cacheMisses;
+        }
+        m_inFlight.insert(key);
+    }
+    
+    SlabPointer decoded = decodeSlab(orientation, slab);
+    
+    {
+        std::lock_guard<std::mutex> lock(m_slabMutex);
+        m_inFlight.erase(key);
+        if (decoded) {
+            storeSlab(key, decoded);
+        }
+    }
+    m_slabDecoded.notify_all();
+    return decoded;
+}
+
+/**
+ * Extracts a slab of planes from the x-fastest NIfTI layout
+ * 
+ * Axial slabs are one contiguous byte range. Coronal slabs read one run of
+ * rows per z slice, and sagittal slabs one short run per row; both visit
+ * each underlying BGZF block once per slab thanks to the block cache.
+ */
+LazyVolumeSource::SlabPointer LazyVolumeSource::decodeSlab(int orientation, int slab)
+{
+    const qint64 nx = m_header.dim[1];
+    const qint64 ny = m_header.dim[2];
+    const qint64 nz = m_header.dim[3];
+    const qint64 voxelBytes = m_header.bytesPerVoxel();
+    const qint64 rowBytes = nx * voxelBytes;
+    const qint64 sliceBytes = rowBytes * ny;
+    const qint64 base = m_header.voxOffset;
+    
+    const int first = slab * planesPerSlab();
+    const int planes = std::min(planesPerSlab(), sliceCount(orientation) - first);
+    if (planes <= 0) {
+        return nullptr;
+    }
+    
+    const qint64 bytesPerPlane = planeBytes(orientation);
+    auto result = std::make_shared<Slab>();
+    result->data.resize(static_cast<size_t>(bytesPerPlane * planes));
+    char *dst = result->data.data();
+    
+    GzipBlockInflater inflater;
+    std::vector<char> run(static_cast<size_t>(planes * std::max(rowBytes, voxelBytes)));
+    
+    switch (orientation) {
+        case AXIAL:
+            if (!readRange(base + first * sliceBytes, planes * sliceBytes, dst, inflater)) {
+                return nullptr;
+            }
+            break;
+        case CORONAL:
+            // Plane p holds rows (x, z) for y = first + p
+            for (qint64 z = 0; z < nz; ++z) {
+                if (!readRange(base + z * sliceBytes + first * rowBytes, planes * rowBytes, run.data(), inflater)) {
+                    return nullptr;
+                }
+                for (int p = 0; p < planes; ++p) {
+                    std::memcpy(dst + p * bytesPerPlane + z * rowBytes, run.data() + p * rowBytes,
+                                static_cast<size_t>(rowBytes));
+                }
+            }
+            break;
+        case SAGITTAL:
+            // Plane p holds voxels (y, z) for x = first + p
+            for (qint64 z = 0; z < nz; ++z) {
+                for (qint64 y = 0; y < ny; ++y) {
+                    const qint64 offset = base + z * sliceBytes + y * rowBytes + first * voxelBytes;
+                    if (!readRange(offset, planes * voxelBytes, run.data(), inflater)) {
+                        return nullptr;
+                    }
+                    const qint64 target = (z * ny + y) * voxelBytes;
+                    for (int p = 0; p < planes; ++p) {
+                        std::memcpy(dst + p * bytesPerPlane + target, run.data() + p * voxelBytes,
+                                    static_cast<size_t>(voxelBytes));
+                    }
+                }
+            }
+            break;
+    }
+    
+    if (m_header.byteSwapped && m_header.bytesPerSwapUnit() > 1) {
+        const int unit = m_header.bytesPerSwapUnit();
+        vtkByteSwap::SwapVoidRange(dst, result->data.size() / unit, static_cast<size_t>(unit));
+    }
+    return result;
+}
+
+void LazyVolumeSource::storeSlab(qint64 key, const SlabPointer &slab)
+{
+    // Caller holds m_slabMutex
+    m_slabs[key] = slab;
+    m_slabLru.push_front(key);
+    m_cachedBytes += static_cast<qint64>(slab->data.size());
+    
+    // Evict least recently used slabs, but never the one just stored
+    while (m_cachedBytes > m_cacheBudget && m_slabLru.size() > 1) {
+        const qint64 victim = m_slabLru.back();
+        m_slabLru.pop_back();
+        auto it = m_slabs.find(victim);
+        if (it != m_slabs.end()) {
+            m_cachedBytes -= static_cast<qint64>(it->second->data.size());
+            m_slabs.erase(it);
+        }
+    }
+}
+
+/**
+ * Copies bytes [position, position + length) of the decompressed file
+ */
+bool LazyVolumeSource::readRange(qint64 position, qint64 length, char *dst, GzipBlockInflater &inflater)
+{
+    
+    if (!m_compressed) {
+        if (position + length > m_fileSize) {
+            return false;
+        }
+        std::memcpy(dst, m_fileData + position, static_cast<size_t>(length));
+        return true;
+    }
+    
+    while (length > 0) {
+        const int index = m_blockIndex.findBlock(position);
+        if (index < 0) {
+            return false;
+        }
+        BlockPointer block = decodedBlock(index, inflater);
+        if (!block) {
+            return false;
+        }
+        
+        const GzipBlock &info = m_blockIndex.block(index);
+        const qint64 inBlock = position - info.uncompressedOffset;
+        const qint64 count = std::min(length, info.uncompressedSize - inBlock);
+        std::memcpy(dst, block->data() + inBlock, static_cast<size_t>(count));
+        
+        dst += count;
+        position += count;
+        length -= count;
+    }
+    return true;
+}
+
+LazyVolumeSource::BlockPointer LazyVolumeSource::decodedBlock(int index, GzipBlockInflater &inflater)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_blockMutex);
+        auto it = m_blocks.find(index);
+        if (it != m_blocks.end()) {
+            m_blockLru.remove(index);
+            m_blockLru.push_front(index);
+            return it->second;
+        }
+    }
+    
+    // Decode outside the lock; two threads may race on one block, which is harmless
+    const GzipBlock &info = m_blockIndex.block(index);
+    auto block = std::make_shared<std::vector<char>>(static_cast<size_t>(info.uncompressedSize));
+    if (!inflater.decode(m_fileData, info, block->data())) {
+        return nullptr;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_blockMutex);
+    if (m_blocks.emplace(index, block).second) {
+        m_blockLru.push_front(index);
+        if (static_cast<int>(m_blockLru.size()) > BLOCK_CACHE_SIZE) {
+            m_blocks.erase(m_blockLru.back());
+            m_blockLru.pop_back();
+        }
+    }
+    return block;
+}
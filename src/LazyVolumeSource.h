@@ -0,0 +1,129 @@
+#ifndef LAZYVOLUMESOURCE_H
+#define LAZYVOLUMESOURCE_H
+
+// Qt base classes for file access and background work
+#include <QString>
+#include <QFile>
+#include <QThreadPool>
+
+// VTK smart pointer for the slice images handed to the renderer
+#include <vtkSmartPointer.h>
+
+// Standard library for the slab cache
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "NiftiHeader.h"
+#include "GzipBlockIndex.h"
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * LazyVolumeSource - Slice-on-demand access to a NIfTI volume
+ * 
+ * Instead of decoding the whole volume up front, the source decodes slabs
+ * of a few planes in the requested orientation when a slice is displayed.
+ * Slabs are kept in an LRU cache bounded by a byte budget, and neighbouring
+ * slabs in the direction of travel are decoded ahead on a low-priority
+ * thread pool.
+ * 
+ * Random access needs either an uncompressed .nii (served from a read-only
+ * file mapping) or a BGZF-compressed .nii.gz (served block by block through
+ * GzipBlockIndex). Single-stream gzip cannot be entered in the middle, so
+ * open() fails for it and the caller loads the whole volume instead.
+ * 
+ * Orientation values match VolumeRenderer::ViewOrientation.
+ */
+class LazyVolumeSource
+{
+public:
+    enum Orientation {
+        AXIAL = 0,    // XY planes, one per z
+        SAGITTAL = 1, // YZ planes, one per x
+        CORONAL = 2   // XZ planes, one per y
+    };
+    
+    explicit LazyVolumeSource(const QString &filePath);
+    ~LazyVolumeSource();
+    
+    // Setup - parse the header and prepare random access
+    bool open();                                         // False for non-seekable or unsupported files
+    QString errorString() const;                         // Reason open() failed
+    const NiftiHeader &header() const;                   // Parsed header
+    QString filePath() const;                            // File being served
+    
+    // Geometry of the first 3D volume
+    int dimension(int axis) const;                       // Voxels along x (0), y (1) or z (2)
+    void getSpacing(double spacing[3]) const;            // Voxel spacing in mm
+    int sliceCount(int orientation) const;               // Number of planes in an orientation
+    
+    // Slice access
+    vtkSmartPointer<vtkImageData> slice(int orientation, int index); // Decode or fetch from cache
+    void prefetch(int orientation, int index, int direction);        // Decode neighbours ahead (-1, 0, +1)
+    
+    // Cache control and statistics
+    void setCacheBudget(qint64 bytes);                   // Upper bound for cached slabs
+    qint64 cacheBudget() const;                          // Current budget in bytes
+    qint64 cachedBytes() const;                          // Bytes held by cached slabs
+    qint64 cacheHits() const;                            // Slice requests served from cache
+    qint64 cacheMisses() const;                          // Slice requests that had to decode
+
+private:
+    /**
+     * A run of consecutive planes of one orientation, decoded and in host byte order
+     */
+    struct Slab {
+        std::vector<char> data;                          // Planes back to back
+    };
+    using SlabPointer = std::shared_ptr<const Slab>;
+    using BlockPointer = std::shared_ptr<const std::vector<char>>;
+    
+    // Source file and random access
+    QString m_filePath;                                  // File being served
+    QString m_errorString;                               // Last error message
+    NiftiHeader m_header;                                // Parsed header
+    QFile m_file;                                        // Open file backing the mapping
+    const uchar *m_fileData;                             // Read-only mapping of the whole file
+    qint64 m_fileSize;                                   // Size of the mapping
+    bool m_compressed;                                   // Whether blocks must be inflated
+    GzipBlockIndex m_blockIndex;                         // BGZF member table for compressed files
+    
+    // Decoded BGZF blocks shared by all slab decodes
+    mutable std::mutex m_blockMutex;                     // Guards the block cache
+    std::unordered_map<int, BlockPointer> m_blocks;      // Decoded blocks by index
+    std::list<int> m_blockLru;                           // Most recently used first
+    
+    // Slab cache
+    mutable std::mutex m_slabMutex;                      // Guards everything below
+    std::condition_variable m_slabDecoded;               // Signalled when an in-flight slab lands
+    std::unordered_map<qint64, SlabPointer> m_slabs;     // Cached slabs by key
+    std::list<qint64> m_slabLru;                         // Most recently used first
+    std::set<qint64> m_inFlight;                         // Slabs being decoded right now
+    qint64 m_cacheBudget;                                // Byte budget for m_slabs
+    qint64 m_cachedBytes;                                // Bytes currently in m_slabs
+    qint64 m_cacheHits;                                  // Requests served from cache
+    qint64 m_cacheMisses;                                // Requests that decoded
+    
+    // Prefetching
+    QThreadPool m_prefetchPool;                          // Low-priority decode threads
+    std::atomic_bool m_shuttingDown;                     // Stops queued prefetches on destruction
+    
+    // Private helper methods
+    static qint64 slabKey(int orientation, int slab);    // Cache key for a slab
+    int planesPerSlab() const;                           // Planes decoded together
+    qint64 planeBytes(int orientation) const;            // Bytes in one plane
+    SlabPointer acquireSlab(int orientation, int slab, bool countStatistics); // Cache lookup or decode
+    SlabPointer decodeSlab(int orientation, int slab);   // Extract planes from the file
+    void storeSlab(qint64 key, const SlabPointer &slab); // Insert and evict down to budget
+    bool readRange(qint64 position, qint64 length, char *dst, GzipBlockInflater &inflater); // Decompressed bytes
+    BlockPointer decodedBlock(int index, GzipBlockInflater &inflater); // Cached BGZF block
+};
+
+#endif // LAZYVOLUMESOURCE_H
@@ -5,10 +5,14 @@
 #include <QMenuBar>
 #include <QToolBar>
 #include <QStatusBar>
+#include <QFileInfo>
+#include <QDir>
+#include <QtMath>
 
 // Qt Dialogs for user interaction
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QInputDialog>
 
 // Qt Layouts for organizing the interface
 #include <QVBoxLayout>
@@ -23,6 +27,7 @@
 #include <QSlider>
 #include <QSpinBox>
 #include <QComboBox>
+#include <QCheckBox>
 #include <QProgressBar>
 #include <QTextEdit>
 
@@ -30,6 +35,11 @@
 #include <QAction>
 #include <QIcon>
 
+// Slice extraction benchmark
+#include "OrthogonalSlicer.h"
+#include <vtkImageData.h>
+#include <QElapsedTimer>
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     // Initialize all member pointers to nullptr for safety
@@ -40,18 +50,49 @@ MainWindow::MainWindow(QWidget *parent)
     , m_renderWidget(nullptr)     // Will be created in setupUI()
     , m_controlPanel(nullptr)     // Will be created in setupUI()
     , m_orientationCombo(nullptr) // Will be created in setupUI()
+    , m_triPlanarCheckBox(nullptr) // Will be created in setupUI()
+    , m_obliqueCheckBox(nullptr)  // Will be created in setupUI()
+    , m_interpolationCombo(nullptr) // Will be created in setupUI()
     , m_sliceSlider(nullptr)      // Will be created in setupUI()
     , m_sliceSpinBox(nullptr)     // Will be created in setupUI()
     , m_sliceLabel(nullptr)       // Will be created in setupUI()
+    , m_slabCheckBox(nullptr)     // Will be created in setupUI()
+    , m_slabProjectionCombo(nullptr) // Will be created in setupUI()
+    , m_slabThicknessSpinBox(nullptr) // Will be created in setupUI()
+    , m_contrastCombo(nullptr)    // Will be created in setupUI()
+    , m_windowLevelLabel(nullptr) // Will be created in setupUI()
+    , m_frameGroup(nullptr)       // Will be created in setupUI()
+    , m_frameSlider(nullptr)      // Will be created in setupUI()
+    , m_frameLabel(nullptr)       // Will be created in setupUI()
+    , m_playButton(nullptr)       // Will be created in setupUI()
+    , m_fpsSpinBox(nullptr)       // Will be created in setupUI()
+    , m_volumeModeCheckBox(nullptr) // Will be created in setupUI()
+    , m_blendModeCombo(nullptr)   // Will be created in setupUI()
+    , m_colorMapCombo(nullptr)    // Will be created in setupUI()
+    , m_thresholdSlider(nullptr)  // Will be created in setupUI()
+    , m_opacitySlider(nullptr)    // Will be created in setupUI()
+    , m_renderTimeLabel(nullptr)  // Will be created in setupUI()
     , m_zoomInButton(nullptr)     // Will be created in setupUI()
     , m_zoomOutButton(nullptr)    // Will be created in setupUI()
     , m_resetViewButton(nullptr)  // Will be created in setupUI()
     , m_infoDisplay(nullptr)      // Will be created in setupUI()
     , m_progressBar(nullptr)      // Will be created in setupUI()
+    , m_cancelLoadButton(nullptr) // Will be created in setupUI()
+    , m_cancelLoadAction(nullptr) // Will be created in setupUI()
+    , m_saveAsAction(nullptr)     // Will be created in setupUI()
+    , m_cancelSaveAction(nullptr) // Will be created in setupUI()
+    , m_recentMenu(nullptr)       // Will be created in setupUI()
+    , m_browserDock(nullptr)      // Will be created in setupUI()
+    , m_directoryBrowser(nullptr) // Will be created in setupUI()
+    , m_contactSheetDock(nullptr) // Will be created in setupUI()
+    , m_contactSheet(nullptr)     // Will be created in setupUI()
     , m_statusLabel(nullptr)      // Will be created in setupUI()
     , m_mainSplitter(nullptr)     // Will be created in setupUI()
     , m_centralWidget(nullptr)    // Will be created in setupUI()
     , m_fileLoaded(false)         // Start with no file loaded
+    , m_contrastProvisional(false) // No window/level awaits a histogram
+    , m_provisionalWindow(0.0)    // Set with the first preset
+    , m_provisionalLevel(0.0)     // Set with the first preset
 {
     setWindowTitle("NifTI Volume Loader");
     setMinimumSize(1000, 700);  // Ensure adequate space for medical imaging interface
@@ -81,9 +122,12 @@ MainWindow::~MainWindow()
  * 2. Toolbar (currently empty for clean interface)
  * 3. Status bar with progress indicator
  * 4. Main content area with render widget and control panel
+ * 5. Folder browser and contact sheet docks (created first so the File menu can toggle them)
  */
 void MainWindow::setupUI()
 {
+    setupDirectoryBrowser(); // Create the folder browser dock
+    setupContactSheet(); // Create the thumbnail grid dock
     setupMenuBar();      // Create application menu bar
     setupToolBar();      // Create toolbar (currently empty)
     setupStatusBar();    // Create status bar with progress
@@ -109,6 +153,137 @@ void MainWindow::setupMenuBar()
     connect(openAction, &QAction::triggered, this, &MainWindow::browseFile);
     fileMenu->addAction(openAction);
     
+    // Save As - writes the decoded volume, compressed on all cores
+    m_saveAsAction = new QAction("Save &As...", this);
+    m_saveAsAction->setShortcut(QKeySequence::SaveAs);
+    connect(m_saveAsAction, &QAction::triggered, this, &MainWindow::saveFileAs);
+    fileMenu->addAction(m_saveAsAction);
+    
+    // Recent files - rebuilt on every open so the cache markers are current
+    m_recentMenu = fileMenu->addMenu("Open &Recent");
+    connect(m_recentMenu, &QMenu::aboutToShow, this, &MainWindow::updateRecentFilesMenu);
+    
+    // Folder browser - lists a directory's headers without loading any volume
+    QAction *browseFolderAction = new QAction("Browse &Folder...", this);
+    browseFolderAction->setShortcut(QKeySequence("Ctrl+Shift+O"));
+    connect(browseFolderAction, &QAction::triggered, this, [this]() {
+        m_browserDock->show();
+        m_directoryBrowser->chooseDirectory();
+    });
+    fileMenu->addAction(browseFolderAction);
+    fileMenu->addAction(m_browserDock->toggleViewAction());
+    
+    // Contact sheet - middle slices of every scan in a folder, starting from the browsed one
+    QAction *contactSheetAction = new QAction("Contact &Sheet...", this);
+    connect(contactSheetAction, &QAction::triggered, this, [this]() {
+        m_contactSheetDock->show();
+        if (m_contactSheet->directory().isEmpty() && !m_directoryBrowser->directory().isEmpty()) {
+            m_contactSheet->setDirectory(m_directoryBrowser->directory());
+        } else {
+            m_contactSheet->chooseDirectory();
+        }
+    });
+    fileMenu->addAction(contactSheetAction);
+    fileMenu->addAction(m_contactSheetDock->toggleViewAction());
+    
+    // Cancel action aborts a background load; the previous volume stays on screen
+    m_cancelLoadAction = new QAction("&Cancel Loading", this);
+    m_cancelLoadAction->setShortcut(QKeySequence(Qt::Key_Escape));
+    m_cancelLoadAction->setEnabled(false);
+    connect(m_cancelLoadAction, &QAction::triggered, m_fileManager, &FileManager::cancelLoading);
+    fileMenu->addAction(m_cancelLoadAction);
+    
+    // Cancelling a save leaves any file already at the target name untouched
+    m_cancelSaveAction = new QAction("Cancel &Saving", this);
+    m_cancelSaveAction->setEnabled(false);
+    connect(m_cancelSaveAction, &QAction::triggered, m_fileManager, &FileManager::cancelSaving);
+    fileMenu->addAction(m_cancelSaveAction);
+    
+    // Loading submenu - loader options that apply to the next file opened
+    QMenu *loadingMenu = fileMenu->addMenu("&Loading");
+    
+    QAction *memoryMapAction = new QAction("&Memory-Map Uncompressed Files", this);
+    memoryMapAction->setCheckable(true);
+    memoryMapAction->setChecked(m_fileManager->isMemoryMappingEnabled());
+    memoryMapAction->setToolTip("Use .nii voxels in place instead of copying them into memory");
+    connect(memoryMapAction, &QAction::toggled, m_fileManager, &FileManager::setMemoryMappingEnabled);
+    loadingMenu->addAction(memoryMapAction);
+    
+    QAction *parallelInflateAction = new QAction("&Parallel Decompression", this);
+    parallelInflateAction->setCheckable(true);
+    parallelInflateAction->setChecked(m_fileManager->isParallelDecompressionEnabled());
+    parallelInflateAction->setToolTip("Inflate BGZF-compressed .nii.gz files on all CPU cores");
+    connect(parallelInflateAction, &QAction::toggled, m_fileManager, &FileManager::setParallelDecompressionEnabled);
+    loadingMenu->addAction(parallelInflateAction);
+    
+    QAction *lazyLoadAction = new QAction("&Lazy Loading for Large Volumes", this);
+    lazyLoadAction->setCheckable(true);
+    lazyLoadAction->setChecked(m_fileManager->isLazyLoadingEnabled());
+    lazyLoadAction->setToolTip("Decode volumes over 512 MB slice by slice as they are viewed");
+    connect(lazyLoadAction, &QAction::toggled, m_fileManager, &FileManager::setLazyLoadingEnabled);
+    loadingMenu->addAction(lazyLoadAction);
+    
+    QAction *compactStorageAction = new QAction("&Compact Voxel Storage", this);
+    compactStorageAction->setCheckable(true);
+    compactStorageAction->setChecked(m_fileManager->isCompactStorageEnabled());
+    compactStorageAction->setToolTip("Keep float64 and other wide voxels in the smallest type that holds every value exactly");
+    connect(compactStorageAction, &QAction::toggled, m_fileManager, &FileManager::setCompactStorageEnabled);
+    loadingMenu->addAction(compactStorageAction);
+    
+    QAction *diskCacheAction = new QAction("&Disk Cache for Compressed Files", this);
+    diskCacheAction->setCheckable(true);
+    diskCacheAction->setChecked(m_fileManager->isDiskCacheEnabled());
+    diskCacheAction->setToolTip("Keep decompressed copies of .nii.gz files so they reopen memory-mapped");
+    connect(diskCacheAction, &QAction::toggled, m_fileManager, &FileManager::setDiskCacheEnabled);
+    loadingMenu->addAction(diskCacheAction);
+    
+    QAction *prefetchAction = new QAction("&Prefetch Next Files in Folder", this);
+    prefetchAction->setCheckable(true);
+    prefetchAction->setChecked(m_fileManager->isPrefetchEnabled());
+    prefetchAction->setToolTip("Decode the next few files of the folder in the background so they open instantly");
+    connect(prefetchAction, &QAction::toggled, m_fileManager, &FileManager::setPrefetchEnabled);
+    loadingMenu->addAction(prefetchAction);
+    
+    QAction *pyramidAction = new QAction("Build Resolution P&yramid", this);
+    pyramidAction->setCheckable(true);
+    pyramidAction->setChecked(m_fileManager->isPyramidEnabled());
+    pyramidAction->setToolTip("Keep 2x-downsampled copies of large volumes so zoomed-out views draw from fewer voxels");
+    connect(pyramidAction, &QAction::toggled, m_fileManager, &FileManager::setPyramidEnabled);
+    loadingMenu->addAction(pyramidAction);
+    
+    QAction *bricksAction = new QAction("&Bricked Copy for Off-Axis Slicing", this);
+    bricksAction->setCheckable(true);
+    bricksAction->setChecked(m_fileManager->isBrickedLayoutEnabled());
+    bricksAction->setToolTip("Keep a cache-blocked copy of volumes shown in the tri-planar view so sagittal planes extract as fast as axial ones");
+    connect(bricksAction, &QAction::toggled, this, [this](bool checked) {
+        m_fileManager->setBrickedLayoutEnabled(checked);
+        if (!checked) {
+            m_volumeRenderer->setBricks(nullptr);
+        } else if (m_fileLoaded && m_volumeRenderer->getRenderMode() == VolumeRenderer::TRI_PLANAR_MODE) {
+            m_fileManager->requestBricks();
+        }
+        updateFileInfo();
+    });
+    loadingMenu->addAction(bricksAction);
+    QAction *benchmarkAction = new QAction("Benchmark Slice &Extraction", this);
+    benchmarkAction->setToolTip("Time axial, sagittal and coronal plane extraction from the current volume");
+    connect(benchmarkAction, &QAction::triggered, this, &MainWindow::benchmarkSlicing);
+    loadingMenu->addAction(benchmarkAction);
+    
+    loadingMenu->addSeparator();
+    QAction *cacheSizeAction = new QAction("Volume &Cache Size...", this);
+    cacheSizeAction->setToolTip("Memory kept for instantly reopening recent volumes");
+    connect(cacheSizeAction, &QAction::triggered, this, &MainWindow::setVolumeCacheSize);
+    loadingMenu->addAction(cacheSizeAction);
+    QAction *diskCacheSizeAction = new QAction("Disk Cache &Size...", this);
+    diskCacheSizeAction->setToolTip("Disk space for decompressed copies of .nii.gz files");
+    connect(diskCacheSizeAction, &QAction::triggered, this, &MainWindow::setDiskCacheSize);
+    loadingMenu->addAction(diskCacheSizeAction);
+    connect(loadingMenu->addAction("Clear Disk Cache"), &QAction::triggered, this, [this]() {
+        m_fileManager->clearDiskCache();
+        updateFileInfo();
+    });
+    
     fileMenu->addSeparator();
     
     // Exit action with standard Ctrl+Q shortcut
@@ -151,6 +326,11 @@ void MainWindow::setupStatusBar()
     m_progressBar->setVisible(false);
     m_progressBar->setMaximumWidth(200);
     statusBar->addPermanentWidget(m_progressBar);
+    
+    m_cancelLoadButton = new QPushButton("Cancel");
+    m_cancelLoadButton->setToolTip("Stop the load or save in progress");
+    m_cancelLoadButton->setVisible(false);
+    statusBar->addPermanentWidget(m_cancelLoadButton);
 }
 
 void MainWindow::setupCentralWidget()
@@ -201,6 +381,34 @@ void MainWindow::setupCentralWidget()
     mainLayout->addWidget(m_mainSplitter);
 }
 
+/**
+ * Creates the folder browser in a dock on the left, hidden until used
+ */
+void MainWindow::setupDirectoryBrowser()
+{
+    m_directoryBrowser = new DirectoryBrowser();
+    
+    m_browserDock = new QDockWidget("Folder Browser", this);
+    m_browserDock->setWidget(m_directoryBrowser);
+    m_browserDock->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea | Qt::BottomDockWidgetArea);
+    addDockWidget(Qt::LeftDockWidgetArea, m_browserDock);
+    m_browserDock->hide();
+}
+
+/**
+ * Creates the contact sheet in a dock at the bottom, hidden until used
+ */
+void MainWindow::setupContactSheet()
+{
+    m_contactSheet = new ContactSheet();
+    
+    m_contactSheetDock = new QDockWidget("Contact Sheet", this);
+    m_contactSheetDock->setWidget(m_contactSheet);
+    m_contactSheetDock->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea | Qt::BottomDockWidgetArea);
+    addDockWidget(Qt::BottomDockWidgetArea, m_contactSheetDock);
+    m_contactSheetDock->hide();
+}
+
 void MainWindow::setupControlPanel()
 {
     m_controlPanel = new QGroupBox("Controls");
@@ -219,6 +427,22 @@ void MainWindow::setupControlPanel()
     m_orientationCombo->addItem("Coronal (XZ)", static_cast<int>(VolumeRenderer::CORONAL));
     orientationLayout->addWidget(m_orientationCombo);
     
+    m_triPlanarCheckBox = new QCheckBox("Show all three planes");
+    m_triPlanarCheckBox->setToolTip("Axial, sagittal and coronal panes; click or drag to move the crosshair, "
+                                    "wheel to step a pane's plane");
+    orientationLayout->addWidget(m_triPlanarCheckBox);
+    
+    m_obliqueCheckBox = new QCheckBox("Oblique plane");
+    m_obliqueCheckBox->setToolTip("Starts from the selected orientation; drag to tilt the plane, "
+                                  "wheel to move it along its normal");
+    orientationLayout->addWidget(m_obliqueCheckBox);
+    
+    m_interpolationCombo = new QComboBox();
+    m_interpolationCombo->addItem("Trilinear", static_cast<int>(ObliqueSlicer::LINEAR_INTERPOLATION));
+    m_interpolationCombo->addItem("Nearest neighbour", static_cast<int>(ObliqueSlicer::NEAREST_INTERPOLATION));
+    m_interpolationCombo->setToolTip("Sampling of the oblique plane");
+    orientationLayout->addWidget(m_interpolationCombo);
+    
     controlLayout->addWidget(orientationGroup);
     
     // Slice controls
@@ -237,9 +461,114 @@ void MainWindow::setupControlPanel()
     sliceLayout->addWidget(new QLabel("Slice:"), 2, 0);
     sliceLayout->addWidget(m_sliceSpinBox, 2, 1);
     
+    m_slabCheckBox = new QCheckBox("Thick slab");
+    m_slabCheckBox->setToolTip("Project the slices around the current one; the slider slides the slab");
+    sliceLayout->addWidget(m_slabCheckBox, 3, 0, 1, 2);
+    
+    m_slabProjectionCombo = new QComboBox();
+    m_slabProjectionCombo->addItem("Maximum (MIP)", static_cast<int>(SlabProjector::MAXIMUM_PROJECTION));
+    m_slabProjectionCombo->addItem("Minimum (MinIP)", static_cast<int>(SlabProjector::MINIMUM_PROJECTION));
+    m_slabProjectionCombo->addItem("Mean", static_cast<int>(SlabProjector::MEAN_PROJECTION));
+    sliceLayout->addWidget(new QLabel("Projection:"), 4, 0);
+    sliceLayout->addWidget(m_slabProjectionCombo, 4, 1);
+    
+    m_slabThicknessSpinBox = new QSpinBox();
+    m_slabThicknessSpinBox->setRange(2, 200);
+    m_slabThicknessSpinBox->setValue(10);
+    m_slabThicknessSpinBox->setSuffix(" slices");
+    sliceLayout->addWidget(new QLabel("Thickness:"), 5, 0);
+    sliceLayout->addWidget(m_slabThicknessSpinBox, 5, 1);
+    
     controlLayout->addWidget(sliceGroup);
     
-
+    // Window/level of the 2D views; presets are percentiles of the volume's histogram
+    QGroupBox *contrastGroup = new QGroupBox("Contrast");
+    QGridLayout *contrastLayout = new QGridLayout(contrastGroup);
+    
+    m_contrastCombo = new QComboBox();
+    m_contrastCombo->addItem("Full range", 0.0);
+    m_contrastCombo->addItem("1-99%", 0.01);
+    m_contrastCombo->addItem("2-98%", 0.02);
+    m_contrastCombo->addItem("5-95%", 0.05);
+    m_contrastCombo->setCurrentIndex(1);
+    m_contrastCombo->setToolTip("Window between two percentiles of the volume; choose again to undo a drag");
+    contrastLayout->addWidget(new QLabel("Auto:"), 0, 0);
+    contrastLayout->addWidget(m_contrastCombo, 0, 1);
+    
+    m_windowLevelLabel = new QLabel();
+    m_windowLevelLabel->setToolTip("Drag with the left button (Shift+left in tri-planar and oblique views): "
+                                   "horizontal for window, vertical for level");
+    contrastLayout->addWidget(m_windowLevelLabel, 1, 0, 1, 2);
+    
+    controlLayout->addWidget(contrastGroup);
+    
+    // Time series controls - hidden until a 4D file is loaded
+    m_frameGroup = new QGroupBox("Time Series");
+    QGridLayout *frameLayout = new QGridLayout(m_frameGroup);
+    
+    m_frameLabel = new QLabel("Frame: 0 / 0");
+    frameLayout->addWidget(m_frameLabel, 0, 0, 1, 2);
+    
+    m_frameSlider = new QSlider(Qt::Horizontal);
+    m_frameSlider->setRange(0, 0);
+    frameLayout->addWidget(m_frameSlider, 1, 0, 1, 2);
+    
+    m_playButton = new QPushButton("Play");
+    m_playButton->setToolTip("Loop through the frames");
+    frameLayout->addWidget(m_playButton, 2, 0);
+    
+    m_fpsSpinBox = new QSpinBox();
+    m_fpsSpinBox->setRange(1, 60);
+    m_fpsSpinBox->setValue(10);
+    m_fpsSpinBox->setSuffix(" fps");
+    m_fpsSpinBox->setToolTip("Target playback rate");
+    frameLayout->addWidget(m_fpsSpinBox, 2, 1);
+    
+    m_frameGroup->setVisible(false);
+    controlLayout->addWidget(m_frameGroup);
+    
+    // 3D rendering - ray cast on the CPU, so it also works without a GPU
+    QGroupBox *volumeGroup = new QGroupBox("3D Rendering");
+    QGridLayout *volumeLayout = new QGridLayout(volumeGroup);
+    
+    m_volumeModeCheckBox = new QCheckBox("Show volume in 3D");
+    m_volumeModeCheckBox->setToolTip("Ray cast the whole volume; drag to rotate, wheel to zoom");
+    volumeLayout->addWidget(m_volumeModeCheckBox, 0, 0, 1, 2);
+    
+    m_blendModeCombo = new QComboBox();
+    m_blendModeCombo->addItem("Maximum Intensity", static_cast<int>(CpuRayCaster::MAXIMUM_INTENSITY));
+    m_blendModeCombo->addItem("Composite", static_cast<int>(CpuRayCaster::COMPOSITE));
+    volumeLayout->addWidget(new QLabel("Mode:"), 1, 0);
+    volumeLayout->addWidget(m_blendModeCombo, 1, 1);
+    
+    m_colorMapCombo = new QComboBox();
+    m_colorMapCombo->addItem("Grayscale", static_cast<int>(CpuRayCaster::GRAYSCALE));
+    m_colorMapCombo->addItem("Hot", static_cast<int>(CpuRayCaster::HOT));
+    m_colorMapCombo->addItem("Bone", static_cast<int>(CpuRayCaster::BONE));
+    volumeLayout->addWidget(new QLabel("Colours:"), 2, 0);
+    volumeLayout->addWidget(m_colorMapCombo, 2, 1);
+    
+    CpuRayCaster::TransferFunction transferFunction;
+    m_thresholdSlider = new QSlider(Qt::Horizontal);
+    m_thresholdSlider->setRange(0, 99);
+    m_thresholdSlider->setValue(qRound(transferFunction.lower * 100.0));
+    m_thresholdSlider->setToolTip("Intensities below this are dark and transparent");
+    volumeLayout->addWidget(new QLabel("Threshold:"), 3, 0);
+    volumeLayout->addWidget(m_thresholdSlider, 3, 1);
+    
+    m_opacitySlider = new QSlider(Qt::Horizontal);
+    m_opacitySlider->setRange(1, 100);
+    m_opacitySlider->setValue(qRound(transferFunction.opacity * 100.0));
+    m_opacitySlider->setToolTip("Opacity of the brightest voxels in composite mode");
+    volumeLayout->addWidget(new QLabel("Opacity:"), 4, 0);
+    volumeLayout->addWidget(m_opacitySlider, 4, 1);
+    
+    m_renderTimeLabel = new QLabel();
+    volumeLayout->addWidget(m_renderTimeLabel, 5, 0, 1, 2);
+    
+    controlLayout->addWidget(volumeGroup);
+    
+    
     
     // Navigation controls
     QGroupBox *navGroup = new QGroupBox("Navigation");
@@ -253,7 +582,7 @@ void MainWindow::setupControlPanel()
     
     m_resetViewButton = new QPushButton("Reset View");
     m_resetViewButton->setToolTip("Reset camera to fit the image");
-    
+            
             navLayout->addWidget(m_zoomInButton, 0, 0);
         navLayout->addWidget(m_zoomOutButton, 0, 1);
         navLayout->addWidget(m_resetViewButton, 1, 0, 1, 2);
@@ -284,10 +613,61 @@ void MainWindow::connectSignals()
             this, &MainWindow::onFileLoadingStarted);
     connect(m_fileManager, &FileManager::fileLoadingProgress,
             this, &MainWindow::onFileLoadingProgress);
+    connect(m_fileManager, &FileManager::fileLoadingThroughput,
+            this, &MainWindow::onFileLoadingThroughput);
     connect(m_fileManager, &FileManager::fileLoadingCompleted,
             this, &MainWindow::onFileLoadingCompleted);
+    connect(m_fileManager, &FileManager::fileLoadingCancelled,
+            this, &MainWindow::onFileLoadingCancelled);
+    connect(m_cancelLoadButton, &QPushButton::clicked,
+            this, &MainWindow::cancelBackgroundTask);
     connect(m_fileManager, &FileManager::fileLoadingError,
             this, &MainWindow::onFileLoadingError);
+    connect(m_fileManager, &FileManager::fileSavingStarted,
+            this, &MainWindow::onFileSavingStarted);
+    connect(m_fileManager, &FileManager::fileSavingProgress,
+            m_progressBar, &QProgressBar::setValue);
+    connect(m_fileManager, &FileManager::fileSavingCompleted,
+            this, &MainWindow::onFileSavingCompleted);
+    connect(m_fileManager, &FileManager::fileSavingCancelled,
+            this, &MainWindow::onFileSavingCancelled);
+    connect(m_fileManager, &FileManager::fileSavingError,
+            this, &MainWindow::onFileSavingError);
+    connect(m_fileManager, &FileManager::pyramidReady, this, [this]() {
+        m_volumeRenderer->setPyramid(m_fileManager->getPyramid());
+        updateFileInfo();
+    });
+    connect(m_fileManager, &FileManager::bricksReady, this, [this]() {
+        m_volumeRenderer->setBricks(m_fileManager->getBricks());
+        updateFileInfo();
+    });
+    connect(m_fileManager, &FileManager::statisticsReady, this, [this]() {
+        m_volumeRenderer->setHistogram(m_fileManager->getHistogram());
+        
+        // The preset replaces the one-slice window unless the user has moved it since
+        double window = 0.0;
+        double level = 0.0;
+        m_volumeRenderer->getWindowLevel(window, level);
+        if (m_contrastProvisional && window == m_provisionalWindow && level == m_provisionalLevel) {
+            applyContrastPreset();
+            m_volumeRenderer->getWindowLevel(window, level);
+        }
+        m_contrastProvisional = false;
+        
+        // The window/level label switches to real-world units once the scaling is known
+        onWindowLevelChanged(window, level);
+        updateFileInfo();
+    });
+    connect(m_directoryBrowser, &DirectoryBrowser::fileActivated, this, [this](const QString &filePath) {
+        if (m_fileManager->loadNiftiFile(filePath)) {
+            m_filePathLabel->setText(filePath);
+        }
+    });
+    connect(m_contactSheet, &ContactSheet::fileActivated, this, [this](const QString &filePath) {
+        if (m_fileManager->loadNiftiFile(filePath)) {
+            m_filePathLabel->setText(filePath);
+        }
+    });
     
     // Volume renderer signals
     connect(m_volumeRenderer, &VolumeRenderer::sliceChanged,
@@ -298,9 +678,63 @@ void MainWindow::connectSignals()
             this, &MainWindow::onOrientationChanged);
     connect(m_sliceSlider, &QSlider::valueChanged,
             this, &MainWindow::onSliceSliderChanged);
+    connect(m_sliceSlider, &QSlider::sliderReleased,
+            this, &MainWindow::updateFileInfo);
     connect(m_sliceSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
             this, &MainWindow::onSliceSliderChanged);
     
+    // Time series signals
+    connect(m_volumeRenderer, &VolumeRenderer::frameChanged,
+            this, &MainWindow::onFrameChanged);
+    connect(m_volumeRenderer, &VolumeRenderer::playbackStateChanged,
+            this, &MainWindow::onPlaybackStateChanged);
+    connect(m_frameSlider, &QSlider::valueChanged,
+            this, &MainWindow::onFrameSliderChanged);
+    connect(m_playButton, &QPushButton::clicked, this, &MainWindow::togglePlayback);
+    connect(m_fpsSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int fps) {
+        // Apply a new rate immediately while playing
+        if (m_volumeRenderer->isPlaying()) {
+            m_volumeRenderer->startPlayback(fps);
+        }
+    });
+    
+    // 3D rendering signals
+    connect(m_volumeModeCheckBox, &QCheckBox::toggled, this, &MainWindow::onVolumeModeToggled);
+    connect(m_triPlanarCheckBox, &QCheckBox::toggled, this, &MainWindow::onTriPlanarToggled);
+    connect(m_volumeRenderer, &VolumeRenderer::cursorChanged, this, &MainWindow::onCursorChanged);
+    connect(m_obliqueCheckBox, &QCheckBox::toggled, this, &MainWindow::onObliqueToggled);
+    connect(m_volumeRenderer, &VolumeRenderer::obliqueResliced, this, &MainWindow::onObliqueResliced);
+    connect(m_interpolationCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this]() {
+        m_volumeRenderer->setObliqueInterpolation(
+            static_cast<ObliqueSlicer::Interpolation>(m_interpolationCombo->currentData().toInt()));
+    });
+    connect(m_slabCheckBox, &QCheckBox::toggled, this, &MainWindow::onSlabToggled);
+    connect(m_volumeRenderer, &VolumeRenderer::slabProjected, this, &MainWindow::onSlabProjected);
+    connect(m_slabProjectionCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this]() {
+        m_volumeRenderer->setSlabProjection(
+            static_cast<SlabProjector::Projection>(m_slabProjectionCombo->currentData().toInt()));
+    });
+    connect(m_slabThicknessSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            m_volumeRenderer, &VolumeRenderer::setSlabThickness);
+    connect(m_contrastCombo, QOverload<int>::of(&QComboBox::activated), this, [this]() {
+        // Mapped volumes are summarised only when a preset asks for their histogram
+        m_fileManager->requestStatistics();
+        applyContrastPreset();
+    });
+    connect(m_volumeRenderer, &VolumeRenderer::windowLevelChanged, this, &MainWindow::onWindowLevelChanged);
+    connect(m_volumeRenderer, &VolumeRenderer::renderModeChanged,
+            this, &MainWindow::onRenderModeChanged);
+    connect(m_volumeRenderer, &VolumeRenderer::volumeRendered,
+            this, &MainWindow::onVolumeRendered);
+    connect(m_blendModeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this]() {
+        m_volumeRenderer->setVolumeBlendMode(
+            static_cast<CpuRayCaster::BlendMode>(m_blendModeCombo->currentData().toInt()));
+    });
+    connect(m_colorMapCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::updateTransferFunction);
+    connect(m_thresholdSlider, &QSlider::valueChanged, this, &MainWindow::updateTransferFunction);
+    connect(m_opacitySlider, &QSlider::valueChanged, this, &MainWindow::updateTransferFunction);
+    
     // Navigation signals
     connect(m_zoomInButton, &QPushButton::clicked, this, &MainWindow::zoomIn);
     connect(m_zoomOutButton, &QPushButton::clicked, this, &MainWindow::zoomOut);
@@ -311,22 +745,168 @@ void MainWindow::browseFile()
 {
     QString fileName = m_fileManager->selectNiftiFile(this);
     if (!fileName.isEmpty()) {
-        m_currentFilePath = fileName;
-        m_filePathLabel->setText(fileName);
-        
-        // Load the file
+        // Load the file in the background; a load already in flight is cancelled
         if (m_fileManager->loadNiftiFile(fileName)) {
             // File loading will trigger signals that handle the rest
+            m_filePathLabel->setText(fileName);
+        }
+    }
+}
+
+/**
+ * Saves the decoded volume under a new name
+ * 
+ * The chosen filter picks the format: BGZF .nii.gz at the default level,
+ * the fast tier at level 1, or uncompressed .nii.
+ */
+void MainWindow::saveFileAs()
+{
+    const QString defaultFilter = "Compressed NIfTI (*.nii.gz)";
+    const QString fastFilter = "Compressed NIfTI, fast (*.nii.gz)";
+    const QString plainFilter = "Uncompressed NIfTI (*.nii)";
+    QString selectedFilter = defaultFilter;
+    QString fileName = QFileDialog::getSaveFileName(
+        this,
+        "Save NifTI File",
+        m_currentFilePath.isEmpty() ? QDir::homePath() : QFileInfo(m_currentFilePath).absolutePath(),
+        defaultFilter + ";;" + fastFilter + ";;" + plainFilter,
+        &selectedFilter
+    );
+    if (fileName.isEmpty()) {
+        return;
+    }
+    
+    // The filter decides the format when the name does not
+    const bool plain = selectedFilter == plainFilter;
+    if (!fileName.endsWith(".nii", Qt::CaseInsensitive) && !fileName.endsWith(".nii.gz", Qt::CaseInsensitive)) {
+        fileName += plain ? ".nii" : ".nii.gz";
+    }
+    const int compressionLevel = selectedFilter == fastFilter ? 1 : 6;
+    m_fileManager->saveNiftiFile(fileName, compressionLevel);
+}
+
+void MainWindow::updateRecentFilesMenu()
+{
+    m_recentMenu->clear();
+    
+    QStringList recentFiles = m_fileManager->getRecentFiles();
+    for (const QString &filePath : recentFiles) {
+        QString text = QFileInfo(filePath).fileName();
+        if (m_fileManager->isVolumeCached(filePath)) {
+            text += "  (in memory)";
         }
+        QAction *action = m_recentMenu->addAction(text);
+        action->setToolTip(filePath);
+        connect(action, &QAction::triggered, this, [this, filePath]() {
+            if (m_fileManager->loadNiftiFile(filePath)) {
+                m_filePathLabel->setText(filePath);
+            }
+        });
     }
+    if (recentFiles.isEmpty()) {
+        m_recentMenu->addAction("No recent files")->setEnabled(false);
+    }
+    
+    m_recentMenu->addSeparator();
+    m_recentMenu->addAction("Cache: " + m_fileManager->getVolumeCacheStatus())->setEnabled(false);
+    connect(m_recentMenu->addAction("Clear Volume Cache"), &QAction::triggered, this, [this]() {
+        m_fileManager->clearVolumeCache();
+        updateFileInfo();
+    });
+    connect(m_recentMenu->addAction("Clear Recent Files"), &QAction::triggered,
+            m_fileManager, &FileManager::clearRecentFiles);
+}
+
+void MainWindow::setVolumeCacheSize()
+{
+    bool ok = false;
+    int megabytes = QInputDialog::getInt(this, "Volume Cache",
+                                         "Memory for recently opened volumes (MB, 0 disables):",
+                                         static_cast<int>(m_fileManager->getVolumeCacheBudget() / (1024 * 1024)),
+                                         0, 1024 * 1024, 256, &ok);
+    if (ok) {
+        m_fileManager->setVolumeCacheBudget(static_cast<qint64>(megabytes) * 1024 * 1024);
+        updateFileInfo();
+    }
+}
+
+void MainWindow::setDiskCacheSize()
+{
+    bool ok = false;
+    int megabytes = QInputDialog::getInt(this, "Disk Cache",
+                                         "Disk space for decompressed .nii.gz copies (MB, 0 disables):",
+                                         static_cast<int>(m_fileManager->getDiskCacheSize() / (1024 * 1024)),
+                                         0, 1024 * 1024, 1024, &ok);
+    if (ok) {
+        m_fileManager->setDiskCacheSize(static_cast<qint64>(megabytes) * 1024 * 1024);
+        updateFileInfo();
+    }
+}
+
+/**
+ * Times plane extraction per orientation from the current volume
+ * 
+ * Each plane is extracted at positions spread along its normal, first
+ * from the volume's own layout and then with the bricked copy attached,
+ * building the copy on the spot if the loader has not made one.
+ */
+void MainWindow::benchmarkSlicing()
+{
+    vtkImageData *volume = m_fileManager->getImageData();
+    if (!volume || m_fileManager->getLazySource()) {
+        QMessageBox::information(this, "Benchmark Slice Extraction",
+                                 "Open a volume that is fully loaded into memory first.");
+        return;
+    }
+    
+    const int samples = 32;
+    const char *names[OrthogonalSlicer::PLANE_COUNT] = { "Axial", "Sagittal", "Coronal" };
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    
+    OrthogonalSlicer slicer;
+    slicer.setVolume(volume);
+    double linear[OrthogonalSlicer::PLANE_COUNT];
+    for (int plane = 0; plane < OrthogonalSlicer::PLANE_COUNT; ++plane) {
+        linear[plane] = slicer.measurePlaneLatency(plane, samples);
+    }
+    
+    std::shared_ptr<BrickedVolume> bricks = m_fileManager->getBricks();
+    qint64 buildMilliseconds = 0;
+    if (!bricks) {
+        QElapsedTimer buildTimer;
+        buildTimer.start();
+        bricks = BrickedVolume::build(volume, nullptr);
+        buildMilliseconds = buildTimer.elapsed();
+    }
+    
+    QString report = QString("Mean time per plane over %1 positions:\n\n").arg(samples);
+    slicer.setBricks(bricks);
+    for (int plane = 0; plane < OrthogonalSlicer::PLANE_COUNT; ++plane) {
+        const double bricked = slicer.measurePlaneLatency(plane, samples);
+        report += QString("%1: %2 ms, %3 ms with bricks\n")
+                      .arg(names[plane])
+                      .arg(linear[plane], 0, 'f', 3)
+                      .arg(bricked, 0, 'f', 3);
+    }
+    if (!m_fileManager->getBricks()) {
+        report += QString("\nBricked copy built in %1 ms").arg(buildMilliseconds);
+    }
+    
+    QApplication::restoreOverrideCursor();
+    QMessageBox::information(this, "Benchmark Slice Extraction", report);
 }
 
 void MainWindow::onFileLoadingStarted(const QString &fileName)
 {
+    m_loadingFileName = fileName;
     m_statusLabel->setText(QString("Loading %1...").arg(fileName));
     m_progressBar->setVisible(true);
     m_progressBar->setValue(0);
-    enableControls(false);
+    m_cancelLoadButton->setVisible(true);
+    m_cancelLoadAction->setEnabled(true);
+    
+    // Keep the current volume interactive while the new one streams in
+    enableControls(m_fileLoaded);
 }
 
 void MainWindow::onFileLoadingProgress(int percentage)
@@ -334,26 +914,142 @@ void MainWindow::onFileLoadingProgress(int percentage)
     m_progressBar->setValue(percentage);
 }
 
+void MainWindow::onFileLoadingThroughput(qint64 bytesRead, qint64 bytesTotal,
+                                         double megabytesPerSecond, double etaSeconds)
+{
+    // Lets the user tell a slow mount (low MB/s) from a stalled load (no updates)
+    const double bytesPerMB = 1024.0 * 1024.0;
+    QString status = QString("Loading %1... %2 / %3 MB at %4 MB/s")
+                         .arg(m_loadingFileName)
+                         .arg(bytesRead / bytesPerMB, 0, 'f', 1)
+                         .arg(bytesTotal / bytesPerMB, 0, 'f', 1)
+                         .arg(megabytesPerSecond, 0, 'f', 1);
+    if (etaSeconds >= 0.0 && bytesRead < bytesTotal) {
+        status += QString(", ETA %1 s").arg(etaSeconds, 0, 'f', 0);
+    }
+    m_statusLabel->setText(status);
+}
+
 void MainWindow::onFileLoadingCompleted(const QString &fileName)
 {
     m_statusLabel->setText(QString("Loaded %1").arg(fileName));
     m_progressBar->setVisible(false);
+    m_cancelLoadButton->setVisible(m_fileManager->isSaving());
+    m_cancelLoadAction->setEnabled(false);
     m_fileLoaded = true;
+    m_currentFilePath = m_fileManager->getLastLoadedFile();
+    m_filePathLabel->setText(m_currentFilePath);
     
-    // Set image data to volume renderer
-    m_volumeRenderer->setImageData(m_fileManager->getImageData());
+    // Set image data to volume renderer; large volumes arrive as a slice source instead
+    if (m_fileManager->getLazySource()) {
+        m_volumeRenderer->setLazySource(m_fileManager->getLazySource());
+    } else {
+        m_volumeRenderer->setImageData(m_fileManager->getImageData());
+    }
+    
+    // 4D files: frame 0 is on screen, later frames stream in on demand
+    m_volumeRenderer->setTimeSeries(m_fileManager->getTimeSeries());
+    
+    // Set on a cache hit; otherwise pyramidReady delivers it once built
+    m_volumeRenderer->setPyramid(m_fileManager->getPyramid());
+    
+    // The bricked copy only serves the tri-planar view; bricksReady delivers it
+    if (m_volumeRenderer->getRenderMode() == VolumeRenderer::TRI_PLANAR_MODE) {
+        m_fileManager->requestBricks();
+    }
+    
+    // Present on a cache hit, so the preset costs a walk over the bins; otherwise
+    // the slice on display sets the window until statisticsReady delivers it
+    m_volumeRenderer->setHistogram(m_fileManager->getHistogram());
+    applyContrastPreset();
     
     updateSliceControls();
+    updateFrameControls();
     updateFileInfo();
     enableControls(true);
+    
+    // Give the folder browser a starting point the first time a file is opened
+    if (m_directoryBrowser->directory().isEmpty()) {
+        m_directoryBrowser->setDirectory(QFileInfo(m_currentFilePath).absolutePath());
+    }
+}
+
+void MainWindow::onFileLoadingCancelled(const QString &fileName)
+{
+    m_statusLabel->setText(QString("Cancelled loading %1").arg(fileName));
+    m_progressBar->setVisible(false);
+    m_cancelLoadButton->setVisible(m_fileManager->isSaving());
+    m_cancelLoadAction->setEnabled(false);
+    
+    // Fall back to the volume that is still displayed, if any
+    m_filePathLabel->setText(m_fileLoaded ? m_currentFilePath : QString("No file selected"));
+    enableControls(m_fileLoaded);
 }
 
 void MainWindow::onFileLoadingError(const QString &errorMessage)
 {
     m_statusLabel->setText("Error loading file");
     m_progressBar->setVisible(false);
+    m_cancelLoadButton->setVisible(m_fileManager->isSaving());
+    m_cancelLoadAction->setEnabled(false);
+    m_filePathLabel->setText(m_fileLoaded ? m_currentFilePath : QString("No file selected"));
+    QMessageBox::critical(this, "Error", errorMessage);
+    enableControls(m_fileLoaded);
+}
+
+void MainWindow::onFileSavingStarted(const QString &fileName)
+{
+    m_statusLabel->setText(QString("Saving %1...").arg(fileName));
+    m_progressBar->setVisible(true);
+    m_progressBar->setValue(0);
+    m_cancelLoadButton->setVisible(true);
+    m_cancelSaveAction->setEnabled(true);
+    m_saveAsAction->setEnabled(false);
+}
+
+void MainWindow::onFileSavingCompleted(const QString &fileName, qint64 fileBytes, double seconds)
+{
+    const double bytesPerMB = 1024.0 * 1024.0;
+    m_statusLabel->setText(QString("Saved %1 (%2 MB in %3 s)")
+                               .arg(fileName)
+                               .arg(fileBytes / bytesPerMB, 0, 'f', 1)
+                               .arg(seconds, 0, 'f', 2));
+    m_progressBar->setVisible(false);
+    m_cancelLoadButton->setVisible(m_fileManager->isLoading());
+    m_cancelSaveAction->setEnabled(false);
+    m_saveAsAction->setEnabled(m_fileManager->canSave());
+}
+
+void MainWindow::onFileSavingCancelled(const QString &fileName)
+{
+    m_statusLabel->setText(QString("Cancelled saving %1").arg(fileName));
+    m_progressBar->setVisible(false);
+    m_cancelLoadButton->setVisible(m_fileManager->isLoading());
+    m_cancelSaveAction->setEnabled(false);
+    m_saveAsAction->setEnabled(m_fileManager->canSave());
+}
+
+void MainWindow::onFileSavingError(const QString &errorMessage)
+{
+    m_statusLabel->setText("Error saving file");
+    m_progressBar->setVisible(false);
+    // Also reached when a second save is refused while the first still runs
+    m_cancelLoadButton->setVisible(m_fileManager->isLoading() || m_fileManager->isSaving());
+    m_cancelSaveAction->setEnabled(m_fileManager->isSaving());
+    m_saveAsAction->setEnabled(m_fileManager->canSave());
     QMessageBox::critical(this, "Error", errorMessage);
-    enableControls(false);
+}
+
+/**
+ * Stops the running load; with none running, stops the save instead
+ */
+void MainWindow::cancelBackgroundTask()
+{
+    if (m_fileManager->isLoading()) {
+        m_fileManager->cancelLoading();
+    } else {
+        m_fileManager->cancelSaving();
+    }
 }
 
 void MainWindow::onSliceChanged(int slice)
@@ -389,9 +1085,197 @@ void MainWindow::onSliceSliderChanged(int value)
     }
 }
 
+void MainWindow::onFrameChanged(int frame)
+{
+    m_frameSlider->blockSignals(true);
+    m_frameSlider->setValue(frame);
+    m_frameSlider->blockSignals(false);
+    
+    m_frameLabel->setText(QString("Frame: %1 / %2")
+                          .arg(frame)
+                          .arg(m_volumeRenderer->getFrameCount() - 1));
+}
+
+void MainWindow::onFrameSliderChanged(int value)
+{
+    if (m_fileLoaded) {
+        // Scrubbing takes over from playback
+        m_volumeRenderer->stopPlayback();
+        m_volumeRenderer->setFrame(value);
+    }
+}
+
+void MainWindow::togglePlayback()
+{
+    if (!m_fileLoaded) return;
+    
+    if (m_volumeRenderer->isPlaying()) {
+        m_volumeRenderer->stopPlayback();
+    } else {
+        m_volumeRenderer->startPlayback(m_fpsSpinBox->value());
+    }
+}
+
+void MainWindow::onPlaybackStateChanged(bool playing)
+{
+    m_playButton->setText(playing ? "Pause" : "Play");
+    if (!playing && m_volumeRenderer->getStalledFrames() > 0) {
+        m_statusLabel->setText(QString("Playback waited for %1 frames")
+                               .arg(m_volumeRenderer->getStalledFrames()));
+    }
+}
+
+
+
+
+
+void MainWindow::onVolumeModeToggled(bool enabled)
+{
+    if (!m_fileLoaded) return;
+    
+    VolumeRenderer::RenderMode mode = enabled ? VolumeRenderer::VOLUME_MODE : VolumeRenderer::SLICE_MODE;
+    if (!m_volumeRenderer->setRenderMode(mode)) {
+        m_statusLabel->setText("3D rendering needs the whole volume in memory; turn off lazy loading");
+        onRenderModeChanged(m_volumeRenderer->getRenderMode());
+    }
+}
+
+void MainWindow::onTriPlanarToggled(bool enabled)
+{
+    if (!m_fileLoaded) return;
+    
+    VolumeRenderer::RenderMode mode = enabled ? VolumeRenderer::TRI_PLANAR_MODE : VolumeRenderer::SLICE_MODE;
+    if (!m_volumeRenderer->setRenderMode(mode)) {
+        m_statusLabel->setText("The tri-planar view needs the whole volume in memory; turn off lazy loading");
+        onRenderModeChanged(m_volumeRenderer->getRenderMode());
+    }
+}
+
+void MainWindow::onCursorChanged(int x, int y, int z)
+{
+    if (m_volumeRenderer->getRenderMode() == VolumeRenderer::TRI_PLANAR_MODE) {
+        m_statusLabel->setText(QString("Crosshair: %1, %2, %3").arg(x).arg(y).arg(z));
+    }
+}
+
+void MainWindow::onObliqueToggled(bool enabled)
+{
+    if (!m_fileLoaded) return;
+    
+    VolumeRenderer::RenderMode mode = enabled ? VolumeRenderer::OBLIQUE_MODE : VolumeRenderer::SLICE_MODE;
+    if (!m_volumeRenderer->setRenderMode(mode)) {
+        m_statusLabel->setText("The oblique view needs the whole volume in memory; turn off lazy loading");
+        onRenderModeChanged(m_volumeRenderer->getRenderMode());
+    }
+}
+
+void MainWindow::onObliqueResliced(double seconds, int size)
+{
+    // Angle between the plane and the nearest axis-aligned plane
+    double normal[3];
+    m_volumeRenderer->getObliqueNormal(normal);
+    double alignment = qMax(qAbs(normal[0]), qMax(qAbs(normal[1]), qAbs(normal[2])));
+    double tilt = qRadiansToDegrees(std::acos(qMin(1.0, alignment)));
+    m_statusLabel->setText(QString("Oblique plane: %1 deg tilt, %2 x %2 resampled in %3 ms")
+                           .arg(tilt, 0, 'f', 1)
+                           .arg(size)
+                           .arg(seconds * 1000.0, 0, 'f', 1));
+}
+
+void MainWindow::onSlabToggled(bool enabled)
+{
+    if (!m_fileLoaded) return;
+    
+    // The renderer starts from the controls' current settings
+    m_volumeRenderer->setSlabProjection(
+        static_cast<SlabProjector::Projection>(m_slabProjectionCombo->currentData().toInt()));
+    m_volumeRenderer->setSlabThickness(m_slabThicknessSpinBox->value());
+    
+    VolumeRenderer::RenderMode mode = enabled ? VolumeRenderer::SLAB_MODE : VolumeRenderer::SLICE_MODE;
+    if (!m_volumeRenderer->setRenderMode(mode)) {
+        m_statusLabel->setText("The slab view needs the whole volume in memory; turn off lazy loading");
+        onRenderModeChanged(m_volumeRenderer->getRenderMode());
+    }
+}
+
+void MainWindow::onSlabProjected(double seconds, int slicesRead, int thickness)
+{
+    m_statusLabel->setText(QString("Slab: %1 of %2 slices in %3 ms, %4 slices read")
+                           .arg(m_slabProjectionCombo->currentText())
+                           .arg(thickness)
+                           .arg(seconds * 1000.0, 0, 'f', 1)
+                           .arg(slicesRead));
+}
+
+void MainWindow::applyContrastPreset()
+{
+    if (!m_fileLoaded) return;
+    
+    double low = m_contrastCombo->currentData().toDouble();
+    m_volumeRenderer->applyContrastPercentiles(low, 1.0 - low);
+    
+    // Without the histogram the window spans one slice; statisticsReady applies the preset again
+    m_contrastProvisional = !m_fileManager->getHistogram();
+    m_volumeRenderer->getWindowLevel(m_provisionalWindow, m_provisionalLevel);
+}
+
+void MainWindow::onWindowLevelChanged(double window, double level)
+{
+    // The lookup table works on stored values; the label shows real-world ones
+    std::shared_ptr<VolumeStatistics> statistics = m_fileManager->getStatistics();
+    if (statistics && statistics->isScaled()) {
+        window = qAbs(statistics->scaledValue(window) - statistics->scaledValue(0.0));
+        level = statistics->scaledValue(level);
+    }
+    m_windowLevelLabel->setText(QString("Window: %1  Level: %2")
+                                .arg(window, 0, 'g', 5)
+                                .arg(level, 0, 'g', 5));
+}
 
+void MainWindow::onRenderModeChanged(VolumeRenderer::RenderMode mode)
+{
+    m_volumeModeCheckBox->blockSignals(true);
+    m_volumeModeCheckBox->setChecked(mode == VolumeRenderer::VOLUME_MODE);
+    m_volumeModeCheckBox->blockSignals(false);
+    m_triPlanarCheckBox->blockSignals(true);
+    m_triPlanarCheckBox->setChecked(mode == VolumeRenderer::TRI_PLANAR_MODE);
+    m_triPlanarCheckBox->blockSignals(false);
+    m_obliqueCheckBox->blockSignals(true);
+    m_obliqueCheckBox->setChecked(mode == VolumeRenderer::OBLIQUE_MODE);
+    m_obliqueCheckBox->blockSignals(false);
+    m_slabCheckBox->blockSignals(true);
+    m_slabCheckBox->setChecked(mode == VolumeRenderer::SLAB_MODE);
+    m_slabCheckBox->blockSignals(false);
+    
+    if (mode != VolumeRenderer::VOLUME_MODE) {
+        m_renderTimeLabel->clear();
+    }
+    if (mode == VolumeRenderer::TRI_PLANAR_MODE) {
+        m_fileManager->requestBricks();
+    }
+    updateRenderModeControls();
+}
 
+/**
+ * The window runs from the threshold to 70% of the way to the top of the
+ * range, so the brightest structures saturate and stay opaque.
+ */
+void MainWindow::updateTransferFunction()
+{
+    CpuRayCaster::TransferFunction transferFunction;
+    transferFunction.lower = m_thresholdSlider->value() / 100.0;
+    transferFunction.upper = transferFunction.lower + 0.7 * (1.0 - transferFunction.lower);
+    transferFunction.opacity = m_opacitySlider->value() / 100.0;
+    transferFunction.colorMap = static_cast<CpuRayCaster::ColorMap>(m_colorMapCombo->currentData().toInt());
+    m_volumeRenderer->setVolumeTransferFunction(transferFunction);
+}
 
+void MainWindow::onVolumeRendered(double seconds, long long samples)
+{
+    m_renderTimeLabel->setText(QString("Frame: %1 ms, %2 M samples")
+                               .arg(seconds * 1000.0, 0, 'f', 0)
+                               .arg(samples / 1.0e6, 0, 'f', 1));
+}
 
 void MainWindow::zoomIn()
 {
@@ -435,12 +1319,60 @@ void MainWindow::updateSliceControls()
     m_sliceLabel->setText(QString("Slice: %1 / %2").arg(currentSlice).arg(maxSlice));
 }
 
+void MainWindow::updateFrameControls()
+{
+    int frameCount = m_volumeRenderer->getFrameCount();
+    m_frameGroup->setVisible(frameCount > 1);
+    if (frameCount <= 1) return;
+    
+    m_frameSlider->blockSignals(true);
+    m_frameSlider->setRange(0, frameCount - 1);
+    m_frameSlider->blockSignals(false);
+    onFrameChanged(m_volumeRenderer->getCurrentFrame());
+    
+    // Default to real time when the header gives the repetition time
+    double interval = m_fileManager->getTimeSeries()->frameInterval();
+    if (interval > 0.0) {
+        m_fpsSpinBox->setValue(qBound(1, qRound(1.0 / interval), 60));
+    }
+}
+
 
 
+void MainWindow::updateRenderModeControls()
+{
+    // Slices are meaningless in the 3D view; zoom and reset work in all
+    // views. In the tri-planar view the slice controls drive the crosshair
+    // along the selected orientation's axis, in the oblique view they
+    // move the plane's pivot and in the slab view they slide the slab.
+    // Contrast presets apply to every 2D view, not the 3D one. The mode
+    // checkbox follows enableControls(), so it gates every set.
+    bool enabled = m_volumeModeCheckBox->isEnabled();
+    bool volumeMode = m_volumeRenderer->getRenderMode() == VolumeRenderer::VOLUME_MODE;
+    bool sliceEnabled = enabled && !volumeMode;
+    m_orientationCombo->setEnabled(sliceEnabled);
+    m_sliceSlider->setEnabled(sliceEnabled);
+    m_sliceSpinBox->setEnabled(sliceEnabled);
+    m_interpolationCombo->setEnabled(enabled && m_volumeRenderer->getRenderMode() == VolumeRenderer::OBLIQUE_MODE);
+    bool slabMode = m_volumeRenderer->getRenderMode() == VolumeRenderer::SLAB_MODE;
+    m_slabProjectionCombo->setEnabled(enabled && slabMode);
+    m_slabThicknessSpinBox->setEnabled(enabled && slabMode);
+    m_contrastCombo->setEnabled(sliceEnabled);
+    
+    bool volumeEnabled = enabled && volumeMode;
+    m_blendModeCombo->setEnabled(volumeEnabled);
+    m_colorMapCombo->setEnabled(volumeEnabled);
+    m_thresholdSlider->setEnabled(volumeEnabled);
+    m_opacitySlider->setEnabled(volumeEnabled);
+}
+
 void MainWindow::updateFileInfo()
 {
     if (m_fileLoaded) {
         QString info = m_fileManager->getFileInfo();
+        info += QString("Rendering: %1 frames drawn, %2 requests coalesced\n")
+                    .arg(m_volumeRenderer->getRenderedFrames())
+                    .arg(m_volumeRenderer->getSkippedRenders());
         m_infoDisplay->setText(info);
     } else {
         m_infoDisplay->setText("No file loaded");
@@ -455,6 +1387,15 @@ void MainWindow::enableControls(bool enabled)
     m_zoomInButton->setEnabled(enabled);
     m_zoomOutButton->setEnabled(enabled);
     m_resetViewButton->setEnabled(enabled);
+    m_frameSlider->setEnabled(enabled);
+    m_playButton->setEnabled(enabled);
+    m_fpsSpinBox->setEnabled(enabled);
+    m_volumeModeCheckBox->setEnabled(enabled);
+    m_triPlanarCheckBox->setEnabled(enabled);
+    m_obliqueCheckBox->setEnabled(enabled);
+    m_slabCheckBox->setEnabled(enabled);
+    m_saveAsAction->setEnabled(enabled && m_fileManager->canSave() && !m_fileManager->isSaving());
+    updateRenderModeControls();
 }
 
 void MainWindow::applyDarkTheme()
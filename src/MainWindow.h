@@ -8,6 +8,7 @@
 #include <QSlider>
 #include <QSpinBox>
 #include <QComboBox>
+#include <QCheckBox>
 #include <QProgressBar>
 #include <QStatusBar>
 #include <QVBoxLayout>
@@ -16,10 +17,15 @@
 #include <QGroupBox>
 #include <QSplitter>
 #include <QTextEdit>
+#include <QAction>
+#include <QMenu>
+#include <QDockWidget>
 
 // Our custom classes for file management and rendering
 #include "FileManager.h"
 #include "VolumeRenderer.h"
+#include "DirectoryBrowser.h"
+#include "ContactSheet.h"
 
 /**
  * Main application window for the NifTI Volume Loader
@@ -40,15 +46,48 @@ public:
 private slots:
     // File management slots - handle file operations and loading states
     void browseFile();                                    // Open file dialog and initiate loading
+    void saveFileAs();                                    // Ask for a name and format, then save in the background
+    void updateRecentFilesMenu();                         // Rebuild File > Open Recent before it opens
+    void setVolumeCacheSize();                            // Ask for the volume cache budget
+    void setDiskCacheSize();                              // Ask for the disk cache cap
+    void benchmarkSlicing();                              // Time plane extraction per orientation, with and without bricks
     void onFileLoadingStarted(const QString &fileName);   // Called when file loading begins
     void onFileLoadingProgress(int percentage);           // Update progress bar during loading
+    void onFileLoadingThroughput(qint64 bytesRead, qint64 bytesTotal,
+                                 double megabytesPerSecond, double etaSeconds); // Show MB/s and ETA
     void onFileLoadingCompleted(const QString &fileName); // Handle successful file load
+    void onFileLoadingCancelled(const QString &fileName); // Handle a user-aborted load
     void onFileLoadingError(const QString &errorMessage); // Handle loading errors
+    void onFileSavingStarted(const QString &fileName);    // Show save progress
+    void onFileSavingCompleted(const QString &fileName, qint64 fileBytes, double seconds); // Report size and MB/s
+    void onFileSavingCancelled(const QString &fileName);  // Handle a user-aborted save
+    void onFileSavingError(const QString &errorMessage);  // Handle saving errors
+    void cancelBackgroundTask();                          // Status-bar Cancel: the load if one runs, else the save
     
     // Image navigation slots - respond to user interactions
     void onSliceChanged(int slice);                      // Update UI when slice changes
     void onOrientationChanged();                         // Handle view orientation changes
     void onSliceSliderChanged(int value);                // Respond to slice slider changes
+    void onTriPlanarToggled(bool enabled);               // Switch between one plane and all three
+    void onCursorChanged(int x, int y, int z);           // Show the tri-planar crosshair position
+    void onObliqueToggled(bool enabled);                 // Switch between the axis-aligned and oblique plane
+    void onObliqueResliced(double seconds, int size);    // Show the oblique resampling time and tilt
+    void onSlabToggled(bool enabled);                    // Switch between a single slice and a thick slab
+    void onSlabProjected(double seconds, int slicesRead, int thickness); // Show the slab projection time and reuse
+    void applyContrastPreset();                          // Window the display between the selected percentiles
+    void onWindowLevelChanged(double window, double level); // Show the current window and level
+    
+    // Time series slots - frame stepping and cine playback for 4D files
+    void onFrameChanged(int frame);                      // Update UI when the displayed frame changes
+    void onFrameSliderChanged(int value);                // Respond to frame slider changes
+    void togglePlayback();                               // Start or pause cine playback
+    void onPlaybackStateChanged(bool playing);           // Reflect playback state on the button
+    
+    // 3D rendering slots - CPU ray-cast view of the whole volume
+    void onVolumeModeToggled(bool enabled);              // Switch between slice and 3D views
+    void onRenderModeChanged(VolumeRenderer::RenderMode mode); // Sync controls with the renderer's mode
+    void updateTransferFunction();                       // Apply the threshold, opacity and colour map
+    void onVolumeRendered(double seconds, long long samples); // Show the ray-casting time
     
     // Navigation controls - manipulate the 3D view
     void zoomIn();        // Zoom into the image (closer view)
@@ -63,10 +102,14 @@ private:
     void setupStatusBar();    // Create status bar with progress indicator
     void setupCentralWidget(); // Create main content area
     void setupControlPanel();  // Create right-side control panel
+    void setupDirectoryBrowser(); // Create the dockable folder browser
+    void setupContactSheet();   // Create the dockable thumbnail grid
     
     // Utility methods - handle UI updates and connections
     void connectSignals();      // Connect all signal-slot relationships
     void updateSliceControls(); // Update slice navigation controls
+    void updateFrameControls(); // Show or hide time series controls for the loaded file
+    void updateRenderModeControls(); // Enable the slice or 3D controls for the current mode
     void updateFileInfo();      // Update file information display
     void enableControls(bool enabled); // Enable/disable UI controls based on file state
     void applyDarkTheme();      // Apply professional dark theme styling
@@ -83,9 +126,34 @@ private:
     // Control panel - right-side navigation and settings
     QGroupBox *m_controlPanel;      // Container for all control widgets
     QComboBox *m_orientationCombo;  // Dropdown to select view orientation (Axial/Sagittal/Coronal)
+    QCheckBox *m_triPlanarCheckBox; // Shows all three planes with a shared crosshair
+    QCheckBox *m_obliqueCheckBox;   // Shows one plane tilted with the mouse
+    QComboBox *m_interpolationCombo; // Trilinear or nearest sampling of the oblique plane
     QSlider *m_sliceSlider;         // Slider for navigating through image slices
     QSpinBox *m_sliceSpinBox;       // Numeric input for precise slice selection
     QLabel *m_sliceLabel;           // Shows current slice position and total count
+    QCheckBox *m_slabCheckBox;      // Thickens the slice into a slab projection
+    QComboBox *m_slabProjectionCombo; // Maximum, minimum or mean across the slab
+    QSpinBox *m_slabThicknessSpinBox; // Slices in the slab
+    
+    // Contrast controls - window/level of the 2D views
+    QComboBox *m_contrastCombo;     // Auto-contrast percentile presets
+    QLabel *m_windowLevelLabel;     // Current window and level
+    
+    // Time series controls - only shown for 4D files
+    QGroupBox *m_frameGroup;        // Container hidden for 3D volumes
+    QSlider *m_frameSlider;         // Scrubs through timepoints
+    QLabel *m_frameLabel;           // Shows current frame and total count
+    QPushButton *m_playButton;      // Starts and pauses cine playback
+    QSpinBox *m_fpsSpinBox;         // Target playback rate in frames per second
+    
+    // 3D rendering controls - software ray casting
+    QCheckBox *m_volumeModeCheckBox; // Switches the view to 3D
+    QComboBox *m_blendModeCombo;    // Maximum intensity or composite
+    QComboBox *m_colorMapCombo;     // Colours across the intensity window
+    QSlider *m_thresholdSlider;     // Lower end of the intensity window, percent of the range
+    QSlider *m_opacitySlider;       // Composite opacity at the top of the window
+    QLabel *m_renderTimeLabel;      // Time of the last ray-cast frame
     
     // Navigation controls - image manipulation
     QPushButton *m_zoomInButton;    // Zoom into the image
@@ -97,6 +165,19 @@ private:
     
     // Status and progress - user feedback
     QProgressBar *m_progressBar;    // Shows file loading progress
+    QPushButton *m_cancelLoadButton; // Aborts the background load, or the save when nothing is loading
+    QAction *m_cancelLoadAction;    // Menu entry (Esc) for aborting the current load
+    QAction *m_saveAsAction;        // File > Save As, enabled while a decoded volume is loaded
+    QAction *m_cancelSaveAction;    // Menu entry for aborting the running save
+    QMenu *m_recentMenu;            // File > Open Recent, marks files still in the volume cache
+    
+    // Folder browser - header-only listing of a directory
+    QDockWidget *m_browserDock;     // Left dock hosting the browser
+    DirectoryBrowser *m_directoryBrowser; // Lists files with dimensions, type and transforms
+    
+    // Contact sheet - middle-slice thumbnails of a directory
+    QDockWidget *m_contactSheetDock; // Bottom dock hosting the sheet
+    ContactSheet *m_contactSheet;   // Grid of axial, sagittal and coronal previews
     QLabel *m_statusLabel;          // Displays current application status
     
     // Layout - interface organization
@@ -105,7 +186,11 @@ private:
     
     // Current state - application data
     QString m_currentFilePath;      // Path to the currently loaded file
+    QString m_loadingFileName;      // Name of the file being loaded in the background
     bool m_fileLoaded;              // Whether a file is currently loaded
+    bool m_contrastProvisional;     // Window/level spans one slice until the histogram arrives
+    double m_provisionalWindow;     // Window set from that slice
+    double m_provisionalLevel;      // Level set from that slice
 };
 
 #endif // MAINWINDOW_H
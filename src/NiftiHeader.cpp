@@ -0,0 +1,411 @@
+#include "NiftiHeader.h"
+
+#include <vtkType.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+/**
+ * Reads a little or big endian field from the raw header block
+ */
+template <typename T>
+T readField(const unsigned char *data, size_t offset, bool swap)
+{
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, data + offset, sizeof(T));
+    if (swap) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+/**
+ * Copies a fixed-width, possibly unterminated text field
+ */
+void readText(const unsigned char *data, size_t offset, size_t length, char *dst)
+{
+    std::memcpy(dst, data + offset, length);
+    dst[length] = '\0';
+}
+
+/**
+ * Stores a field in host byte order
+ */
+template <typename T>
+void writeField(unsigned char *data, size_t offset, T value)
+{
+    std::memcpy(data + offset, &value, sizeof(T));
+}
+
+/**
+ * Copies a text field, truncated to its width and zero-padded
+ */
+void writeText(unsigned char *data, size_t offset, size_t length, const char *src)
+{
+    std::strncpy(reinterpret_cast<char *>(data + offset), src, length);
+}
+
+} // namespace
+
+bool NiftiHeader::parse(const unsigned char *data, size_t size)
+{
+    version = 0;
+    if (!data || size < static_cast<size_t>(NIFTI1_HEADER_SIZE)) {
+        return false;
+    }
+    
+    // sizeof_hdr doubles as the byte order and version marker
+    int32_t sizeofHdr = readField<int32_t>(data, 0, false);
+    bool swap = false;
+    if (sizeofHdr != NIFTI1_HEADER_SIZE && sizeofHdr != NIFTI2_HEADER_SIZE) {
+        swap = true;
+        sizeofHdr = readField<int32_t>(data, 0, true);
+    }
+    
+    if (sizeofHdr == NIFTI1_HEADER_SIZE) {
+        // Single-file NIfTI-1 magic is "n+1\0"; "ni1" is the .hdr/.img pair
+        if (std::memcmp(data + 344, "n+1\0", 4) != 0) {
+            return false;
+        }
+        
+        for (int i = 0; i < 8; ++i) {
+            dim[i] = readField<int16_t>(data, 40 + 2 * i, swap);
+            pixdim[i] = readField<float>(data, 76 + 4 * i, swap);
+        }
+        datatype = readField<int16_t>(data, 70, swap);
+        bitpix = readField<int16_t>(data, 72, swap);
+        voxOffset = static_cast<int64_t>(readField<float>(data, 108, swap));
+        sclSlope = readField<float>(data, 112, swap);
+        sclInter = readField<float>(data, 116, swap);
+        xyztUnits = data[123];
+        
+        intentCode = readField<int16_t>(data, 68, swap);
+        for (int i = 0; i < 3; ++i) {
+            intentP[i] = readField<float>(data, 56 + 4 * i, swap);
+            quatern[i] = readField<float>(data, 256 + 4 * i, swap);
+            qoffset[i] = readField<float>(data, 268 + 4 * i, swap);
+            for (int j = 0; j < 4; ++j) {
+                srow[i][j] = readField<float>(data, 280 + 16 * i + 4 * j, swap);
+            }
+        }
+        qformCode = readField<int16_t>(data, 252, swap);
+        sformCode = readField<int16_t>(data, 254, swap);
+        readText(data, 328, 16, intentName);
+        readText(data, 148, 80, descrip);
+        version = 1;
+    } else if (sizeofHdr == NIFTI2_HEADER_SIZE) {
+        if (size < static_cast<size_t>(NIFTI2_HEADER_SIZE) ||
+            std::memcmp(data + 4, "n+2\0", 4) != 0) {
+            return false;
+        }
+        
+        for (int i = 0; i < 8; ++i) {
+            dim[i] = readField<int64_t>(data, 16 + 8 * i, swap);
+            pixdim[i] = readField<double>(data, 104 + 8 * i, swap);
+        }
+        datatype = readField<int16_t>(data, 12, swap);
+        bitpix = readField<int16_t>(data, 14, swap);
+        voxOffset = readField<int64_t>(data, 168, swap);
+        sclSlope = readField<double>(data, 176, swap);
+        sclInter = readField<double>(data, 184, swap);
+        xyztUnits = readField<int32_t>(data, 500, swap);
+        
+        intentCode = readField<int32_t>(data, 504, swap);
+        for (int i = 0; i < 3; ++i) {
+            intentP[i] = readField<double>(data, 80 + 8 * i, swap);
+            quatern[i] = readField<double>(data, 352 + 8 * i, swap);
+            qoffset[i] = readField<double>(data, 376 + 8 * i, swap);
+            for (int j = 0; j < 4; ++j) {
+                srow[i][j] = readField<double>(data, 400 + 32 * i + 8 * j, swap);
+            }
+        }
+        qformCode = readField<int32_t>(data, 344, swap);
+        sformCode = readField<int32_t>(data, 348, swap);
+        readText(data, 508, 16, intentName);
+        readText(data, 240, 80, descrip);
+        version = 2;
+    } else {
+        return false;
+    }
+    
+    byteSwapped = swap;
+    
+    // Missing trailing dimensions are stored as 0 by some writers
+    if (dim[0] < 1 || dim[0] > 7) {
+        version = 0;
+        return false;
+    }
+    for (int i = dim[0] + 1; i < 8; ++i) {
+        dim[i] = 1;
+    }
+    for (int i = 1; i <= dim[0]; ++i) {
+        if (dim[i] < 1) {
+            dim[i] = 1;
+        }
+    }
+    
+    if (voxOffset < sizeofHdr || bitpix <= 0 || bitpix % 8 != 0) {
+        version = 0;
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+ * Mirror of parse() for the single-file layouts
+ * 
+ * Fields this structure does not hold (slice timing, cal_min/max,
+ * aux_file) are written as zero. NIfTI-1 stores dimensions as 16-bit
+ * values, so larger volumes need version 2.
+ */
+bool NiftiHeader::serialize(std::vector<unsigned char> &block) const
+{
+    if (version != 1 && version != 2) {
+        return false;
+    }
+    block.assign(static_cast<size_t>(headerBlockSize(version)), 0);
+    unsigned char *data = block.data();
+    
+    if (version == 1) {
+        for (int i = 0; i < 8; ++i) {
+            if (dim[i] > INT16_MAX) {
+                return false;
+            }
+        }
+        
+        writeField<int32_t>(data, 0, NIFTI1_HEADER_SIZE);
+        data[38] = 'r';                                  // regular, as other writers set it
+        for (int i = 0; i < 8; ++i) {
+            writeField<int16_t>(data, 40 + 2 * i, static_cast<int16_t>(dim[i]));
+            writeField<float>(data, 76 + 4 * i, static_cast<float>(pixdim[i]));
+        }
+        writeField<int16_t>(data, 70, static_cast<int16_t>(datatype));
+        writeField<int16_t>(data, 72, static_cast<int16_t>(bitpix));
+        writeField<float>(data, 108, static_cast<float>(voxOffset));
+        writeField<float>(data, 112, static_cast<float>(sclSlope));
+        writeField<float>(data, 116, static_cast<float>(sclInter));
+        data[123] = static_cast<unsigned char>(xyztUnits);
+        
+        writeField<int16_t>(data, 68, static_cast<int16_t>(intentCode));
+        for (int i = 0; i < 3; ++i) {
+            writeField<float>(data, 56 + 4 * i, static_cast<float>(intentP[i]));
+            writeField<float>(data, 256 + 4 * i, static_cast<float>(quatern[i]));
+            writeField<float>(data, 268 + 4 * i, static_cast<float>(qoffset[i]));
+            for (int j = 0; j < 4; ++j) {
+                writeField<float>(data, 280 + 16 * i + 4 * j, static_cast<float>(srow[i][j]));
+            }
+        }
+        writeField<int16_t>(data, 252, static_cast<int16_t>(qformCode));
+        writeField<int16_t>(data, 254, static_cast<int16_t>(sformCode));
+        writeText(data, 328, 16, intentName);
+        writeText(data, 148, 80, descrip);
+        std::memcpy(data + 344, "n+1\0", 4);
+    } else {
+        writeField<int32_t>(data, 0, NIFTI2_HEADER_SIZE);
+        std::memcpy(data + 4, "n+2\0\r\n\032\n", 8);
+        for (int i = 0; i < 8; ++i) {
+            writeField<int64_t>(data, 16 + 8 * i, dim[i]);
+            writeField<double>(data, 104 + 8 * i, pixdim[i]);
+        }
+        writeField<int16_t>(data, 12, static_cast<int16_t>(datatype));
+        writeField<int16_t>(data, 14, static_cast<int16_t>(bitpix));
+        writeField<int64_t>(data, 168, voxOffset);
+        writeField<double>(data, 176, sclSlope);
+        writeField<double>(data, 184, sclInter);
+        writeField<int32_t>(data, 500, xyztUnits);
+        
+        writeField<int32_t>(data, 504, intentCode);
+        for (int i = 0; i < 3; ++i) {
+            writeField<double>(data, 80 + 8 * i, intentP[i]);
+            writeField<double>(data, 352 + 8 * i, quatern[i]);
+            writeField<double>(data, 376 + 8 * i, qoffset[i]);
+            for (int j = 0; j < 4; ++j) {
+                writeField<double>(data, 400 + 32 * i + 8 * j, srow[i][j]);
+            }
+        }
+        writeField<int32_t>(data, 344, qformCode);
+        writeField<int32_t>(data, 348, sformCode);
+        writeText(data, 508, 16, intentName);
+        writeText(data, 240, 80, descrip);
+    }
+    
+    // The four bytes after the header stay zero: no extensions follow
+    return true;
+}
+
+int64_t NiftiHeader::headerBlockSize(int version)
+{
+    return (version == 2 ? NIFTI2_HEADER_SIZE : NIFTI1_HEADER_SIZE) + 4;
+}
+
+int64_t NiftiHeader::voxelsPerVolume() const
+{
+    return dim[1] * dim[2] * dim[3];
+}
+
+int NiftiHeader::bytesPerVoxel() const
+{
+    return bitpix / 8;
+}
+
+int64_t NiftiHeader::bytesPerVolume() const
+{
+    return voxelsPerVolume() * bytesPerVoxel();
+}
+
+/**
+ * A zero slope means the file is not scaled (NIfTI-1 convention)
+ */
+bool NiftiHeader::hasScaling() const
+{
+    return sclSlope != 0.0 && std::isfinite(sclSlope) && std::isfinite(sclInter) &&
+           (sclSlope != 1.0 || sclInter != 0.0);
+}
+
+int64_t NiftiHeader::volumeCount() const
+{
+    return dim[0] >= 4 ? dim[4] : 1;
+}
+
+double NiftiHeader::timeStepSeconds() const
+{
+    // Temporal unit code lives in bits 3-5 of xyzt_units
+    switch (xyztUnits & 0x38) {
+        case 8:  return pixdim[4];           // NIFTI_UNITS_SEC
+        case 16: return pixdim[4] / 1e3;     // NIFTI_UNITS_MSEC
+        case 24: return pixdim[4] / 1e6;     // NIFTI_UNITS_USEC
+        default: return 0.0;                 // Hz, ppm, rad/s or unspecified
+    }
+}
+
+int NiftiHeader::bytesPerSwapUnit() const
+{
+    switch (datatype) {
+        case DT_RGB24:
+        case DT_RGBA32:
+            return 1;                    // Byte-sized channels
+        case DT_COMPLEX64:
+            return 4;                    // Two float32 parts
+        case DT_COMPLEX128:
+            return 8;                    // Two float64 parts
+        case DT_COMPLEX256:
+            return 16;                   // Two float128 parts
+        default:
+            return bytesPerVoxel();
+    }
+}
+
+int NiftiHeader::vtkScalarType() const
+{
+    switch (datatype) {
+        case DT_UINT8:     return VTK_UNSIGNED_CHAR;
+        case DT_INT8:      return VTK_SIGNED_CHAR;
+        case DT_INT16:     return VTK_SHORT;
+        case DT_UINT16:    return VTK_UNSIGNED_SHORT;
+        case DT_INT32:     return VTK_INT;
+        case DT_UINT32:    return VTK_UNSIGNED_INT;
+        case DT_INT64:     return VTK_LONG_LONG;
+        case DT_UINT64:    return VTK_UNSIGNED_LONG_LONG;
+        case DT_FLOAT32:   return VTK_FLOAT;
+        case DT_FLOAT64:   return VTK_DOUBLE;
+        case DT_COMPLEX64: return VTK_FLOAT;
+        case DT_RGB24:     return VTK_UNSIGNED_CHAR;
+        case DT_RGBA32:    return VTK_UNSIGNED_CHAR;
+        default:           return VTK_VOID;
+    }
+}
+
+int NiftiHeader::scalarComponents() const
+{
+    switch (datatype) {
+        case DT_COMPLEX64: return 2;
+        case DT_RGB24:     return 3;
+        case DT_RGBA32:    return 4;
+        default:           return 1;
+    }
+}
+
+/**
+ * Picks the datatype that vtkScalarType() and scalarComponents() map back
+ * to the given VTK layout, and sets bitpix to match
+ */
+bool NiftiHeader::setVtkScalarType(int scalarType, int components)
+{
+    int code = 0;
+    int bytes = 0;
+    if (components == 1) {
+        switch (scalarType) {
+            case VTK_UNSIGNED_CHAR:      code = DT_UINT8;   bytes = 1; break;
+            case VTK_SIGNED_CHAR:
+            case VTK_CHAR:               code = DT_INT8;    bytes = 1; break;
+            case VTK_SHORT:              code = DT_INT16;   bytes = 2; break;
+            case VTK_UNSIGNED_SHORT:     code = DT_UINT16;  bytes = 2; break;
+            case VTK_INT:                code = DT_INT32;   bytes = 4; break;
+            case VTK_UNSIGNED_INT:       code = DT_UINT32;  bytes = 4; break;
+            case VTK_LONG_LONG:          code = DT_INT64;   bytes = 8; break;
+            case VTK_UNSIGNED_LONG_LONG: code = DT_UINT64;  bytes = 8; break;
+            case VTK_FLOAT:              code = DT_FLOAT32; bytes = 4; break;
+            case VTK_DOUBLE:             code = DT_FLOAT64; bytes = 8; break;
+            default:                     return false;
+        }
+    } else if (components == 2 && scalarType == VTK_FLOAT) {
+        code = DT_COMPLEX64;
+        bytes = 8;
+    } else if (components == 3 && scalarType == VTK_UNSIGNED_CHAR) {
+        code = DT_RGB24;
+        bytes = 3;
+    } else if (components == 4 && scalarType == VTK_UNSIGNED_CHAR) {
+        code = DT_RGBA32;
+        bytes = 4;
+    } else {
+        return false;
+    }
+    
+    datatype = code;
+    bitpix = 8 * bytes;
+    return true;
+}
+
+const char *NiftiHeader::datatypeName() const
+{
+    switch (datatype) {
+        case DT_UINT8:      return "uint8";
+        case DT_INT8:       return "int8";
+        case DT_INT16:      return "int16";
+        case DT_UINT16:     return "uint16";
+        case DT_INT32:      return "int32";
+        case DT_UINT32:     return "uint32";
+        case DT_INT64:      return "int64";
+        case DT_UINT64:     return "uint64";
+        case DT_FLOAT32:    return "float32";
+        case DT_FLOAT64:    return "float64";
+        case DT_FLOAT128:   return "float128";
+        case DT_COMPLEX64:  return "complex64";
+        case DT_COMPLEX128: return "complex128";
+        case DT_COMPLEX256: return "complex256";
+        case DT_RGB24:      return "rgb24";
+        case DT_RGBA32:     return "rgba32";
+        default:            return "unknown";
+    }
+}
+
+const char *NiftiHeader::xformName(int code)
+{
+    switch (code) {
+        case 0:  return "none";             // NIFTI_XFORM_UNKNOWN
+        case 1:  return "scanner";          // NIFTI_XFORM_SCANNER_ANAT
+        case 2:  return "aligned";          // NIFTI_XFORM_ALIGNED_ANAT
+        case 3:  return "talairach";        // NIFTI_XFORM_TALAIRACH
+        case 4:  return "mni152";           // NIFTI_XFORM_MNI_152
+        case 5:  return "template";         // NIFTI_XFORM_TEMPLATE_OTHER
+        default: return "invalid";
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef NIFTIHEADER_H
+#define NIFTIHEADER_H
+
+// Standard library for fixed-width header fields
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * NiftiHeader - Decoded NIfTI-1 / NIfTI-2 header fields
+ * 
+ * Both on-disk layouts are normalized into one structure with 64-bit
+ * dimensions and double precision spacing. Byte order is detected from
+ * sizeof_hdr, so headers written on big-endian machines parse as well.
+ * serialize() writes the same fields back in host byte order.
+ */
+struct NiftiHeader
+{
+    /**
+     * NIfTI datatype codes (nifti1.h DT_* values)
+     */
+    enum DataType {
+        DT_UINT8 = 2,
+        DT_INT16 = 4,
+        DT_INT32 = 8,
+        DT_FLOAT32 = 16,
+        DT_COMPLEX64 = 32,
+        DT_FLOAT64 = 64,
+        DT_RGB24 = 128,
+        DT_INT8 = 256,
+        DT_UINT16 = 512,
+        DT_UINT32 = 768,
+        DT_INT64 = 1024,
+        DT_UINT64 = 1280,
+        DT_FLOAT128 = 1536,
+        DT_COMPLEX128 = 1792,
+        DT_COMPLEX256 = 2048,
+        DT_RGBA32 = 2304
+    };
+    
+    static const int NIFTI1_HEADER_SIZE = 348;  // sizeof_hdr for NIfTI-1
+    static const int NIFTI2_HEADER_SIZE = 540;  // sizeof_hdr for NIfTI-2
+    
+    int version = 0;             // 1 or 2, 0 when not parsed
+    bool byteSwapped = false;    // File byte order differs from the host
+    int64_t dim[8] = {};         // dim[0] = rank, dim[1..7] = extents
+    double pixdim[8] = {};       // pixdim[1..3] = voxel spacing in mm
+    int datatype = 0;            // One of DataType
+    int bitpix = 0;              // Bits per voxel
+    int64_t voxOffset = 0;       // Byte offset of the voxel block in a single-file .nii
+    double sclSlope = 0.0;       // Intensity scaling slope (0 = no scaling)
+    double sclInter = 0.0;       // Intensity scaling intercept
+    int xyztUnits = 0;           // Spatial and temporal unit codes (NIFTI_UNITS_*)
+    int intentCode = 0;          // Statistic or meaning of the voxel values (NIFTI_INTENT_*)
+    double intentP[3] = {};      // intent_p1..3 parameters
+    char intentName[17] = {};    // intent_name, NUL-terminated
+    char descrip[81] = {};       // Free-text description, NUL-terminated
+    int qformCode = 0;           // NIFTI_XFORM_* code of the quaternion transform
+    int sformCode = 0;           // NIFTI_XFORM_* code of the affine rows
+    double quatern[3] = {};      // quatern_b, quatern_c, quatern_d
+    double qoffset[3] = {};      // qoffset_x, qoffset_y, qoffset_z in mm
+    double srow[3][4] = {};      // srow_x, srow_y, srow_z of the sform affine
+    
+    // Parse a raw header block; returns false if it is not a single-file NIfTI header
+    bool parse(const unsigned char *data, size_t size);
+    
+    // Build a header block for writing; returns false if a field does not fit the version
+    bool serialize(std::vector<unsigned char> &block) const;
+    static int64_t headerBlockSize(int version); // Header plus the 4-byte extension flag: 352 or 544
+    
+    // Derived sizes - only the first 3D volume of the series
+    int64_t voxelsPerVolume() const;   // dim[1] * dim[2] * dim[3]
+    int bytesPerVoxel() const;         // bitpix / 8
+    int64_t bytesPerVolume() const;    // voxelsPerVolume() * bytesPerVoxel()
+    int bytesPerSwapUnit() const;      // Element size used for byte swapping
+    
+    // Time series - dim[4] volumes stored back to back
+    int64_t volumeCount() const;       // dim[4], 1 for a plain 3D file
+    double timeStepSeconds() const;    // pixdim[4] converted to seconds, 0 if not a time axis
+    
+    // Intensity scaling - real value = scl_slope * stored + scl_inter
+    bool hasScaling() const;           // scl_slope is set, finite and not the identity
+
+    // VTK representation of the datatype
+    int vtkScalarType() const;         // VTK_* scalar type, VTK_VOID if unsupported
+    int scalarComponents() const;      // Interleaved components per voxel (RGB = 3, complex = 2)
+    bool setVtkScalarType(int scalarType, int components); // Inverse of the two above; false if unsupported
+    
+    // Display names
+    const char *datatypeName() const;  // "int16", "float32", ...
+    static const char *xformName(int code); // "scanner", "aligned", "talairach", "mni152", ...
+};
+
+#endif // NIFTIHEADER_H
@@ -0,0 +1,102 @@
+#include "NiftiHeaderScanner.h"
+
+#include <vtk_zlib.h>
+
+#include <QDir>
+#include <QFile>
+
+namespace {
+
+const qint64 READ_STEP = 4096;                   // Compressed bytes pulled per read
+const qint64 MAX_COMPRESSED_PREFIX = 64 * 1024;  // Give up if the header is not inflated by then
+
+} // namespace
+
+/**
+ * Reads and parses only the header of a .nii or .nii.gz file
+ * 
+ * Extensions and voxels are never read, so the cost does not depend on
+ * the volume size.
+ */
+NiftiHeaderScanner::Entry NiftiHeaderScanner::scanFile(const QString &filePath)
+{
+    Entry entry;
+    entry.filePath = filePath;
+    
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        entry.errorString = file.errorString();
+        return entry;
+    }
+    entry.fileBytes = file.size();
+    
+    // Enough for either version; parse() reads sizeof_hdr to tell them apart
+    unsigned char block[NiftiHeader::NIFTI2_HEADER_SIZE];
+    qint64 got = filePath.toLower().endsWith(".gz")
+                     ? inflateHeader(file, block, sizeof(block))
+                     : file.read(reinterpret_cast<char *>(block), sizeof(block));
+    
+    if (got < NiftiHeader::NIFTI1_HEADER_SIZE ||
+        !entry.header.parse(block, static_cast<size_t>(got))) {
+        entry.errorString = "Not a single-file NIfTI-1/2 header";
+    }
+    return entry;
+}
+
+QStringList NiftiHeaderScanner::listFiles(const QString &directory)
+{
+    // Same filter as the open dialog
+    const QStringList names = QDir(directory).entryList({"*.nii", "*.nii.gz"}, QDir::Files, QDir::Name);
+    
+    QStringList files;
+    for (const QString &name : names) {
+        files << QDir(directory).absoluteFilePath(name);
+    }
+    return files;
+}
+
+/**
+ * Inflates the first size bytes of a gzip file
+ * 
+ * A deflated NIfTI header takes a few hundred bytes, so the first read
+ * normally suffices. Returns the number of bytes produced, which is less
+ * than size for a short or corrupt file.
+ */
+qint64 NiftiHeaderScanner::inflateHeader(QFile &file, unsigned char *dst, qint64 size)
+{
+    z_stream stream = z_stream();
+    // 16 + MAX_WBITS selects gzip framing
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        return -1;
+    }
+    
+    unsigned char input[READ_STEP];
+    stream.next_out = dst;
+    stream.avail_out = static_cast<uInt>(size);
+    
+    while (stream.avail_out > 0) {
+        if (stream.avail_in == 0) {
+            if (file.pos() >= MAX_COMPRESSED_PREFIX) {
+                break;
+            }
+            qint64 n = file.read(reinterpret_cast<char *>(input), READ_STEP);
+            if (n <= 0) {
+                break;
+            }
+            stream.next_in = input;
+            stream.avail_in = static_cast<uInt>(n);
+        }
+        
+        int code = inflate(&stream, Z_NO_FLUSH);
+        if (code == Z_STREAM_END) {
+            // Tiny files may be split over several gzip members
+            inflateReset(&stream);
+        } else if (code != Z_OK && code != Z_BUF_ERROR) {
+            break;
+        }
+    }
+    
+    qint64 produced = size - stream.avail_out;
+    inflateEnd(&stream);
+    return produced;
+}
@@ -0,0 +1,43 @@
+#ifndef NIFTIHEADERSCANNER_H
+#define NIFTIHEADERSCANNER_H
+
+// Qt base classes for paths and listings
+#include <QString>
+#include <QStringList>
+
+#include "NiftiHeader.h"
+
+// Forward declarations
+class QFile;                // Source of the compressed header bytes
+
+/**
+ * NiftiHeaderScanner - Reads NIfTI metadata without touching voxel data
+ * 
+ * Only the fixed 348-byte (NIfTI-1) or 540-byte (NIfTI-2) header is read.
+ * For .nii.gz files a few KB of compressed input are pulled from disk and
+ * inflated just far enough to produce the header, so scanning a directory
+ * of thousands of scans costs one small read per file.
+ * 
+ * All methods are static and thread-safe.
+ */
+class NiftiHeaderScanner
+{
+public:
+    /**
+     * Metadata of one file, or the reason it could not be read
+     */
+    struct Entry {
+        QString filePath;                                // Scanned file
+        qint64 fileBytes = 0;                            // Size on disk
+        NiftiHeader header;                              // Parsed header, version 0 on failure
+        QString errorString;                             // Empty when the header parsed
+    };
+    
+    static Entry scanFile(const QString &filePath);      // Header-only read of one file
+    static QStringList listFiles(const QString &directory); // .nii and .nii.gz files by name
+
+private:
+    static qint64 inflateHeader(QFile &file, unsigned char *dst, qint64 size); // Gzip prefix of a file
+};
+
+#endif // NIFTIHEADERSCANNER_H
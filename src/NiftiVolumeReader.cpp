@@ -0,0 +1,415 @@
+#include "NiftiVolumeReader.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkCallbackCommand.h>
+#include <vtkByteSwap.h>
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+
+#include "GzipBlockIndex.h"
+#include "VoxelStream.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+const qint64 CHUNK_SIZE = 4 * 1024 * 1024;        // Voxel bytes decoded between progress reports
+const vtkIdType BLOCKS_PER_TASK = 64;             // BGZF members (<= 64 KB each) per parallel task
+
+/**
+ * Releases the mapping once the scalar array that wraps it is destroyed
+ */
+void closeMappedFile(void *clientData)
+{
+    delete static_cast<QFile *>(clientData);
+}
+
+/**
+ * Reads and parses the fixed header at the start of the stream
+ * 
+ * Returns the number of header bytes consumed, or -1 when the block is
+ * not a valid single-file NIfTI-1/2 header.
+ */
+qint64 readHeaderBlock(VoxelStream &stream, NiftiHeader &header)
+{
+    unsigned char block[NiftiHeader::NIFTI2_HEADER_SIZE];
+    qint64 got = stream.read(reinterpret_cast<char *>(block), NiftiHeader::NIFTI1_HEADER_SIZE);
+    if (got != NiftiHeader::NIFTI1_HEADER_SIZE) {
+        return -1;
+    }
+    
+    // NIfTI-2 headers are longer; sizeof_hdr tells us in either byte order
+    qint32 sizeofHdr;
+    std::memcpy(&sizeofHdr, block, sizeof(sizeofHdr));
+    qint32 swappedSizeofHdr = sizeofHdr;
+    vtkByteSwap::SwapVoidRange(&swappedSizeofHdr, 1, sizeof(swappedSizeofHdr));
+    if (sizeofHdr != NiftiHeader::NIFTI1_HEADER_SIZE && swappedSizeofHdr != NiftiHeader::NIFTI1_HEADER_SIZE) {
+        const qint64 rest = NiftiHeader::NIFTI2_HEADER_SIZE - NiftiHeader::NIFTI1_HEADER_SIZE;
+        if (stream.read(reinterpret_cast<char *>(block) + got, rest) == rest) {
+            got += rest;
+        }
+    }
+    
+    if (!header.parse(block, static_cast<size_t>(got))) {
+        return -1;
+    }
+    return got;
+}
+
+} // namespace
+
+NiftiVolumeReader::NiftiVolumeReader(const QString &filePath)
+    : m_filePath(filePath)
+    , m_compressed(filePath.toLower().endsWith(".gz"))
+    , m_cancelFlag(nullptr)
+    , m_memoryMappingEnabled(false)
+    , m_parallelDecompressionEnabled(false)
+    , m_cancelled(false)
+    , m_memoryMapped(false)
+    , m_parallelDecompressed(false)
+    , m_fileBytesRead(0)
+{
+}
+
+void NiftiVolumeReader::setProgressCallback(ProgressCallback callback)
+{
+    m_progressCallback = std::move(callback);
+}
+
+void NiftiVolumeReader::setCancelFlag(const std::atomic_bool *cancelFlag)
+{
+    m_cancelFlag = cancelFlag;
+}
+
+void NiftiVolumeReader::setMemoryMappingEnabled(bool enabled)
+{
+    m_memoryMappingEnabled = enabled;
+}
+
+void NiftiVolumeReader::setParallelDecompressionEnabled(bool enabled)
+{
+    m_parallelDecompressionEnabled = enabled;
+}
+
+bool NiftiVolumeReader::readHeader()
+{
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_errorString = QString("Cannot open file: %1").arg(file.errorString());
+        return false;
+    }
+    
+    VoxelStream stream(file, m_compressed);
+    if (!stream.open() || readHeaderBlock(stream, m_header) < 0) {
+        m_errorString = "Not a single-file NIfTI-1/NIfTI-2 header";
+        return false;
+    }
+    
+    return true;
+}
+
+bool NiftiVolumeReader::canRead() const
+{
+    // Vector-valued images store components as separate volumes; leave those to VTK
+    return m_header.version != 0 &&
+           m_header.vtkScalarType() != VTK_VOID &&
+           m_header.dim[5] == 1;
+}
+
+vtkSmartPointer<vtkImageData> NiftiVolumeReader::read()
+{
+    m_cancelled = false;
+    m_memoryMapped = false;
+    m_parallelDecompressed = false;
+    m_fileBytesRead = 0;
+    
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_errorString = QString("Cannot open file: %1").arg(file.errorString());
+        return nullptr;
+    }
+    
+    VoxelStream stream(file, m_compressed);
+    if (!stream.open()) {
+        m_errorString = "Failed to initialize decompression";
+        return nullptr;
+    }
+    
+    qint64 headerBytes = readHeaderBlock(stream, m_header);
+    if (headerBytes < 0) {
+        m_errorString = "Not a single-file NIfTI-1/NIfTI-2 header";
+        return nullptr;
+    }
+    if (!canRead()) {
+        m_errorString = QString("Unsupported NIfTI datatype %1").arg(m_header.datatype);
+        return nullptr;
+    }
+    
+    // Skip header extensions between the fixed header and vox_offset
+    if (m_header.voxOffset < headerBytes) {
+        m_errorString = QString("Corrupt header: vox_offset %1 lies inside the header").arg(m_header.voxOffset);
+        return nullptr;
+    }
+    if (!stream.skip(m_header.voxOffset - headerBytes)) {
+        m_errorString = "File ends before the voxel data";
+        return nullptr;
+    }
+    
+    vtkSmartPointer<vtkImageData> imageData = vtkSmartPointer<vtkImageData>::New();
+    imageData->SetDimensions(static_cast<int>(m_header.dim[1]),
+                             static_cast<int>(m_header.dim[2]),
+                             static_cast<int>(m_header.dim[3]));
+    double spacing[3];
+    for (int i = 0; i < 3; ++i) {
+        spacing[i] = m_header.pixdim[i + 1] != 0.0 ? std::abs(m_header.pixdim[i + 1]) : 1.0;
+    }
+    imageData->SetSpacing(spacing);
+    imageData->SetOrigin(0.0, 0.0, 0.0);
+    
+    const qint64 total = m_header.bytesPerVolume();
+    
+    // Zero-copy path: the page cache is the voxel buffer
+    if (m_memoryMappingEnabled && mapVoxels(imageData)) {
+        m_memoryMapped = true;
+        if (m_progressCallback) {
+            m_progressCallback(total, total);
+        }
+        return imageData;
+    }
+    
+    imageData->AllocateScalars(m_header.vtkScalarType(), m_header.scalarComponents());
+    
+    char *dst = static_cast<char *>(imageData->GetScalarPointer());
+    qint64 done = 0;
+    
+    if (m_progressCallback) {
+        m_progressCallback(0, total);
+    }
+    
+    // BGZF files inflate on all cores; plain single-stream gzip falls through
+    if (m_compressed && m_parallelDecompressionEnabled) {
+        ParallelStatus status = inflateBlocksParallel(dst, total);
+        if (status == ParallelFailed) {
+            return nullptr;
+        }
+        if (status == ParallelInflated) {
+            m_parallelDecompressed = true;
+            done = total;
+        }
+    }
+    
+    // Chunked read straight into the scalar buffer, reporting after each chunk
+    while (done < total) {
+        if (isCancelled()) {
+            m_cancelled = true;
+            return nullptr;
+        }
+        
+        qint64 n = stream.read(dst + done, std::min(CHUNK_SIZE, total - done));
+        if (n <= 0) {
+            m_errorString = n < 0 ? QString("Read error: %1").arg(file.errorString())
+                                  : QString("File is truncated");
+            return nullptr;
+        }
+        done += n;
+        m_fileBytesRead = file.pos();
+        
+        if (m_progressCallback) {
+            m_progressCallback(done, total);
+        }
+    }
+    
+    if (m_header.byteSwapped && m_header.bytesPerSwapUnit() > 1) {
+        const int unit = m_header.bytesPerSwapUnit();
+        vtkByteSwap::SwapVoidRange(dst, static_cast<size_t>(total / unit), static_cast<size_t>(unit));
+    }
+    
+    return imageData;
+}
+
+const NiftiHeader &NiftiVolumeReader::header() const
+{
+    return m_header;
+}
+
+QString NiftiVolumeReader::errorString() const
+{
+    return m_errorString;
+}
+
+bool NiftiVolumeReader::wasCancelled() const
+{
+    return m_cancelled;
+}
+
+bool NiftiVolumeReader::isMemoryMapped() const
+{
+    return m_memoryMapped;
+}
+
+bool NiftiVolumeReader::isParallelDecompressed() const
+{
+    return m_parallelDecompressed;
+}
+
+qint64 NiftiVolumeReader::fileBytesRead() const
+{
+    return m_fileBytesRead;
+}
+
+bool NiftiVolumeReader::isCancelled() const
+{
+    return m_cancelFlag && m_cancelFlag->load();
+}
+
+/**
+ * Wraps the voxel block of an uncompressed file as the scalar array
+ * 
+ * The whole file is mapped copy-on-write, so nothing is read up front and
+ * only pages that a slice actually touches become resident. Writes to the
+ * array stay private to the process. Returns false when the layout cannot
+ * be used in place (compressed, foreign byte order, misaligned vox_offset).
+ */
+bool NiftiVolumeReader::mapVoxels(vtkImageData *imageData)
+{
+    if (m_compressed || m_header.byteSwapped) {
+        return false;
+    }
+    
+    const qint64 total = m_header.bytesPerVolume();
+    QFile *file = new QFile(m_filePath);
+    if (!file->open(QIODevice::ReadOnly) || file->size() < m_header.voxOffset + total) {
+        delete file;
+        return false;
+    }
+    
+    uchar *base = file->map(0, file->size(), QFileDevice::MapPrivateOption);
+    if (!base) {
+        delete file;
+        return false;
+    }
+    
+    uchar *voxels = base + m_header.voxOffset;
+    const int valueSize = m_header.bytesPerSwapUnit();
+    if (reinterpret_cast<quintptr>(voxels) % valueSize != 0) {
+        delete file;
+        return false;
+    }
+    
+    vtkSmartPointer<vtkDataArray> scalars =
+        vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(m_header.vtkScalarType()));
+    scalars->SetNumberOfComponents(m_header.scalarComponents());
+    scalars->SetVoidArray(voxels, total / valueSize, 1);  // save = 1: VTK must not free it
+    
+    // The mapping lives exactly as long as the array: the observer's client
+    // data is released when the array (and with it the observer) is destroyed
+    vtkSmartPointer<vtkCallbackCommand> unmapOnDelete = vtkSmartPointer<vtkCallbackCommand>::New();
+    unmapOnDelete->SetClientData(file);
+    unmapOnDelete->SetClientDataDeleteCallback(closeMappedFile);
+    scalars->AddObserver(vtkCommand::DeleteEvent, unmapOnDelete);
+    
+    imageData->GetPointData()->SetScalars(scalars);
+    return true;
+}
+
+/**
+ * Inflates the first volume of a BGZF-compressed file on all cores
+ * 
+ * Member boundaries and output sizes come from the .gzi sidecar or the
+ * BGZF headers and trailers, so every member's destination is known
+ * before anything is decoded. Members are inflated in ranges directly into
+ * place; only the few that straddle vox_offset or the end of the first
+ * volume go through a scratch buffer. Members past the first volume (the
+ * remaining frames of a 4D file) are never touched.
+ */
+NiftiVolumeReader::ParallelStatus NiftiVolumeReader::inflateBlocksParallel(char *dst, qint64 total)
+{
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return ParallelNotApplicable;
+    }
+    
+    const qint64 fileSize = file.size();
+    const uchar *data = file.map(0, fileSize);
+    if (!data) {
+        return ParallelNotApplicable;
+    }
+    
+    GzipBlockIndex index;
+    const qint64 volumeBegin = m_header.voxOffset;
+    const qint64 volumeEnd = volumeBegin + total;
+    if (!index.open(m_filePath, data, fileSize) || index.uncompressedSize() < volumeEnd) {
+        return ParallelNotApplicable;
+    }
+    
+    std::atomic<qint64> done(0);
+    std::atomic_bool failed(false);
+    std::mutex progressMutex;
+    
+    auto inflateRange = [&](vtkIdType first, vtkIdType last) {
+        if (failed.load() || isCancelled()) {
+            return;
+        }
+        
+        GzipBlockInflater inflater;
+        std::vector<char> scratch;
+        qint64 produced = 0;
+        
+        for (vtkIdType i = first; i < last; ++i) {
+            const GzipBlock &block = index.block(static_cast<int>(i));
+            const qint64 blockBegin = block.uncompressedOffset;
+            const qint64 blockEnd = blockBegin + block.uncompressedSize;
+            if (blockEnd <= volumeBegin || blockBegin >= volumeEnd) {
+                continue;
+            }
+            
+            bool ok;
+            if (blockBegin >= volumeBegin && blockEnd <= volumeEnd) {
+                ok = inflater.decode(data, block, dst + (blockBegin - volumeBegin));
+            } else {
+                scratch.resize(static_cast<size_t>(block.uncompressedSize));
+                ok = inflater.decode(data, block, scratch.data());
+                if (ok) {
+                    const qint64 from = std::max(blockBegin, volumeBegin);
+                    const qint64 to = std::min(blockEnd, volumeEnd);
+                    std::memcpy(dst + (from - volumeBegin), scratch.data() + (from - blockBegin),
+                                static_cast<size_t>(to - from));
+                }
+            }
+            
+            if (!ok) {
+                failed.store(true);
+                return;
+            }
+            produced += std::min(blockEnd, volumeEnd) - std::max(blockBegin, volumeBegin);
+        }
+        
+        done += produced;
+        if (m_progressCallback) {
+            // Serialized so the callback never runs concurrently with itself
+            std::lock_guard<std::mutex> lock(progressMutex);
+            m_progressCallback(done.load(), total);
+        }
+    };
+    vtkSMPTools::For(0, index.blockCount(), BLOCKS_PER_TASK, inflateRange);
+    
+    if (isCancelled()) {
+        m_cancelled = true;
+        return ParallelFailed;
+    }
+    if (failed.load()) {
+        m_errorString = "Corrupt BGZF block";
+        return ParallelFailed;
+    }
+    
+    m_fileBytesRead = fileSize;
+    return ParallelInflated;
+}
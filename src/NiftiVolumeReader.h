@@ -0,0 +1,91 @@
+#ifndef NIFTIVOLUMEREADER_H
+#define NIFTIVOLUMEREADER_H
+
+// Qt base classes for file access and string handling
+#include <QString>
+
+// VTK smart pointer for the image data handed back to the caller
+#include <vtkSmartPointer.h>
+
+// Standard library for callbacks and the cancellation flag
+#include <atomic>
+#include <functional>
+
+#include "NiftiHeader.h"
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * NiftiVolumeReader - Streaming reader for single-file NIfTI volumes
+ * 
+ * Unlike vtkNIFTIImageReader, the voxel block is read in fixed-size
+ * chunks straight into the vtkImageData buffer. Between chunks the reader
+ * reports how many bytes have been decoded and checks for cancellation,
+ * which gives byte-accurate progress for both .nii and .nii.gz files.
+ * 
+ * For uncompressed files the voxel block can instead be memory-mapped and
+ * used in place, so opening costs no I/O until slices are displayed.
+ * BGZF-compressed files (independent gzip members) are inflated in
+ * parallel, one task per range of members.
+ * 
+ * The reader is not a QObject; it is meant to run on a worker thread and
+ * report through the progress callback.
+ */
+class NiftiVolumeReader
+{
+public:
+    // Called after each chunk with decoded voxel bytes so far and the total
+    using ProgressCallback = std::function<void(qint64 bytesDone, qint64 bytesTotal)>;
+    
+    explicit NiftiVolumeReader(const QString &filePath);
+    
+    // Configuration - must be set before read()
+    void setProgressCallback(ProgressCallback callback); // Receive per-chunk progress
+    void setCancelFlag(const std::atomic_bool *cancelFlag); // Abort between chunks when set
+    void setMemoryMappingEnabled(bool enabled);  // Map uncompressed voxels instead of copying
+    void setParallelDecompressionEnabled(bool enabled); // Inflate BGZF members on all cores
+    
+    // Reading
+    bool readHeader();                           // Parse only the header
+    bool canRead() const;                        // Whether the voxel layout is supported
+    vtkSmartPointer<vtkImageData> read();        // Read the first 3D volume, null on failure
+    
+    // Results
+    const NiftiHeader &header() const;           // Header parsed by readHeader()/read()
+    QString errorString() const;                 // Reason for the last failure
+    bool wasCancelled() const;                   // True when read() stopped on the cancel flag
+    bool isMemoryMapped() const;                 // True when read() wrapped a file mapping
+    bool isParallelDecompressed() const;         // True when read() inflated BGZF members in parallel
+    qint64 fileBytesRead() const;                // Bytes pulled from disk (compressed for .nii.gz)
+
+private:
+    /**
+     * Outcome of the parallel BGZF path
+     */
+    enum ParallelStatus {
+        ParallelInflated,      // Volume decoded
+        ParallelNotApplicable, // Not BGZF; use the sequential stream
+        ParallelFailed         // Corrupt data or cancelled; error already set
+    };
+    
+    QString m_filePath;                          // File being read
+    bool m_compressed;                           // Whether the file is gzip-compressed
+    NiftiHeader m_header;                        // Parsed header
+    ProgressCallback m_progressCallback;         // Optional progress sink
+    const std::atomic_bool *m_cancelFlag;        // Optional cancellation flag
+    bool m_memoryMappingEnabled;                 // Try the zero-copy path for .nii files
+    bool m_parallelDecompressionEnabled;         // Try block-parallel inflate for .nii.gz files
+    QString m_errorString;                       // Last error message
+    bool m_cancelled;                            // Whether the last read was cancelled
+    bool m_memoryMapped;                         // Whether the last read is a file mapping
+    bool m_parallelDecompressed;                 // Whether the last read used parallel inflate
+    qint64 m_fileBytesRead;                      // Raw bytes consumed from the file
+    
+    // Private helper methods
+    bool isCancelled() const;                    // Poll the cancellation flag
+    bool mapVoxels(vtkImageData *imageData);     // Attach a mapped voxel block as scalars
+    ParallelStatus inflateBlocksParallel(char *dst, qint64 total); // Parallel BGZF decode
+};
+
+#endif // NIFTIVOLUMEREADER_H
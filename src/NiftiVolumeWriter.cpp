@@ -0,0 +1,311 @@
+#include "NiftiVolumeWriter.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSMPTools.h>
+
+#include "GzipBlockIndex.h"
+
+#include <QSaveFile>
+#include <QByteArray>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const qint64 CHUNK_SIZE = 4 * 1024 * 1024;        // Voxel bytes written between progress reports (.nii)
+const vtkIdType BATCH_BLOCKS = 512;               // BGZF members compressed before the batch is written (32 MB)
+const vtkIdType BLOCKS_PER_TASK = 16;             // BGZF members per parallel task
+const int NIFTI_UNITS_MM = 2;                     // xyzt_units when there is no template
+
+} // namespace
+
+NiftiVolumeWriter::NiftiVolumeWriter(const QString &filePath)
+    : m_filePath(filePath)
+    , m_compressed(filePath.endsWith(".gz", Qt::CaseInsensitive))
+    , m_version(0)
+    , m_compressionLevel(6)
+    , m_cancelFlag(nullptr)
+    , m_cancelled(false)
+    , m_fileBytesWritten(0)
+{
+}
+
+void NiftiVolumeWriter::setTemplateHeader(const NiftiHeader &header)
+{
+    m_templateHeader = header;
+}
+
+void NiftiVolumeWriter::setVersion(int version)
+{
+    m_version = version;
+}
+
+void NiftiVolumeWriter::setCompressionLevel(int level)
+{
+    m_compressionLevel = std::max(1, std::min(9, level));
+}
+
+void NiftiVolumeWriter::setProgressCallback(ProgressCallback callback)
+{
+    m_progressCallback = std::move(callback);
+}
+
+void NiftiVolumeWriter::setCancelFlag(const std::atomic_bool *cancelFlag)
+{
+    m_cancelFlag = cancelFlag;
+}
+
+QString NiftiVolumeWriter::errorString() const
+{
+    return m_errorString;
+}
+
+bool NiftiVolumeWriter::wasCancelled() const
+{
+    return m_cancelled;
+}
+
+qint64 NiftiVolumeWriter::fileBytesWritten() const
+{
+    return m_fileBytesWritten;
+}
+
+bool NiftiVolumeWriter::isCancelled() const
+{
+    return m_cancelFlag && m_cancelFlag->load();
+}
+
+/**
+ * Writes the header and the voxel block
+ * 
+ * Compressed output puts the header in a member of its own, so every
+ * voxel member starts on a 64 KB boundary of the voxel block. Each batch
+ * of members is deflated on all cores, then appended in order; the
+ * cancel flag is checked between batches. The member table is saved as
+ * a .gzi sidecar, so readers can seek without scanning the file.
+ */
+bool NiftiVolumeWriter::write(vtkImageData *imageData)
+{
+    m_errorString.clear();
+    m_cancelled = false;
+    m_fileBytesWritten = 0;
+    
+    if (!imageData || !imageData->GetPointData()->GetScalars()) {
+        m_errorString = "No image data to write";
+        return false;
+    }
+    
+    NiftiHeader header;
+    if (!buildHeader(imageData, header)) {
+        return false;
+    }
+    std::vector<unsigned char> headerBlock;
+    if (!header.serialize(headerBlock)) {
+        m_errorString = "Volume does not fit the NIfTI header";
+        return false;
+    }
+    
+    const char *voxels = static_cast<const char *>(imageData->GetScalarPointer());
+    const qint64 total = header.bytesPerVolume();
+    
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        m_errorString = QString("Cannot create file: %1").arg(file.errorString());
+        return false;
+    }
+    
+    const qint64 headerSize = static_cast<qint64>(headerBlock.size());
+    GzipBlockIndex blockIndex;
+    if (!m_compressed) {
+        bool ok = file.write(reinterpret_cast<const char *>(headerBlock.data()), headerSize) == headerSize;
+        for (qint64 done = 0; ok && done < total; ) {
+            if (isCancelled()) {
+                file.cancelWriting();
+                m_cancelled = true;
+                return false;
+            }
+            const qint64 chunk = std::min(CHUNK_SIZE, total - done);
+            ok = file.write(voxels + done, chunk) == chunk;
+            done += chunk;
+            if (ok && m_progressCallback) {
+                m_progressCallback(done, total);
+            }
+        }
+        if (!ok) {
+            m_errorString = QString("Write failed: %1").arg(file.errorString());
+            file.cancelWriting();
+            return false;
+        }
+    } else {
+        GzipBlockDeflater headerDeflater(m_compressionLevel);
+        QByteArray headerMember;
+        if (!headerDeflater.encode(reinterpret_cast<const char *>(headerBlock.data()),
+                                   static_cast<int>(headerSize), headerMember) ||
+            file.write(headerMember) != headerMember.size()) {
+            m_errorString = QString("Write failed: %1").arg(file.errorString());
+            file.cancelWriting();
+            return false;
+        }
+        blockIndex.appendMember(headerMember.size(), headerSize);
+        
+        const qint64 blockBytes = GzipBlockDeflater::MAX_BLOCK_BYTES;
+        const vtkIdType blockCount = static_cast<vtkIdType>((total + blockBytes - 1) / blockBytes);
+        std::vector<QByteArray> members(static_cast<size_t>(BATCH_BLOCKS));
+        
+        for (vtkIdType first = 0; first < blockCount; first += BATCH_BLOCKS) {
+            if (isCancelled()) {
+                file.cancelWriting();
+                m_cancelled = true;
+                return false;
+            }
+            
+            const vtkIdType count = std::min(BATCH_BLOCKS, blockCount - first);
+            std::atomic_bool failed(false);
+            auto deflateRange = [&](vtkIdType begin, vtkIdType end) {
+                GzipBlockDeflater deflater(m_compressionLevel);
+                for (vtkIdType i = begin; i < end; ++i) {
+                    const qint64 offset = (first + i) * blockBytes;
+                    const int size = static_cast<int>(std::min(blockBytes, total - offset));
+                    members[i].clear();
+                    if (!deflater.encode(voxels + offset, size, members[i])) {
+                        failed.store(true);
+                        return;
+                    }
+                }
+            };
+            vtkSMPTools::For(0, count, BLOCKS_PER_TASK, deflateRange);
+            
+            bool ok = !failed.load();
+            for (vtkIdType i = 0; ok && i < count; ++i) {
+                ok = file.write(members[i]) == members[i].size();
+                blockIndex.appendMember(members[i].size(), std::min(blockBytes, total - (first + i) * blockBytes));
+            }
+            if (!ok) {
+                m_errorString = failed.load() ? QString("Compression failed")
+                                              : QString("Write failed: %1").arg(file.errorString());
+                file.cancelWriting();
+                return false;
+            }
+            
+            if (m_progressCallback) {
+                m_progressCallback(std::min(total, (first + count) * blockBytes), total);
+            }
+        }
+        
+        const QByteArray endOfFile = GzipBlockDeflater::endOfFile();
+        if (file.write(endOfFile) != endOfFile.size()) {
+            m_errorString = QString("Write failed: %1").arg(file.errorString());
+            file.cancelWriting();
+            return false;
+        }
+        blockIndex.appendMember(endOfFile.size(), 0);
+    }
+    
+    m_fileBytesWritten = file.size();
+    if (!file.commit()) {
+        m_errorString = QString("Cannot save file: %1").arg(file.errorString());
+        m_fileBytesWritten = 0;
+        return false;
+    }
+    
+    // Without the sidecar, readers scan the members instead
+    if (m_compressed) {
+        blockIndex.saveSidecar(m_filePath);
+    }
+    return true;
+}
+
+/**
+ * Fills a header for the image, keeping the template's world placement
+ * 
+ * The loader places voxel k of the source at k * spacing millimetres with
+ * a zero origin, so the source affine divided by its spacing maps those
+ * millimetres to world space. The first voxel written sits at origin +
+ * extent start * spacing in that frame, which gives the new translation;
+ * the new spacing rescales the sform columns. The qform keeps its
+ * rotation, and only its offset moves.
+ */
+bool NiftiVolumeWriter::buildHeader(vtkImageData *imageData, NiftiHeader &header)
+{
+    const NiftiHeader &source = m_templateHeader;
+    const bool hasTemplate = source.version != 0;
+    header = hasTemplate ? source : NiftiHeader();
+    if (!hasTemplate) {
+        header.xyztUnits = NIFTI_UNITS_MM;
+        header.pixdim[0] = 1.0;
+    }
+    
+    vtkDataArray *scalars = imageData->GetPointData()->GetScalars();
+    if (!header.setVtkScalarType(scalars->GetDataType(), scalars->GetNumberOfComponents())) {
+        m_errorString = QString("Cannot store %1 with %2 components in NIfTI")
+                            .arg(scalars->GetDataTypeAsString())
+                            .arg(scalars->GetNumberOfComponents());
+        return false;
+    }
+    
+    int extent[6];
+    double spacing[3];
+    double origin[3];
+    imageData->GetExtent(extent);
+    imageData->GetSpacing(spacing);
+    imageData->GetOrigin(origin);
+    
+    header.dim[0] = 3;
+    bool needsVersion2 = false;
+    double start[3];
+    double sourceSpacing[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        header.dim[axis + 1] = extent[2 * axis + 1] - extent[2 * axis] + 1;
+        header.pixdim[axis + 1] = spacing[axis];
+        needsVersion2 = needsVersion2 || header.dim[axis + 1] > INT16_MAX;
+        start[axis] = origin[axis] + extent[2 * axis] * spacing[axis];
+        const double pixdim = hasTemplate ? std::abs(source.pixdim[axis + 1]) : 0.0;
+        sourceSpacing[axis] = pixdim != 0.0 ? pixdim : 1.0;
+    }
+    for (int i = 4; i < 8; ++i) {
+        header.dim[i] = 1;
+    }
+    
+    if (source.sformCode > 0) {
+        for (int row = 0; row < 3; ++row) {
+            double shift = 0.0;
+            for (int axis = 0; axis < 3; ++axis) {
+                const double perMillimetre = source.srow[row][axis] / sourceSpacing[axis];
+                header.srow[row][axis] = perMillimetre * spacing[axis];
+                shift += perMillimetre * start[axis];
+            }
+            header.srow[row][3] = source.srow[row][3] + shift;
+        }
+    }
+    
+    if (source.qformCode > 0) {
+        // Rotation of the quaternion (b, c, d), with qfac flipping the third axis
+        const double b = source.quatern[0];
+        const double c = source.quatern[1];
+        const double d = source.quatern[2];
+        const double a = std::sqrt(std::max(0.0, 1.0 - b * b - c * c - d * d));
+        const double rotation[3][3] = {
+            { a * a + b * b - c * c - d * d, 2.0 * (b * c - a * d), 2.0 * (b * d + a * c) },
+            { 2.0 * (b * c + a * d), a * a + c * c - b * b - d * d, 2.0 * (c * d - a * b) },
+            { 2.0 * (b * d - a * c), 2.0 * (c * d + a * b), a * a + d * d - b * b - c * c }
+        };
+        const double qfac = source.pixdim[0] < 0.0 ? -1.0 : 1.0;
+        const double axisStart[3] = { start[0], start[1], qfac * start[2] };
+        for (int row = 0; row < 3; ++row) {
+            for (int axis = 0; axis < 3; ++axis) {
+                header.qoffset[row] += rotation[row][axis] * axisStart[axis];
+            }
+        }
+    }
+    
+    header.version = (m_version == 2 || needsVersion2 || (m_version == 0 && source.version == 2)) ? 2 : 1;
+    header.voxOffset = NiftiHeader::headerBlockSize(header.version);
+    header.byteSwapped = false;
+    return true;
+}
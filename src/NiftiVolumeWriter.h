@@ -0,0 +1,79 @@
+#ifndef NIFTIVOLUMEWRITER_H
+#define NIFTIVOLUMEWRITER_H
+
+// Qt base classes for file access and string handling
+#include <QString>
+
+// Standard library for callbacks and the cancellation flag
+#include <atomic>
+#include <functional>
+
+#include "NiftiHeader.h"
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * NiftiVolumeWriter - Single-file NIfTI-1/NIfTI-2 writer with parallel compression
+ * 
+ * Writes a vtkImageData as .nii, or as .nii.gz when the name ends in
+ * .gz. Compressed output is BGZF: the voxel block is cut into 64 KB
+ * pieces that are deflated as independent gzip members on all cores,
+ * a batch at a time, and written in order. Any gzip reader accepts the
+ * result, and this viewer reads it back in parallel and lazily; the
+ * member table goes to a .gzi sidecar next to the file.
+ * Compression level 1 is the fast tier; it trades a larger file for
+ * several times the throughput of the default level.
+ * 
+ * Geometry comes from the image: dimensions, spacing and datatype. The
+ * template header (usually the file the volume was loaded from) supplies
+ * transforms, intensity scaling, units, intent and description. Its
+ * qform and sform are adjusted for the image's spacing, origin and
+ * extent, so cropped or resampled copies stay in the same world space.
+ * 
+ * The output goes through QSaveFile, so an existing file is only
+ * replaced once the new one is complete. Like the reader, the writer is
+ * not a QObject; it runs on a worker thread and reports through the
+ * progress callback.
+ */
+class NiftiVolumeWriter
+{
+public:
+    // Called after each batch with voxel bytes written so far and the total
+    using ProgressCallback = std::function<void(qint64 bytesDone, qint64 bytesTotal)>;
+    
+    explicit NiftiVolumeWriter(const QString &filePath);
+    
+    // Configuration - must be set before write()
+    void setTemplateHeader(const NiftiHeader &header);   // Transforms, scaling and metadata to carry over
+    void setVersion(int version);                        // 1 or 2; 1 switches to 2 for dimensions above 32767
+    void setCompressionLevel(int level);                 // zlib level 1-9 for .nii.gz files
+    void setProgressCallback(ProgressCallback callback); // Receive per-batch progress
+    void setCancelFlag(const std::atomic_bool *cancelFlag); // Abort between batches when set
+    
+    // Writing
+    bool write(vtkImageData *imageData);                 // Write the volume; false on failure or cancel
+    
+    // Results
+    QString errorString() const;                         // Reason for the last failure
+    bool wasCancelled() const;                           // True when write() stopped on the cancel flag
+    qint64 fileBytesWritten() const;                     // Bytes on disk after the last write()
+
+private:
+    QString m_filePath;                                  // File being written
+    bool m_compressed;                                   // Whether the output is BGZF
+    NiftiHeader m_templateHeader;                        // Metadata source, version 0 when unset
+    int m_version;                                       // Requested NIfTI version
+    int m_compressionLevel;                              // zlib level of the BGZF members
+    ProgressCallback m_progressCallback;                 // Optional progress sink
+    const std::atomic_bool *m_cancelFlag;                // Optional cancellation flag
+    QString m_errorString;                               // Last error message
+    bool m_cancelled;                                    // Whether the last write was cancelled
+    qint64 m_fileBytesWritten;                           // Size of the last written file
+    
+    // Private helper methods
+    bool isCancelled() const;                            // Poll the cancellation flag
+    bool buildHeader(vtkImageData *imageData, NiftiHeader &header); // Geometry from the image, rest from the template
+};
+
+#endif // NIFTIVOLUMEWRITER_H
@@ -0,0 +1,324 @@
+#include "ObliqueSlicer.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSetGet.h>
+#include <vtkSMPTools.h>
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const int BLOCK_SIZE = 64;                        // Columns whose positions and weights are computed together
+const vtkIdType ROWS_PER_TASK = 4;                // Output rows per parallel task
+
+/**
+ * A plane in voxel memory coordinates: where pixel (0, 0) samples and
+ * how far one column and one row move through the volume
+ */
+struct PlaneGeometry {
+    float start[3];                               // Memory coordinates of the first pixel
+    float column[3];                              // Step per output column
+    float row[3];                                 // Step per output row
+    int size;                                     // Pixels along each side
+};
+
+template <typename T>
+inline T toScalar(float value)
+{
+    if (std::numeric_limits<T>::is_integer) {
+        return static_cast<T>(std::floor(value + 0.5f));
+    }
+    return static_cast<T>(value);
+}
+
+/**
+ * Nearest-neighbour samples of one block
+ * 
+ * Rounding and the bounds test run over plain arrays first; only the
+ * fetch itself is a scalar gather.
+ */
+template <typename T>
+void sampleNearest(const T *src, const int *dims, int components, const float *xs, const float *ys,
+                   const float *zs, int count, T background, T *out)
+{
+    const vtkIdType strideY = static_cast<vtkIdType>(dims[0]) * components;
+    const vtkIdType strideZ = strideY * dims[1];
+    vtkIdType offsets[BLOCK_SIZE];
+    bool inside[BLOCK_SIZE];
+    
+    for (int i = 0; i < count; ++i) {
+        const int x = static_cast<int>(std::floor(xs[i] + 0.5f));
+        const int y = static_cast<int>(std::floor(ys[i] + 0.5f));
+        const int z = static_cast<int>(std::floor(zs[i] + 0.5f));
+        inside[i] = x >= 0 && x < dims[0] && y >= 0 && y < dims[1] && z >= 0 && z < dims[2];
+        offsets[i] = inside[i] ? x * components + y * strideY + z * strideZ : 0;
+    }
+    
+    for (int i = 0; i < count; ++i) {
+        const T *voxel = src + offsets[i];
+        for (int c = 0; c < components; ++c) {
+            out[c] = inside[i] ? voxel[c] : background;
+        }
+        out += components;
+    }
+}
+
+/**
+ * Trilinear samples of one block
+ * 
+ * Cell corners and fractional weights are computed for the whole block,
+ * then the eight corners of each sample are fetched and blended. A
+ * sample on the last voxel of an axis reuses that voxel as its far
+ * corner, so the volume's faces are sampled exactly.
+ */
+template <typename T>
+void sampleLinear(const T *src, const int *dims, int components, const float *xs, const float *ys,
+                  const float *zs, int count, T background, T *out)
+{
+    const vtkIdType strideY = static_cast<vtkIdType>(dims[0]) * components;
+    const vtkIdType strideZ = strideY * dims[1];
+    const float last[3] = {
+        static_cast<float>(dims[0] - 1), static_cast<float>(dims[1] - 1), static_cast<float>(dims[2] - 1)
+    };
+    vtkIdType offsets[BLOCK_SIZE];
+    vtkIdType stepX[BLOCK_SIZE], stepY[BLOCK_SIZE], stepZ[BLOCK_SIZE];
+    float fx[BLOCK_SIZE], fy[BLOCK_SIZE], fz[BLOCK_SIZE];
+    bool inside[BLOCK_SIZE];
+    
+    for (int i = 0; i < count; ++i) {
+        inside[i] = xs[i] >= 0.0f && xs[i] <= last[0] && ys[i] >= 0.0f && ys[i] <= last[1] &&
+                    zs[i] >= 0.0f && zs[i] <= last[2];
+        const float x = inside[i] ? xs[i] : 0.0f;
+        const float y = inside[i] ? ys[i] : 0.0f;
+        const float z = inside[i] ? zs[i] : 0.0f;
+        const int x0 = static_cast<int>(x);
+        const int y0 = static_cast<int>(y);
+        const int z0 = static_cast<int>(z);
+        fx[i] = x - x0;
+        fy[i] = y - y0;
+        fz[i] = z - z0;
+        stepX[i] = x0 + 1 < dims[0] ? components : 0;
+        stepY[i] = y0 + 1 < dims[1] ? strideY : 0;
+        stepZ[i] = z0 + 1 < dims[2] ? strideZ : 0;
+        offsets[i] = x0 * components + y0 * strideY + z0 * strideZ;
+    }
+    
+    for (int i = 0; i < count; ++i) {
+        if (!inside[i]) {
+            for (int c = 0; c < components; ++c) {
+                out[c] = background;
+            }
+            out += components;
+            continue;
+        }
+        const T *corner = src + offsets[i];
+        const vtkIdType dx = stepX[i];
+        const vtkIdType dy = stepY[i];
+        const vtkIdType dz = stepZ[i];
+        for (int c = 0; c < components; ++c) {
+            const float c00 = corner[c] + fx[i] * (static_cast<float>(corner[c + dx]) - corner[c]);
+            const float c10 = corner[c + dy] + fx[i] * (static_cast<float>(corner[c + dy + dx]) - corner[c + dy]);
+            const float c01 = corner[c + dz] + fx[i] * (static_cast<float>(corner[c + dz + dx]) - corner[c + dz]);
+            const float c11 = corner[c + dz + dy] +
+                              fx[i] * (static_cast<float>(corner[c + dz + dy + dx]) - corner[c + dz + dy]);
+            const float c0 = c00 + fy[i] * (c10 - c00);
+            const float c1 = c01 + fy[i] * (c11 - c01);
+            out[c] = toScalar<T>(c0 + fz[i] * (c1 - c0));
+        }
+        out += components;
+    }
+}
+
+/**
+ * Resamples every output row, rows split across threads
+ * 
+ * Positions along a row are the row start plus a multiple of the column
+ * step, computed a block at a time into separate x, y and z arrays.
+ */
+template <typename T>
+void resampleRows(const T *src, const int *dims, int components, const PlaneGeometry &plane, bool linear,
+                  double background, T *dst)
+{
+    const T fill = toScalar<T>(static_cast<float>(background));
+    vtkSMPTools::For(0, plane.size, ROWS_PER_TASK, [&](vtkIdType begin, vtkIdType end) {
+        float xs[BLOCK_SIZE];
+        float ys[BLOCK_SIZE];
+        float zs[BLOCK_SIZE];
+        
+        for (vtkIdType row = begin; row < end; ++row) {
+            const float rowX = plane.start[0] + row * plane.row[0];
+            const float rowY = plane.start[1] + row * plane.row[1];
+            const float rowZ = plane.start[2] + row * plane.row[2];
+            T *out = dst + row * plane.size * components;
+            
+            for (int first = 0; first < plane.size; first += BLOCK_SIZE) {
+                const int count = std::min(BLOCK_SIZE, plane.size - first);
+                for (int i = 0; i < count; ++i) {
+                    const float column = static_cast<float>(first + i);
+                    xs[i] = rowX + column * plane.column[0];
+                    ys[i] = rowY + column * plane.column[1];
+                    zs[i] = rowZ + column * plane.column[2];
+                }
+                if (linear) {
+                    sampleLinear(src, dims, components, xs, ys, zs, count, fill, out + first * components);
+                } else {
+                    sampleNearest(src, dims, components, xs, ys, zs, count, fill, out + first * components);
+                }
+            }
+        }
+    });
+}
+
+} // namespace
+
+ObliqueSlicer::ObliqueSlicer()
+    : m_interpolation(LINEAR_INTERPOLATION)
+    , m_background(0.0)
+    , m_lastResliceSeconds(0.0)
+{
+}
+
+ObliqueSlicer::~ObliqueSlicer() = default;
+
+void ObliqueSlicer::setVolume(vtkImageData *volume)
+{
+    m_volume = volume;
+    if (!volume) {
+        m_output = nullptr;
+    }
+}
+
+vtkImageData *ObliqueSlicer::volume() const
+{
+    return m_volume;
+}
+
+void ObliqueSlicer::setInterpolation(Interpolation interpolation)
+{
+    m_interpolation = interpolation;
+}
+
+ObliqueSlicer::Interpolation ObliqueSlicer::interpolation() const
+{
+    return m_interpolation;
+}
+
+void ObliqueSlicer::setBackground(double value)
+{
+    m_background = value;
+}
+
+/**
+ * Resamples the plane through centre spanned by xAxis and yAxis
+ * 
+ * The axes are unit vectors in world space; output columns run along
+ * xAxis and rows along yAxis. The output's origin is chosen so the plane
+ * centre sits at (0, 0), which keeps a camera aimed there steady while
+ * the plane turns or moves.
+ */
+vtkImageData *ObliqueSlicer::reslice(const double centre[3], const double xAxis[3], const double yAxis[3],
+                                     double pixelSpacing)
+{
+    if (!m_volume || pixelSpacing <= 0.0 || !m_volume->GetPointData() || !m_volume->GetPointData()->GetScalars()) {
+        return nullptr;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    int dims[3];
+    int extent[6];
+    double spacing[3];
+    double origin[3];
+    m_volume->GetDimensions(dims);
+    m_volume->GetExtent(extent);
+    m_volume->GetSpacing(spacing);
+    m_volume->GetOrigin(origin);
+    vtkDataArray *scalars = m_volume->GetPointData()->GetScalars();
+    
+    const int size = outputSize(m_volume, pixelSpacing);
+    prepareOutput(size, pixelSpacing);
+    
+    // World to memory coordinates: structured index, less the extent start
+    PlaneGeometry plane;
+    plane.size = size;
+    const double half = 0.5 * (size - 1) * pixelSpacing;
+    for (int axis = 0; axis < 3; ++axis) {
+        const double first = centre[axis] - half * xAxis[axis] - half * yAxis[axis];
+        plane.start[axis] = static_cast<float>((first - origin[axis]) / spacing[axis] - extent[2 * axis]);
+        plane.column[axis] = static_cast<float>(pixelSpacing * xAxis[axis] / spacing[axis]);
+        plane.row[axis] = static_cast<float>(pixelSpacing * yAxis[axis] / spacing[axis]);
+    }
+    
+    const bool linear = m_interpolation == LINEAR_INTERPOLATION;
+    switch (scalars->GetDataType()) {
+        vtkTemplateMacro(resampleRows(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)), dims,
+                                      scalars->GetNumberOfComponents(), plane, linear, m_background,
+                                      static_cast<VTK_TT *>(m_output->GetScalarPointer())));
+        default:
+            return nullptr;
+    }
+    
+    m_output->Modified();
+    m_lastResliceSeconds = timer.nsecsElapsed() / 1.0e9;
+    return m_output;
+}
+
+vtkImageData *ObliqueSlicer::output() const
+{
+    return m_output;
+}
+
+double ObliqueSlicer::lastResliceSeconds() const
+{
+    return m_lastResliceSeconds;
+}
+
+/**
+ * Side of the square output: the volume's diagonal in pixels, plus one
+ */
+int ObliqueSlicer::outputSize(vtkImageData *volume, double pixelSpacing)
+{
+    if (!volume || pixelSpacing <= 0.0) {
+        return 0;
+    }
+    int dims[3];
+    double spacing[3];
+    volume->GetDimensions(dims);
+    volume->GetSpacing(spacing);
+    double diagonal = 0.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        const double length = (dims[axis] - 1) * spacing[axis];
+        diagonal += length * length;
+    }
+    return static_cast<int>(std::ceil(std::sqrt(diagonal) / pixelSpacing)) + 1;
+}
+
+/**
+ * Reallocates the output only when the size or the volume's type changed
+ */
+void ObliqueSlicer::prepareOutput(int size, double pixelSpacing)
+{
+    vtkDataArray *scalars = m_volume->GetPointData()->GetScalars();
+    
+    if (!m_output) {
+        m_output = vtkSmartPointer<vtkImageData>::New();
+    }
+    int *current = m_output->GetDimensions();
+    vtkDataArray *currentScalars = m_output->GetPointData()->GetScalars();
+    if (current[0] != size || current[1] != size || !currentScalars ||
+        currentScalars->GetDataType() != scalars->GetDataType() ||
+        currentScalars->GetNumberOfComponents() != scalars->GetNumberOfComponents()) {
+        m_output->SetDimensions(size, size, 1);
+        m_output->AllocateScalars(scalars->GetDataType(), scalars->GetNumberOfComponents());
+    }
+    const double half = 0.5 * (size - 1) * pixelSpacing;
+    m_output->SetSpacing(pixelSpacing, pixelSpacing, 1.0);
+    m_output->SetOrigin(-half, -half, 0.0);
+}
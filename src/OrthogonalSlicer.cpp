@@ -0,0 +1,298 @@
+#include "OrthogonalSlicer.h"
+#include "BrickedVolume.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSetGet.h>
+#include <vtkSMPTools.h>
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+const int NORMAL_AXIS[3] = { 2, 0, 1 };           // Axial cuts z, sagittal x, coronal y
+const int COLUMN_AXIS[3] = { 0, 1, 0 };           // Matches vtkImageViewer2's XY, YZ and XZ views
+const int ROW_AXIS[3] = { 1, 2, 2 };
+const vtkIdType ROWS_PER_TASK = 8;                // Plane rows per parallel task
+
+/**
+ * One plane of an extraction, addressed in elements of the scalar array
+ */
+struct PlaneJob {
+    int plane;                                    // Plane being filled
+    int normalIndex;                              // Position of the plane along its normal
+    vtkIdType sourceStart;                        // First element of row 0
+    vtkIdType columnStride;                       // Elements between neighbouring columns
+    vtkIdType rowStride;                          // Elements between neighbouring rows
+    int width;                                    // Columns per row
+    vtkIdType firstRow;                           // Index of row 0 in the combined row range
+    void *destination;                            // Scalars of the plane image
+    const BrickedVolume *bricks;                  // Read from these instead of the volume, or null
+};
+
+/**
+ * Copies the rows of every job, all planes in one parallel loop
+ * 
+ * Each output row is contiguous; the source is read with the plane's
+ * strides, which for the axial plane is contiguous too. A job with bricks
+ * hands each run of its rows within a task to them in one call.
+ */
+template <typename T>
+bool copyPlaneRows(const T *source, int components, const std::vector<PlaneJob> &jobs, vtkIdType rowCount)
+{
+    std::atomic_bool ok(true);
+    vtkSMPTools::For(0, rowCount, ROWS_PER_TASK, [&](vtkIdType begin, vtkIdType end) {
+        size_t index = 0;
+        vtkIdType row = begin;
+        while (row < end) {
+            while (index + 1 < jobs.size() && row >= jobs[index + 1].firstRow) {
+                ++index;
+            }
+            const PlaneJob &job = jobs[index];
+            const vtkIdType runEnd = index + 1 < jobs.size() ? std::min(end, jobs[index + 1].firstRow) : end;
+            
+            if (job.bricks) {
+                if (!job.bricks->copyPlaneRows(NORMAL_AXIS[job.plane], job.normalIndex, COLUMN_AXIS[job.plane],
+                                               ROW_AXIS[job.plane], static_cast<int>(row - job.firstRow),
+                                               static_cast<int>(runEnd - job.firstRow), job.destination)) {
+                    ok = false;
+                }
+                row = runEnd;
+                continue;
+            }
+            
+            for (; row < runEnd; ++row) {
+                const vtkIdType planeRow = row - job.firstRow;
+                const T *src = source + job.sourceStart + planeRow * job.rowStride;
+                T *dst = static_cast<T *>(job.destination) + planeRow * job.width * components;
+                if (job.columnStride == components) {
+                    std::copy(src, src + static_cast<vtkIdType>(job.width) * components, dst);
+                    continue;
+                }
+                for (int column = 0; column < job.width; ++column) {
+                    for (int c = 0; c < components; ++c) {
+                        dst[c] = src[c];
+                    }
+                    src += job.columnStride;
+                    dst += components;
+                }
+            }
+        }
+    });
+    return ok;
+}
+
+} // namespace
+
+OrthogonalSlicer::OrthogonalSlicer()
+    : m_lastExtractSeconds(0.0)
+{
+}
+
+OrthogonalSlicer::~OrthogonalSlicer() = default;
+
+void OrthogonalSlicer::setVolume(vtkImageData *volume)
+{
+    m_volume = volume;
+    if (!volume) {
+        for (int plane = 0; plane < PLANE_COUNT; ++plane) {
+            m_planes[plane] = nullptr;
+        }
+    }
+}
+
+vtkImageData *OrthogonalSlicer::volume() const
+{
+    return m_volume;
+}
+
+/**
+ * Attaches a bricked copy to extract from
+ * 
+ * The copy is kept across setVolume() calls but only read while its
+ * source is the current volume, so a 4D frame or a new file falls back
+ * to the volume itself without the caller having to detach it.
+ */
+void OrthogonalSlicer::setBricks(std::shared_ptr<BrickedVolume> bricks)
+{
+    m_bricks = bricks;
+}
+
+bool OrthogonalSlicer::usesBricks() const
+{
+    return m_bricks && m_volume && m_bricks->source() == m_volume.GetPointer();
+}
+
+/**
+ * Refills the planes in planeMask with the voxels through cursor
+ * 
+ * The cursor is in structured indices, the same numbers as slice indices;
+ * it is clamped to the volume's extent.
+ */
+bool OrthogonalSlicer::extract(const int cursor[3], int planeMask)
+{
+    if (!m_volume || !m_volume->GetPointData() || !m_volume->GetPointData()->GetScalars()) {
+        return false;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    int dims[3];
+    int extent[6];
+    m_volume->GetDimensions(dims);
+    m_volume->GetExtent(extent);
+    vtkDataArray *scalars = m_volume->GetPointData()->GetScalars();
+    const int components = scalars->GetNumberOfComponents();
+    
+    int index[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        index[axis] = std::max(0, std::min(dims[axis] - 1, cursor[axis] - extent[2 * axis]));
+    }
+    const vtkIdType strides[3] = {
+        components,
+        static_cast<vtkIdType>(dims[0]) * components,
+        static_cast<vtkIdType>(dims[0]) * dims[1] * components
+    };
+    
+    std::vector<PlaneJob> jobs;
+    vtkIdType rowCount = 0;
+    for (int plane = 0; plane < PLANE_COUNT; ++plane) {
+        if (!(planeMask & (1 << plane))) {
+            continue;
+        }
+        preparePlane(plane);
+        
+        PlaneJob job;
+        job.plane = plane;
+        job.normalIndex = index[NORMAL_AXIS[plane]];
+        job.sourceStart = index[NORMAL_AXIS[plane]] * strides[NORMAL_AXIS[plane]];
+        job.columnStride = strides[COLUMN_AXIS[plane]];
+        job.rowStride = strides[ROW_AXIS[plane]];
+        job.width = dims[COLUMN_AXIS[plane]];
+        job.firstRow = rowCount;
+        job.destination = m_planes[plane]->GetScalarPointer();
+        job.bricks = usesBricks() && job.columnStride != components ? m_bricks.get() : nullptr;
+        jobs.push_back(job);
+        rowCount += dims[ROW_AXIS[plane]];
+    }
+    if (jobs.empty()) {
+        return true;
+    }
+    
+    bool copied = false;
+    switch (scalars->GetDataType()) {
+        vtkTemplateMacro(copied = copyPlaneRows(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)),
+                                                components, jobs, rowCount));
+        default:
+            return false;
+    }
+    if (!copied) {
+        return false;
+    }
+    
+    for (int plane = 0; plane < PLANE_COUNT; ++plane) {
+        if (planeMask & (1 << plane)) {
+            m_planes[plane]->Modified();
+        }
+    }
+    m_lastExtractSeconds = timer.elapsed() / 1000.0;
+    return true;
+}
+
+vtkImageData *OrthogonalSlicer::plane(int plane) const
+{
+    if (plane < 0 || plane >= PLANE_COUNT) {
+        return nullptr;
+    }
+    return m_planes[plane];
+}
+
+double OrthogonalSlicer::lastExtractSeconds() const
+{
+    return m_lastExtractSeconds;
+}
+
+/**
+ * Times the extraction of one plane at evenly spaced positions
+ * 
+ * The first extraction allocates the plane image and is not counted.
+ * Positions sweep the whole normal axis so the result is not one slab
+ * that happens to sit in cache; the current planes are overwritten.
+ */
+double OrthogonalSlicer::measurePlaneLatency(int plane, int samples)
+{
+    if (!m_volume || plane < 0 || plane >= PLANE_COUNT || samples < 1) {
+        return 0.0;
+    }
+    
+    int extent[6];
+    m_volume->GetExtent(extent);
+    int cursor[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        cursor[axis] = (extent[2 * axis] + extent[2 * axis + 1]) / 2;
+    }
+    if (!extract(cursor, 1 << plane)) {
+        return 0.0;
+    }
+    
+    const int axis = NORMAL_AXIS[plane];
+    const int span = extent[2 * axis + 1] - extent[2 * axis];
+    QElapsedTimer timer;
+    timer.start();
+    for (int sample = 0; sample < samples; ++sample) {
+        cursor[axis] = extent[2 * axis] + (samples > 1 ? span * sample / (samples - 1) : span / 2);
+        extract(cursor, 1 << plane);
+    }
+    return timer.nsecsElapsed() / 1.0e6 / samples;
+}
+
+int OrthogonalSlicer::normalAxis(int plane)
+{
+    return NORMAL_AXIS[plane];
+}
+
+int OrthogonalSlicer::columnAxis(int plane)
+{
+    return COLUMN_AXIS[plane];
+}
+
+int OrthogonalSlicer::rowAxis(int plane)
+{
+    return ROW_AXIS[plane];
+}
+
+/**
+ * Reallocates a plane image only when the volume's shape or type changed
+ */
+void OrthogonalSlicer::preparePlane(int plane)
+{
+    int dims[3];
+    double spacing[3];
+    m_volume->GetDimensions(dims);
+    m_volume->GetSpacing(spacing);
+    vtkDataArray *scalars = m_volume->GetPointData()->GetScalars();
+    
+    const int width = dims[COLUMN_AXIS[plane]];
+    const int height = dims[ROW_AXIS[plane]];
+    
+    vtkSmartPointer<vtkImageData> &image = m_planes[plane];
+    if (!image) {
+        image = vtkSmartPointer<vtkImageData>::New();
+    }
+    int *current = image->GetDimensions();
+    vtkDataArray *currentScalars = image->GetPointData()->GetScalars();
+    if (current[0] != width || current[1] != height || !currentScalars ||
+        currentScalars->GetDataType() != scalars->GetDataType() ||
+        currentScalars->GetNumberOfComponents() != scalars->GetNumberOfComponents()) {
+        image->SetDimensions(width, height, 1);
+        image->AllocateScalars(scalars->GetDataType(), scalars->GetNumberOfComponents());
+    }
+    image->SetSpacing(spacing[COLUMN_AXIS[plane]], spacing[ROW_AXIS[plane]], 1.0);
+    image->SetOrigin(0.0, 0.0, 0.0);
+}
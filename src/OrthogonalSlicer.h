@@ -0,0 +1,72 @@
+#ifndef ORTHOGONALSLICER_H
+#define ORTHOGONALSLICER_H
+
+// VTK smart pointer for the shared volume and the plane images
+#include <vtkSmartPointer.h>
+
+// Standard library for the shared bricked copy
+#include <memory>
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+class BrickedVolume;        // Cache-blocked copy of a volume
+
+/**
+ * OrthogonalSlicer - Axial, sagittal and coronal planes through one point
+ * 
+ * Holds a reference to the volume, never a copy, and fills three small 2D
+ * images with the planes through a cursor voxel. Each plane image keeps
+ * the volume's scalar type and components, with its columns along the
+ * first in-plane axis and the matching in-plane spacing, so it can be
+ * shown and window/levelled like the volume itself.
+ * 
+ * extract() splits the rows of all requested planes into one parallel
+ * loop, so the strided sagittal and coronal reads share the cores instead
+ * of running one after another. With a BrickedVolume of the same volume
+ * attached, planes whose columns are strided in the volume (sagittal) are
+ * read from its bricks instead; rows that are contiguous runs in the
+ * volume are still copied from it directly, which no layout beats.
+ */
+class OrthogonalSlicer
+{
+public:
+    enum Plane {
+        AXIAL_PLANE = 0,       // Normal along z, same value as VolumeRenderer::AXIAL
+        SAGITTAL_PLANE = 1,    // Normal along x
+        CORONAL_PLANE = 2      // Normal along y
+    };
+    
+    static const int PLANE_COUNT = 3;
+    static const int ALL_PLANES = 0x7;                   // Mask with every plane set
+    
+    OrthogonalSlicer();
+    ~OrthogonalSlicer();
+    
+    // Volume setup - shared with the caller, not copied
+    void setVolume(vtkImageData *volume);                // Null releases the reference
+    vtkImageData *volume() const;                        // Current volume, or null
+    void setBricks(std::shared_ptr<BrickedVolume> bricks); // Bricked copy to read from, null for the volume itself
+    bool usesBricks() const;                             // Whether the bricks belong to the current volume
+    
+    // Extraction
+    bool extract(const int cursor[3], int planeMask = ALL_PLANES); // Refill the masked planes through cursor (structured indices)
+    vtkImageData *plane(int plane) const;                // 2D image of the last extraction, null before the first
+    double lastExtractSeconds() const;                   // Wall-clock time of the last extract()
+    double measurePlaneLatency(int plane, int samples);  // Mean milliseconds per plane over positions along its normal
+    
+    // Plane geometry
+    static int normalAxis(int plane);                    // Volume axis the plane cuts across
+    static int columnAxis(int plane);                    // Volume axis along the image columns
+    static int rowAxis(int plane);                       // Volume axis along the image rows
+
+private:
+    vtkSmartPointer<vtkImageData> m_volume;              // Shared volume
+    std::shared_ptr<BrickedVolume> m_bricks;             // Bricked copy, used only while it matches m_volume
+    vtkSmartPointer<vtkImageData> m_planes[PLANE_COUNT]; // Reused plane images
+    double m_lastExtractSeconds;                         // Time of the last extraction
+    
+    // Private helper methods
+    void preparePlane(int plane);                        // Match a plane image to the volume's geometry and type
+};
+
+#endif // ORTHOGONALSLICER_H
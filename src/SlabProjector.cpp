@@ -0,0 +1,647 @@
+#include "SlabProjector.h"
+#include "OrthogonalSlicer.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSetGet.h>
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const vtkIdType ROWS_PER_TASK = 8;                // Output rows per parallel task
+const vtkIdType ELEMENTS_PER_TASK = 1 << 16;      // Plane elements per parallel task when combining
+const size_t PARTIAL_BUDGET = 256u * 1024 * 1024; // Bytes of suffix and prefix partials before reducing directly
+
+/**
+ * Where the slices of one orientation sit in the scalar array
+ */
+struct SliceLayout {
+    vtkIdType sliceStride;                        // Elements between neighbouring slices
+    vtkIdType columnStride;                       // Elements between neighbouring columns
+    vtkIdType rowStride;                          // Elements between neighbouring rows
+    int width;                                    // Columns of the projection
+    int height;                                   // Rows of the projection
+    int components;                               // Scalar components per voxel
+};
+
+SliceLayout sliceLayout(vtkImageData *volume, int plane)
+{
+    int dims[3];
+    volume->GetDimensions(dims);
+    const int components = volume->GetPointData()->GetScalars()->GetNumberOfComponents();
+    const vtkIdType strides[3] = {
+        components,
+        static_cast<vtkIdType>(dims[0]) * components,
+        static_cast<vtkIdType>(dims[0]) * dims[1] * components
+    };
+    
+    SliceLayout layout;
+    layout.sliceStride = strides[OrthogonalSlicer::normalAxis(plane)];
+    layout.columnStride = strides[OrthogonalSlicer::columnAxis(plane)];
+    layout.rowStride = strides[OrthogonalSlicer::rowAxis(plane)];
+    layout.width = dims[OrthogonalSlicer::columnAxis(plane)];
+    layout.height = dims[OrthogonalSlicer::rowAxis(plane)];
+    layout.components = components;
+    return layout;
+}
+
+vtkIdType planeElements(const SliceLayout &layout)
+{
+    return static_cast<vtkIdType>(layout.width) * layout.height * layout.components;
+}
+
+struct MaximumOp {
+    template <typename T>
+    T operator()(T a, T b) const { return a < b ? b : a; }
+};
+
+struct MinimumOp {
+    template <typename T>
+    T operator()(T a, T b) const { return b < a ? b : a; }
+};
+
+template <typename T>
+inline T toScalar(double value)
+{
+    if (std::numeric_limits<T>::is_integer) {
+        return static_cast<T>(std::floor(value + 0.5));
+    }
+    return static_cast<T>(value);
+}
+
+/**
+ * Reduces slices [first, last] into dst, folding in previous if given
+ * 
+ * Rows run in parallel. When the slab's slices are neighbours in memory
+ * (sagittal) each output voxel reads its run of the slab in one go;
+ * otherwise whole slice rows are folded into the output row, which for
+ * contiguous rows is a plain element-wise loop the compiler vectorises.
+ */
+template <typename T, typename Op>
+void reduceRows(const T *volume, const SliceLayout &layout, int first, int last, const T *previous, T *dst, Op op)
+{
+    const vtkIdType rowElements = static_cast<vtkIdType>(layout.width) * layout.components;
+    const bool contiguous = layout.columnStride == layout.components;
+    const bool slicesAdjacent = layout.sliceStride < layout.columnStride;
+    
+    vtkSMPTools::For(0, layout.height, ROWS_PER_TASK, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType row = begin; row < end; ++row) {
+            const T *src = volume + row * layout.rowStride;
+            const T *prev = previous ? previous + row * rowElements : nullptr;
+            T *out = dst + row * rowElements;
+            
+            if (slicesAdjacent) {
+                for (int column = 0; column < layout.width; ++column) {
+                    for (int c = 0; c < layout.components; ++c) {
+                        const T *voxel = src + column * layout.columnStride + c;
+                        const vtkIdType index = static_cast<vtkIdType>(column) * layout.components + c;
+                        T value = voxel[first * layout.sliceStride];
+                        for (int slice = first + 1; slice <= last; ++slice) {
+                            value = op(value, voxel[slice * layout.sliceStride]);
+                        }
+                        out[index] = prev ? op(prev[index], value) : value;
+                    }
+                }
+                continue;
+            }
+            
+            for (int slice = first; slice <= last; ++slice) {
+                const T *in = src + slice * layout.sliceStride;
+                const T *accumulated = slice == first ? prev : out;
+                if (contiguous) {
+                    if (!accumulated) {
+                        std::copy(in, in + rowElements, out);
+                        continue;
+                    }
+                    for (vtkIdType i = 0; i < rowElements; ++i) {
+                        out[i] = op(accumulated[i], in[i]);
+                    }
+                    continue;
+                }
+                for (int column = 0; column < layout.width; ++column) {
+                    for (int c = 0; c < layout.components; ++c) {
+                        const vtkIdType index = static_cast<vtkIdType>(column) * layout.components + c;
+                        const T value = in[column * layout.columnStride + c];
+                        out[index] = accumulated ? op(accumulated[index], value) : value;
+                    }
+                }
+            }
+        }
+    });
+}
+
+/**
+ * Adds weight times one voxel to its sum
+ * 
+ * NaN and infinity would stay in a running sum for good (Inf - Inf is
+ * NaN), so floating-point types count them per element instead: NaN,
+ * +Inf and -Inf in counts[0..2], moved by the sign of the weight.
+ */
+template <typename T>
+inline void addValue(T value, double weight, double &sum, int *counts)
+{
+    if (!std::numeric_limits<T>::is_integer && !std::isfinite(static_cast<double>(value))) {
+        const int kind = value != value ? 0 : (value > 0 ? 1 : 2);
+        counts[kind] += weight > 0.0 ? 1 : -1;
+        return;
+    }
+    sum += weight * value;
+}
+
+/**
+ * Adds weight (+1 or -1) times every voxel of slices [first, last] to
+ * the sums; counts holds three per element for floating-point types
+ */
+template <typename T>
+void accumulateRows(const T *volume, const SliceLayout &layout, int first, int last, double weight, double *sums,
+                    int *counts)
+{
+    const vtkIdType rowElements = static_cast<vtkIdType>(layout.width) * layout.components;
+    const bool contiguous = layout.columnStride == layout.components;
+    const bool slicesAdjacent = layout.sliceStride < layout.columnStride;
+    
+    vtkSMPTools::For(0, layout.height, ROWS_PER_TASK, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType row = begin; row < end; ++row) {
+            const T *src = volume + row * layout.rowStride;
+            double *out = sums + row * rowElements;
+            int *outCounts = counts ? counts + 3 * row * rowElements : nullptr;
+            
+            if (slicesAdjacent) {
+                for (int column = 0; column < layout.width; ++column) {
+                    for (int c = 0; c < layout.components; ++c) {
+                        const T *voxel = src + column * layout.columnStride + c;
+                        const vtkIdType index = static_cast<vtkIdType>(column) * layout.components + c;
+                        double total = 0.0;
+                        for (int slice = first; slice <= last; ++slice) {
+                            addValue(voxel[slice * layout.sliceStride], weight, total,
+                                     outCounts ? outCounts + 3 * index : nullptr);
+                        }
+                        out[index] += total;
+                    }
+                }
+                continue;
+            }
+            
+            for (int slice = first; slice <= last; ++slice) {
+                const T *in = src + slice * layout.sliceStride;
+                if (contiguous && !outCounts) {
+                    for (vtkIdType i = 0; i < rowElements; ++i) {
+                        out[i] += weight * in[i];
+                    }
+                    continue;
+                }
+                if (contiguous) {
+                    for (vtkIdType i = 0; i < rowElements; ++i) {
+                        addValue(in[i], weight, out[i], outCounts + 3 * i);
+                    }
+                    continue;
+                }
+                for (int column = 0; column < layout.width; ++column) {
+                    for (int c = 0; c < layout.components; ++c) {
+                        const vtkIdType index = static_cast<vtkIdType>(column) * layout.components + c;
+                        addValue(in[column * layout.columnStride + c], weight, out[index],
+                                 outCounts ? outCounts + 3 * index : nullptr);
+                    }
+                }
+            }
+        }
+    });
+}
+
+template <typename T, typename Op>
+void combineElements(const T *a, const T *b, T *dst, vtkIdType count, Op op)
+{
+    vtkSMPTools::For(0, count, ELEMENTS_PER_TASK, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i) {
+            dst[i] = op(a[i], b[i]);
+        }
+    });
+}
+
+/**
+ * Divides the sums into dst; an element with non-finite values in its
+ * slab gets what summing them would have given
+ */
+template <typename T>
+void storeMean(const double *sums, const int *counts, vtkIdType count, double scale, T *dst)
+{
+    vtkSMPTools::For(0, count, ELEMENTS_PER_TASK, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i) {
+            const int *kinds = counts ? counts + 3 * i : nullptr;
+            if (kinds && (kinds[0] > 0 || (kinds[1] > 0 && kinds[2] > 0))) {
+                dst[i] = toScalar<T>(std::numeric_limits<double>::quiet_NaN());
+            } else if (kinds && kinds[1] > 0) {
+                dst[i] = toScalar<T>(std::numeric_limits<double>::infinity());
+            } else if (kinds && kinds[2] > 0) {
+                dst[i] = toScalar<T>(-std::numeric_limits<double>::infinity());
+            } else {
+                dst[i] = toScalar<T>(sums[i] * scale);
+            }
+        }
+    });
+}
+
+// Scalar type dispatch of the kernels; false for types VTK's template macro does not cover
+
+bool reduceSlices(int dataType, const void *volume, const SliceLayout &layout, int first, int last,
+                  const void *previous, void *dst, bool maximum)
+{
+    switch (dataType) {
+        vtkTemplateMacro(maximum ? reduceRows(static_cast<const VTK_TT *>(volume), layout, first, last,
+                                              static_cast<const VTK_TT *>(previous), static_cast<VTK_TT *>(dst),
+                                              MaximumOp())
+                                 : reduceRows(static_cast<const VTK_TT *>(volume), layout, first, last,
+                                              static_cast<const VTK_TT *>(previous), static_cast<VTK_TT *>(dst),
+                                              MinimumOp()));
+        default:
+            return false;
+    }
+    return true;
+}
+
+bool accumulateSlices(int dataType, const void *volume, const SliceLayout &layout, int first, int last,
+                      double weight, double *sums, int *counts)
+{
+    switch (dataType) {
+        vtkTemplateMacro(accumulateRows(static_cast<const VTK_TT *>(volume), layout, first, last, weight, sums,
+                                        counts));
+        default:
+            return false;
+    }
+    return true;
+}
+
+bool combinePlanes(int dataType, const void *a, const void *b, void *dst, vtkIdType count, bool maximum)
+{
+    switch (dataType) {
+        vtkTemplateMacro(maximum ? combineElements(static_cast<const VTK_TT *>(a), static_cast<const VTK_TT *>(b),
+                                                   static_cast<VTK_TT *>(dst), count, MaximumOp())
+                                 : combineElements(static_cast<const VTK_TT *>(a), static_cast<const VTK_TT *>(b),
+                                                   static_cast<VTK_TT *>(dst), count, MinimumOp()));
+        default:
+            return false;
+    }
+    return true;
+}
+
+bool storeMeans(int dataType, const double *sums, const int *counts, vtkIdType count, double scale, void *dst)
+{
+    switch (dataType) {
+        vtkTemplateMacro(storeMean(sums, counts, count, scale, static_cast<VTK_TT *>(dst)));
+        default:
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+SlabProjector::SlabProjector()
+    : m_projection(MAXIMUM_PROJECTION)
+    , m_thickness(1)
+    , m_lastProjectSeconds(0.0)
+    , m_lastSlicesRead(0)
+    , m_plane(-1)
+    , m_blockLength(1)
+    , m_sumFirst(0)
+    , m_sumLast(-1)
+    , m_suffixBlock(-1)
+    , m_prefixBlock(-1)
+    , m_suffixLowest(0)
+    , m_prefixHighest(0)
+{
+}
+
+SlabProjector::~SlabProjector() = default;
+
+void SlabProjector::setVolume(vtkImageData *volume)
+{
+    if (volume != m_volume.GetPointer()) {
+        clearPartials();
+    }
+    m_volume = volume;
+    if (!volume) {
+        m_output = nullptr;
+    }
+}
+
+vtkImageData *SlabProjector::volume() const
+{
+    return m_volume;
+}
+
+void SlabProjector::setProjection(Projection projection)
+{
+    if (projection != m_projection) {
+        m_projection = projection;
+        clearPartials();
+    }
+}
+
+SlabProjector::Projection SlabProjector::projection() const
+{
+    return m_projection;
+}
+
+void SlabProjector::setThickness(int slices)
+{
+    slices = std::max(1, slices);
+    if (slices != m_thickness) {
+        m_thickness = slices;
+        clearPartials();
+    }
+}
+
+int SlabProjector::thickness() const
+{
+    return m_thickness;
+}
+
+/**
+ * Projects the slab of plane centred on centreSlice
+ * 
+ * The slab is shifted rather than cut short at the ends of the axis, so
+ * every projection covers the same number of slices; a slab thicker
+ * than the volume covers all of it. Partial results are reused while the
+ * plane, projection and thickness stay the same.
+ */
+vtkImageData *SlabProjector::project(int plane, int centreSlice)
+{
+    if (!m_volume || plane < 0 || plane >= OrthogonalSlicer::PLANE_COUNT || !m_volume->GetPointData() ||
+        !m_volume->GetPointData()->GetScalars()) {
+        return nullptr;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    if (plane != m_plane) {
+        clearPartials();
+        m_plane = plane;
+    }
+    
+    int dims[3];
+    int extent[6];
+    m_volume->GetDimensions(dims);
+    m_volume->GetExtent(extent);
+    const int axis = OrthogonalSlicer::normalAxis(plane);
+    const int count = dims[axis];
+    const int thickness = std::min(m_thickness, count);
+    const int centre = std::max(0, std::min(count - 1, centreSlice - extent[2 * axis]));
+    const int first = std::max(0, std::min(count - thickness, centre - (thickness - 1) / 2));
+    const int last = first + thickness - 1;
+    
+    m_blockLength = thickness;
+    
+    prepareOutput(plane);
+    m_lastSlicesRead = 0;
+    bool projected = m_projection == MEAN_PROJECTION ? projectMean(plane, first, last)
+                                                     : projectExtreme(plane, first, last);
+    if (!projected) {
+        clearPartials();
+        return nullptr;
+    }
+    
+    m_output->Modified();
+    m_lastProjectSeconds = timer.nsecsElapsed() / 1.0e9;
+    return m_output;
+}
+
+vtkImageData *SlabProjector::output() const
+{
+    return m_output;
+}
+
+double SlabProjector::lastProjectSeconds() const
+{
+    return m_lastProjectSeconds;
+}
+
+int SlabProjector::lastSlicesRead() const
+{
+    return m_lastSlicesRead;
+}
+
+/**
+ * Reallocates the output only when the plane's shape or the type changed
+ */
+void SlabProjector::prepareOutput(int plane)
+{
+    int dims[3];
+    double spacing[3];
+    m_volume->GetDimensions(dims);
+    m_volume->GetSpacing(spacing);
+    vtkDataArray *scalars = m_volume->GetPointData()->GetScalars();
+    
+    const int width = dims[OrthogonalSlicer::columnAxis(plane)];
+    const int height = dims[OrthogonalSlicer::rowAxis(plane)];
+    
+    if (!m_output) {
+        m_output = vtkSmartPointer<vtkImageData>::New();
+    }
+    int *current = m_output->GetDimensions();
+    vtkDataArray *currentScalars = m_output->GetPointData()->GetScalars();
+    if (current[0] != width || current[1] != height || !currentScalars ||
+        currentScalars->GetDataType() != scalars->GetDataType() ||
+        currentScalars->GetNumberOfComponents() != scalars->GetNumberOfComponents()) {
+        m_output->SetDimensions(width, height, 1);
+        m_output->AllocateScalars(scalars->GetDataType(), scalars->GetNumberOfComponents());
+    }
+    m_output->SetSpacing(spacing[OrthogonalSlicer::columnAxis(plane)], spacing[OrthogonalSlicer::rowAxis(plane)], 1.0);
+    m_output->SetOrigin(0.0, 0.0, 0.0);
+}
+
+void SlabProjector::clearPartials()
+{
+    m_plane = -1;
+    std::vector<double>().swap(m_sums);
+    std::vector<int>().swap(m_nonFinite);
+    m_sumFirst = 0;
+    m_sumLast = -1;
+    std::vector<unsigned char>().swap(m_suffixes);
+    std::vector<unsigned char>().swap(m_prefixes);
+    m_suffixBlock = -1;
+    m_prefixBlock = -1;
+}
+
+/**
+ * Mean of slices [first, last] from running sums
+ * 
+ * When the new slab overlaps the summed one and sliding costs fewer
+ * slice reads than starting over, only the slices that left are
+ * subtracted and those that entered are added. For floating-point
+ * volumes NaN and infinity are counted beside the sums rather than
+ * added to them, so they leave the slab with their slice.
+ */
+bool SlabProjector::projectMean(int plane, int first, int last)
+{
+    const SliceLayout layout = sliceLayout(m_volume, plane);
+    const vtkIdType elements = planeElements(layout);
+    vtkDataArray *scalars = m_volume->GetPointData()->GetScalars();
+    const int dataType = scalars->GetDataType();
+    const void *volume = scalars->GetVoidPointer(0);
+    const bool floating = dataType == VTK_FLOAT || dataType == VTK_DOUBLE;
+    
+    if (static_cast<vtkIdType>(m_sums.size()) != elements ||
+        m_nonFinite.size() != (floating ? 3 * static_cast<size_t>(elements) : 0)) {
+        m_sums.assign(elements, 0.0);
+        m_nonFinite.assign(floating ? 3 * static_cast<size_t>(elements) : 0, 0);
+        m_sumFirst = 0;
+        m_sumLast = -1;
+    }
+    int *counts = floating ? m_nonFinite.data() : nullptr;
+    
+    const int slices = last - first + 1;
+    const int kept = std::max(0, std::min(last, m_sumLast) - std::max(first, m_sumFirst) + 1);
+    const int changed = (slices - kept) + (m_sumLast - m_sumFirst + 1 - kept);
+    bool ok = true;
+    if (kept == 0 || changed >= slices) {
+        std::fill(m_sums.begin(), m_sums.end(), 0.0);
+        std::fill(m_nonFinite.begin(), m_nonFinite.end(), 0);
+        ok = accumulateSlices(dataType, volume, layout, first, last, 1.0, m_sums.data(), counts);
+        m_lastSlicesRead = slices;
+    } else {
+        // The slices that left and entered form at most one run at each end
+        if (m_sumFirst < first) {
+            ok = ok && accumulateSlices(dataType, volume, layout, m_sumFirst, first - 1, -1.0, m_sums.data(),
+                                        counts);
+        }
+        if (last < m_sumLast) {
+            ok = ok && accumulateSlices(dataType, volume, layout, last + 1, m_sumLast, -1.0, m_sums.data(),
+                                        counts);
+        }
+        if (first < m_sumFirst) {
+            ok = ok && accumulateSlices(dataType, volume, layout, first, m_sumFirst - 1, 1.0, m_sums.data(),
+                                        counts);
+        }
+        if (m_sumLast < last) {
+            ok = ok && accumulateSlices(dataType, volume, layout, m_sumLast + 1, last, 1.0, m_sums.data(),
+                                        counts);
+        }
+        m_lastSlicesRead = changed;
+    }
+    if (!ok) {
+        return false;
+    }
+    m_sumFirst = first;
+    m_sumLast = last;
+    
+    return storeMeans(dataType, m_sums.data(), counts, elements, 1.0 / slices, m_output->GetScalarPointer());
+}
+
+/**
+ * Maximum or minimum of slices [first, last] from block partials
+ * 
+ * Blocks are as long as the slab and start at slice 0, so a slab
+ * either is one block, the suffix of its first slice, or crosses into
+ * the next block, the suffix of its first slice combined with the
+ * prefix of its last. Thick slabs of large planes whose partials would
+ * not fit PARTIAL_BUDGET are reduced directly instead.
+ */
+bool SlabProjector::projectExtreme(int plane, int first, int last)
+{
+    const SliceLayout layout = sliceLayout(m_volume, plane);
+    const vtkIdType elements = planeElements(layout);
+    vtkDataArray *scalars = m_volume->GetPointData()->GetScalars();
+    const int dataType = scalars->GetDataType();
+    const bool maximum = m_projection == MAXIMUM_PROJECTION;
+    void *destination = m_output->GetScalarPointer();
+    
+    const size_t planeBytes = static_cast<size_t>(elements) * m_volume->GetScalarSize();
+    if (2 * static_cast<size_t>(m_blockLength) * planeBytes > PARTIAL_BUDGET) {
+        m_lastSlicesRead = last - first + 1;
+        return reduceSlices(dataType, scalars->GetVoidPointer(0), layout, first, last, nullptr, destination,
+                            maximum);
+    }
+    
+    const void *head = suffix(plane, first);
+    if (!head) {
+        return false;
+    }
+    if (first / m_blockLength == last / m_blockLength) {
+        std::memcpy(destination, head, planeBytes);
+        return true;
+    }
+    const void *tail = prefix(plane, last);
+    if (!tail) {
+        return false;
+    }
+    return combinePlanes(dataType, head, tail, destination, elements, maximum);
+}
+
+/**
+ * Reduction from slice to the end of its block
+ * 
+ * Built downwards from the block end, one slice per step, so a slab
+ * sliding back costs one slice read and a slab sliding forward none.
+ */
+const void *SlabProjector::suffix(int plane, int slice)
+{
+    const SliceLayout layout = sliceLayout(m_volume, plane);
+    const size_t planeBytes = static_cast<size_t>(planeElements(layout)) * m_volume->GetScalarSize();
+    vtkDataArray *scalars = m_volume->GetPointData()->GetScalars();
+    const int count = m_volume->GetDimensions()[OrthogonalSlicer::normalAxis(plane)];
+    const int block = slice / m_blockLength;
+    const int blockStart = block * m_blockLength;
+    const int blockEnd = std::min(count - 1, blockStart + m_blockLength - 1);
+    
+    if (block != m_suffixBlock) {
+        m_suffixes.resize(static_cast<size_t>(m_blockLength) * planeBytes);
+        m_suffixBlock = block;
+        m_suffixLowest = blockEnd + 1;
+    }
+    while (m_suffixLowest > slice) {
+        const int next = m_suffixLowest - 1;
+        unsigned char *out = m_suffixes.data() + (next - blockStart) * planeBytes;
+        const unsigned char *previous = next < blockEnd ? out + planeBytes : nullptr;
+        if (!reduceSlices(scalars->GetDataType(), scalars->GetVoidPointer(0), layout, next, next, previous, out,
+                          m_projection == MAXIMUM_PROJECTION)) {
+            return nullptr;
+        }
+        ++m_lastSlicesRead;
+        m_suffixLowest = next;
+    }
+    return m_suffixes.data() + (slice - blockStart) * planeBytes;
+}
+
+/**
+ * Reduction from the start of slice's block to slice
+ * 
+ * Built upwards from the block start, one slice per step, so a slab
+ * sliding forward costs one slice read and a slab sliding back none.
+ */
+const void *SlabProjector::prefix(int plane, int slice)
+{
+    const SliceLayout layout = sliceLayout(m_volume, plane);
+    const size_t planeBytes = static_cast<size_t>(planeElements(layout)) * m_volume->GetScalarSize();
+    vtkDataArray *scalars = m_volume->GetPointData()->GetScalars();
+    const int block = slice / m_blockLength;
+    const int blockStart = block * m_blockLength;
+    
+    if (block != m_prefixBlock) {
+        m_prefixes.resize(static_cast<size_t>(m_blockLength) * planeBytes);
+        m_prefixBlock = block;
+        m_prefixHighest = blockStart - 1;
+    }
+    while (m_prefixHighest < slice) {
+        const int next = m_prefixHighest + 1;
+        unsigned char *out = m_prefixes.data() + (next - blockStart) * planeBytes;
+        const unsigned char *previous = next > blockStart ? out - planeBytes : nullptr;
+        if (!reduceSlices(scalars->GetDataType(), scalars->GetVoidPointer(0), layout, next, next, previous, out,
+                          m_projection == MAXIMUM_PROJECTION)) {
+            return nullptr;
+        }
+        ++m_lastSlicesRead;
+        m_prefixHighest = next;
+    }
+    return m_prefixes.data() + (slice - blockStart) * planeBytes;
+}
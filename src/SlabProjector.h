@@ -0,0 +1,90 @@
+#ifndef SLABPROJECTOR_H
+#define SLABPROJECTOR_H
+
+// VTK smart pointer for the shared volume and the output image
+#include <vtkSmartPointer.h>
+
+// Standard library for the partial results
+#include <vector>
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * SlabProjector - Thick-slab intensity projections along an axis
+ * 
+ * Reduces a run of consecutive axial, sagittal or coronal slices to one
+ * 2D image holding their maximum, minimum or mean. The image has the
+ * same geometry, scalar type and components as OrthogonalSlicer's plane
+ * of that orientation, so it window/levels like the volume itself. The
+ * volume is shared, never copied; slices are read in place.
+ * 
+ * A slab sliding one slice at a time is not reduced from scratch. The
+ * mean keeps per-pixel running sums and only adds the slices that enter
+ * and subtracts the ones that leave. Maximum and minimum split the axis
+ * into blocks as long as the slab (the van Herk/Gil-Werman scheme): any
+ * slab spans at most two neighbouring blocks, so it is the combination
+ * of a suffix of the first and a prefix of the second. Those partial
+ * results are built one slice at a time as the slab reaches them, so a
+ * step costs about two slice reads whatever the thickness.
+ */
+class SlabProjector
+{
+public:
+    enum Projection {
+        MAXIMUM_PROJECTION = 0, // Brightest voxel along the slab (MIP)
+        MINIMUM_PROJECTION = 1, // Darkest voxel along the slab (MinIP)
+        MEAN_PROJECTION = 2     // Average of the slab
+    };
+    
+    SlabProjector();
+    ~SlabProjector();
+    
+    // Volume setup - shared with the caller, not copied
+    void setVolume(vtkImageData *volume);                // Null releases the reference, the output and partial results
+    vtkImageData *volume() const;                        // Current volume, or null
+    
+    // Slab options - changing either drops the partial results
+    void setProjection(Projection projection);           // Reduction applied across the slab
+    Projection projection() const;                       // Current reduction
+    void setThickness(int slices);                       // Slices in a slab, at least one
+    int thickness() const;                               // Current thickness
+    
+    // Projection
+    vtkImageData *project(int plane, int centreSlice);   // Slab of an OrthogonalSlicer plane around a structured slice index, null on failure
+    vtkImageData *output() const;                        // Image of the last project(), null before the first
+    double lastProjectSeconds() const;                   // Wall-clock time of the last project()
+    int lastSlicesRead() const;                          // Volume slices the last project() had to read
+
+private:
+    vtkSmartPointer<vtkImageData> m_volume;              // Shared volume
+    vtkSmartPointer<vtkImageData> m_output;              // Reused projection image
+    Projection m_projection;                             // Reduction
+    int m_thickness;                                     // Slices per slab
+    double m_lastProjectSeconds;                         // Time of the last projection
+    int m_lastSlicesRead;                                // Slices read by the last projection
+    
+    // Partial results, valid for m_plane only
+    int m_plane;                                         // Plane the partial results belong to, -1 for none
+    int m_blockLength;                                   // Slices per block: the thickness, capped at the axis length
+    std::vector<double> m_sums;                          // Per-element sums over [m_sumFirst, m_sumLast] for the mean
+    std::vector<int> m_nonFinite;                        // NaN, +Inf and -Inf left out of each sum, float types only
+    int m_sumFirst;                                      // First slice in m_sums
+    int m_sumLast;                                       // Last slice in m_sums, below m_sumFirst when empty
+    std::vector<unsigned char> m_suffixes;               // Reduction from each slice of m_suffixBlock to its end
+    std::vector<unsigned char> m_prefixes;               // Reduction from the start of m_prefixBlock to each slice
+    int m_suffixBlock;                                   // Block of m_suffixes, -1 for none
+    int m_prefixBlock;                                   // Block of m_prefixes, -1 for none
+    int m_suffixLowest;                                  // Lowest slice with a valid suffix
+    int m_prefixHighest;                                 // Highest slice with a valid prefix
+    
+    // Private helper methods
+    void prepareOutput(int plane);                       // Match the output to the plane's geometry and the volume's type
+    void clearPartials();                                // Forget every partial result
+    bool projectMean(int plane, int first, int last);    // Slide or rebuild the running sums, then divide
+    bool projectExtreme(int plane, int first, int last); // Combine a block suffix and prefix, or reduce directly
+    const void *suffix(int plane, int slice);            // Suffix partial at slice, built down from the block end as needed
+    const void *prefix(int plane, int slice);            // Prefix partial at slice, built up from the block start as needed
+};
+
+#endif // SLABPROJECTOR_H
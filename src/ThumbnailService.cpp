@@ -0,0 +1,325 @@
+#include "ThumbnailService.h"
+#include "LazyVolumeSource.h"
+#include "NiftiHeaderScanner.h"
+#include "VoxelStream.h"
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkByteSwap.h>
+#include <vtkType.h>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const int BUFFER_SIZE = 1 << 20;                         // Inflated bytes per step while streaming
+const double LOW_PERCENTILE = 0.01;                      // Maps to black
+const double HIGH_PERCENTILE = 0.99;                     // Maps to white
+
+// Plane order of the strip, as LazyVolumeSource::Orientation
+const int PLANE_COUNT = 3;
+
+} // namespace
+
+/**
+ * Returns the cached strip when one exists for this exact file state,
+ * otherwise decodes the middle planes, renders and caches the strip
+ */
+ThumbnailService::Entry ThumbnailService::thumbnail(const QString &filePath, int tileSize,
+                                                    const QString &cacheDirectory)
+{
+    Entry entry;
+    entry.filePath = filePath;
+    
+    const QString cached = cacheDirectory.isEmpty() ? QString() : cachePath(filePath, tileSize, cacheDirectory);
+    if (!cached.isEmpty() && entry.image.load(cached, "PNG")) {
+        entry.cached = true;
+        return entry;
+    }
+    
+    NiftiHeader header;
+    vtkSmartPointer<vtkImageData> planes[PLANE_COUNT];
+    if (!extractPlanes(filePath, header, planes, entry.errorString)) {
+        return entry;
+    }
+    
+    int dims[3];
+    double spacing[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        dims[axis] = static_cast<int>(header.dim[axis + 1]);
+        spacing[axis] = header.pixdim[axis + 1] != 0.0 ? std::abs(header.pixdim[axis + 1]) : 1.0;
+    }
+    entry.image = renderStrip(planes, dims, spacing, tileSize);
+    
+    // QSaveFile renames on commit, so parallel readers never see a partial PNG
+    if (!cached.isEmpty() && QDir().mkpath(cacheDirectory)) {
+        QSaveFile file(cached);
+        if (file.open(QIODevice::WriteOnly) && entry.image.save(&file, "PNG")) {
+            file.commit();
+        } else {
+            file.cancelWriting();
+        }
+    }
+    return entry;
+}
+
+QString ThumbnailService::defaultCacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails";
+}
+
+/**
+ * Deletes strips, oldest first, until the directory fits maxBytes
+ */
+void ThumbnailService::trimCache(const QString &cacheDirectory, qint64 maxBytes)
+{
+    const QFileInfoList strips = QDir(cacheDirectory).entryInfoList({"*.png"}, QDir::Files, QDir::Time);
+    qint64 total = 0;
+    for (const QFileInfo &strip : strips) {
+        total += strip.size();
+        if (total > maxBytes) {
+            QFile::remove(strip.absoluteFilePath());
+        }
+    }
+}
+
+/**
+ * Names the cached strip of a source
+ * 
+ * As in DiskVolumeCache, the name hashes canonical path, modification time
+ * and size, so a changed file never maps to an old thumbnail.
+ */
+QString ThumbnailService::cachePath(const QString &filePath, int tileSize, const QString &cacheDirectory)
+{
+    QFileInfo info(filePath);
+    const QString canonicalPath = info.canonicalFilePath();
+    if (canonicalPath.isEmpty()) {
+        return QString();
+    }
+    
+    const QString key = QString("%1\n%2\n%3\n%4").arg(canonicalPath)
+                                                 .arg(info.lastModified().toMSecsSinceEpoch())
+                                                 .arg(info.size())
+                                                 .arg(tileSize);
+    const QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1);
+    return cacheDirectory + "/" + QString::fromLatin1(hash.toHex()) + ".png";
+}
+
+/**
+ * Fills planes with the middle axial, sagittal and coronal slice
+ * 
+ * Seekable files go through LazyVolumeSource, which decodes one slab per
+ * plane. Plain .nii.gz files cannot be entered in the middle and are
+ * streamed once instead.
+ */
+bool ThumbnailService::extractPlanes(const QString &filePath, NiftiHeader &header,
+                                     vtkSmartPointer<vtkImageData> planes[3], QString &errorString)
+{
+    LazyVolumeSource source(filePath);
+    if (source.open()) {
+        header = source.header();
+        for (int orientation = 0; orientation < PLANE_COUNT; ++orientation) {
+            planes[orientation] = source.slice(orientation, source.sliceCount(orientation) / 2);
+            if (!planes[orientation]) {
+                errorString = "Cannot decode the middle slices";
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    if (!filePath.endsWith(".gz", Qt::CaseInsensitive)) {
+        errorString = source.errorString();
+        return false;
+    }
+    
+    const NiftiHeaderScanner::Entry entry = NiftiHeaderScanner::scanFile(filePath);
+    if (!entry.errorString.isEmpty()) {
+        errorString = entry.errorString;
+        return false;
+    }
+    header = entry.header;
+    if (header.vtkScalarType() == VTK_VOID || header.bytesPerVolume() <= 0) {
+        errorString = "Unsupported NIfTI header";
+        return false;
+    }
+    return streamPlanes(filePath, header, planes, errorString);
+}
+
+/**
+ * Inflates a gzip file once and copies out only the three middle planes
+ * 
+ * Each inflated chunk is walked row by row: the middle z slice keeps
+ * whole rows, the middle y row of every slice feeds the coronal plane,
+ * and one voxel per row feeds the sagittal plane. Inflation stops at the
+ * end of the first volume.
+ */
+bool ThumbnailService::streamPlanes(const QString &filePath, const NiftiHeader &header,
+                                    vtkSmartPointer<vtkImageData> planes[3], QString &errorString)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorString = QString("Cannot open file: %1").arg(file.errorString());
+        return false;
+    }
+    
+    const qint64 nx = header.dim[1];
+    const qint64 ny = header.dim[2];
+    const qint64 nz = header.dim[3];
+    const qint64 voxelBytes = header.bytesPerVoxel();
+    const qint64 rowBytes = nx * voxelBytes;
+    const qint64 begin = header.voxOffset;
+    const qint64 end = begin + header.bytesPerVolume();
+    const qint64 middleX = nx / 2;
+    const qint64 middleY = ny / 2;
+    const qint64 middleZ = nz / 2;
+    
+    const int width[PLANE_COUNT] = { static_cast<int>(nx), static_cast<int>(ny), static_cast<int>(nx) };
+    const int height[PLANE_COUNT] = { static_cast<int>(ny), static_cast<int>(nz), static_cast<int>(nz) };
+    char *planeData[PLANE_COUNT];
+    for (int plane = 0; plane < PLANE_COUNT; ++plane) {
+        planes[plane] = vtkSmartPointer<vtkImageData>::New();
+        planes[plane]->SetDimensions(width[plane], height[plane], 1);
+        planes[plane]->AllocateScalars(header.vtkScalarType(), header.scalarComponents());
+        planeData[plane] = static_cast<char *>(planes[plane]->GetScalarPointer());
+    }
+    
+    VoxelStream stream(file, true);
+    if (!stream.open()) {
+        errorString = "Cannot initialize decompression";
+        return false;
+    }
+    
+    std::vector<char> output(BUFFER_SIZE);
+    qint64 position = 0;
+    bool failed = false;
+    
+    while (position < end) {
+        const qint64 chunk = stream.read(output.data(), std::min<qint64>(BUFFER_SIZE, end - position));
+        if (chunk <= 0) {
+            failed = true;  // Read error or truncated stream
+            break;
+        }
+        const qint64 from = std::max(position, begin);
+        const qint64 to = std::min(position + chunk, end);
+        
+        // Copies the part of [rangeStart, rangeEnd) inside this chunk to dst, which maps rangeStart
+        auto copyRange = [&](qint64 rangeStart, qint64 rangeEnd, char *dst) {
+            const qint64 a = std::max(from, rangeStart);
+            const qint64 b = std::min(to, rangeEnd);
+            if (a < b) {
+                std::memcpy(dst + (a - rangeStart), output.data() + (a - position), static_cast<size_t>(b - a));
+            }
+        };
+        
+        for (qint64 row = (from - begin) / rowBytes; from < to && begin + row * rowBytes < to; ++row) {
+            const qint64 rowStart = begin + row * rowBytes;
+            const qint64 y = row % ny;
+            const qint64 z = row / ny;
+            if (z == middleZ) {
+                copyRange(rowStart, rowStart + rowBytes, planeData[LazyVolumeSource::AXIAL] + y * rowBytes);
+            }
+            if (y == middleY) {
+                copyRange(rowStart, rowStart + rowBytes, planeData[LazyVolumeSource::CORONAL] + z * rowBytes);
+            }
+            copyRange(rowStart + middleX * voxelBytes, rowStart + (middleX + 1) * voxelBytes,
+                      planeData[LazyVolumeSource::SAGITTAL] + (z * ny + y) * voxelBytes);
+        }
+        position += chunk;
+    }
+    
+    if (failed) {
+        errorString = "File is truncated or corrupt";
+        return false;
+    }
+    
+    if (header.byteSwapped && header.bytesPerSwapUnit() > 1) {
+        const int unit = header.bytesPerSwapUnit();
+        for (int plane = 0; plane < PLANE_COUNT; ++plane) {
+            const size_t bytes = static_cast<size_t>(width[plane]) * height[plane] * voxelBytes;
+            vtkByteSwap::SwapVoidRange(planeData[plane], bytes / unit, static_cast<size_t>(unit));
+        }
+    }
+    return true;
+}
+
+/**
+ * Windows the planes to 8 bits and lays them out as square tiles
+ * 
+ * One window covers all three tiles, so they read as the same volume.
+ * VTK rows run bottom-up, so rows are flipped for QImage; the first
+ * component stands for multi-component voxels.
+ */
+QImage ThumbnailService::renderStrip(vtkSmartPointer<vtkImageData> planes[3], const int dims[3],
+                                     const double spacing[3], int tileSize)
+{
+    const int width[PLANE_COUNT] = { dims[0], dims[1], dims[0] };
+    const int height[PLANE_COUNT] = { dims[1], dims[2], dims[2] };
+    const double columnSpacing[PLANE_COUNT] = { spacing[0], spacing[1], spacing[0] };
+    const double rowSpacing[PLANE_COUNT] = { spacing[1], spacing[2], spacing[2] };
+    
+    // Percentiles of the finite values shown
+    std::vector<double> values;
+    for (int plane = 0; plane < PLANE_COUNT; ++plane) {
+        vtkDataArray *scalars = planes[plane]->GetPointData()->GetScalars();
+        const vtkIdType count = static_cast<vtkIdType>(width[plane]) * height[plane];
+        for (vtkIdType i = 0; i < count; ++i) {
+            const double value = scalars->GetComponent(i, 0);
+            if (std::isfinite(value)) {
+                values.push_back(value);
+            }
+        }
+    }
+    double low = 0.0;
+    double window = 1.0;
+    if (!values.empty()) {
+        const size_t lowIndex = static_cast<size_t>(LOW_PERCENTILE * (values.size() - 1));
+        const size_t highIndex = static_cast<size_t>(HIGH_PERCENTILE * (values.size() - 1));
+        std::nth_element(values.begin(), values.begin() + lowIndex, values.end());
+        low = values[lowIndex];
+        std::nth_element(values.begin() + lowIndex, values.begin() + highIndex, values.end());
+        window = std::max(values[highIndex] - low, 1e-6);
+    }
+    
+    QImage strip(PLANE_COUNT * tileSize, tileSize, QImage::Format_Grayscale8);
+    strip.fill(0);
+    for (int plane = 0; plane < PLANE_COUNT; ++plane) {
+        vtkDataArray *scalars = planes[plane]->GetPointData()->GetScalars();
+        QImage tile(width[plane], height[plane], QImage::Format_Grayscale8);
+        for (int y = 0; y < height[plane]; ++y) {
+            uchar *line = tile.scanLine(height[plane] - 1 - y);
+            for (int x = 0; x < width[plane]; ++x) {
+                const double value = scalars->GetComponent(static_cast<vtkIdType>(y) * width[plane] + x, 0);
+                const double grey = std::isfinite(value) ? (value - low) / window * 255.0 : 0.0;
+                line[x] = static_cast<uchar>(std::max(0.0, std::min(255.0, grey)));
+            }
+        }
+        
+        // Physical aspect, fitted into the tile and centred
+        const double physicalWidth = width[plane] * columnSpacing[plane];
+        const double physicalHeight = height[plane] * rowSpacing[plane];
+        const double scale = tileSize / std::max(physicalWidth, physicalHeight);
+        const int tileWidth = std::max(1, std::min(tileSize, static_cast<int>(std::lround(physicalWidth * scale))));
+        const int tileHeight = std::max(1, std::min(tileSize, static_cast<int>(std::lround(physicalHeight * scale))));
+        // Smooth scaling may widen the format, so bring it back before copying rows
+        tile = tile.scaled(tileWidth, tileHeight, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                   .convertToFormat(QImage::Format_Grayscale8);
+        
+        const int left = plane * tileSize + (tileSize - tileWidth) / 2;
+        const int top = (tileSize - tileHeight) / 2;
+        for (int y = 0; y < tileHeight; ++y) {
+            std::memcpy(strip.scanLine(top + y) + left, tile.constScanLine(y), static_cast<size_t>(tileWidth));
+        }
+    }
+    return strip;
+}
@@ -0,0 +1,63 @@
+#ifndef THUMBNAILSERVICE_H
+#define THUMBNAILSERVICE_H
+
+// Qt base classes for paths and the rendered strip
+#include <QString>
+#include <QImage>
+
+// VTK smart pointer for the extracted planes
+#include <vtkSmartPointer.h>
+
+#include "NiftiHeader.h"
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * ThumbnailService - Middle-slice previews of NIfTI files for the contact sheet
+ * 
+ * A thumbnail is a strip of three square tiles: the middle axial,
+ * sagittal and coronal slice of the first volume. Only those planes are
+ * ever decoded. Uncompressed and BGZF files are read through
+ * LazyVolumeSource, which touches just the slabs holding each plane;
+ * single-stream .nii.gz files are inflated once while the three planes
+ * are picked out of the stream, so no full volume is ever allocated.
+ * 
+ * Grey levels span the 1st to 99th percentile of the three planes, and
+ * each tile keeps the aspect of the voxel spacing.
+ * 
+ * Finished strips are kept as PNG files in a cache directory, named
+ * after the source path, modification time, size and tile size, so an
+ * unchanged folder reopens without touching any volume. trimCache()
+ * keeps the directory under a size cap, least recently used first.
+ * 
+ * All methods are static and thread-safe.
+ */
+class ThumbnailService
+{
+public:
+    /**
+     * Thumbnail of one file, or the reason it could not be made
+     */
+    struct Entry {
+        QString filePath;                                // Source volume
+        QImage image;                                    // Axial, sagittal and coronal tiles side by side
+        bool cached = false;                             // Read from the thumbnail cache
+        QString errorString;                             // Empty on success
+    };
+    
+    static Entry thumbnail(const QString &filePath, int tileSize, const QString &cacheDirectory); // Cached or rendered strip
+    static QString defaultCacheDirectory();              // Per-user cache location
+    static void trimCache(const QString &cacheDirectory, qint64 maxBytes); // Delete the oldest strips over the cap
+
+private:
+    static QString cachePath(const QString &filePath, int tileSize, const QString &cacheDirectory); // Empty if the source is missing
+    static bool extractPlanes(const QString &filePath, NiftiHeader &header,
+                              vtkSmartPointer<vtkImageData> planes[3], QString &errorString); // Middle planes by the cheapest route
+    static bool streamPlanes(const QString &filePath, const NiftiHeader &header,
+                             vtkSmartPointer<vtkImageData> planes[3], QString &errorString); // Pick planes out of a gzip stream
+    static QImage renderStrip(vtkSmartPointer<vtkImageData> planes[3], const int dims[3],
+                              const double spacing[3], int tileSize); // Window and tile
+};
+
+#endif // THUMBNAILSERVICE_H
@@ -0,0 +1,287 @@
+#include "TimeSeriesSource.h"
+
+#include <vtkImageData.h>
+#include <vtkByteSwap.h>
+#include <vtkType.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const qint64 SKIP_BUFFER_SIZE = 256 * 1024;   // Decompressed bytes discarded per inflate call
+const qint64 MAX_INPUT_SIZE = 1 << 30;        // Compressed bytes handed to zlib at once
+
+} // namespace
+
+TimeSeriesSource::TimeSeriesSource(const QString &filePath)
+    : m_filePath(filePath)
+    , m_file(filePath)
+    , m_fileData(nullptr)
+    , m_fileSize(0)
+    , m_accessMode(MappedAccess)
+    , m_streamInitialized(false)
+    , m_streamPosition(0)
+{
+    m_stream = z_stream();
+}
+
+TimeSeriesSource::~TimeSeriesSource()
+{
+    if (m_streamInitialized) {
+        inflateEnd(&m_stream);
+    }
+}
+
+bool TimeSeriesSource::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = QString("Cannot open file: %1").arg(m_file.errorString());
+        return false;
+    }
+    
+    m_fileSize = m_file.size();
+    m_fileData = m_file.map(0, m_fileSize);
+    if (!m_fileData) {
+        m_errorString = "Cannot map file";
+        return false;
+    }
+    
+    // BGZF allows jumping to any frame; other gzip files are inflated front to back
+    qint64 available = m_fileSize;
+    if (m_filePath.toLower().endsWith(".gz")) {
+        if (m_blockIndex.open(m_filePath, m_fileData, m_fileSize)) {
+            m_accessMode = BlockAccess;
+            available = m_blockIndex.uncompressedSize();
+        } else {
+            m_accessMode = StreamAccess;
+            available = -1;  // Unknown until the stream has been inflated
+            if (!rewindStream()) {
+                return false;
+            }
+        }
+    }
+    
+    // The NIfTI-2 tail is optional: a small NIfTI-1 file may end before 540 bytes
+    std::vector<char> headerBlock(NiftiHeader::NIFTI2_HEADER_SIZE, 0);
+    qint64 headerBytes = NiftiHeader::NIFTI1_HEADER_SIZE;
+    if (!readRange(0, headerBytes, headerBlock.data())) {
+        return false;
+    }
+    const qint64 tailBytes = NiftiHeader::NIFTI2_HEADER_SIZE - NiftiHeader::NIFTI1_HEADER_SIZE;
+    if ((available < 0 || available >= NiftiHeader::NIFTI2_HEADER_SIZE) &&
+        readRange(headerBytes, tailBytes, headerBlock.data() + headerBytes)) {
+        headerBytes += tailBytes;
+    }
+    
+    if (!m_header.parse(reinterpret_cast<const unsigned char *>(headerBlock.data()),
+                        static_cast<size_t>(headerBytes)) ||
+        m_header.vtkScalarType() == VTK_VOID || m_header.dim[5] != 1) {
+        m_errorString = "Unsupported NIfTI header";
+        return false;
+    }
+    
+    // A truncated plain gzip file is only detected when the missing frame is decoded
+    if (available >= 0 && available < m_header.voxOffset + frameBytes() * frameCount()) {
+        m_errorString = "File is truncated";
+        return false;
+    }
+    return true;
+}
+
+QString TimeSeriesSource::errorString() const
+{
+    return m_errorString;
+}
+
+const NiftiHeader &TimeSeriesSource::header() const
+{
+    return m_header;
+}
+
+QString TimeSeriesSource::filePath() const
+{
+    return m_filePath;
+}
+
+int TimeSeriesSource::frameCount() const
+{
+    return static_cast<int>(m_header.volumeCount());
+}
+
+qint64 TimeSeriesSource::frameBytes() const
+{
+    return m_header.bytesPerVolume();
+}
+
+double TimeSeriesSource::frameInterval() const
+{
+    return m_header.timeStepSeconds();
+}
+
+/**
+ * Decodes one 3D volume of the series
+ * 
+ * The geometry matches what NiftiVolumeReader produces for the first
+ * volume, so frames can replace each other in the viewer unchanged.
+ */
+vtkSmartPointer<vtkImageData> TimeSeriesSource::readFrame(int frame)
+{
+    if (frame < 0 || frame >= frameCount()) {
+        m_errorString = QString("Frame %1 out of range").arg(frame);
+        return nullptr;
+    }
+    
+    vtkSmartPointer<vtkImageData> imageData = vtkSmartPointer<vtkImageData>::New();
+    imageData->SetDimensions(static_cast<int>(m_header.dim[1]),
+                             static_cast<int>(m_header.dim[2]),
+                             static_cast<int>(m_header.dim[3]));
+    double spacing[3];
+    for (int i = 0; i < 3; ++i) {
+        spacing[i] = m_header.pixdim[i + 1] != 0.0 ? std::abs(m_header.pixdim[i + 1]) : 1.0;
+    }
+    imageData->SetSpacing(spacing);
+    imageData->SetOrigin(0.0, 0.0, 0.0);
+    imageData->AllocateScalars(m_header.vtkScalarType(), m_header.scalarComponents());
+    
+    const qint64 total = frameBytes();
+    char *dst = static_cast<char *>(imageData->GetScalarPointer());
+    if (!readRange(m_header.voxOffset + frame * total, total, dst)) {
+        return nullptr;
+    }
+    
+    if (m_header.byteSwapped && m_header.bytesPerSwapUnit() > 1) {
+        const int unit = m_header.bytesPerSwapUnit();
+        vtkByteSwap::SwapVoidRange(dst, static_cast<size_t>(total / unit), static_cast<size_t>(unit));
+    }
+    
+    return imageData;
+}
+
+bool TimeSeriesSource::readRange(qint64 position, qint64 length, char *dst)
+{
+    switch (m_accessMode) {
+        case BlockAccess:
+            return readBlocks(position, length, dst);
+        case StreamAccess:
+            return readStream(position, length, dst);
+        default:
+            if (position + length > m_fileSize) {
+                m_errorString = "File is truncated";
+                return false;
+            }
+            std::memcpy(dst, m_fileData + position, static_cast<size_t>(length));
+            return true;
+    }
+}
+
+bool TimeSeriesSource::readBlocks(qint64 position, qint64 length, char *dst)
+{
+    while (length > 0) {
+        const int index = m_blockIndex.findBlock(position);
+        if (index < 0) {
+            m_errorString = "File is truncated";
+            return false;
+        }
+        
+        const GzipBlock &block = m_blockIndex.block(index);
+        const qint64 inBlock = position - block.uncompressedOffset;
+        const qint64 count = std::min(length, block.uncompressedSize - inBlock);
+        
+        // Whole members inflate in place; only the ones at the frame edges need a copy
+        bool ok;
+        if (inBlock == 0 && count == block.uncompressedSize) {
+            ok = m_blockInflater.decode(m_fileData, block, dst);
+        } else {
+            m_blockBuffer.resize(static_cast<size_t>(block.uncompressedSize));
+            ok = m_blockInflater.decode(m_fileData, block, m_blockBuffer.data());
+            if (ok) {
+                std::memcpy(dst, m_blockBuffer.data() + inBlock, static_cast<size_t>(count));
+            }
+        }
+        if (!ok) {
+            m_errorString = "Corrupt BGZF block";
+            return false;
+        }
+        
+        dst += count;
+        position += count;
+        length -= count;
+    }
+    return true;
+}
+
+/**
+ * Inflates the range from the persistent stream
+ * 
+ * Forward reads continue where the previous one stopped, so a forward
+ * sweep through the series inflates every byte once. A read behind the
+ * current position starts over from the beginning of the file.
+ */
+bool TimeSeriesSource::readStream(qint64 position, qint64 length, char *dst)
+{
+    if (position < m_streamPosition && !rewindStream()) {
+        return false;
+    }
+    
+    // Gzip members are concatenated; zlib stops at the end of each one
+    auto inflateInto = [this](char *out, qint64 size) -> bool {
+        qint64 produced = 0;
+        while (produced < size) {
+            if (m_stream.avail_in == 0) {
+                const qint64 consumed = reinterpret_cast<const uchar *>(m_stream.next_in) - m_fileData;
+                if (consumed >= m_fileSize) {
+                    m_errorString = "File is truncated";
+                    return false;
+                }
+                m_stream.avail_in = static_cast<uInt>(std::min(m_fileSize - consumed, MAX_INPUT_SIZE));
+            }
+            
+            const qint64 request = std::min<qint64>(size - produced, MAX_INPUT_SIZE);
+            m_stream.next_out = reinterpret_cast<Bytef *>(out + produced);
+            m_stream.avail_out = static_cast<uInt>(request);
+            
+            int code = inflate(&m_stream, Z_NO_FLUSH);
+            const qint64 n = request - m_stream.avail_out;
+            produced += n;
+            m_streamPosition += n;
+            
+            if (code == Z_STREAM_END) {
+                inflateReset(&m_stream);
+            } else if ((code != Z_OK && code != Z_BUF_ERROR) ||
+                       (code == Z_BUF_ERROR && n == 0 && m_stream.avail_in > 0)) {
+                m_errorString = "Corrupt gzip stream";
+                return false;
+            }
+        }
+        return true;
+    };
+    
+    m_skipBuffer.resize(static_cast<size_t>(SKIP_BUFFER_SIZE));
+    while (m_streamPosition < position) {
+        if (!inflateInto(m_skipBuffer.data(), std::min(SKIP_BUFFER_SIZE, position - m_streamPosition))) {
+            return false;
+        }
+    }
+    return inflateInto(dst, length);
+}
+
+bool TimeSeriesSource::rewindStream()
+{
+    if (m_streamInitialized) {
+        inflateEnd(&m_stream);
+    }
+    m_stream = z_stream();
+    // 16 + MAX_WBITS selects gzip framing
+    m_streamInitialized = inflateInit2(&m_stream, 16 + MAX_WBITS) == Z_OK;
+    if (!m_streamInitialized) {
+        m_errorString = "Failed to initialize decompression";
+        return false;
+    }
+    
+    m_stream.next_in = const_cast<Bytef *>(m_fileData);
+    m_stream.avail_in = 0;
+    m_streamPosition = 0;
+    return true;
+}
@@ -0,0 +1,95 @@
+#ifndef TIMESERIESSOURCE_H
+#define TIMESERIESSOURCE_H
+
+// Qt base classes for file access and string handling
+#include <QString>
+#include <QFile>
+
+// VTK smart pointer for the decoded frames
+#include <vtkSmartPointer.h>
+
+// zlib as bundled with VTK, for sequential access to plain .nii.gz files
+#include <vtk_zlib.h>
+
+// Standard library for the skip buffer
+#include <vector>
+
+#include "NiftiHeader.h"
+#include "GzipBlockIndex.h"
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * TimeSeriesSource - Frame-by-frame access to a 4D NIfTI file
+ * 
+ * Each frame (fMRI timepoint, DWI direction, ...) is one 3D volume stored
+ * back to back after vox_offset. Frames are decoded into fresh image data
+ * on request; nothing beyond the frame being decoded is held in memory.
+ * 
+ * Uncompressed files are read from a file mapping and BGZF files through
+ * their member table, so any frame can be reached directly. Plain gzip is
+ * inflated as one forward stream; stepping backwards restarts it, which is
+ * why playback runs forward.
+ * 
+ * Not thread-safe: one thread (the FrameRingBuffer decoder) reads frames.
+ */
+class TimeSeriesSource
+{
+public:
+    explicit TimeSeriesSource(const QString &filePath);
+    ~TimeSeriesSource();
+    
+    // Setup - parse the header and prepare frame access
+    bool open();                                         // False for unsupported or truncated files
+    QString errorString() const;                         // Reason the last call failed
+    const NiftiHeader &header() const;                   // Parsed header
+    QString filePath() const;                            // File being served
+    
+    // Frames
+    int frameCount() const;                              // Number of 3D volumes
+    qint64 frameBytes() const;                           // Decoded bytes per frame
+    double frameInterval() const;                        // Seconds between frames from pixdim[4], 0 if unknown
+    vtkSmartPointer<vtkImageData> readFrame(int frame);  // Decode one volume, null on failure
+
+private:
+    /**
+     * How voxel bytes are reached
+     */
+    enum AccessMode {
+        MappedAccess,  // Uncompressed, straight from the file mapping
+        BlockAccess,   // BGZF, member by member
+        StreamAccess   // Single-stream gzip, sequential inflate
+    };
+    
+    QString m_filePath;                                  // File being served
+    QString m_errorString;                               // Last error message
+    NiftiHeader m_header;                                // Parsed header
+    QFile m_file;                                        // Open file backing the mapping
+    const uchar *m_fileData;                             // Read-only mapping of the whole file
+    qint64 m_fileSize;                                   // Size of the mapping
+    AccessMode m_accessMode;                             // Chosen in open()
+    
+    // BGZF random access
+    GzipBlockIndex m_blockIndex;                         // Member table
+    GzipBlockInflater m_blockInflater;                   // Reused raw inflate state
+    std::vector<char> m_blockBuffer;                     // Member straddling a frame boundary
+    
+    // Sequential gzip access
+    z_stream m_stream;                                   // Inflate state positioned at m_streamPosition
+    bool m_streamInitialized;                            // Whether inflateInit2 succeeded
+    qint64 m_streamPosition;                             // Decompressed bytes produced so far
+    std::vector<char> m_skipBuffer;                      // Sink for skipped bytes
+    
+    // Private helper methods
+    bool readRange(qint64 position, qint64 length, char *dst); // Decompressed bytes at a position
+    bool readBlocks(qint64 position, qint64 length, char *dst); // BGZF path
+    bool readStream(qint64 position, qint64 length, char *dst); // Sequential gzip path
+    bool rewindStream();                                 // Restart inflate at the first byte
+    
+    // Non-copyable: owns a file mapping and zlib state
+    TimeSeriesSource(const TimeSeriesSource &) = delete;
+    TimeSeriesSource &operator=(const TimeSeriesSource &) = delete;
+};
+
+#endif // TIMESERIESSOURCE_H
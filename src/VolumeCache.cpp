@@ -0,0 +1,240 @@
+#include "VolumeCache.h"
+#include "TimeSeriesSource.h"
+#include "VolumePyramid.h"
+
+#include <vtkImageData.h>
+
+#include <QFileInfo>
+#include <QDateTime>
+
+VolumeCache::VolumeCache(qint64 budgetBytes)
+    : m_budget(budgetBytes)
+    , m_usedBytes(0)
+    , m_hits(0)
+    , m_misses(0)
+{
+}
+
+bool VolumeCache::lookup(const QString &filePath, Entry &entry)
+{
+    QString path;
+    qint64 modified = 0;
+    qint64 size = 0;
+    const bool exists = identify(filePath, path, modified, size);
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = findLocked(path);
+    if (it == m_slots.end()) {
+        ++m_misses;
+        return false;
+    }
+    
+    // The file changed since it was decoded; the entry is useless now
+    if (!exists || it->modified != modified || it->size != size) {
+        m_usedBytes -= it->entry.bytes;
+        m_slots.erase(it);
+        ++m_misses;
+        return false;
+    }
+    
+    m_slots.splice(m_slots.begin(), m_slots, it);
+    entry = it->entry;
+    ++m_hits;
+    return true;
+}
+
+bool VolumeCache::contains(const QString &filePath) const
+{
+    QString path;
+    qint64 modified = 0;
+    qint64 size = 0;
+    if (!identify(filePath, path, modified, size)) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const Slot &slot : m_slots) {
+        if (slot.path == path) {
+            return slot.modified == modified && slot.size == size;
+        }
+    }
+    return false;
+}
+
+void VolumeCache::insert(const QString &filePath, const Entry &entry)
+{
+    Slot slot;
+    if (!identify(filePath, slot.path, slot.modified, slot.size) || !entry.imageData) {
+        return;
+    }
+    slot.entry = entry;
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = findLocked(slot.path);
+    if (it != m_slots.end()) {
+        m_usedBytes -= it->entry.bytes;
+        m_slots.erase(it);
+    }
+    
+    if (entry.bytes > m_budget) {
+        return;
+    }
+    
+    m_slots.push_front(slot);
+    m_usedBytes += entry.bytes;
+    evictLocked();
+}
+
+/**
+ * Stores a pyramid built after the volume was inserted
+ * 
+ * Only attaches to the entry holding the pyramid's own level 0, so a
+ * pyramid finished after the file was reloaded or evicted is dropped.
+ */
+void VolumeCache::attachPyramid(const QString &filePath, std::shared_ptr<VolumePyramid> pyramid)
+{
+    QString path;
+    qint64 modified = 0;
+    qint64 size = 0;
+    if (!pyramid || !identify(filePath, path, modified, size)) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = findLocked(path);
+    if (it == m_slots.end() || it->entry.pyramid || it->entry.imageData.GetPointer() != pyramid->level(0)) {
+        return;
+    }
+    it->entry.pyramid = pyramid;
+    it->entry.bytes += pyramid->reducedBytes();
+    m_usedBytes += pyramid->reducedBytes();
+    evictLocked();
+}
+
+/**
+ * Statistics are small, so attaching them never evicts
+ */
+void VolumeCache::attachStatistics(const QString &filePath, vtkImageData *volume,
+                                   std::shared_ptr<VolumeStatistics> statistics)
+{
+    QString path;
+    qint64 modified = 0;
+    qint64 size = 0;
+    if (!statistics || !identify(filePath, path, modified, size)) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = findLocked(path);
+    if (it == m_slots.end() || it->entry.statistics || it->entry.imageData.GetPointer() != volume) {
+        return;
+    }
+    it->entry.statistics = statistics;
+}
+
+void VolumeCache::remove(const QString &filePath)
+{
+    QString path;
+    qint64 modified = 0;
+    qint64 size = 0;
+    identify(filePath, path, modified, size);
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = findLocked(path);
+    if (it != m_slots.end()) {
+        m_usedBytes -= it->entry.bytes;
+        m_slots.erase(it);
+    }
+}
+
+void VolumeCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots.clear();
+    m_usedBytes = 0;
+}
+
+void VolumeCache::setBudget(qint64 bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = bytes;
+    evictLocked();
+}
+
+qint64 VolumeCache::budget() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_budget;
+}
+
+qint64 VolumeCache::usedBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_usedBytes;
+}
+
+int VolumeCache::entryCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<int>(m_slots.size());
+}
+
+qint64 VolumeCache::hits() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+}
+
+qint64 VolumeCache::misses() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+}
+
+QStringList VolumeCache::cachedFiles() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    QStringList files;
+    for (const Slot &slot : m_slots) {
+        files << slot.path;
+    }
+    return files;
+}
+
+/**
+ * Resolves the cache key of a file
+ * 
+ * Symlinks and relative paths resolve to the same canonical path. Returns
+ * false when the file no longer exists; path is still filled in so a stale
+ * entry can be found and dropped.
+ */
+bool VolumeCache::identify(const QString &filePath, QString &path, qint64 &modified, qint64 &size)
+{
+    QFileInfo info(filePath);
+    path = info.canonicalFilePath();
+    if (path.isEmpty()) {
+        path = info.absoluteFilePath();
+        return false;
+    }
+    modified = info.lastModified().toMSecsSinceEpoch();
+    size = info.size();
+    return true;
+}
+
+std::list<VolumeCache::Slot>::iterator VolumeCache::findLocked(const QString &path)
+{
+    for (auto it = m_slots.begin(); it != m_slots.end(); ++it) {
+        if (it->path == path) {
+            return it;
+        }
+    }
+    return m_slots.end();
+}
+
+void VolumeCache::evictLocked()
+{
+    while (m_usedBytes > m_budget && !m_slots.empty()) {
+        m_usedBytes -= m_slots.back().entry.bytes;
+        m_slots.pop_back();
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef VOLUMECACHE_H
+#define VOLUMECACHE_H
+
+// Qt base classes for paths and file metadata
+#include <QString>
+#include <QStringList>
+
+// VTK smart pointer for the cached volumes
+#include <vtkSmartPointer.h>
+
+// Standard library for the LRU list and its lock
+#include <list>
+#include <memory>
+#include <mutex>
+
+// Forward declarations
+class vtkImageData;         // VTK data structure for image/volume data
+class TimeSeriesSource;     // Frame source of a 4D file
+class VolumePyramid;        // Downsampled levels of a volume
+class VolumeStatistics;     // Intensity summary of a volume
+
+/**
+ * VolumeCache - Memory-budgeted LRU cache of decoded volumes
+ * 
+ * Entries are keyed by canonical path, modification time and size, so a
+ * file that changed on disk is never served stale: the lookup notices the
+ * mismatch, drops the entry and reports a miss.
+ * 
+ * The budget counts decoded voxel bytes (memory-mapped volumes at their
+ * mapped size) plus any resolution pyramid attached later. Inserting past
+ * the budget evicts least recently used entries; an entry larger than the
+ * whole budget is not cached.
+ * 
+ * All methods are thread-safe so background loaders can fill the cache.
+ */
+class VolumeCache
+{
+public:
+    /**
+     * A decoded volume together with what is needed to show it again
+     */
+    struct Entry {
+        vtkSmartPointer<vtkImageData> imageData;         // First (or only) 3D volume
+        std::shared_ptr<TimeSeriesSource> timeSeries;    // Frame source of a 4D file, else null
+        std::shared_ptr<VolumePyramid> pyramid;          // Reduced levels once built, else null
+        std::shared_ptr<VolumeStatistics> statistics;    // Statistics once computed, else null
+        double sclSlope = 1.0;                           // NIfTI intensity scaling for computing them
+        double sclInter = 0.0;                           // NIfTI intensity offset for computing them
+        qint64 bytes = 0;                                // Decoded voxel bytes, pyramid included
+        qint64 fileBytes = 0;                            // Bytes read from disk for the original load
+        double seconds = 0.0;                            // Time the original load took
+        bool memoryMapped = false;                       // Voxels are a file mapping
+        bool parallelDecompressed = false;               // Original load inflated BGZF in parallel
+        int narrowedFromType = 0;                        // VTK type in the file when the voxels were narrowed
+    };
+    
+    explicit VolumeCache(qint64 budgetBytes);
+    
+    // Lookup and insertion
+    bool lookup(const QString &filePath, Entry &entry);  // Hit refreshes recency; counts hits and misses
+    bool contains(const QString &filePath) const;        // Valid entry present; no statistics
+    void insert(const QString &filePath, const Entry &entry); // Add or replace, then evict to budget
+    void attachPyramid(const QString &filePath, std::shared_ptr<VolumePyramid> pyramid); // Keep levels with their volume
+    void attachStatistics(const QString &filePath, vtkImageData *volume,
+                          std::shared_ptr<VolumeStatistics> statistics); // Keep a summary with its volume
+    void remove(const QString &filePath);                // Drop one file
+    void clear();                                        // Drop everything
+    
+    // Budget and statistics
+    void setBudget(qint64 bytes);                        // Evicts immediately when shrinking
+    qint64 budget() const;                               // Upper bound in bytes
+    qint64 usedBytes() const;                            // Bytes held by entries
+    int entryCount() const;                              // Number of cached volumes
+    qint64 hits() const;                                 // Lookups served from the cache
+    qint64 misses() const;                               // Lookups that had to load
+    QStringList cachedFiles() const;                     // Paths, most recently used first
+
+private:
+    /**
+     * Cache slot with the file identity it was decoded from
+     */
+    struct Slot {
+        QString path;                                    // Canonical path
+        qint64 modified = 0;                             // mtime in ms since epoch
+        qint64 size = 0;                                 // File size in bytes
+        Entry entry;                                     // Cached data
+    };
+    
+    mutable std::mutex m_mutex;                          // Guards everything below
+    std::list<Slot> m_slots;                             // Most recently used first
+    qint64 m_budget;                                     // Byte budget
+    qint64 m_usedBytes;                                  // Sum of entry bytes
+    qint64 m_hits;                                       // Successful lookups
+    qint64 m_misses;                                     // Failed lookups
+    
+    // Private helper methods
+    static bool identify(const QString &filePath, QString &path, qint64 &modified, qint64 &size); // Key of a file
+    std::list<Slot>::iterator findLocked(const QString &path); // Slot for a canonical path
+    void evictLocked();                                  // Drop LRU slots until within budget
+};
+
+#endif // VOLUMECACHE_H
@@ -0,0 +1,229 @@
+#include "VolumeNarrowing.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSetGet.h>
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace {
+
+const vtkIdType MAX_CHUNKS = 64;                  // Value ranges checked in parallel
+const vtkIdType MIN_CHUNK_VALUES = 1 << 16;       // Smaller volumes use fewer chunks
+const vtkIdType CONVERT_GRAIN = 1 << 16;          // Values converted per parallel task
+
+/**
+ * What the check pass learns about one chunk of values
+ */
+struct ChunkRange {
+    double minimum = std::numeric_limits<double>::max();
+    double maximum = std::numeric_limits<double>::lowest();
+    bool integers = true;                         // Every value is a finite whole number
+    bool singles = true;                          // Every value survives a round trip through float
+};
+
+/**
+ * Range and exactness of one chunk
+ * 
+ * Integer types only need the range. For floating-point types the loop
+ * keeps going after the first fraction, since a float32 result still
+ * needs to know about every value.
+ */
+template <typename T>
+void checkValues(const T *values, vtkIdType count, ChunkRange &range)
+{
+    double low = range.minimum;
+    double high = range.maximum;
+    if (std::numeric_limits<T>::is_integer) {
+        for (vtkIdType i = 0; i < count; ++i) {
+            const double value = static_cast<double>(values[i]);
+            low = std::min(low, value);
+            high = std::max(high, value);
+        }
+    } else {
+        bool integers = range.integers;
+        bool singles = range.singles;
+        for (vtkIdType i = 0; i < count; ++i) {
+            const double value = static_cast<double>(values[i]);
+            if (std::isfinite(value)) {
+                low = std::min(low, value);
+                high = std::max(high, value);
+                integers = integers && value == std::floor(value);
+                singles = singles && static_cast<double>(static_cast<float>(value)) == value;
+            } else {
+                integers = false;                 // NaN and infinity only exist in floating point
+            }
+        }
+        range.integers = integers;
+        range.singles = singles;
+    }
+    range.minimum = low;
+    range.maximum = high;
+}
+
+template <typename T>
+void checkChunks(const T *values, vtkIdType count, vtkIdType chunks, ChunkRange *ranges)
+{
+    vtkSMPTools::For(0, chunks, 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType chunk = begin; chunk < end; ++chunk) {
+            const vtkIdType first = count * chunk / chunks;
+            const vtkIdType last = count * (chunk + 1) / chunks;
+            checkValues(values + first, last - first, ranges[chunk]);
+        }
+    });
+}
+
+template <typename In, typename Out>
+void convertValues(const In *src, Out *dst, vtkIdType count)
+{
+    vtkSMPTools::For(0, count, CONVERT_GRAIN, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i) {
+            dst[i] = static_cast<Out>(src[i]);
+        }
+    });
+}
+
+/**
+ * Second level of the type dispatch: the target is one of the few types
+ * narrowestType() can return
+ */
+template <typename In>
+bool convertTo(const In *src, void *dst, int type, vtkIdType count)
+{
+    switch (type) {
+    case VTK_UNSIGNED_CHAR:
+        convertValues(src, static_cast<unsigned char *>(dst), count);
+        return true;
+    case VTK_SIGNED_CHAR:
+        convertValues(src, static_cast<signed char *>(dst), count);
+        return true;
+    case VTK_UNSIGNED_SHORT:
+        convertValues(src, static_cast<unsigned short *>(dst), count);
+        return true;
+    case VTK_SHORT:
+        convertValues(src, static_cast<short *>(dst), count);
+        return true;
+    case VTK_INT:
+        convertValues(src, static_cast<int *>(dst), count);
+        return true;
+    case VTK_FLOAT:
+        convertValues(src, static_cast<float *>(dst), count);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Smallest integer type whose range covers [low, high]
+ */
+int integerTypeFor(double low, double high)
+{
+    if (low >= 0.0 && high <= VTK_UNSIGNED_CHAR_MAX) {
+        return VTK_UNSIGNED_CHAR;
+    }
+    if (low >= VTK_SIGNED_CHAR_MIN && high <= VTK_SIGNED_CHAR_MAX) {
+        return VTK_SIGNED_CHAR;
+    }
+    if (low >= 0.0 && high <= VTK_UNSIGNED_SHORT_MAX) {
+        return VTK_UNSIGNED_SHORT;
+    }
+    if (low >= VTK_SHORT_MIN && high <= VTK_SHORT_MAX) {
+        return VTK_SHORT;
+    }
+    if (low >= VTK_INT_MIN && high <= VTK_INT_MAX) {
+        return VTK_INT;
+    }
+    return VTK_VOID;
+}
+
+} // namespace
+
+/**
+ * Checks every value of the volume on all cores
+ * 
+ * A volume without a single finite value (all NaN) has no range and
+ * keeps its type; so does anything that is not a plain number type.
+ */
+int VolumeNarrowing::narrowestType(vtkImageData *volume)
+{
+    if (!volume || !volume->GetPointData() || !volume->GetPointData()->GetScalars()) {
+        return VTK_VOID;
+    }
+    
+    vtkDataArray *scalars = volume->GetPointData()->GetScalars();
+    const int type = scalars->GetDataType();
+    const vtkIdType count = scalars->GetNumberOfTuples() * scalars->GetNumberOfComponents();
+    if (count < 1 || scalars->GetDataTypeSize() < 2) {
+        return type;
+    }
+    
+    const vtkIdType chunks = std::max<vtkIdType>(1, std::min(MAX_CHUNKS, count / MIN_CHUNK_VALUES));
+    std::vector<ChunkRange> ranges(static_cast<size_t>(chunks));
+    switch (type) {
+        vtkTemplateMacro(checkChunks(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)), count, chunks,
+                                     ranges.data()));
+        default:
+            return type;
+    }
+    
+    ChunkRange total;
+    for (const ChunkRange &range : ranges) {
+        total.minimum = std::min(total.minimum, range.minimum);
+        total.maximum = std::max(total.maximum, range.maximum);
+        total.integers = total.integers && range.integers;
+        total.singles = total.singles && range.singles;
+    }
+    if (total.minimum > total.maximum) {
+        return type;
+    }
+    
+    // Whole numbers narrow furthest; otherwise float64 may still halve
+    int narrowest = total.integers ? integerTypeFor(total.minimum, total.maximum) : VTK_VOID;
+    if (narrowest == VTK_VOID && type == VTK_DOUBLE && total.singles) {
+        narrowest = VTK_FLOAT;
+    }
+    if (narrowest == VTK_VOID || vtkDataArray::GetDataTypeSize(narrowest) >= scalars->GetDataTypeSize()) {
+        return type;
+    }
+    return narrowest;
+}
+
+vtkSmartPointer<vtkImageData> VolumeNarrowing::narrow(vtkImageData *volume)
+{
+    const int type = narrowestType(volume);
+    vtkDataArray *scalars = volume ? volume->GetPointData()->GetScalars() : nullptr;
+    if (!scalars || type == VTK_VOID || type == scalars->GetDataType()) {
+        return nullptr;
+    }
+    
+    const vtkIdType count = scalars->GetNumberOfTuples() * scalars->GetNumberOfComponents();
+    vtkSmartPointer<vtkDataArray> narrowed =
+        vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(type));
+    narrowed->SetName(scalars->GetName());
+    narrowed->SetNumberOfComponents(scalars->GetNumberOfComponents());
+    narrowed->SetNumberOfTuples(scalars->GetNumberOfTuples());
+    
+    bool converted = false;
+    switch (scalars->GetDataType()) {
+        vtkTemplateMacro(converted = convertTo(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)),
+                                               narrowed->GetVoidPointer(0), type, count));
+        default:
+            break;
+    }
+    if (!converted) {
+        return nullptr;
+    }
+    
+    // Same geometry; only the scalars are replaced
+    vtkSmartPointer<vtkImageData> result = vtkSmartPointer<vtkImageData>::New();
+    result->CopyStructure(volume);
+    result->GetPointData()->SetScalars(narrowed);
+    return result;
+}
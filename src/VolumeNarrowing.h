@@ -0,0 +1,34 @@
+#ifndef VOLUMENARROWING_H
+#define VOLUMENARROWING_H
+
+// VTK smart pointer for the narrowed copy
+#include <vtkSmartPointer.h>
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * VolumeNarrowing - Lossless conversion of a volume to a smaller scalar type
+ * 
+ * Pipeline outputs are often written as float64 or float32 although every
+ * voxel is a small integer (label maps, masks, rescaled scanner data), or
+ * as float64 although every value is exactly a float32. narrow() finds the
+ * smallest VTK type that holds every value of the volume unchanged:
+ * 
+ * - Integer values (and no NaN or infinity): uint8, int8, uint16, int16
+ *   or int32, whichever covers the range
+ * - float64 values that survive a round trip through float32: float32
+ * 
+ * and returns a copy in that type, or null when no smaller type fits.
+ * Both passes - the check and the conversion - run on all cores. The
+ * NIfTI intensity scaling is untouched: it is applied to the statistics
+ * and the display window, never to the stored voxels.
+ */
+class VolumeNarrowing
+{
+public:
+    static int narrowestType(vtkImageData *volume);      // Smallest lossless VTK_* type, the current one if none is smaller
+    static vtkSmartPointer<vtkImageData> narrow(vtkImageData *volume); // Copy in that type, null when nothing is saved
+};
+
+#endif // VOLUMENARROWING_H
@@ -0,0 +1,249 @@
+#include "VolumePyramid.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSetGet.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+/**
+ * Averages blocks of src into dst, one output z slice per task
+ * 
+ * Blocks at the far edges may be partial; they average the voxels that
+ * exist, so no padding is invented.
+ */
+template <typename T>
+void boxFilter(const T *src, const int *srcDims, int components, int factor, T *dst, const int *dstDims)
+{
+    vtkSMPTools::For(0, dstDims[2], [&](vtkIdType zBegin, vtkIdType zEnd) {
+        std::vector<double> sums(static_cast<size_t>(dstDims[0]) * components);
+        
+        for (vtkIdType z = zBegin; z < zEnd; ++z) {
+            const int z0 = static_cast<int>(z) * factor;
+            const int z1 = std::min(z0 + factor, srcDims[2]);
+            
+            for (int y = 0; y < dstDims[1]; ++y) {
+                const int y0 = y * factor;
+                const int y1 = std::min(y0 + factor, srcDims[1]);
+                std::fill(sums.begin(), sums.end(), 0.0);
+                
+                // Source rows are read front to back, so the pass stays sequential in memory
+                for (int sz = z0; sz < z1; ++sz) {
+                    for (int sy = y0; sy < y1; ++sy) {
+                        const T *row = src + (static_cast<size_t>(sz) * srcDims[1] + sy) * srcDims[0] * components;
+                        for (int sx = 0; sx < srcDims[0]; ++sx) {
+                            double *sum = &sums[static_cast<size_t>(sx / factor) * components];
+                            for (int c = 0; c < components; ++c) {
+                                sum[c] += static_cast<double>(row[sx * components + c]);
+                            }
+                        }
+                    }
+                }
+                
+                T *out = dst + (static_cast<size_t>(z) * dstDims[1] + y) * dstDims[0] * components;
+                for (int x = 0; x < dstDims[0]; ++x) {
+                    const int width = std::min(x * factor + factor, srcDims[0]) - x * factor;
+                    const double count = static_cast<double>((z1 - z0) * (y1 - y0) * width);
+                    for (int c = 0; c < components; ++c) {
+                        double mean = sums[static_cast<size_t>(x) * components + c] / count;
+                        if (std::numeric_limits<T>::is_integer) {
+                            mean = std::floor(mean + 0.5);
+                        }
+                        out[x * components + c] = static_cast<T>(mean);
+                    }
+                }
+            }
+        }
+    });
+}
+
+/**
+ * First-component min and max, read straight from the buffer
+ * 
+ * vtkDataArray::GetRange() caches its result in the array's information
+ * object, which is not safe while the GUI thread may query the same array.
+ */
+template <typename T>
+void scalarRange(const T *src, int components, vtkIdType count, double *range)
+{
+    std::mutex mutex;
+    range[0] = std::numeric_limits<double>::max();
+    range[1] = std::numeric_limits<double>::lowest();
+    
+    vtkSMPTools::For(0, count, 1 << 20, [&](vtkIdType begin, vtkIdType end) {
+        double low = std::numeric_limits<double>::max();
+        double high = std::numeric_limits<double>::lowest();
+        for (vtkIdType i = begin; i < end; ++i) {
+            double value = static_cast<double>(src[i * components]);
+            // NaN fails both comparisons and is skipped
+            if (value < low) {
+                low = value;
+            }
+            if (value > high) {
+                high = value;
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        range[0] = std::min(range[0], low);
+        range[1] = std::max(range[1], high);
+    });
+    
+    if (range[0] > range[1]) {
+        range[0] = range[1] = 0.0;
+    }
+}
+
+qint64 voxelBytes(vtkImageData *image)
+{
+    return static_cast<qint64>(image->GetNumberOfPoints()) * image->GetNumberOfScalarComponents() *
+           image->GetScalarSize();
+}
+
+int longestAxis(vtkImageData *image)
+{
+    int *dims = image->GetDimensions();
+    return std::max(dims[0], std::max(dims[1], dims[2]));
+}
+
+} // namespace
+
+VolumePyramid::VolumePyramid()
+    : m_reducedBytes(0)
+{
+    m_range[0] = m_range[1] = 0.0;
+}
+
+/**
+ * Builds the levels of a volume, each from the previous one
+ * 
+ * Each level is computed on all cores and reads only the level before it,
+ * so the whole pyramid costs about 1.14 passes over the full volume.
+ * The cancel flag is checked between levels.
+ */
+std::shared_ptr<VolumePyramid> VolumePyramid::build(vtkSmartPointer<vtkImageData> volume, int coarsestDimension,
+                                                    std::shared_ptr<std::atomic_bool> cancelFlag)
+{
+    if (!volume || !volume->GetPointData() || !volume->GetPointData()->GetScalars()) {
+        return nullptr;
+    }
+    
+    std::shared_ptr<VolumePyramid> pyramid(new VolumePyramid());
+    pyramid->m_levels.push_back(volume);
+    
+    vtkDataArray *scalars = volume->GetPointData()->GetScalars();
+    switch (scalars->GetDataType()) {
+        vtkTemplateMacro(scalarRange(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)),
+                                     scalars->GetNumberOfComponents(), volume->GetNumberOfPoints(),
+                                     pyramid->m_range));
+        default:
+            return nullptr;
+    }
+    
+    while (longestAxis(pyramid->m_levels.back()) > coarsestDimension) {
+        if (cancelFlag && cancelFlag->load()) {
+            return nullptr;
+        }
+        vtkSmartPointer<vtkImageData> reduced = downsample(pyramid->m_levels.back(), 2);
+        if (!reduced) {
+            break;
+        }
+        pyramid->m_reducedBytes += voxelBytes(reduced);
+        pyramid->m_levels.push_back(reduced);
+    }
+    return pyramid;
+}
+
+vtkSmartPointer<vtkImageData> VolumePyramid::downsample(vtkImageData *volume, int factor)
+{
+    if (!volume || factor < 1 || !volume->GetPointData() || !volume->GetPointData()->GetScalars()) {
+        return nullptr;
+    }
+    
+    int srcDims[3];
+    double spacing[3];
+    double origin[3];
+    volume->GetDimensions(srcDims);
+    volume->GetSpacing(spacing);
+    volume->GetOrigin(origin);
+    if (srcDims[0] < 1 || srcDims[1] < 1 || srcDims[2] < 1) {
+        return nullptr;
+    }
+    
+    // An axis with a single voxel (a 2D image) stays a single voxel
+    int dstDims[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        dstDims[axis] = (srcDims[axis] + factor - 1) / factor;
+        if (srcDims[axis] > 1) {
+            origin[axis] += 0.5 * (factor - 1) * spacing[axis];
+            spacing[axis] *= factor;
+        }
+    }
+    
+    vtkDataArray *scalars = volume->GetPointData()->GetScalars();
+    const int components = scalars->GetNumberOfComponents();
+    
+    vtkSmartPointer<vtkImageData> reduced = vtkSmartPointer<vtkImageData>::New();
+    reduced->SetDimensions(dstDims);
+    reduced->SetSpacing(spacing);
+    reduced->SetOrigin(origin);
+    reduced->AllocateScalars(scalars->GetDataType(), components);
+    
+    switch (scalars->GetDataType()) {
+        vtkTemplateMacro(boxFilter(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)), srcDims, components,
+                                   factor, static_cast<VTK_TT *>(reduced->GetScalarPointer()), dstDims));
+        default:
+            return nullptr;
+    }
+    return reduced;
+}
+
+int VolumePyramid::levelCount() const
+{
+    return static_cast<int>(m_levels.size());
+}
+
+vtkImageData *VolumePyramid::level(int index) const
+{
+    index = std::max(0, std::min(levelCount() - 1, index));
+    return m_levels[index];
+}
+
+int VolumePyramid::levelForVoxelsPerPixel(double voxelsPerPixel) const
+{
+    // Level n has 2^n voxels of level 0 per voxel
+    int index = 0;
+    while (index + 1 < levelCount() && static_cast<double>(2 << index) <= voxelsPerPixel) {
+        ++index;
+    }
+    return index;
+}
+
+int VolumePyramid::levelForSize(int maxDimension) const
+{
+    for (int index = 0; index < levelCount(); ++index) {
+        if (longestAxis(m_levels[index]) <= maxDimension) {
+            return index;
+        }
+    }
+    return levelCount() - 1;
+}
+
+void VolumePyramid::getScalarRange(double range[2]) const
+{
+    range[0] = m_range[0];
+    range[1] = m_range[1];
+}
+
+qint64 VolumePyramid::reducedBytes() const
+{
+    return m_reducedBytes;
+}
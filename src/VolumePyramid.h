@@ -0,0 +1,55 @@
+#ifndef VOLUMEPYRAMID_H
+#define VOLUMEPYRAMID_H
+
+// Qt types for byte counts
+#include <QtGlobal>
+
+// VTK smart pointer for the downsampled volumes
+#include <vtkSmartPointer.h>
+
+// Standard library for the level list and the cancellation flag
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * VolumePyramid - A volume and its 2x-downsampled levels
+ * 
+ * Level 0 is the volume itself; each further level averages 2x2x2 blocks
+ * of the one before, down to a level whose longest axis fits a minimum
+ * size. Every level keeps the scalar type and covers the same physical
+ * extent: spacing doubles and the origin moves to the centre of the first
+ * block, so a camera set up for one level frames all of them identically.
+ * 
+ * build() is meant for a worker thread; a finished pyramid is read-only
+ * and may be shared between threads.
+ */
+class VolumePyramid
+{
+public:
+    static std::shared_ptr<VolumePyramid> build(vtkSmartPointer<vtkImageData> volume, int coarsestDimension,
+                                                std::shared_ptr<std::atomic_bool> cancelFlag); // Null if cancelled
+    static vtkSmartPointer<vtkImageData> downsample(vtkImageData *volume, int factor); // Null for an empty or unsupported volume
+    
+    // Levels
+    int levelCount() const;                              // At least 1
+    vtkImageData *level(int index) const;                // 0 is the full-resolution volume
+    int levelForVoxelsPerPixel(double voxelsPerPixel) const; // Coarsest level still at least one voxel per screen pixel
+    int levelForSize(int maxDimension) const;            // Finest level whose longest axis fits maxDimension
+    
+    // Properties
+    void getScalarRange(double range[2]) const;          // First-component range of level 0
+    qint64 reducedBytes() const;                         // Memory held by levels 1 and up
+
+private:
+    std::vector<vtkSmartPointer<vtkImageData>> m_levels; // Finest first
+    double m_range[2];                                   // Scalar range of level 0
+    qint64 m_reducedBytes;                               // Voxel bytes of the reduced levels
+    
+    VolumePyramid();
+};
+
+#endif // VOLUMEPYRAMID_H
@@ -14,14 +14,110 @@
 #include <vtkImageMapToColors.h>       // Base class for color mapping
 #include <vtkImageMapToWindowLevelColors.h> // Color mapping for contrast adjustment
 #include <vtkImageMapper3D.h>          // 3D image mapping
-#include <vtkLookupTable.h>            // Color lookup table
+#include <vtkLookupTable.h>            // Greyscale table the window/level range is mapped through
+#include <vtkImageProperty.h>          // Window/level shared by every 2D image actor
+#include "IntensityHistogram.h"
+
+// Crosshair geometry of the tri-planar view
+#include <vtkActor.h>
+#include <vtkCellArray.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+#include "OrthogonalSlicer.h"
+
+// Slice-on-demand source for large volumes
+#include "LazyVolumeSource.h"
+
+// 4D time series playback
+#include "TimeSeriesSource.h"
+#include "FrameRingBuffer.h"
+#include <QTimer>
+
+// Reduced levels for progressive and zoom-dependent rendering
+#include "VolumePyramid.h"
+
+// Mouse handling of the 3D view
+#include <QEvent>
+#include <QMouseEvent>
+#include <QWheelEvent>
 
 // Qt VTK integration
 #include <QVTKOpenGLNativeWidget.h>   // Qt widget for VTK rendering
 
+// Display refresh rate for render scheduling
+#include <QScreen>
+
 // Qt debugging support
 #include <QDebug>                      // For debug output
 
+#include <cmath>
+
+namespace {
+
+const qint64 FRAME_BUFFER_BYTES = 256 * 1024 * 1024;  // Memory for frames decoded ahead
+const int MIN_BUFFERED_FRAMES = 2;                     // Enough to hide one slow decode
+const int MAX_BUFFERED_FRAMES = 16;                    // More adds latency to seeks, not smoothness
+const double DEGREES_PER_PIXEL = 0.5;                  // 3D view rotation per pixel dragged
+const double ZOOM_STEP = 1.2;                          // Zoom factor per button press or wheel notch
+const int PREVIEW_SIZE = 128;                          // Longest axis of the interaction preview level, in voxels
+const int PREVIEW_PIXELS = 256 * 256;                  // Rays cast per 3D frame during interaction
+const int REFINE_DELAY_MS = 150;                       // Idle time before full resolution is drawn
+const double DEFAULT_REFRESH_RATE = 60.0;              // Display refresh in Hz when the screen does not say
+
+// Tri-planar panes as (xmin, ymin, xmax, ymax): axial, sagittal, coronal, then the empty quadrant
+const double PANE_VIEWPORTS[4][4] = {
+    { 0.0, 0.5, 0.5, 1.0 },
+    { 0.5, 0.5, 1.0, 1.0 },
+    { 0.0, 0.0, 0.5, 0.5 },
+    { 0.5, 0.0, 1.0, 0.5 }
+};
+const double CROSSHAIR_COLOR[3] = { 1.0, 0.8, 0.0 };  // Yellow, visible on any grey level
+const double OBLIQUE_PREVIEW_FACTOR = 2.0;             // Oblique pixel spacing multiplier while interacting
+const double DEGREES_TO_RADIANS = 3.14159265358979323846 / 180.0;
+const int GREY_LEVELS = 256;                           // Entries of the window/level lookup table
+const double WINDOW_LEVEL_PIXELS = 200.0;              // Drag distance that doubles the window or moves the level one window
+const double MIN_WINDOW = 1e-6;                        // Keeps the lookup range from collapsing
+
+/**
+ * Turns a vector about a unit axis (Rodrigues' rotation formula)
+ */
+void rotateVector(double vector[3], const double axis[3], double degrees)
+{
+    const double radians = degrees * DEGREES_TO_RADIANS;
+    const double c = std::cos(radians);
+    const double s = std::sin(radians);
+    const double dot = axis[0] * vector[0] + axis[1] * vector[1] + axis[2] * vector[2];
+    const double cross[3] = {
+        axis[1] * vector[2] - axis[2] * vector[1],
+        axis[2] * vector[0] - axis[0] * vector[2],
+        axis[0] * vector[1] - axis[1] * vector[0]
+    };
+    for (int i = 0; i < 3; ++i) {
+        vector[i] = vector[i] * c + cross[i] * s + axis[i] * dot * (1.0 - c);
+    }
+}
+
+void crossProduct(const double a[3], const double b[3], double result[3])
+{
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+void normalize(double vector[3])
+{
+    const double length = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+    if (length > 0.0) {
+        vector[0] /= length;
+        vector[1] /= length;
+        vector[2] /= length;
+    }
+}
+
+} // namespace
+
 /**
  * Constructor - Initializes the VolumeRenderer with default settings
  * 
@@ -39,12 +135,62 @@ VolumeRenderer::VolumeRenderer(QObject *parent)
     , m_imageData(nullptr)        // Image data (none loaded initially)
     , m_currentOrientation(AXIAL) // Start with axial view (top-down)
     , m_currentSlice(0)           // Start at first slice
+    , m_playbackTimer(nullptr)    // Created below
+    , m_currentFrame(0)           // 3D volumes have a single frame
+    , m_stalledFrames(0)          // No playback yet
+    , m_renderMode(SLICE_MODE)    // Start with the slice view
+    , m_rotating(false)           // No drag in progress
+    , m_refineTimer(nullptr)      // Created below
+    , m_casterLevel(-1)           // Nothing handed to the ray caster yet
+    , m_renderTimer(nullptr)      // Created below
+    , m_slicePending(false)       // No slice requested yet
+    , m_pendingSlice(0)           // Set with m_slicePending
+    , m_volumeRequest(NO_VOLUME_RENDER) // No ray cast requested yet
+    , m_renderedFrames(0)         // Nothing drawn yet
+    , m_skippedRenders(0)         // Nothing coalesced yet
+    , m_dirtyPlanes(0)            // No planes extracted yet
+    , m_dragPane(-1)              // No crosshair drag in progress
+    , m_obliqueDirty(false)       // Nothing to resample yet
+    , m_obliquePreview(false)     // Full resolution until the user interacts
+    , m_slabDirty(false)          // Nothing to project yet
+    , m_windowLeveling(false)     // No window/level drag in progress
+    , m_dragWindow(0.0)           // Set when a drag starts
+    , m_dragLevel(0.0)            // Set when a drag starts
 {
+    m_cursor[0] = m_cursor[1] = m_cursor[2] = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        m_obliqueCentre[axis] = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            m_obliqueAxes[axis][i] = axis == i ? 1.0 : 0.0;
+        }
+    }
+    
+    m_playbackTimer = new QTimer(this);
+    m_playbackTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_playbackTimer, &QTimer::timeout, this, &VolumeRenderer::advancePlayback);
+    
+    // Restarted by every interaction, so full resolution waits for a pause
+    m_refineTimer = new QTimer(this);
+    m_refineTimer->setSingleShot(true);
+    m_refineTimer->setInterval(REFINE_DELAY_MS);
+    connect(m_refineTimer, &QTimer::timeout, this, &VolumeRenderer::refine);
+    
+    // Every render request between two display refreshes ends up in one render
+    m_renderTimer = new QTimer(this);
+    m_renderTimer->setSingleShot(true);
+    m_renderTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_renderTimer, &QTimer::timeout, this, &VolumeRenderer::flushRender);
+
     setupViewer();  // Initialize all VTK components
 }
 
 VolumeRenderer::~VolumeRenderer()
 {
+    // The decoder thread must stop before the viewer goes away; no signals during teardown
+    m_playbackTimer->stop();
+    m_renderTimer->stop();
+    m_frameBuffer.reset();
+    
     if (m_imageViewer) {
         m_imageViewer->Delete();
     }
@@ -86,6 +232,84 @@ void VolumeRenderer::setupViewer()
     
     // Set default orientation to axial view (top-down, standard for medical imaging)
     m_imageViewer->SetSliceOrientationToXY(); // Axial view
+    
+    // 3D view: the ray-cast image on a flat, pixel-aligned camera
+    m_rayCaster = std::make_unique<CpuRayCaster>();
+    m_previewCaster = std::make_unique<CpuRayCaster>();
+    m_volumeActor = vtkSmartPointer<vtkImageActor>::New();
+    m_volumeRenderer = vtkSmartPointer<vtkRenderer>::New();
+    m_volumeRenderer->AddActor(m_volumeActor);
+    m_volumeRenderer->GetActiveCamera()->ParallelProjectionOn();
+    
+    // Tri-planar view: one renderer per quadrant of the same window, so a
+    // crosshair move redraws all panes in a single Render()
+    m_mprSlicer = std::make_unique<OrthogonalSlicer>();
+    for (int pane = 0; pane < 4; ++pane) {
+        m_mprRenderers[pane] = vtkSmartPointer<vtkRenderer>::New();
+        m_mprRenderers[pane]->SetViewport(PANE_VIEWPORTS[pane][0], PANE_VIEWPORTS[pane][1],
+                                          PANE_VIEWPORTS[pane][2], PANE_VIEWPORTS[pane][3]);
+        m_mprRenderers[pane]->GetActiveCamera()->ParallelProjectionOn();
+    }
+    for (int pane = 0; pane < OrthogonalSlicer::PLANE_COUNT; ++pane) {
+        m_mprActors[pane] = vtkSmartPointer<vtkImageActor>::New();
+        m_mprRenderers[pane]->AddActor(m_mprActors[pane]);
+        
+        vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+        points->SetNumberOfPoints(4);
+        vtkSmartPointer<vtkCellArray> lines = vtkSmartPointer<vtkCellArray>::New();
+        vtkIdType vertical[2] = { 0, 1 };
+        vtkIdType horizontal[2] = { 2, 3 };
+        lines->InsertNextCell(2, vertical);
+        lines->InsertNextCell(2, horizontal);
+        m_crosshairs[pane] = vtkSmartPointer<vtkPolyData>::New();
+        m_crosshairs[pane]->SetPoints(points);
+        m_crosshairs[pane]->SetLines(lines);
+        
+        vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+        mapper->SetInputData(m_crosshairs[pane]);
+        m_crosshairActors[pane] = vtkSmartPointer<vtkActor>::New();
+        m_crosshairActors[pane]->SetMapper(mapper);
+        m_crosshairActors[pane]->GetProperty()->SetColor(CROSSHAIR_COLOR[0], CROSSHAIR_COLOR[1], CROSSHAIR_COLOR[2]);
+        m_mprRenderers[pane]->AddActor(m_crosshairActors[pane]);
+    }
+    
+    // Oblique view: the resampled plane centred on the origin of its own renderer
+    m_obliqueSlicer = std::make_unique<ObliqueSlicer>();
+    m_obliqueActor = vtkSmartPointer<vtkImageActor>::New();
+    m_obliqueRenderer = vtkSmartPointer<vtkRenderer>::New();
+    m_obliqueRenderer->AddActor(m_obliqueActor);
+    m_obliqueRenderer->GetActiveCamera()->ParallelProjectionOn();
+    
+    // Slab view: the projection in plane coordinates, like a tri-planar pane
+    m_slabProjector = std::make_unique<SlabProjector>();
+    m_slabActor = vtkSmartPointer<vtkImageActor>::New();
+    m_slabRenderer = vtkSmartPointer<vtkRenderer>::New();
+    m_slabRenderer->AddActor(m_slabActor);
+    m_slabRenderer->GetActiveCamera()->ParallelProjectionOn();
+    
+    // Window/level: every 2D actor maps its own scalars through one greyscale
+    // table whose range is the window, so a contrast change re-colours only
+    // what is drawn instead of re-running a colour filter over the slice
+    vtkSmartPointer<vtkLookupTable> greyscale = vtkSmartPointer<vtkLookupTable>::New();
+    greyscale->SetNumberOfTableValues(GREY_LEVELS);
+    greyscale->SetHueRange(0.0, 0.0);
+    greyscale->SetSaturationRange(0.0, 0.0);
+    greyscale->SetValueRange(0.0, 1.0);
+    greyscale->Build();
+    m_windowLevelProperty = vtkSmartPointer<vtkImageProperty>::New();
+    m_windowLevelProperty->SetLookupTable(greyscale);
+    m_windowLevelProperty->UseLookupTableScalarRangeOff();
+    m_windowLevelProperty->SetColorWindow(m_imageViewer->GetColorWindow());
+    m_windowLevelProperty->SetColorLevel(m_imageViewer->GetColorLevel());
+    m_imageViewer->GetImageActor()->SetProperty(m_windowLevelProperty);
+    for (int pane = 0; pane < OrthogonalSlicer::PLANE_COUNT; ++pane) {
+        m_mprActors[pane]->SetProperty(m_windowLevelProperty);
+    }
+    m_obliqueActor->SetProperty(m_windowLevelProperty);
+    m_slabActor->SetProperty(m_windowLevelProperty);
+    
+    // Mouse input of the 3D view bypasses the image interactor style
+    m_vtkWidget->installEventFilter(this);
 }
 
 void VolumeRenderer::setImageData(vtkImageData *imageData)
@@ -95,8 +319,15 @@ void VolumeRenderer::setImageData(vtkImageData *imageData)
         return;
     }
     
+    clearTimeSeries();
+    m_lazySource.reset();
+    m_lazySlice = nullptr;
     m_imageData = imageData;
-    m_imageViewer->SetInputData(imageData);
+    setViewerInput(imageData);
+    m_pyramid.reset();
+    m_histogram.reset();
+    m_mprSlicer->setBricks(nullptr);
+    m_previewCaster->clearVolume();
     
     // Update the pipeline before proceeding
     m_imageViewer->GetInput()->Modified();
@@ -104,14 +335,108 @@ void VolumeRenderer::setImageData(vtkImageData *imageData)
     
     updateSliceRange();
     
-    // Set to middle slice
+    // Set to middle slice; a slice requested for the previous volume is dropped
     int middleSlice = (getMinSlice() + getMaxSlice()) / 2;
-    setSlice(middleSlice);
+    m_slicePending = false;
+    m_currentSlice = middleSlice;
+    m_imageViewer->SetSlice(middleSlice);
+    emit sliceChanged(middleSlice);
     
     // Reset view
     resetView();
     
     updateRender();
+    
+    // Stay in 3D or tri-planar for the new volume when possible
+    if (m_renderMode == VOLUME_MODE) {
+        if (prepareVolume(0)) {
+            renderVolume();
+        } else {
+            setRenderMode(SLICE_MODE);
+        }
+    } else if (m_renderMode == TRI_PLANAR_MODE) {
+        if (prepareTriPlanar()) {
+            updateRender();
+        } else {
+            setRenderMode(SLICE_MODE);
+        }
+    } else if (m_renderMode == OBLIQUE_MODE) {
+        if (prepareOblique()) {
+            updateRender();
+        } else {
+            setRenderMode(SLICE_MODE);
+        }
+    } else if (m_renderMode == SLAB_MODE) {
+        if (prepareSlab()) {
+            updateRender();
+        } else {
+            setRenderMode(SLICE_MODE);
+        }
+    }
+}
+
+/**
+ * Displays a volume that is decoded slice by slice
+ * 
+ * The viewer only ever holds the current plane; its extent keeps the
+ * plane at the right depth so the camera and slice numbering match a
+ * fully loaded volume.
+ */
+void VolumeRenderer::setLazySource(std::shared_ptr<LazyVolumeSource> source)
+{
+    if (!source) {
+        qWarning() << "Null lazy source provided to VolumeRenderer";
+        return;
+    }
+    
+    // Lazy volumes are never resident, so there is nothing to ray cast
+    setRenderMode(SLICE_MODE);
+    clearTimeSeries();
+    m_lazySource = source;
+    m_pyramid.reset();
+    m_histogram.reset();
+    m_mprSlicer->setBricks(nullptr);
+    m_slicePending = false;
+    
+    // Show the middle slice before anything else queries the viewer's input
+    int middleSlice = (getMinSlice() + getMaxSlice()) / 2;
+    if (!showLazySlice(middleSlice)) {
+        return;
+    }
+    m_lazySource->prefetch(m_currentOrientation, middleSlice, 0);
+    
+    resetView();
+    emit sliceChanged(m_currentSlice);
+}
+
+/**
+ * Attaches the reduced levels of the displayed volume
+ * 
+ * The pyramid is built in the background after a load, so it arrives
+ * after setImageData(); the view switches to the level for the current
+ * zoom right away. A pyramid of any other volume is ignored.
+ */
+void VolumeRenderer::setPyramid(std::shared_ptr<VolumePyramid> pyramid)
+{
+    m_pyramid = pyramid;
+    if (!usesPyramid()) {
+        return;
+    }
+    
+    preparePreviewCaster();
+    refine();
+}
+
+/**
+ * Attaches a bricked copy of the displayed volume
+ * 
+ * Like the pyramid it arrives after setImageData(); the slicer reads the
+ * sagittal pane from it from the next extraction on. The copy is
+ * dropped with the volume so it is not held past its use.
+ */
+void VolumeRenderer::setBricks(std::shared_ptr<BrickedVolume> bricks)
+{
+    m_mprSlicer->setBricks(bricks);
 }
 
 QWidget* VolumeRenderer::getRenderWidget()
@@ -131,9 +456,40 @@ void VolumeRenderer::setSlice(int slice)
     // Clamp slice to valid range
     slice = qMax(minSlice, qMin(maxSlice, slice));
     
+    // Decoding waits for the next render, so slices scrubbed past in between are never read
+    if (m_lazySource) {
+        if (slice != (m_slicePending ? m_pendingSlice : m_currentSlice)) {
+            m_pendingSlice = slice;
+            m_slicePending = true;
+            scheduleRender();
+        }
+        return;
+    }
+    
+    // The tri-planar crosshair carries the slice along its axis
+    if (m_renderMode == TRI_PLANAR_MODE) {
+        int cursor[3] = { m_cursor[0], m_cursor[1], m_cursor[2] };
+        cursor[sliceAxis()] = slice;
+        setCursor(cursor);
+        return;
+    }
+    
     if (slice != m_currentSlice) {
         m_currentSlice = slice;
-        m_imageViewer->SetSlice(slice);
+        m_pendingSlice = slice;
+        m_slicePending = true;
+        
+        // The oblique plane pivots about a centre the slider carries along the slice axis
+        if (m_renderMode == OBLIQUE_MODE) {
+            int axis = sliceAxis();
+            m_obliqueCentre[axis] = m_imageData->GetOrigin()[axis] + slice * m_imageData->GetSpacing()[axis];
+            m_obliqueDirty = true;
+            m_obliquePreview = true;
+        }
+        if (m_renderMode == SLAB_MODE) {
+            m_slabDirty = true;
+        }
+        beginInteraction();
         updateRender();
         emit sliceChanged(slice);
     }
@@ -161,9 +517,33 @@ void VolumeRenderer::setOrientation(ViewOrientation orientation)
     
     updateSliceRange();
     
-    // Reset to middle slice for new orientation
-    int middleSlice = (getMinSlice() + getMaxSlice()) / 2;
-    setSlice(middleSlice);
+    // Reset to middle slice for new orientation; the tri-planar crosshair stays put
+    int middleSlice = m_renderMode == TRI_PLANAR_MODE ? m_cursor[sliceAxis()] : (getMinSlice() + getMaxSlice()) / 2;
+    m_slicePending = false;
+    if (m_lazySource) {
+        // The displayed plane belongs to the old orientation; always fetch a new one
+        if (showLazySlice(middleSlice)) {
+            m_lazySource->prefetch(m_currentOrientation, middleSlice, 0);
+            resetView();
+            emit sliceChanged(middleSlice);
+        }
+    } else if (m_imageData) {
+        // The viewer may hold a pyramid level; place the new plane explicitly
+        m_currentSlice = middleSlice;
+        showLevelSlice(usesPyramid() ? sliceLevel() : 0);
+        if (m_renderMode == OBLIQUE_MODE) {
+            resetObliquePlane();
+            m_obliqueRenderer->ResetCamera();
+        }
+        if (m_renderMode == SLAB_MODE) {
+            // The projection changes shape with the orientation; fit it now
+            m_slabDirty = true;
+            updateSlab();
+            m_slabRenderer->ResetCamera();
+        }
+        updateRender();
+        emit sliceChanged(middleSlice);
+    }
     
     emit orientationChanged(orientation);
 }
@@ -175,41 +555,124 @@ int VolumeRenderer::getCurrentSlice() const
 
 int VolumeRenderer::getMaxSlice() const
 {
-    if (!m_imageViewer) {
+    if (m_lazySource) {
+        return m_lazySource->sliceCount(m_currentOrientation) - 1;
+    }
+    if (!m_imageViewer || !m_imageData) {
         return 0;
     }
-    return m_imageViewer->GetSliceMax();
+    // From the volume itself: the viewer may be showing the preview
+    return m_imageData->GetExtent()[2 * sliceAxis() + 1];
 }
 
 int VolumeRenderer::getMinSlice() const
 {
-    if (!m_imageViewer) {
+    if (m_lazySource) {
+        return 0;
+    }
+    if (!m_imageViewer || !m_imageData) {
         return 0;
     }
-    return m_imageViewer->GetSliceMin();
+    return m_imageData->GetExtent()[2 * sliceAxis()];
 }
 
 void VolumeRenderer::resetView()
 {
+    if (m_renderMode == VOLUME_MODE) {
+        m_rayCaster->setCamera(CpuRayCaster::Camera());
+        refine();
+        return;
+    }
+    if (m_renderMode == TRI_PLANAR_MODE) {
+        for (int pane = 0; pane < OrthogonalSlicer::PLANE_COUNT; ++pane) {
+            m_mprRenderers[pane]->ResetCamera();
+        }
+        updateRender();
+        return;
+    }
+    if (m_renderMode == OBLIQUE_MODE) {
+        resetObliquePlane();
+        m_obliqueRenderer->ResetCamera();
+        updateRender();
+        return;
+    }
+    if (m_renderMode == SLAB_MODE) {
+        m_slabRenderer->ResetCamera();
+        updateRender();
+        return;
+    }
     if (m_imageViewer) {
         m_imageViewer->GetRenderer()->ResetCamera();
+        if (usesPyramid()) {
+            showLevelSlice(sliceLevel());
+        }
         updateRender();
     }
 }
 
 void VolumeRenderer::zoomIn()
 {
+    if (m_renderMode == VOLUME_MODE) {
+        CpuRayCaster::Camera camera = m_rayCaster->camera();
+        camera.zoom *= ZOOM_STEP;
+        m_rayCaster->setCamera(camera);
+        beginInteraction();
+        renderVolumePreview();
+        return;
+    }
+    if (m_renderMode == TRI_PLANAR_MODE) {
+        zoomTriPlanar(ZOOM_STEP);
+        return;
+    }
+    if (m_renderMode == OBLIQUE_MODE) {
+        m_obliqueRenderer->GetActiveCamera()->Zoom(ZOOM_STEP);
+        updateRender();
+        return;
+    }
+    if (m_renderMode == SLAB_MODE) {
+        m_slabRenderer->GetActiveCamera()->Zoom(ZOOM_STEP);
+        updateRender();
+        return;
+    }
     if (m_imageViewer) {
+        if (beginInteraction()) {
+            showLevelSlice(qMax(previewLevel(), sliceLevel()));
+        }
         vtkRenderer* renderer = m_imageViewer->GetRenderer();
         vtkCamera* camera = renderer->GetActiveCamera();
-        camera->Zoom(1.2);
+        camera->Zoom(ZOOM_STEP);
         updateRender();
     }
 }
 
 void VolumeRenderer::zoomOut()
 {
+    if (m_renderMode == VOLUME_MODE) {
+        CpuRayCaster::Camera camera = m_rayCaster->camera();
+        camera.zoom /= ZOOM_STEP;
+        m_rayCaster->setCamera(camera);
+        beginInteraction();
+        renderVolumePreview();
+        return;
+    }
+    if (m_renderMode == TRI_PLANAR_MODE) {
+        zoomTriPlanar(1.0 / ZOOM_STEP);
+        return;
+    }
+    if (m_renderMode == OBLIQUE_MODE) {
+        m_obliqueRenderer->GetActiveCamera()->Zoom(1.0 / ZOOM_STEP);
+        updateRender();
+        return;
+    }
+    if (m_renderMode == SLAB_MODE) {
+        m_slabRenderer->GetActiveCamera()->Zoom(1.0 / ZOOM_STEP);
+        updateRender();
+        return;
+    }
     if (m_imageViewer) {
+        if (beginInteraction()) {
+            showLevelSlice(qMax(previewLevel(), sliceLevel()));
+        }
         vtkRenderer* renderer = m_imageViewer->GetRenderer();
         vtkCamera* camera = renderer->GetActiveCamera();
         camera->Zoom(0.8);
@@ -222,30 +685,1365 @@ void VolumeRenderer::resetZoom()
     resetView();
 }
 
+/**
+ * Switches the render widget between the slice, 3D, tri-planar, oblique
+ * and slab views
+ * 
+ * The 3D view is ray cast on the CPU into an image shown by its own
+ * renderer, so it needs no GPU volume mapper. Entering it copies the
+ * volume into the ray caster; leaving it releases that copy. The
+ * tri-planar, oblique and slab views only hold a reference to the
+ * volume.
+ */
+bool VolumeRenderer::setRenderMode(RenderMode mode)
+{
+    if (mode == m_renderMode) {
+        return true;
+    }
+    
+    if (mode == VOLUME_MODE && !prepareVolume(volumeLevel())) {
+        return false;
+    }
+    if (mode == TRI_PLANAR_MODE && !prepareTriPlanar()) {
+        return false;
+    }
+    if (mode == OBLIQUE_MODE && !prepareOblique()) {
+        return false;
+    }
+    if (mode == SLAB_MODE && !prepareSlab()) {
+        return false;
+    }
+    
+    // Release what the previous mode held
+    if (m_renderMode == VOLUME_MODE) {
+        m_rotating = false;
+        m_rayCaster->clearVolume();
+        m_previewCaster->clearVolume();
+        m_casterLevel = -1;
+    } else if (m_renderMode == TRI_PLANAR_MODE) {
+        m_mprSlicer->setVolume(nullptr);
+        m_dragPane = -1;
+    } else if (m_renderMode == OBLIQUE_MODE) {
+        m_rotating = false;
+        m_obliqueSlicer->setVolume(nullptr);
+        m_obliquePreview = false;
+    } else if (m_renderMode == SLAB_MODE) {
+        m_slabProjector->setVolume(nullptr);
+    }
+    
+    m_renderMode = mode;
+    attachRenderers();
+    if (mode == VOLUME_MODE) {
+        preparePreviewCaster();
+        renderVolume();
+    } else {
+        refine();
+        updateRender();
+    }
+    
+    emit renderModeChanged(mode);
+    return true;
+}
+
+VolumeRenderer::RenderMode VolumeRenderer::getRenderMode() const
+{
+    return m_renderMode;
+}
+
+void VolumeRenderer::setVolumeBlendMode(CpuRayCaster::BlendMode mode)
+{
+    m_rayCaster->setBlendMode(mode);
+    renderVolume();
+}
+
+void VolumeRenderer::setVolumeTransferFunction(const CpuRayCaster::TransferFunction &transferFunction)
+{
+    // Dragging the threshold or opacity sliders is interactive too
+    m_rayCaster->setTransferFunction(transferFunction);
+    beginInteraction();
+    renderVolumePreview();
+}
+
+CpuRayCaster::TransferFunction VolumeRenderer::getVolumeTransferFunction() const
+{
+    return m_rayCaster->transferFunction();
+}
+
+/**
+ * Moves the tri-planar crosshair to a voxel
+ * 
+ * Only the planes whose position changed are marked for extraction. The
+ * slice of the current orientation follows the crosshair, so the slider
+ * and the slice view agree with the panes.
+ */
+void VolumeRenderer::setCursor(const int cursor[3])
+{
+    if (!m_imageData || m_lazySource) {
+        return;
+    }
+    
+    int extent[6];
+    m_imageData->GetExtent(extent);
+    int changedPlanes = 0;
+    for (int plane = 0; plane < OrthogonalSlicer::PLANE_COUNT; ++plane) {
+        int axis = OrthogonalSlicer::normalAxis(plane);
+        int position = qBound(extent[2 * axis], cursor[axis], extent[2 * axis + 1]);
+        if (position != m_cursor[axis]) {
+            m_cursor[axis] = position;
+            changedPlanes |= 1 << plane;
+        }
+    }
+    if (!changedPlanes) {
+        return;
+    }
+    m_dirtyPlanes |= changedPlanes;
+    
+    if (m_cursor[sliceAxis()] != m_currentSlice) {
+        m_currentSlice = m_cursor[sliceAxis()];
+        m_pendingSlice = m_currentSlice;
+        m_slicePending = true;
+        emit sliceChanged(m_currentSlice);
+    }
+    updateRender();
+    emit cursorChanged(m_cursor[0], m_cursor[1], m_cursor[2]);
+}
 
+void VolumeRenderer::getCursor(int cursor[3]) const
+{
+    cursor[0] = m_cursor[0];
+    cursor[1] = m_cursor[1];
+    cursor[2] = m_cursor[2];
+}
 
+void VolumeRenderer::setObliqueInterpolation(ObliqueSlicer::Interpolation interpolation)
+{
+    m_obliqueSlicer->setInterpolation(interpolation);
+    m_obliqueDirty = true;
+    updateRender();
+}
 
+void VolumeRenderer::getObliqueNormal(double normal[3]) const
+{
+    normal[0] = m_obliqueAxes[2][0];
+    normal[1] = m_obliqueAxes[2][1];
+    normal[2] = m_obliqueAxes[2][2];
+}
 
+void VolumeRenderer::setSlabProjection(SlabProjector::Projection projection)
+{
+    m_slabProjector->setProjection(projection);
+    m_slabDirty = true;
+    updateRender();
+}
 
+void VolumeRenderer::setSlabThickness(int slices)
+{
+    m_slabProjector->setThickness(slices);
+    m_slabDirty = true;
+    updateRender();
+}
 
-void VolumeRenderer::updateRender()
+/**
+ * Moves the range of the shared lookup table
+ * 
+ * No image is re-mapped here; each visible actor re-colours its own
+ * pixels through the table at the next render.
+ */
+void VolumeRenderer::setWindowLevel(double window, double level)
 {
-    if (m_renderWindow) {
-        m_renderWindow->Render();
+    window = qMax(window, MIN_WINDOW);
+    if (window == m_windowLevelProperty->GetColorWindow() && level == m_windowLevelProperty->GetColorLevel()) {
+        return;
     }
+    m_windowLevelProperty->SetColorWindow(window);
+    m_windowLevelProperty->SetColorLevel(level);
+    emit windowLevelChanged(window, level);
+    updateRender();
 }
 
-void VolumeRenderer::updateSliceRange()
+void VolumeRenderer::getWindowLevel(double &window, double &level) const
 {
-    if (m_imageViewer && m_imageData) {
-        m_imageViewer->UpdateDisplayExtent();
-        
-        // Get the current slice range
-        int minSlice = getMinSlice();
-        int maxSlice = getMaxSlice();
-        
-        qDebug() << "Slice range updated:" << minSlice << "to" << maxSlice;
+    window = m_windowLevelProperty->GetColorWindow();
+    level = m_windowLevelProperty->GetColorLevel();
+}
+
+/**
+ * Attaches the histogram of the displayed volume
+ * 
+ * It is computed in the background after the load, so it arrives after
+ * setImageData(), which drops the previous volume's histogram. An open
+ * oblique view takes the volume minimum from it as its background.
+ */
+void VolumeRenderer::setHistogram(std::shared_ptr<IntensityHistogram> histogram)
+{
+    m_histogram = histogram;
+    if (m_histogram && m_renderMode == OBLIQUE_MODE) {
+        m_obliqueSlicer->setBackground(m_histogram->minimum());
+        m_obliqueDirty = true;
+        updateRender();
+    }
+}
+
+/**
+ * Sets the window to span two percentiles of the volume
+ * 
+ * With a histogram this is a walk over its bins. Without one - a lazily
+ * opened volume, or a decoded one whose histogram is still being
+ * computed - the range of the slice on display stands in; the range of
+ * the whole volume would be the very scan the histogram saves. If that
+ * slice cannot be cut out, the current window is kept and false returned.
+ */
+bool VolumeRenderer::applyContrastPercentiles(double lowFraction, double highFraction)
+{
+    double window = 0.0;
+    double level = 0.0;
+    if (m_histogram) {
+        m_histogram->percentileWindow(lowFraction, highFraction, window, level);
+    } else if (m_imageData) {
+        // A lazy volume's image data is already the slice on display
+        vtkImageData *image = m_imageData;
+        OrthogonalSlicer slicer;
+        if (!m_lazySource) {
+            int cursor[3] = { 0, 0, 0 };
+            cursor[OrthogonalSlicer::normalAxis(m_currentOrientation)] = m_currentSlice;
+            slicer.setVolume(m_imageData);
+            if (!slicer.extract(cursor, 1 << m_currentOrientation)) {
+                return false;
+            }
+            image = slicer.plane(m_currentOrientation);
+        }
+        double *range = image->GetScalarRange();
+        window = range[1] - range[0];
+        level = 0.5 * (range[0] + range[1]);
+    } else {
+        return false;
+    }
+    setWindowLevel(window, level);
+    return true;
+}
+
+/**
+ * Attaches the frames of a 4D file to the volume already displayed
+ * 
+ * The volume passed to setImageData() is frame 0. Later frames are
+ * decoded ahead by a FrameRingBuffer sized to a fixed memory budget, so
+ * only a handful of timepoints are ever resident.
+ */
+void VolumeRenderer::setTimeSeries(std::shared_ptr<TimeSeriesSource> source)
+{
+    clearTimeSeries();
+    if (!source || source->frameCount() < 2 || m_lazySource) {
+        return;
+    }
+    
+    int capacity = static_cast<int>(FRAME_BUFFER_BYTES / qMax<qint64>(1, source->frameBytes()));
+    capacity = qBound(MIN_BUFFERED_FRAMES, capacity, MAX_BUFFERED_FRAMES);
+    
+    m_timeSeries = source;
+    m_frameBuffer = std::make_unique<FrameRingBuffer>(source, capacity);
+    m_frameBuffer->start(1);
+    m_currentFrame = 0;
+    
+    emit frameChanged(m_currentFrame);
+}
+
+int VolumeRenderer::getFrameCount() const
+{
+    return m_timeSeries ? m_timeSeries->frameCount() : 1;
+}
+
+int VolumeRenderer::getCurrentFrame() const
+{
+    return m_currentFrame;
+}
+
+void VolumeRenderer::setFrame(int frame)
+{
+    if (!m_frameBuffer) {
+        return;
+    }
+    
+    frame = qMax(0, qMin(getFrameCount() - 1, frame));
+    if (frame == m_currentFrame) {
+        return;
+    }
+    
+    // An explicit step waits for the decode; the buffer then continues after this frame
+    vtkSmartPointer<vtkImageData> image = m_frameBuffer->takeFrame(frame, true);
+    if (!image) {
+        qWarning() << "Failed to decode frame" << frame << "of" << m_timeSeries->filePath();
+        stopPlayback();
+        return;
+    }
+    showFrame(image, frame);
+}
+
+void VolumeRenderer::nextFrame()
+{
+    if (m_frameBuffer) {
+        setFrame((m_currentFrame + 1) % getFrameCount());
     }
 }
 
+void VolumeRenderer::previousFrame()
+{
+    if (m_frameBuffer) {
+        setFrame((m_currentFrame + getFrameCount() - 1) % getFrameCount());
+    }
+}
+
+void VolumeRenderer::startPlayback(double framesPerSecond)
+{
+    if (!m_frameBuffer || framesPerSecond <= 0.0) {
+        return;
+    }
+    
+    m_stalledFrames = 0;
+    m_playbackTimer->start(qMax(1, qRound(1000.0 / framesPerSecond)));
+    emit playbackStateChanged(true);
+}
+
+void VolumeRenderer::stopPlayback()
+{
+    if (!m_playbackTimer->isActive()) {
+        return;
+    }
+    
+    m_playbackTimer->stop();
+    if (m_stalledFrames > 0) {
+        qDebug() << "Playback skipped" << m_stalledFrames << "ticks waiting for frames";
+    }
+    emit playbackStateChanged(false);
+}
 
+bool VolumeRenderer::isPlaying() const
+{
+    return m_playbackTimer->isActive();
+}
+
+int VolumeRenderer::getStalledFrames() const
+{
+    return m_stalledFrames;
+}
+
+/**
+ * Shows the next frame if the decoder has it ready
+ * 
+ * The GUI thread never waits here: when decoding falls behind, the
+ * current frame stays up for another tick and the skip is counted.
+ */
+void VolumeRenderer::advancePlayback()
+{
+    if (!m_frameBuffer) {
+        stopPlayback();
+        return;
+    }
+    
+    int next = (m_currentFrame + 1) % getFrameCount();
+    vtkSmartPointer<vtkImageData> image = m_frameBuffer->takeFrame(next, false);
+    if (!image) {
+        if (m_frameBuffer->hasFailed()) {
+            qWarning() << "Playback stopped: failed to decode" << m_timeSeries->filePath();
+            stopPlayback();
+        } else {
+            ++m_stalledFrames;
+        }
+        return;
+    }
+    showFrame(image, next);
+}
+
+/**
+ * Asks for the volume at full resolution, one ray per screen pixel
+ */
+void VolumeRenderer::renderVolume()
+{
+    if (m_renderMode != VOLUME_MODE) {
+        return;
+    }
+    m_volumeRequest = FULL_VOLUME_RENDER;
+    scheduleRender();
+}
+
+/**
+ * Asks for a frame whose cost does not grow with the volume or window
+ * 
+ * The latest request wins: a drag that follows a refine replaces the
+ * full-resolution cast with a preview rather than waiting for it.
+ */
+void VolumeRenderer::renderVolumePreview()
+{
+    if (m_renderMode != VOLUME_MODE) {
+        return;
+    }
+    m_volumeRequest = PREVIEW_VOLUME_RENDER;
+    scheduleRender();
+}
+
+/**
+ * Ray casts into the 3D view's image actor
+ * 
+ * A preview is capped at PREVIEW_PIXELS rays and stretched to the view;
+ * with a pyramid its rays also take a bounded number of samples.
+ */
+void VolumeRenderer::castVolume(bool preview)
+{
+    if (!m_rayCaster->hasVolume()) {
+        return;
+    }
+    
+    int *size = m_renderWindow->GetSize();
+    int width = qMax(1, size[0]);
+    int height = qMax(1, size[1]);
+    if (!preview) {
+        renderVolumeImage(m_rayCaster.get(), width, height);
+        return;
+    }
+    double scale = qMin(1.0, std::sqrt(PREVIEW_PIXELS / (static_cast<double>(width) * height)));
+    
+    CpuRayCaster *caster = m_rayCaster.get();
+    if (usesPyramid() && m_previewCaster->hasVolume()) {
+        m_previewCaster->setBlendMode(m_rayCaster->blendMode());
+        m_previewCaster->setTransferFunction(m_rayCaster->transferFunction());
+        m_previewCaster->setCamera(m_rayCaster->camera());
+        caster = m_previewCaster.get();
+    }
+    renderVolumeImage(caster, qMax(1, qRound(width * scale)), qMax(1, qRound(height * scale)));
+}
+
+void VolumeRenderer::renderVolumeImage(CpuRayCaster *caster, int width, int height)
+{
+    vtkImageData *image = caster->render(width, height);
+    if (!image) {
+        return;
+    }
+    m_volumeActor->SetInputData(image);
+    
+    // Fit the image exactly to the viewport
+    vtkCamera *camera = m_volumeRenderer->GetActiveCamera();
+    camera->SetFocalPoint(0.5 * (width - 1), 0.5 * (height - 1), 0.0);
+    camera->SetPosition(0.5 * (width - 1), 0.5 * (height - 1), 1.0);
+    camera->SetViewUp(0.0, 1.0, 0.0);
+    camera->SetParallelScale(0.5 * height);
+    m_volumeRenderer->ResetCameraClippingRange();
+    
+    emit volumeRendered(caster->lastRenderSeconds(), caster->lastSampleCount());
+}
+
+/**
+ * Turns mouse input on the render widget into 3D camera moves
+ * 
+ * Only active in the 3D view: left-drag orbits, the wheel zooms. Mouse
+ * events are consumed so the slice interactor style never sees them.
+ * The tri-planar and oblique views have handlers of their own. Resizes
+ * of any view pick the level for the new pixel density.
+ */
+bool VolumeRenderer::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched != m_vtkWidget) {
+        return QObject::eventFilter(watched, event);
+    }
+    
+    // The level to show depends on the pixel density; the render window
+    // takes the new size while this event is handled
+    if (event->type() == QEvent::Resize) {
+        QTimer::singleShot(0, this, &VolumeRenderer::refine);
+        return QObject::eventFilter(watched, event);
+    }
+    if (m_renderMode != VOLUME_MODE && handleWindowLevelEvent(event)) {
+        return true;
+    }
+    if (m_renderMode == TRI_PLANAR_MODE) {
+        return handleTriPlanarEvent(event) || QObject::eventFilter(watched, event);
+    }
+    if (m_renderMode == OBLIQUE_MODE) {
+        return handleObliqueEvent(event) || QObject::eventFilter(watched, event);
+    }
+    if (m_renderMode != VOLUME_MODE) {
+        return QObject::eventFilter(watched, event);
+    }
+    
+    switch (event->type()) {
+        case QEvent::MouseButtonPress: {
+            QMouseEvent *mouseEvent = static_cast<QMouseEvent *>(event);
+            if (mouseEvent->button() == Qt::LeftButton) {
+                m_rotating = true;
+                m_lastMousePosition = mouseEvent->position().toPoint();
+            }
+            return true;
+        }
+        case QEvent::MouseMove: {
+            QMouseEvent *mouseEvent = static_cast<QMouseEvent *>(event);
+            if (m_rotating) {
+                QPoint position = mouseEvent->position().toPoint();
+                QPoint delta = position - m_lastMousePosition;
+                m_lastMousePosition = position;
+                
+                // The volume follows the mouse
+                CpuRayCaster::Camera camera = m_rayCaster->camera();
+                camera.azimuth += delta.x() * DEGREES_PER_PIXEL;
+                camera.elevation += delta.y() * DEGREES_PER_PIXEL;
+                m_rayCaster->setCamera(camera);
+                beginInteraction();
+                renderVolumePreview();
+            }
+            return true;
+        }
+        case QEvent::MouseButtonRelease:
+            if (static_cast<QMouseEvent *>(event)->button() == Qt::LeftButton) {
+                m_rotating = false;
+            }
+            return true;
+        case QEvent::MouseButtonDblClick:
+            return true;
+        case QEvent::Wheel: {
+            int steps = static_cast<QWheelEvent *>(event)->angleDelta().y();
+            if (steps > 0) {
+                zoomIn();
+            } else if (steps < 0) {
+                zoomOut();
+            }
+            return true;
+        }
+        default:
+            break;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+/**
+ * Window/level drag, on the 2D views only
+ * 
+ * Plain left-drag in the slice and slab views, which have no other use
+ * for it; Shift+left-drag in the tri-planar and oblique views, where the
+ * plain drag moves the crosshair or tilts the plane. Right and middle
+ * buttons stay with the interactor style. Horizontal movement scales
+ * the window, vertical movement shifts the level, both relative to the
+ * window at the start of the drag so the feel is the same at any range.
+ */
+bool VolumeRenderer::handleWindowLevelEvent(QEvent *event)
+{
+    switch (event->type()) {
+        case QEvent::MouseButtonPress: {
+            QMouseEvent *mouseEvent = static_cast<QMouseEvent *>(event);
+            if (mouseEvent->button() != Qt::LeftButton || !m_imageData) {
+                return false;
+            }
+            bool plainDrag = m_renderMode == SLICE_MODE || m_renderMode == SLAB_MODE;
+            bool shifted = mouseEvent->modifiers().testFlag(Qt::ShiftModifier);
+            if (shifted == plainDrag) {
+                return false;
+            }
+            m_windowLeveling = true;
+            m_windowLevelOrigin = mouseEvent->position().toPoint();
+            getWindowLevel(m_dragWindow, m_dragLevel);
+            return true;
+        }
+        case QEvent::MouseMove: {
+            if (!m_windowLeveling) {
+                return false;
+            }
+            QPoint delta = static_cast<QMouseEvent *>(event)->position().toPoint() - m_windowLevelOrigin;
+            double window = m_dragWindow * std::pow(2.0, delta.x() / WINDOW_LEVEL_PIXELS);
+            double level = m_dragLevel - delta.y() * m_dragWindow / WINDOW_LEVEL_PIXELS;
+            setWindowLevel(window, level);
+            return true;
+        }
+        case QEvent::MouseButtonRelease:
+            if (!m_windowLeveling || static_cast<QMouseEvent *>(event)->button() != Qt::LeftButton) {
+                return false;
+            }
+            m_windowLeveling = false;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void VolumeRenderer::updateRender()
+{
+    if (m_renderWindow) {
+        scheduleRender();
+    }
+}
+
+/**
+ * Queues a render for the next display refresh
+ * 
+ * Requests arriving while one is queued only bump the skipped count; the
+ * queued render picks up whatever state is current when it runs.
+ */
+void VolumeRenderer::scheduleRender()
+{
+    if (m_renderTimer->isActive()) {
+        ++m_skippedRenders;
+        return;
+    }
+    
+    QScreen *screen = m_vtkWidget ? m_vtkWidget->screen() : nullptr;
+    double refreshRate = screen && screen->refreshRate() > 0.0 ? screen->refreshRate() : DEFAULT_REFRESH_RATE;
+    int frameMs = static_cast<int>(std::ceil(1000.0 / refreshRate));
+    
+    // Right away after an idle period, otherwise one refresh after the last render
+    int delay = m_frameClock.isValid() ? qMax(0, frameMs - static_cast<int>(m_frameClock.elapsed())) : 0;
+    m_renderTimer->start(delay);
+}
+
+/**
+ * Draws once with the latest state of everything that was requested
+ */
+void VolumeRenderer::flushRender()
+{
+    if (m_slicePending) {
+        m_slicePending = false;
+        applyPendingSlice();
+    }
+    
+    VolumeRequest request = m_volumeRequest;
+    m_volumeRequest = NO_VOLUME_RENDER;
+    if (m_renderMode == VOLUME_MODE && request != NO_VOLUME_RENDER) {
+        castVolume(request == PREVIEW_VOLUME_RENDER);
+    }
+    if (m_renderMode == TRI_PLANAR_MODE) {
+        updateTriPlanar();
+    }
+    if (m_renderMode == OBLIQUE_MODE) {
+        updateOblique();
+    }
+    if (m_renderMode == SLAB_MODE) {
+        updateSlab();
+    }
+    
+    m_renderWindow->Render();
+    ++m_renderedFrames;
+    m_frameClock.restart();
+}
+
+void VolumeRenderer::applyPendingSlice()
+{
+    if (m_lazySource) {
+        int direction = m_pendingSlice > m_currentSlice ? 1 : (m_pendingSlice < m_currentSlice ? -1 : 0);
+        if (direction != 0 && showLazySlice(m_pendingSlice)) {
+            m_lazySource->prefetch(m_currentOrientation, m_currentSlice, direction);
+            emit sliceChanged(m_currentSlice);
+        }
+        return;
+    }
+    
+    if (usesPyramid()) {
+        showLevelSlice(qMax(previewLevel(), sliceLevel()));
+    } else {
+        m_imageViewer->SetSlice(m_currentSlice);
+    }
+}
+
+long long VolumeRenderer::getRenderedFrames() const
+{
+    return m_renderedFrames;
+}
+
+long long VolumeRenderer::getSkippedRenders() const
+{
+    return m_skippedRenders;
+}
+
+void VolumeRenderer::updateSliceRange()
+{
+    if (m_imageViewer && m_imageData) {
+        m_imageViewer->UpdateDisplayExtent();
+        
+        // Get the current slice range
+        int minSlice = getMinSlice();
+        int maxSlice = getMaxSlice();
+        
+        qDebug() << "Slice range updated:" << minSlice << "to" << maxSlice;
+    }
+}
+
+bool VolumeRenderer::showLazySlice(int slice)
+{
+    vtkSmartPointer<vtkImageData> image = m_lazySource->slice(m_currentOrientation, slice);
+    if (!image) {
+        qWarning() << "Failed to decode slice" << slice << "from" << m_lazySource->filePath();
+        return false;
+    }
+    
+    // Keep the plane alive for as long as the viewer shows it
+    m_lazySlice = image;
+    m_imageData = image;
+    m_currentSlice = slice;
+    
+    setViewerInput(image);
+    m_imageViewer->SetSlice(slice);
+    return true;
+}
+
+/**
+ * Feeds an image to the slice view's actor directly
+ * 
+ * vtkImageViewer2 routes its input through a window/level filter that
+ * converts the whole displayed slice to colours whenever the contrast
+ * changes. The viewer keeps the input for its extent and slice
+ * bookkeeping, but the actor reads the scalars itself and maps them
+ * through the shared lookup table.
+ */
+void VolumeRenderer::setViewerInput(vtkImageData *image)
+{
+    m_imageViewer->SetInputData(image);
+    m_imageViewer->GetImageActor()->SetInputData(image);
+}
+
+void VolumeRenderer::showFrame(vtkImageData *frame, int index)
+{
+    // Keep the frame alive for as long as the viewer shows it
+    m_frameImage = frame;
+    m_imageData = frame;
+    m_currentFrame = index;
+    
+    // Same geometry as the previous frame, so slice and camera carry over
+    setViewerInput(frame);
+    m_imageViewer->SetSlice(m_currentSlice);
+    updateRender();
+    
+    if (m_renderMode == VOLUME_MODE && prepareVolume(0)) {
+        renderVolume();
+    }
+    if (m_renderMode == TRI_PLANAR_MODE) {
+        m_mprSlicer->setVolume(frame);
+        m_dirtyPlanes = OrthogonalSlicer::ALL_PLANES;
+    }
+    if (m_renderMode == OBLIQUE_MODE) {
+        m_obliqueSlicer->setVolume(frame);
+        m_obliqueDirty = true;
+    }
+    if (m_renderMode == SLAB_MODE) {
+        m_slabProjector->setVolume(frame);
+        m_slabDirty = true;
+    }
+    
+    emit frameChanged(index);
+}
+
+void VolumeRenderer::clearTimeSeries()
+{
+    stopPlayback();
+    m_frameBuffer.reset();
+    m_timeSeries.reset();
+    m_frameImage = nullptr;
+    m_currentFrame = 0;
+}
+
+/**
+ * Copies one level of the displayed volume into the ray caster
+ * 
+ * With a pyramid, levels are normalized over the full volume's range, so
+ * switching level on zoom keeps the colours and never scans level 0.
+ */
+bool VolumeRenderer::prepareVolume(int level)
+{
+    if (m_lazySource || !m_imageData) {
+        qWarning() << "3D rendering needs a fully loaded volume";
+        return false;
+    }
+    
+    bool prepared = false;
+    if (usesPyramid()) {
+        double range[2];
+        m_pyramid->getScalarRange(range);
+        prepared = m_rayCaster->setVolume(levelImage(level), range);
+    } else {
+        level = 0;
+        prepared = m_rayCaster->setVolume(m_imageData);
+    }
+    if (!prepared) {
+        qWarning() << "Unsupported volume for 3D rendering";
+        m_casterLevel = -1;
+        return false;
+    }
+    m_casterLevel = level;
+    return true;
+}
+
+void VolumeRenderer::preparePreviewCaster()
+{
+    m_previewCaster->clearVolume();
+    if (m_renderMode != VOLUME_MODE || !usesPyramid()) {
+        return;
+    }
+    
+    double range[2];
+    m_pyramid->getScalarRange(range);
+    m_previewCaster->setVolume(levelImage(previewLevel()), range);
+}
+
+bool VolumeRenderer::usesPyramid() const
+{
+    // Frames of a time series other than the first have no pyramid
+    return m_pyramid && m_pyramid->levelCount() > 1 && m_pyramid->level(0) == m_imageData && !m_lazySource;
+}
+
+vtkImageData *VolumeRenderer::levelImage(int level) const
+{
+    return usesPyramid() ? m_pyramid->level(level) : m_imageData;
+}
+
+/**
+ * The level whose longest axis fits PREVIEW_SIZE, so an interactive frame
+ * costs the same for any volume size
+ */
+int VolumeRenderer::previewLevel() const
+{
+    return usesPyramid() ? m_pyramid->levelForSize(PREVIEW_SIZE) : 0;
+}
+
+int VolumeRenderer::sliceLevel() const
+{
+    int *size = m_renderWindow->GetSize();
+    if (!usesPyramid() || size[1] < 1) {
+        return 0;
+    }
+    
+    // Screen pixel size in mm against the finest in-plane voxel spacing
+    double millimetresPerPixel = 2.0 * m_imageViewer->GetRenderer()->GetActiveCamera()->GetParallelScale() / size[1];
+    double *spacing = m_imageData->GetSpacing();
+    int axis = sliceAxis();
+    double finest = qMin(spacing[(axis + 1) % 3], spacing[(axis + 2) % 3]);
+    return m_pyramid->levelForVoxelsPerPixel(millimetresPerPixel / finest);
+}
+
+int VolumeRenderer::volumeLevel() const
+{
+    int *size = m_renderWindow->GetSize();
+    if (!usesPyramid() || size[0] < 1 || size[1] < 1) {
+        return 0;
+    }
+    
+    // Image pixel size in mm against the finest voxel spacing
+    double *spacing = m_imageData->GetSpacing();
+    double finest = qMin(spacing[0], qMin(spacing[1], spacing[2]));
+    double millimetresPerPixel = CpuRayCaster::pixelSpacing(m_imageData, m_rayCaster->camera(), size[0], size[1]);
+    return m_pyramid->levelForVoxelsPerPixel(millimetresPerPixel / finest);
+}
+
+bool VolumeRenderer::beginInteraction()
+{
+    m_refineTimer->start();
+    return usesPyramid();
+}
+
+void VolumeRenderer::showLevelSlice(int level)
+{
+    vtkImageData *image = levelImage(level);
+    
+    // Nearest slice of the level to the physical plane of the current slice
+    int axis = sliceAxis();
+    double position = m_imageData->GetOrigin()[axis] + m_currentSlice * m_imageData->GetSpacing()[axis];
+    int levelSlice = qRound((position - image->GetOrigin()[axis]) / image->GetSpacing()[axis]);
+    int *extent = image->GetExtent();
+    levelSlice = qBound(extent[2 * axis], levelSlice, extent[2 * axis + 1]);
+    
+    if (m_imageViewer->GetInput() != image) {
+        setViewerInput(image);
+    }
+    m_imageViewer->SetSlice(levelSlice);
+}
+
+/**
+ * Draws the level that matches the zoom once interaction pauses
+ */
+void VolumeRenderer::refine()
+{
+    if (m_renderMode == VOLUME_MODE) {
+        int level = volumeLevel();
+        if (level != m_casterLevel && !prepareVolume(level)) {
+            return;
+        }
+        renderVolume();
+        return;
+    }
+    
+    // The oblique plane was resampled coarsely while the user interacted
+    if (m_renderMode == OBLIQUE_MODE) {
+        if (m_obliquePreview) {
+            m_obliquePreview = false;
+            m_obliqueDirty = true;
+            updateRender();
+        }
+        return;
+    }
+    
+    // The tri-planar panes and the slab always show full resolution
+    if (!m_imageData || m_lazySource || m_renderMode == TRI_PLANAR_MODE || m_renderMode == SLAB_MODE) {
+        return;
+    }
+    int level = sliceLevel();
+    if (m_imageViewer->GetInput() != levelImage(level)) {
+        showLevelSlice(level);
+        updateRender();
+    }
+}
+
+void VolumeRenderer::attachRenderers()
+{
+    m_renderWindow->RemoveRenderer(m_imageViewer->GetRenderer());
+    m_renderWindow->RemoveRenderer(m_volumeRenderer);
+    m_renderWindow->RemoveRenderer(m_obliqueRenderer);
+    m_renderWindow->RemoveRenderer(m_slabRenderer);
+    for (int pane = 0; pane < 4; ++pane) {
+        m_renderWindow->RemoveRenderer(m_mprRenderers[pane]);
+    }
+    
+    switch (m_renderMode) {
+        case VOLUME_MODE:
+            m_renderWindow->AddRenderer(m_volumeRenderer);
+            break;
+        case TRI_PLANAR_MODE:
+            for (int pane = 0; pane < 4; ++pane) {
+                m_renderWindow->AddRenderer(m_mprRenderers[pane]);
+            }
+            break;
+        case OBLIQUE_MODE:
+            m_renderWindow->AddRenderer(m_obliqueRenderer);
+            break;
+        case SLAB_MODE:
+            m_renderWindow->AddRenderer(m_slabRenderer);
+            break;
+        default:
+            m_renderWindow->AddRenderer(m_imageViewer->GetRenderer());
+            break;
+    }
+}
+
+/**
+ * Points the slicer at the displayed volume and centres the crosshair
+ * 
+ * The crosshair starts on the current slice, so switching from the slice
+ * view keeps that plane in its pane.
+ */
+bool VolumeRenderer::prepareTriPlanar()
+{
+    if (m_lazySource || !m_imageData) {
+        qWarning() << "The tri-planar view needs a fully loaded volume";
+        return false;
+    }
+    m_mprSlicer->setVolume(m_imageData);
+    
+    int extent[6];
+    m_imageData->GetExtent(extent);
+    for (int axis = 0; axis < 3; ++axis) {
+        m_cursor[axis] = (extent[2 * axis] + extent[2 * axis + 1]) / 2;
+    }
+    m_cursor[sliceAxis()] = m_currentSlice;
+    m_dirtyPlanes = OrthogonalSlicer::ALL_PLANES;
+    updateTriPlanar();
+    
+    for (int pane = 0; pane < OrthogonalSlicer::PLANE_COUNT; ++pane) {
+        m_mprRenderers[pane]->ResetCamera();
+    }
+    emit cursorChanged(m_cursor[0], m_cursor[1], m_cursor[2]);
+    return true;
+}
+
+/**
+ * Brings the panes up to date with the crosshair before a render
+ * 
+ * The moved planes are cut in one parallel pass; the crosshair lines are
+ * cheap and always repositioned. Window and level follow the slice view.
+ */
+void VolumeRenderer::updateTriPlanar()
+{
+    vtkImageData *volume = m_mprSlicer->volume();
+    if (!volume) {
+        return;
+    }
+    
+    if (m_dirtyPlanes) {
+        if (!m_mprSlicer->extract(m_cursor, m_dirtyPlanes)) {
+            qWarning() << "Unsupported volume for the tri-planar view";
+        }
+        m_dirtyPlanes = 0;
+    }
+    
+    int extent[6];
+    double spacing[3];
+    volume->GetExtent(extent);
+    volume->GetSpacing(spacing);
+    for (int pane = 0; pane < OrthogonalSlicer::PLANE_COUNT; ++pane) {
+        vtkImageData *plane = m_mprSlicer->plane(pane);
+        if (!plane) {
+            continue;
+        }
+        if (m_mprActors[pane]->GetInput() != plane) {
+            m_mprActors[pane]->SetInputData(plane);
+        }
+        
+        // Pane coordinates are millimetres from the first voxel, lines drawn just above the plane
+        int columnAxis = OrthogonalSlicer::columnAxis(pane);
+        int rowAxis = OrthogonalSlicer::rowAxis(pane);
+        double columnSpacing = spacing[columnAxis];
+        double rowSpacing = spacing[rowAxis];
+        double x = (m_cursor[columnAxis] - extent[2 * columnAxis]) * columnSpacing;
+        double y = (m_cursor[rowAxis] - extent[2 * rowAxis]) * rowSpacing;
+        double right = (extent[2 * columnAxis + 1] - extent[2 * columnAxis] + 0.5) * columnSpacing;
+        double top = (extent[2 * rowAxis + 1] - extent[2 * rowAxis] + 0.5) * rowSpacing;
+        double z = 0.5 * qMin(columnSpacing, rowSpacing);
+        
+        vtkPoints *points = m_crosshairs[pane]->GetPoints();
+        points->SetPoint(0, x, -0.5 * rowSpacing, z);
+        points->SetPoint(1, x, top, z);
+        points->SetPoint(2, -0.5 * columnSpacing, y, z);
+        points->SetPoint(3, right, y, z);
+        points->Modified();
+    }
+}
+
+void VolumeRenderer::zoomTriPlanar(double factor)
+{
+    for (int pane = 0; pane < OrthogonalSlicer::PLANE_COUNT; ++pane) {
+        m_mprRenderers[pane]->GetActiveCamera()->Zoom(factor);
+    }
+    updateRender();
+}
+
+/**
+ * Finds the pane under a widget position and the pane point there
+ * 
+ * Qt positions are in logical pixels from the top; VTK display
+ * coordinates are device pixels from the bottom.
+ */
+int VolumeRenderer::paneAt(const QPoint &position, double world[3]) const
+{
+    int *size = m_renderWindow->GetSize();
+    double ratio = m_vtkWidget->devicePixelRatioF();
+    int x = qRound(position.x() * ratio);
+    int y = size[1] - 1 - qRound(position.y() * ratio);
+    
+    for (int pane = 0; pane < OrthogonalSlicer::PLANE_COUNT; ++pane) {
+        vtkRenderer *renderer = m_mprRenderers[pane];
+        if (!renderer->IsInViewport(x, y)) {
+            continue;
+        }
+        renderer->SetDisplayPoint(x, y, 0.0);
+        renderer->DisplayToWorld();
+        double point[4];
+        renderer->GetWorldPoint(point);
+        double w = point[3] != 0.0 ? point[3] : 1.0;
+        world[0] = point[0] / w;
+        world[1] = point[1] / w;
+        world[2] = point[2] / w;
+        return pane;
+    }
+    return -1;
+}
+
+/**
+ * Left click or drag in a pane moves the crosshair to that voxel; the
+ * wheel steps the pane's own plane. Other buttons reach the interactor
+ * style, so right-drag zoom and middle-drag pan still work per pane.
+ */
+bool VolumeRenderer::handleTriPlanarEvent(QEvent *event)
+{
+    if (!m_mprSlicer->volume()) {
+        return false;
+    }
+    
+    double world[3];
+    switch (event->type()) {
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseMove: {
+            QMouseEvent *mouseEvent = static_cast<QMouseEvent *>(event);
+            if (event->type() == QEvent::MouseButtonPress) {
+                if (mouseEvent->button() != Qt::LeftButton) {
+                    return false;
+                }
+                m_dragPane = paneAt(mouseEvent->position().toPoint(), world);
+            } else if (m_dragPane < 0 || paneAt(mouseEvent->position().toPoint(), world) != m_dragPane) {
+                return m_dragPane >= 0;
+            }
+            if (m_dragPane < 0) {
+                return true;
+            }
+            
+            double spacing[3];
+            int extent[6];
+            m_mprSlicer->volume()->GetSpacing(spacing);
+            m_mprSlicer->volume()->GetExtent(extent);
+            int columnAxis = OrthogonalSlicer::columnAxis(m_dragPane);
+            int rowAxis = OrthogonalSlicer::rowAxis(m_dragPane);
+            int cursor[3] = { m_cursor[0], m_cursor[1], m_cursor[2] };
+            cursor[columnAxis] = extent[2 * columnAxis] + qRound(world[0] / spacing[columnAxis]);
+            cursor[rowAxis] = extent[2 * rowAxis] + qRound(world[1] / spacing[rowAxis]);
+            setCursor(cursor);
+            return true;
+        }
+        case QEvent::MouseButtonRelease:
+            if (static_cast<QMouseEvent *>(event)->button() != Qt::LeftButton) {
+                return false;
+            }
+            m_dragPane = -1;
+            return true;
+        case QEvent::MouseButtonDblClick:
+            return static_cast<QMouseEvent *>(event)->button() == Qt::LeftButton;
+        case QEvent::Wheel: {
+            QWheelEvent *wheelEvent = static_cast<QWheelEvent *>(event);
+            int pane = paneAt(wheelEvent->position().toPoint(), world);
+            int steps = wheelEvent->angleDelta().y();
+            if (pane < 0 || steps == 0) {
+                return true;
+            }
+            int cursor[3] = { m_cursor[0], m_cursor[1], m_cursor[2] };
+            cursor[OrthogonalSlicer::normalAxis(pane)] += steps > 0 ? 1 : -1;
+            setCursor(cursor);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * Points the oblique slicer at the displayed volume
+ * 
+ * Samples outside the volume take its minimum, so the corners of the
+ * square output read as background rather than as mid-grey. The minimum
+ * comes from the histogram; until that arrives, the minimum of the slice
+ * on display stands in rather than a scan of the whole volume.
+ */
+bool VolumeRenderer::prepareOblique()
+{
+    if (m_lazySource || !m_imageData) {
+        qWarning() << "The oblique view needs a fully loaded volume";
+        return false;
+    }
+    m_obliqueSlicer->setVolume(m_imageData);
+    
+    double background = 0.0;
+    if (m_histogram) {
+        background = m_histogram->minimum();
+    } else {
+        int cursor[3] = { 0, 0, 0 };
+        cursor[OrthogonalSlicer::normalAxis(m_currentOrientation)] = m_currentSlice;
+        OrthogonalSlicer slicer;
+        slicer.setVolume(m_imageData);
+        if (slicer.extract(cursor, 1 << m_currentOrientation)) {
+            background = slicer.plane(m_currentOrientation)->GetScalarRange()[0];
+        }
+    }
+    m_obliqueSlicer->setBackground(background);
+    m_obliquePreview = false;
+    resetObliquePlane();
+    updateOblique();
+    m_obliqueRenderer->ResetCamera();
+    return true;
+}
+
+/**
+ * Starts the plane as the current slice of the current orientation
+ * 
+ * The in-plane axes match the slice view's, so entering the oblique view
+ * shows the same picture until the plane is tilted.
+ */
+void VolumeRenderer::resetObliquePlane()
+{
+    if (!m_imageData) {
+        return;
+    }
+    
+    const int plane = static_cast<int>(m_currentOrientation);
+    for (int axis = 0; axis < 3; ++axis) {
+        m_obliqueAxes[0][axis] = axis == OrthogonalSlicer::columnAxis(plane) ? 1.0 : 0.0;
+        m_obliqueAxes[1][axis] = axis == OrthogonalSlicer::rowAxis(plane) ? 1.0 : 0.0;
+    }
+    crossProduct(m_obliqueAxes[0], m_obliqueAxes[1], m_obliqueAxes[2]);
+    
+    int extent[6];
+    double spacing[3];
+    double origin[3];
+    m_imageData->GetExtent(extent);
+    m_imageData->GetSpacing(spacing);
+    m_imageData->GetOrigin(origin);
+    for (int axis = 0; axis < 3; ++axis) {
+        m_obliqueCentre[axis] = origin[axis] + 0.5 * (extent[2 * axis] + extent[2 * axis + 1]) * spacing[axis];
+    }
+    int axis = sliceAxis();
+    m_obliqueCentre[axis] = origin[axis] + m_currentSlice * spacing[axis];
+    m_obliqueDirty = true;
+}
+
+/**
+ * Resamples the plane before a render if it moved
+ * 
+ * Pixels are as fine as the finest voxel spacing, or coarser by
+ * OBLIQUE_PREVIEW_FACTOR while the user is dragging. Window and level
+ * follow the slice view.
+ */
+void VolumeRenderer::updateOblique()
+{
+    vtkImageData *volume = m_obliqueSlicer->volume();
+    if (!volume) {
+        return;
+    }
+    
+    if (m_obliqueDirty) {
+        m_obliqueDirty = false;
+        double *spacing = volume->GetSpacing();
+        double pixelSpacing = qMin(spacing[0], qMin(spacing[1], spacing[2]));
+        if (m_obliquePreview) {
+            pixelSpacing *= OBLIQUE_PREVIEW_FACTOR;
+        }
+        vtkImageData *image = m_obliqueSlicer->reslice(m_obliqueCentre, m_obliqueAxes[0], m_obliqueAxes[1],
+                                                       pixelSpacing);
+        if (!image) {
+            qWarning() << "Unsupported volume for the oblique view";
+            return;
+        }
+        if (m_obliqueActor->GetInput() != image) {
+            m_obliqueActor->SetInputData(image);
+        }
+        emit obliqueResliced(m_obliqueSlicer->lastResliceSeconds(), ObliqueSlicer::outputSize(volume, pixelSpacing));
+    }
+}
+
+/**
+ * Tilts the plane about its own axes, so a drag always turns it the way
+ * the mouse moves on screen whatever its current orientation
+ */
+void VolumeRenderer::rotateOblique(double columnDegrees, double rowDegrees)
+{
+    rotateVector(m_obliqueAxes[0], m_obliqueAxes[1], columnDegrees);
+    rotateVector(m_obliqueAxes[1], m_obliqueAxes[0], rowDegrees);
+    
+    // Keep the frame orthonormal as rounding errors accumulate over a drag
+    normalize(m_obliqueAxes[0]);
+    crossProduct(m_obliqueAxes[0], m_obliqueAxes[1], m_obliqueAxes[2]);
+    normalize(m_obliqueAxes[2]);
+    crossProduct(m_obliqueAxes[2], m_obliqueAxes[0], m_obliqueAxes[1]);
+    
+    m_obliqueDirty = true;
+    m_obliquePreview = true;
+    beginInteraction();
+    updateRender();
+}
+
+/**
+ * Left-drag tilts the plane, the wheel moves it one voxel along its
+ * normal. Other buttons reach the interactor style, so right-drag zoom
+ * and middle-drag pan work as in the slice view.
+ */
+bool VolumeRenderer::handleObliqueEvent(QEvent *event)
+{
+    vtkImageData *volume = m_obliqueSlicer->volume();
+    if (!volume) {
+        return false;
+    }
+    
+    switch (event->type()) {
+        case QEvent::MouseButtonPress: {
+            QMouseEvent *mouseEvent = static_cast<QMouseEvent *>(event);
+            if (mouseEvent->button() != Qt::LeftButton) {
+                return false;
+            }
+            m_rotating = true;
+            m_lastMousePosition = mouseEvent->position().toPoint();
+            return true;
+        }
+        case QEvent::MouseMove: {
+            if (!m_rotating) {
+                return false;
+            }
+            QPoint position = static_cast<QMouseEvent *>(event)->position().toPoint();
+            QPoint delta = position - m_lastMousePosition;
+            m_lastMousePosition = position;
+            rotateOblique(delta.x() * DEGREES_PER_PIXEL, delta.y() * DEGREES_PER_PIXEL);
+            return true;
+        }
+        case QEvent::MouseButtonRelease:
+            if (static_cast<QMouseEvent *>(event)->button() != Qt::LeftButton) {
+                return false;
+            }
+            m_rotating = false;
+            return true;
+        case QEvent::MouseButtonDblClick:
+            return static_cast<QMouseEvent *>(event)->button() == Qt::LeftButton;
+        case QEvent::Wheel: {
+            int steps = static_cast<QWheelEvent *>(event)->angleDelta().y();
+            if (steps == 0) {
+                return true;
+            }
+            
+            // One step of the finest spacing, kept inside the volume's bounds
+            double bounds[6];
+            double *spacing = volume->GetSpacing();
+            volume->GetBounds(bounds);
+            double distance = (steps > 0 ? 1.0 : -1.0) * qMin(spacing[0], qMin(spacing[1], spacing[2]));
+            for (int axis = 0; axis < 3; ++axis) {
+                m_obliqueCentre[axis] = qBound(bounds[2 * axis],
+                                               m_obliqueCentre[axis] + distance * m_obliqueAxes[2][axis],
+                                               bounds[2 * axis + 1]);
+            }
+            m_obliqueDirty = true;
+            m_obliquePreview = true;
+            beginInteraction();
+            updateRender();
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * Points the slab projector at the displayed volume
+ */
+bool VolumeRenderer::prepareSlab()
+{
+    if (m_lazySource || !m_imageData) {
+        qWarning() << "The slab view needs a fully loaded volume";
+        return false;
+    }
+    m_slabProjector->setVolume(m_imageData);
+    m_slabDirty = true;
+    updateSlab();
+    m_slabRenderer->ResetCamera();
+    return true;
+}
+
+/**
+ * Projects the slab around the current slice before a render if it moved
+ * 
+ * Only the latest slice reaches the projector, so a fast slider drag
+ * moves the slab in jumps rather than projecting every slice it passes.
+ * Window and level follow the slice view.
+ */
+void VolumeRenderer::updateSlab()
+{
+    if (!m_slabProjector->volume()) {
+        return;
+    }
+    
+    if (m_slabDirty) {
+        m_slabDirty = false;
+        vtkImageData *image = m_slabProjector->project(static_cast<int>(m_currentOrientation), m_currentSlice);
+        if (!image) {
+            qWarning() << "Unsupported volume for the slab view";
+            return;
+        }
+        if (m_slabActor->GetInput() != image) {
+            m_slabActor->SetInputData(image);
+        }
+        emit slabProjected(m_slabProjector->lastProjectSeconds(), m_slabProjector->lastSlicesRead(),
+                           m_slabProjector->thickness());
+    }
+}
+
+int VolumeRenderer::sliceAxis() const
+{
+    switch (m_currentOrientation) {
+        case SAGITTAL:
+            return 0;
+        case CORONAL:
+            return 1;
+        default:
+            return 2;
+    }
+}
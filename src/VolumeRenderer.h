@@ -4,6 +4,19 @@
 // Qt base classes for object management and widget integration
 #include <QObject>
 #include <QWidget>
+#include <QPoint>
+#include <QElapsedTimer>
+
+// VTK smart pointer for the slice currently shown from a lazy source
+#include <vtkSmartPointer.h>
+
+// Standard library for sharing the lazy source with FileManager
+#include <memory>
+
+// Software ray caster for the 3D view
+#include "CpuRayCaster.h"
+#include "ObliqueSlicer.h"
+#include "SlabProjector.h"
 
 // Forward declarations of VTK classes to avoid including headers
 class vtkImageData;              // VTK data structure for image/volume data
@@ -11,7 +24,21 @@ class vtkImageViewer2;           // VTK widget for displaying 2D image slices
 class vtkRenderWindow;           // VTK window for OpenGL rendering
 class vtkRenderWindowInteractor; // VTK interactor for handling user input
 class vtkInteractorStyleImage;   // VTK interaction style for image viewing
+class vtkRenderer;               // VTK scene renderer for the 3D view
+class vtkImageActor;             // VTK actor showing the ray-cast image
+class vtkActor;                  // VTK actor drawing the crosshair lines
+class vtkPolyData;               // VTK geometry of the crosshair lines
 class QVTKOpenGLNativeWidget;    // Qt widget that integrates VTK with Qt
+class LazyVolumeSource;          // Slice-on-demand volume access
+class TimeSeriesSource;          // Frame access for 4D files
+class FrameRingBuffer;           // Frames decoded ahead of playback
+class QTimer;                    // Drives cine playback
+class QEvent;                    // Mouse and resize events of the 3D view
+class VolumePyramid;             // Downsampled levels of the volume
+class OrthogonalSlicer;          // Planes through the tri-planar crosshair
+class BrickedVolume;             // Cache-blocked copy of the volume
+class IntensityHistogram;        // Voxel value distribution for auto-contrast
+class vtkImageProperty;          // Window/level shared by every 2D image actor
 
 /**
  * VolumeRenderer - Manages VTK-based 3D volume rendering and image display
@@ -21,6 +48,22 @@ class QVTKOpenGLNativeWidget;    // Qt widget that integrates VTK with Qt
  * - Image data rendering and slice viewing
  * - User interaction (zoom, pan, slice navigation)
  * - Multi-planar view orientations
+ * - Frame stepping and cine playback of 4D time series
+ * - A 3D view ray cast on the CPU, usable without GPU drivers
+ * - A tri-planar view: axial, sagittal and coronal panes in one render
+ *   window, cut from the shared volume through a common crosshair
+ * - An oblique view: one plane of any orientation, tilted by dragging,
+ *   resampled from the volume with a trilinear or nearest kernel
+ * - A thick-slab view: the maximum, minimum or mean of a run of slices
+ *   around the current one, updated incrementally as the slab slides
+ * - Window/level: one image property with a greyscale lookup table shared
+ *   by every 2D view, set by mouse drag or from percentiles of the
+ *   volume's histogram; a change only retunes the table's range
+ * - Multi-resolution display: with a VolumePyramid, a coarse level is shown
+ *   while the user drags or zooms, and once input idles the level matching
+ *   the zoom replaces it, so zoomed-out views never read full resolution
+ * - Render scheduling: requests are coalesced into at most one render per
+ *   display refresh, and only the latest requested slice is ever drawn
  */
 class VolumeRenderer : public QObject
 {
@@ -37,11 +80,25 @@ public:
         CORONAL = 2   // Front view (XZ plane) - looking from the front
     };
 
+    /**
+     * What the render widget shows
+     */
+    enum RenderMode {
+        SLICE_MODE = 0,  // One plane of the volume
+        VOLUME_MODE = 1, // The whole volume ray cast on the CPU
+        TRI_PLANAR_MODE = 2, // All three orthogonal planes with a shared crosshair
+        OBLIQUE_MODE = 3, // One plane of any orientation, tilted with the mouse
+        SLAB_MODE = 4    // A projection of the slices around the current one
+    };
+
     explicit VolumeRenderer(QObject *parent = nullptr);
     ~VolumeRenderer();
 
     // Rendering setup - initialize and configure VTK components
     void setImageData(vtkImageData *imageData);  // Load image data into the renderer
+    void setLazySource(std::shared_ptr<LazyVolumeSource> source); // Display slices fetched on demand
+    void setPyramid(std::shared_ptr<VolumePyramid> pyramid); // Reduced levels of the volume passed to setImageData
+    void setBricks(std::shared_ptr<BrickedVolume> bricks); // Bricked copy the tri-planar view slices from
     QWidget* getRenderWidget();                  // Get the Qt widget for display
     
     // Slice navigation - move through the 3D volume
@@ -57,16 +114,81 @@ public:
     void zoomOut();                              // Zoom out from the image
     void resetZoom();                            // Reset zoom to default level
     
-
+    // Time series - 4D files show one 3D frame at a time
+    void setTimeSeries(std::shared_ptr<TimeSeriesSource> source); // Enable frames for the current volume
+    int getFrameCount() const;                   // Frames in the series, 1 for a 3D volume
+    int getCurrentFrame() const;                 // Frame on screen
+    void setFrame(int frame);                    // Jump to a frame, waiting for its decode
+    void nextFrame();                            // Step forward one frame (wraps)
+    void previousFrame();                        // Step back one frame (wraps)
+    void startPlayback(double framesPerSecond);  // Loop through the frames at a target rate
+    void stopPlayback();                         // Pause on the current frame
+    bool isPlaying() const;                      // Whether cine playback is running
+    int getStalledFrames() const;                // Playback ticks skipped because decoding fell behind
+    
+    // 3D rendering - the volume ray cast on the CPU instead of a slice
+    bool setRenderMode(RenderMode mode);         // False if the volume is not resident
+    RenderMode getRenderMode() const;            // Current mode
+    void setVolumeBlendMode(CpuRayCaster::BlendMode mode); // MIP or composite
+    void setVolumeTransferFunction(const CpuRayCaster::TransferFunction &transferFunction); // Window, opacity and colours
+    CpuRayCaster::TransferFunction getVolumeTransferFunction() const; // Current transfer function
+    
+    // Tri-planar view - the crosshair in structured voxel indices
+    void setCursor(const int cursor[3]);         // Move the crosshair; the slice follows along its axis
+    void getCursor(int cursor[3]) const;         // Current crosshair voxel
+    
+    // Oblique view - the plane starts from the current orientation
+    void setObliqueInterpolation(ObliqueSlicer::Interpolation interpolation); // Trilinear or nearest sampling
+    void getObliqueNormal(double normal[3]) const; // Unit normal of the plane in world space
+    
+    // Slab view - centred on the current slice of the current orientation
+    void setSlabProjection(SlabProjector::Projection projection); // Maximum, minimum or mean
+    void setSlabThickness(int slices);           // Slices in the slab
+    
+    // Window/level - shared by the slice, tri-planar, oblique and slab views
+    void setWindowLevel(double window, double level); // Intensity span and centre mapped to black..white
+    void getWindowLevel(double &window, double &level) const; // Current window and level
+    void setHistogram(std::shared_ptr<IntensityHistogram> histogram); // Histogram of the volume passed to setImageData
+    bool applyContrastPercentiles(double lowFraction, double highFraction); // Percentile window, the slice's range before setHistogram()
+    
+    // Render statistics
+    long long getRenderedFrames() const;         // Renders actually drawn
+    long long getSkippedRenders() const;         // Requests merged into an already scheduled render
 
 signals:
     void sliceChanged(int slice);                    // Emitted when slice position changes
     void orientationChanged(ViewOrientation orientation); // Emitted when view orientation changes
+    void frameChanged(int frame);                    // Emitted when a different frame is shown
+    void playbackStateChanged(bool playing);         // Emitted when cine playback starts or stops
+    void renderModeChanged(RenderMode mode);         // Emitted when switching between slice and 3D views
+    void volumeRendered(double seconds, long long samples); // Emitted after each ray-cast frame
+    void cursorChanged(int x, int y, int z);         // Emitted when the tri-planar crosshair moves
+    void obliqueResliced(double seconds, int size);  // Emitted after each oblique plane is resampled
+    void slabProjected(double seconds, int slicesRead, int thickness); // Emitted after each slab projection
+    void windowLevelChanged(double window, double level); // Emitted when the contrast changes
 
 public slots:
-    void updateRender();                             // Force a re-render of the scene
+    void updateRender();                             // Schedule a re-render at the next display refresh
+
+private slots:
+    void advancePlayback();                          // Show the next buffered frame on each timer tick
+    void renderVolume();                             // Schedule a full ray cast at the widget's size
+    void refine();                                   // Replace the interaction preview with the level for the zoom
+    void flushRender();                              // Apply the latest pending state and draw it once
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override; // Rotate and zoom the 3D view, move the crosshair, tilt the oblique plane, window/level
 
 private:
+    /**
+     * Ray cast to run with the next scheduled render
+     */
+    enum VolumeRequest {
+        NO_VOLUME_RENDER = 0,       // Redraw the current scene only
+        PREVIEW_VOLUME_RENDER = 1,  // Small image during interaction
+        FULL_VOLUME_RENDER = 2      // One ray per screen pixel
+    };
+    
     // VTK rendering components
     vtkImageViewer2 *m_imageViewer;                 // Main VTK image viewer for slice display
     QVTKOpenGLNativeWidget *m_vtkWidget;            // Qt widget that contains VTK rendering
@@ -76,12 +198,111 @@ private:
     
     // Current state
     vtkImageData *m_imageData;                      // Currently loaded image data
+    std::shared_ptr<LazyVolumeSource> m_lazySource; // Slice source when the volume is not resident
+    vtkSmartPointer<vtkImageData> m_lazySlice;      // Slice currently displayed from m_lazySource
+    
+    // Time series playback
+    std::shared_ptr<TimeSeriesSource> m_timeSeries; // Frame source of a 4D file
+    std::unique_ptr<FrameRingBuffer> m_frameBuffer; // Frames decoded ahead on a background thread
+    vtkSmartPointer<vtkImageData> m_frameImage;     // Frame currently displayed from the buffer
+    QTimer *m_playbackTimer;                        // Fires once per frame during playback
+    int m_currentFrame;                             // Frame on screen
+    int m_stalledFrames;                            // Ticks with no decoded frame ready
     ViewOrientation m_currentOrientation;           // Current viewing orientation
     int m_currentSlice;                             // Current slice position
     
+    // 3D rendering
+    RenderMode m_renderMode;                        // Slice or 3D view
+    std::unique_ptr<CpuRayCaster> m_rayCaster;      // Normalized volume copy and ray caster
+    vtkSmartPointer<vtkRenderer> m_volumeRenderer;  // Replaces the slice renderer in 3D mode
+    vtkSmartPointer<vtkImageActor> m_volumeActor;   // Shows the ray-cast image
+    QPoint m_lastMousePosition;                     // Previous position of a rotating drag
+    bool m_rotating;                                // Left button held in the 3D view
+    
+    // Multi-resolution rendering
+    std::shared_ptr<VolumePyramid> m_pyramid;       // Levels of the current volume, null until built
+    std::unique_ptr<CpuRayCaster> m_previewCaster;  // Ray caster over the preview level in 3D mode
+    QTimer *m_refineTimer;                          // Fires once input has been idle
+    int m_casterLevel;                              // Pyramid level held by m_rayCaster, -1 for none
+    
+    // Render scheduling
+    QTimer *m_renderTimer;                          // Single-shot, fires at the next display refresh
+    QElapsedTimer m_frameClock;                     // Time since the last render
+    bool m_slicePending;                            // A requested slice is not applied to the viewer yet
+    int m_pendingSlice;                             // Latest requested slice
+    VolumeRequest m_volumeRequest;                  // Ray cast to run with the next render
+    long long m_renderedFrames;                     // Renders drawn
+    long long m_skippedRenders;                     // Requests coalesced away
+    
+    // Tri-planar view
+    std::unique_ptr<OrthogonalSlicer> m_mprSlicer;  // Planes cut from m_imageData in place
+    vtkSmartPointer<vtkRenderer> m_mprRenderers[4]; // Axial, sagittal and coronal panes, then the empty quadrant
+    vtkSmartPointer<vtkImageActor> m_mprActors[3];  // Plane image of each pane
+    vtkSmartPointer<vtkPolyData> m_crosshairs[3];   // Two crosshair lines per pane
+    vtkSmartPointer<vtkActor> m_crosshairActors[3]; // Draws the crosshair over each plane
+    int m_cursor[3];                                // Crosshair voxel in structured indices
+    int m_dirtyPlanes;                              // OrthogonalSlicer plane mask to re-extract
+    int m_dragPane;                                 // Pane under a left-button drag, -1 for none
+    
+    // Oblique view
+    std::unique_ptr<ObliqueSlicer> m_obliqueSlicer; // Resamples the plane from m_imageData in place
+    vtkSmartPointer<vtkRenderer> m_obliqueRenderer; // Replaces the slice renderer in oblique mode
+    vtkSmartPointer<vtkImageActor> m_obliqueActor;  // Shows the resampled plane
+    double m_obliqueCentre[3];                      // Plane centre in world millimetres
+    double m_obliqueAxes[3][3];                     // Column, row and normal directions, orthonormal
+    bool m_obliqueDirty;                            // The plane moved since it was last resampled
+    bool m_obliquePreview;                          // Resample at half resolution while interacting
+    
+    // Slab view
+    std::unique_ptr<SlabProjector> m_slabProjector; // Projects slabs of m_imageData, keeping partial results
+    vtkSmartPointer<vtkRenderer> m_slabRenderer;    // Replaces the slice renderer in slab mode
+    vtkSmartPointer<vtkImageActor> m_slabActor;     // Shows the projection
+    bool m_slabDirty;                               // The slab moved or changed since it was last projected
+    
+    // Window/level
+    vtkSmartPointer<vtkImageProperty> m_windowLevelProperty; // Set on every 2D image actor
+    std::shared_ptr<IntensityHistogram> m_histogram; // Histogram of m_imageData, null until attached
+    bool m_windowLeveling;                          // A window/level drag is in progress
+    QPoint m_windowLevelOrigin;                     // Where the drag started
+    double m_dragWindow;                            // Window when the drag started
+    double m_dragLevel;                             // Level when the drag started
+    
     // Private helper methods
     void setupViewer();                              // Initialize VTK components
     void updateSliceRange();                         // Update slice range when orientation changes
+    bool showLazySlice(int slice);                   // Fetch a slice from m_lazySource and display it
+    void showFrame(vtkImageData *frame, int index);  // Swap the displayed volume for another frame
+    void clearTimeSeries();                          // Stop playback and release buffered frames
+    bool prepareVolume(int level);                   // Hand a level of the displayed volume to the ray caster
+    void preparePreviewCaster();                     // Hand the preview level to the preview ray caster
+    bool usesPyramid() const;                        // Whether the pyramid belongs to the displayed volume
+    vtkImageData *levelImage(int level) const;       // Pyramid level, or the volume itself without a pyramid
+    int previewLevel() const;                        // Level shown while interacting
+    int sliceLevel() const;                          // Level matching the slice view's zoom
+    int volumeLevel() const;                         // Level matching the 3D view's zoom
+    bool beginInteraction();                         // Restart the refine timer; true if a preview can stand in
+    void showLevelSlice(int level);                  // Show the current slice from a pyramid level
+    void scheduleRender();                           // Start the render timer unless it is already running
+    void applyPendingSlice();                        // Put the latest requested slice into the viewer
+    void renderVolumePreview();                      // Schedule a small ray cast, from the preview if available
+    void castVolume(bool preview);                   // Ray cast now at full or preview resolution
+    void attachRenderers();                          // Put the current mode's renderers into the window
+    bool prepareTriPlanar();                         // Share the displayed volume with the slicer, centre the crosshair
+    void updateTriPlanar();                          // Re-extract moved planes and place the crosshair lines
+    void zoomTriPlanar(double factor);               // Zoom all three panes together
+    int paneAt(const QPoint &position, double world[3]) const; // Pane under a widget position and the point there, -1 if none
+    bool handleTriPlanarEvent(QEvent *event);        // Click, drag and wheel on the panes; true if consumed
+    bool prepareOblique();                           // Share the displayed volume and start the plane on the current slice
+    void resetObliquePlane();                        // Align the plane with the current orientation and slice
+    void updateOblique();                            // Resample the plane if it moved
+    void rotateOblique(double columnDegrees, double rowDegrees); // Tilt the plane about its own row and column axes
+    bool handleObliqueEvent(QEvent *event);          // Drag to tilt, wheel to move along the normal; true if consumed
+    bool prepareSlab();                              // Share the displayed volume with the projector
+    void updateSlab();                               // Re-project the slab if it moved
+    bool handleWindowLevelEvent(QEvent *event);      // Drag to change window and level; true if consumed
+    void setViewerInput(vtkImageData *image);        // Show an image in the slice view without colour mapping it
+    void renderVolumeImage(CpuRayCaster *caster, int width, int height); // Ray cast and fit the image to the view
+    int sliceAxis() const;                           // Volume axis the current orientation slices along
 };
 
 #endif // VOLUMERENDERER_H
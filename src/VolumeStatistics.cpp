@@ -0,0 +1,443 @@
+#include "VolumeStatistics.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSetGet.h>
+#include <vtkSMPTools.h>
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const vtkIdType MAX_CHUNKS = 64;                  // Row ranges summarized in parallel
+const vtkIdType MIN_CHUNK_VALUES = 1 << 16;       // Smaller volumes use fewer chunks
+
+/**
+ * Everything the first pass learns about one chunk of rows
+ * 
+ * Sums are of (value - shift), with the shift taken from the chunk's
+ * first value, so the variance does not cancel away on data with a large
+ * offset.
+ */
+struct ChunkSummary {
+    qint64 count = 0;                             // Finite values
+    qint64 nonFinite = 0;                         // NaNs and infinities
+    double minimum = std::numeric_limits<double>::max();
+    double maximum = std::numeric_limits<double>::lowest();
+    double shift = 0.0;                           // Subtracted before summing
+    double sum = 0.0;                             // Sum of shifted values
+    double sumSquares = 0.0;                      // Sum of squared shifted values
+    qint64 nonZeroVoxels = 0;                     // Voxels with a non-zero component
+    int box[6] = { 0, -1, 0, -1, 0, -1 };         // Memory index bounds of those voxels
+};
+
+template <typename T>
+inline bool isNonZero(T value)
+{
+    return value != T(0) && value == value;       // NaN compares unequal to itself
+}
+
+/**
+ * Range and shifted sums of one row
+ * 
+ * The integer branch has no test in the loop; the floating-point one
+ * skips non-finite values.
+ */
+template <typename T>
+void accumulateRow(const T *row, vtkIdType length, ChunkSummary &summary)
+{
+    double low = summary.minimum;
+    double high = summary.maximum;
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    const double shift = summary.shift;
+    
+    if (std::numeric_limits<T>::is_integer) {
+        for (vtkIdType i = 0; i < length; ++i) {
+            const double value = static_cast<double>(row[i]);
+            low = std::min(low, value);
+            high = std::max(high, value);
+            const double shifted = value - shift;
+            sum += shifted;
+            sumSquares += shifted * shifted;
+        }
+        summary.count += length;
+    } else {
+        qint64 finite = 0;
+        for (vtkIdType i = 0; i < length; ++i) {
+            const double value = static_cast<double>(row[i]);
+            if (!std::isfinite(value)) {
+                continue;
+            }
+            low = std::min(low, value);
+            high = std::max(high, value);
+            const double shifted = value - shift;
+            sum += shifted;
+            sumSquares += shifted * shifted;
+            ++finite;
+        }
+        summary.count += finite;
+        summary.nonFinite += length - finite;
+    }
+    summary.minimum = low;
+    summary.maximum = high;
+    summary.sum += sum;
+    summary.sumSquares += sumSquares;
+}
+
+/**
+ * Non-zero voxels of one row and the first and last column holding one
+ * 
+ * Single-component rows are counted without branches, then scanned in
+ * from both ends only if anything was found.
+ */
+template <typename T>
+qint64 rowNonZero(const T *row, int width, int components, int &first, int &last)
+{
+    if (components == 1) {
+        qint64 count = 0;
+        for (int x = 0; x < width; ++x) {
+            count += isNonZero(row[x]) ? 1 : 0;
+        }
+        if (count > 0) {
+            first = 0;
+            while (!isNonZero(row[first])) {
+                ++first;
+            }
+            last = width - 1;
+            while (!isNonZero(row[last])) {
+                --last;
+            }
+        }
+        return count;
+    }
+    
+    qint64 count = 0;
+    for (int x = 0; x < width; ++x) {
+        bool any = false;
+        for (int c = 0; c < components; ++c) {
+            any = any || isNonZero(row[x * components + c]);
+        }
+        if (any) {
+            if (count == 0) {
+                first = x;
+            }
+            last = x;
+            ++count;
+        }
+    }
+    return count;
+}
+
+/**
+ * First pass: summarizes each chunk of rows
+ * 
+ * A row is one x run of the volume, so its y and z follow from its index
+ * and the non-zero box needs no per-voxel index arithmetic.
+ */
+template <typename T>
+void summarizeChunks(const T *values, const int *dims, int components, vtkIdType chunks, ChunkSummary *summaries,
+                     const std::atomic_bool *cancelFlag)
+{
+    const vtkIdType rows = static_cast<vtkIdType>(dims[1]) * dims[2];
+    const vtkIdType rowLength = static_cast<vtkIdType>(dims[0]) * components;
+    vtkSMPTools::For(0, chunks, 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType chunk = begin; chunk < end; ++chunk) {
+            if (cancelFlag && cancelFlag->load()) {
+                return;
+            }
+            const vtkIdType firstRow = rows * chunk / chunks;
+            const vtkIdType lastRow = rows * (chunk + 1) / chunks;
+            ChunkSummary &summary = summaries[chunk];
+            if (firstRow < lastRow) {
+                const double start = static_cast<double>(values[firstRow * rowLength]);
+                summary.shift = std::isfinite(start) ? start : 0.0;
+            }
+            
+            for (vtkIdType r = firstRow; r < lastRow; ++r) {
+                const T *row = values + r * rowLength;
+                accumulateRow(row, rowLength, summary);
+                
+                int first = 0;
+                int last = -1;
+                const qint64 nonZero = rowNonZero(row, dims[0], components, first, last);
+                if (nonZero == 0) {
+                    continue;
+                }
+                const int y = static_cast<int>(r % dims[1]);
+                const int z = static_cast<int>(r / dims[1]);
+                if (summary.nonZeroVoxels == 0) {
+                    summary.box[0] = first;
+                    summary.box[1] = last;
+                    summary.box[2] = summary.box[3] = y;
+                    summary.box[4] = summary.box[5] = z;
+                } else {
+                    summary.box[0] = std::min(summary.box[0], first);
+                    summary.box[1] = std::max(summary.box[1], last);
+                    summary.box[2] = std::min(summary.box[2], y);
+                    summary.box[3] = std::max(summary.box[3], y);
+                    summary.box[5] = z;               // Rows only move forward through z
+                }
+                summary.nonZeroVoxels += nonZero;
+            }
+        }
+    });
+}
+
+/**
+ * Second pass: bins of each chunk, BIN_COUNT counts per chunk end to end
+ */
+template <typename T>
+void binChunks(const T *values, vtkIdType count, vtkIdType chunks, double minimum, double scale, qint64 *bins,
+               const std::atomic_bool *cancelFlag)
+{
+    const int lastBin = IntensityHistogram::BIN_COUNT - 1;
+    vtkSMPTools::For(0, chunks, 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType chunk = begin; chunk < end; ++chunk) {
+            if (cancelFlag && cancelFlag->load()) {
+                return;
+            }
+            const vtkIdType first = count * chunk / chunks;
+            const vtkIdType last = count * (chunk + 1) / chunks;
+            qint64 *counts = bins + chunk * IntensityHistogram::BIN_COUNT;
+            for (vtkIdType i = first; i < last; ++i) {
+                const double value = static_cast<double>(values[i]);
+                if (!std::numeric_limits<T>::is_integer && !std::isfinite(value)) {
+                    continue;
+                }
+                const int bin = static_cast<int>((value - minimum) * scale);
+                ++counts[std::min(bin, lastBin)];
+            }
+        }
+    });
+}
+
+} // namespace
+
+VolumeStatistics::VolumeStatistics()
+    : m_count(0)
+    , m_nonFiniteCount(0)
+    , m_minimum(0.0)
+    , m_maximum(0.0)
+    , m_mean(0.0)
+    , m_variance(0.0)
+    , m_slope(1.0)
+    , m_intercept(0.0)
+    , m_nonZeroVoxels(0)
+    , m_computeSeconds(0.0)
+{
+    for (int i = 0; i < 6; ++i) {
+        m_nonZeroExtent[i] = i % 2 == 0 ? 0 : -1;
+    }
+}
+
+/**
+ * Summarizes every scalar value of a volume on all cores
+ * 
+ * Chunk moments are combined with the pairwise update of Chan, Golub and
+ * LeVeque, which is exact for any split of the data.
+ */
+std::shared_ptr<VolumeStatistics> VolumeStatistics::compute(vtkImageData *volume, double slope, double intercept,
+                                                            std::shared_ptr<std::atomic_bool> cancelFlag)
+{
+    if (!volume || !volume->GetPointData() || !volume->GetPointData()->GetScalars()) {
+        return nullptr;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    int dims[3];
+    int extent[6];
+    volume->GetDimensions(dims);
+    volume->GetExtent(extent);
+    vtkDataArray *scalars = volume->GetPointData()->GetScalars();
+    const int components = scalars->GetNumberOfComponents();
+    const vtkIdType rows = static_cast<vtkIdType>(dims[1]) * dims[2];
+    const vtkIdType count = rows * dims[0] * components;
+    if (count < 1 || scalars->GetNumberOfTuples() * components < count) {
+        return nullptr;
+    }
+    const vtkIdType chunks = std::max<vtkIdType>(1, std::min(std::min(MAX_CHUNKS, rows), count / MIN_CHUNK_VALUES));
+    
+    std::vector<ChunkSummary> summaries(chunks);
+    switch (scalars->GetDataType()) {
+        vtkTemplateMacro(summarizeChunks(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)), dims, components,
+                                         chunks, summaries.data(), cancelFlag.get()));
+        default:
+            return nullptr;
+    }
+    if (cancelFlag && cancelFlag->load()) {
+        return nullptr;
+    }
+    
+    std::shared_ptr<VolumeStatistics> statistics(new VolumeStatistics());
+    statistics->m_slope = slope;
+    statistics->m_intercept = intercept;
+    double low = std::numeric_limits<double>::max();
+    double high = std::numeric_limits<double>::lowest();
+    double mean = 0.0;
+    double squares = 0.0;                         // Sum of squared deviations from the mean
+    for (const ChunkSummary &summary : summaries) {
+        statistics->m_nonFiniteCount += summary.nonFinite;
+        if (summary.nonZeroVoxels > 0) {
+            int *box = statistics->m_nonZeroExtent;
+            if (statistics->m_nonZeroVoxels == 0) {
+                std::copy(summary.box, summary.box + 6, box);
+            } else {
+                for (int axis = 0; axis < 3; ++axis) {
+                    box[2 * axis] = std::min(box[2 * axis], summary.box[2 * axis]);
+                    box[2 * axis + 1] = std::max(box[2 * axis + 1], summary.box[2 * axis + 1]);
+                }
+            }
+            statistics->m_nonZeroVoxels += summary.nonZeroVoxels;
+        }
+        if (summary.count == 0) {
+            continue;
+        }
+        
+        const double n = static_cast<double>(summary.count);
+        const double chunkMean = summary.shift + summary.sum / n;
+        const double chunkSquares = std::max(0.0, summary.sumSquares - summary.sum * summary.sum / n);
+        const double total = static_cast<double>(statistics->m_count) + n;
+        const double delta = chunkMean - mean;
+        mean += delta * n / total;
+        squares += chunkSquares + delta * delta * statistics->m_count * n / total;
+        statistics->m_count += summary.count;
+        low = std::min(low, summary.minimum);
+        high = std::max(high, summary.maximum);
+    }
+    for (int axis = 0; axis < 3 && statistics->m_nonZeroVoxels > 0; ++axis) {
+        statistics->m_nonZeroExtent[2 * axis] += extent[2 * axis];
+        statistics->m_nonZeroExtent[2 * axis + 1] += extent[2 * axis];
+    }
+    
+    if (statistics->m_count > 0) {
+        statistics->m_minimum = low;
+        statistics->m_maximum = high;
+        statistics->m_mean = mean;
+        statistics->m_variance = squares / statistics->m_count;
+        
+        const double span = high - low;
+        const double scale = span > 0.0 ? IntensityHistogram::BIN_COUNT / span : 0.0;
+        std::vector<qint64> bins(static_cast<size_t>(chunks) * IntensityHistogram::BIN_COUNT, 0);
+        switch (scalars->GetDataType()) {
+            vtkTemplateMacro(binChunks(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)), count, chunks,
+                                       low, scale, bins.data(), cancelFlag.get()));
+            default:
+                return nullptr;
+        }
+        if (cancelFlag && cancelFlag->load()) {
+            return nullptr;
+        }
+        std::vector<qint64> counts(IntensityHistogram::BIN_COUNT, 0);
+        for (vtkIdType chunk = 0; chunk < chunks; ++chunk) {
+            const qint64 *chunkBins = bins.data() + chunk * IntensityHistogram::BIN_COUNT;
+            for (int bin = 0; bin < IntensityHistogram::BIN_COUNT; ++bin) {
+                counts[bin] += chunkBins[bin];
+            }
+        }
+        statistics->m_histogram = std::make_shared<IntensityHistogram>(low, high, std::move(counts));
+    }
+    
+    statistics->m_computeSeconds = timer.nsecsElapsed() / 1.0e9;
+    return statistics;
+}
+
+qint64 VolumeStatistics::count() const
+{
+    return m_count;
+}
+
+qint64 VolumeStatistics::nonFiniteCount() const
+{
+    return m_nonFiniteCount;
+}
+
+double VolumeStatistics::minimum() const
+{
+    return m_minimum;
+}
+
+double VolumeStatistics::maximum() const
+{
+    return m_maximum;
+}
+
+double VolumeStatistics::mean() const
+{
+    return m_mean;
+}
+
+double VolumeStatistics::standardDeviation() const
+{
+    return std::sqrt(m_variance);
+}
+
+double VolumeStatistics::percentile(double fraction) const
+{
+    return m_histogram ? m_histogram->percentile(fraction) : 0.0;
+}
+
+std::shared_ptr<IntensityHistogram> VolumeStatistics::histogram() const
+{
+    return m_histogram;
+}
+
+bool VolumeStatistics::isScaled() const
+{
+    return m_slope != 1.0 || m_intercept != 0.0;
+}
+
+double VolumeStatistics::scaledValue(double stored) const
+{
+    return m_slope * stored + m_intercept;
+}
+
+double VolumeStatistics::scaledMinimum() const
+{
+    return scaledValue(m_slope < 0.0 ? m_maximum : m_minimum);
+}
+
+double VolumeStatistics::scaledMaximum() const
+{
+    return scaledValue(m_slope < 0.0 ? m_minimum : m_maximum);
+}
+
+double VolumeStatistics::scaledMean() const
+{
+    return scaledValue(m_mean);
+}
+
+double VolumeStatistics::scaledStandardDeviation() const
+{
+    return std::abs(m_slope) * standardDeviation();
+}
+
+double VolumeStatistics::scaledPercentile(double fraction) const
+{
+    return scaledValue(percentile(m_slope < 0.0 ? 1.0 - fraction : fraction));
+}
+
+qint64 VolumeStatistics::nonZeroVoxels() const
+{
+    return m_nonZeroVoxels;
+}
+
+bool VolumeStatistics::getNonZeroExtent(int extent[6]) const
+{
+    std::copy(m_nonZeroExtent, m_nonZeroExtent + 6, extent);
+    return m_nonZeroVoxels > 0;
+}
+
+double VolumeStatistics::computeSeconds() const
+{
+    return m_computeSeconds;
+}
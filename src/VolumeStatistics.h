@@ -0,0 +1,91 @@
+#ifndef VOLUMESTATISTICS_H
+#define VOLUMESTATISTICS_H
+
+// Qt types for voxel counts
+#include <QtGlobal>
+
+// Standard library for sharing between threads and the cancellation flag
+#include <atomic>
+#include <memory>
+
+#include "IntensityHistogram.h"
+
+// Forward declarations of VTK classes to avoid including headers
+class vtkImageData;         // VTK data structure for image/volume data
+
+/**
+ * VolumeStatistics - Intensity summary of a volume for display and QC
+ * 
+ * Range, mean and standard deviation, a histogram with percentiles, and
+ * the bounding box of the non-zero voxels. Computed once per volume in
+ * the background after it is shown and kept with the volume in the
+ * cache, so neither the info panel nor auto-contrast ever scans the
+ * voxels again, and the load itself never waits for the scan.
+ * 
+ * Values are the stored scalars of every component, before any NIfTI
+ * intensity scaling, so the histogram lines up with the display lookup
+ * table. The scl_slope and scl_inter passed to compute() are applied
+ * afterwards by the scaled*() accessors: the summary of an affine map is
+ * the affine map of the summary, so real-world values never need a
+ * full-precision copy of the voxels. NaNs and infinities are counted
+ * apart and left out of everything else; a voxel is non-zero when any
+ * component is finite and non-zero.
+ * 
+ * compute() walks the voxel buffer in row chunks on all cores. The first
+ * pass gathers the range, shifted moment sums and non-zero extents of
+ * each chunk; the second fills per-chunk bins once the range is known.
+ * Chunks are merged afterwards, so nothing is shared between threads.
+ * A cancellation flag is checked before each chunk of either pass.
+ * Integer types skip the finiteness test, which leaves the inner loops
+ * free of branches for the compiler to vectorize.
+ */
+class VolumeStatistics
+{
+public:
+    static std::shared_ptr<VolumeStatistics> compute(vtkImageData *volume, double slope = 1.0,
+                                                     double intercept = 0.0,
+                                                     std::shared_ptr<std::atomic_bool> cancelFlag = nullptr); // Null for an empty or unsupported volume, or if cancelled
+    
+    // Value summary over the finite values
+    qint64 count() const;                                // Finite values, every component
+    qint64 nonFiniteCount() const;                       // NaNs and infinities left out
+    double minimum() const;                              // Smallest finite value
+    double maximum() const;                              // Largest finite value
+    double mean() const;                                 // Arithmetic mean
+    double standardDeviation() const;                    // Population standard deviation
+    double percentile(double fraction) const;            // From the histogram, linear within a bin
+    std::shared_ptr<IntensityHistogram> histogram() const; // Null when no value is finite
+    
+    // Real-world values - slope * stored + intercept
+    bool isScaled() const;                               // Whether the scaling differs from the identity
+    double scaledValue(double stored) const;             // One stored value in real-world units
+    double scaledMinimum() const;                        // Smallest real-world value
+    double scaledMaximum() const;                        // Largest real-world value
+    double scaledMean() const;                           // Mean in real-world units
+    double scaledStandardDeviation() const;              // Standard deviation in real-world units
+    double scaledPercentile(double fraction) const;      // A negative slope reverses the order
+    
+    // Non-zero voxels
+    qint64 nonZeroVoxels() const;                        // Voxels with a finite, non-zero component
+    bool getNonZeroExtent(int extent[6]) const;          // Structured index bounds of those voxels; false if none
+    
+    double computeSeconds() const;                       // Wall-clock time of compute()
+
+private:
+    qint64 m_count;                                      // Finite values
+    qint64 m_nonFiniteCount;                             // Skipped values
+    double m_minimum;                                    // Smallest finite value
+    double m_maximum;                                    // Largest finite value
+    double m_mean;                                       // Mean of the finite values
+    double m_variance;                                   // Population variance
+    std::shared_ptr<IntensityHistogram> m_histogram;     // Bins over [m_minimum, m_maximum]
+    double m_slope;                                      // scl_slope, 1 without scaling
+    double m_intercept;                                  // scl_inter, 0 without scaling
+    qint64 m_nonZeroVoxels;                              // Voxels counted in m_nonZeroExtent
+    int m_nonZeroExtent[6];                              // x, y and z index bounds, min above max when empty
+    double m_computeSeconds;                             // Time compute() took
+    
+    VolumeStatistics();
+};
+
+#endif // VOLUMESTATISTICS_H
@@ -0,0 +1,122 @@
+#include "VoxelStream.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const qint64 INPUT_BUFFER_SIZE = 1024 * 1024;     // Compressed bytes pulled from disk per read
+const qint64 MAX_INFLATE_SIZE = 1 << 30;          // Output handed to zlib per call (uInt limit)
+const qint64 SKIP_BUFFER_SIZE = 64 * 1024;        // Decompressed bytes discarded per read
+
+} // namespace
+
+VoxelStream::VoxelStream(QFile &file, bool compressed)
+    : m_file(file)
+    , m_compressed(compressed)
+    , m_initialized(false)
+    , m_finished(false)
+{
+    m_stream = z_stream();
+}
+
+VoxelStream::~VoxelStream()
+{
+    if (m_initialized) {
+        inflateEnd(&m_stream);
+    }
+}
+
+bool VoxelStream::open()
+{
+    if (!m_compressed) {
+        return true;
+    }
+    
+    m_input.resize(INPUT_BUFFER_SIZE);
+    // 16 + MAX_WBITS selects gzip framing
+    m_initialized = inflateInit2(&m_stream, 16 + MAX_WBITS) == Z_OK;
+    return m_initialized;
+}
+
+/**
+ * Reads up to size bytes
+ * 
+ * Returns fewer only when the stream ends, normally (atEnd() is then
+ * true) or because the file is truncated; -1 on a read or data error.
+ */
+qint64 VoxelStream::read(char *dst, qint64 size)
+{
+    if (!m_compressed) {
+        return m_file.read(dst, size);
+    }
+    
+    qint64 produced = 0;
+    while (produced < size && !m_finished) {
+        if (m_stream.avail_in == 0) {
+            qint64 n = m_file.read(m_input.data(), m_input.size());
+            if (n < 0) {
+                return -1;
+            }
+            if (n == 0) {
+                break;  // Truncated stream
+            }
+            m_stream.next_in = reinterpret_cast<Bytef *>(m_input.data());
+            m_stream.avail_in = static_cast<uInt>(n);
+        }
+        
+        qint64 request = std::min(size - produced, MAX_INFLATE_SIZE);
+        m_stream.next_out = reinterpret_cast<Bytef *>(dst + produced);
+        m_stream.avail_out = static_cast<uInt>(request);
+        
+        int code = inflate(&m_stream, Z_NO_FLUSH);
+        produced += request - m_stream.avail_out;
+        
+        if (code == Z_STREAM_END) {
+            // Another gzip member may follow (pigz, BGZF)
+            if (m_stream.avail_in == 0 && m_file.atEnd()) {
+                m_finished = true;
+            } else {
+                inflateReset(&m_stream);
+            }
+        } else if (code == Z_DATA_ERROR && m_stream.total_out == 0) {
+            // Trailing padding after the last member, as gzip itself tolerates
+            m_finished = true;
+        } else if (code != Z_OK && code != Z_BUF_ERROR) {
+            return -1;
+        }
+    }
+    
+    return produced;
+}
+
+/**
+ * Discards size bytes (header extensions before vox_offset, frames
+ * before the one wanted)
+ */
+bool VoxelStream::skip(qint64 size)
+{
+    if (size < 0) {
+        return false;  // vox_offset inside the fixed header
+    }
+    if (!m_compressed) {
+        return m_file.seek(m_file.pos() + size);
+    }
+    
+    std::vector<char> scratch(static_cast<size_t>(std::min(size, SKIP_BUFFER_SIZE)));
+    while (size > 0) {
+        qint64 n = read(scratch.data(), std::min<qint64>(size, scratch.size()));
+        if (n <= 0) {
+            return false;
+        }
+        size -= n;
+    }
+    return true;
+}
+
+bool VoxelStream::atEnd() const
+{
+    return m_compressed ? m_finished : m_file.atEnd();
+}
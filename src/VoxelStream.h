@@ -0,0 +1,50 @@
+#ifndef VOXELSTREAM_H
+#define VOXELSTREAM_H
+
+// Qt file access and byte counts
+#include <QtGlobal>
+#include <QByteArray>
+
+// zlib as bundled with VTK (the same copy vtkNIFTIImageReader uses)
+#include <vtk_zlib.h>
+
+class QFile;                // Source being read
+
+/**
+ * VoxelStream - Sequential byte source over a .nii or .nii.gz file
+ * 
+ * Compressed files are inflated with zlib directly into the caller's
+ * buffer; concatenated gzip members (pigz, BGZF) are followed
+ * transparently, and zero padding after the last member is tolerated as
+ * gzip itself does. Plain files are read as they are. The file must be
+ * open and positioned at the start of the stream.
+ * 
+ * This is the one front-to-back reader shared by the voxel reader, the
+ * disk cache, the thumbnail service and the batch CLI. Random access into
+ * BGZF files goes through GzipBlockIndex instead.
+ */
+class VoxelStream
+{
+public:
+    VoxelStream(QFile &file, bool compressed);
+    ~VoxelStream();
+    
+    bool open();                                         // Set up inflation; false if zlib cannot
+    qint64 read(char *dst, qint64 size);                 // Up to size bytes, fewer only at the end; -1 on error
+    bool skip(qint64 size);                              // Discard size bytes; false if the stream ends first
+    bool atEnd() const;                                  // The whole stream was read, not cut short
+
+private:
+    QFile &m_file;                                       // Source, owned by the caller
+    bool m_compressed;                                   // Inflate, or pass the file through
+    bool m_initialized;                                  // Whether inflateInit2 succeeded
+    bool m_finished;                                     // Last gzip member (or padding) reached
+    z_stream m_stream;                                   // Inflate state
+    QByteArray m_input;                                  // Compressed bytes read ahead
+    
+    // Non-copyable: owns zlib state
+    VoxelStream(const VoxelStream &) = delete;
+    VoxelStream &operator=(const VoxelStream &) = delete;
+};
+
+#endif // VOXELSTREAM_H
@@ -1,23 +1,60 @@
 // Qt application framework
 #include <QApplication>
+#include <QCoreApplication>
 #include <QStyleFactory>
 #include <QDir>
 
 // Our main application window
 #include "MainWindow.h"
 
+// Headless batch commands
+#include "BatchProcessor.h"
+
 // VTK output handling - suppress error popups and redirect to log file
 #include <vtkOutputWindow.h>
 #include <vtkFileOutputWindow.h>
 
+// VTK parallel loops used by decompression and image kernels
+#include <vtkSMPTools.h>
+
+/**
+ * VTK setup shared by the viewer and the batch commands
+ */
+static void configureVtk()
+{
+    // Configure VTK error handling to avoid popup dialogs
+    // Instead, redirect all VTK errors and warnings to a log file
+    vtkOutputWindow::SetGlobalWarningDisplay(0);  // Disable error popups
+    auto fileOutputWindow = vtkFileOutputWindow::New();
+    fileOutputWindow->SetFileName("vtk_errors.log");  // Log file for VTK errors
+    vtkOutputWindow::SetInstance(fileOutputWindow);
+    fileOutputWindow->Delete();
+    
+    // Use the std::thread backend for vtkSMPTools unless overridden by VTK_SMP_BACKEND_IN_USE
+    if (qEnvironmentVariableIsEmpty("VTK_SMP_BACKEND_IN_USE")) {
+        vtkSMPTools::SetBackend("STDThread");
+    }
+}
+
 /**
  * Main entry point for the NifTI Volume Loader application
  * 
  * Sets up the Qt application, configures VTK error handling,
- * applies styling, and launches the main window.
+ * applies styling, and launches the main window. When the first
+ * argument is a batch command (header, stats, thumbnail, recompress, index)
+ * no window or display is needed and the files are processed headless.
  */
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && BatchProcessor::isCommand(QString::fromLocal8Bit(argv[1]))) {
+        QCoreApplication app(argc, argv);
+        app.setApplicationName("NifTI Volume Loader");
+        app.setApplicationVersion("1.0.0");
+        app.setOrganizationName("NifTI Viewer");
+        configureVtk();
+        return BatchProcessor::run(app.arguments());
+    }
+    
     QApplication app(argc, argv);
 
     // Set application metadata for system integration
@@ -25,13 +62,7 @@ int main(int argc, char *argv[])
     app.setApplicationVersion("1.0.0");
     app.setOrganizationName("NifTI Viewer");
     
-        // Configure VTK error handling to avoid popup dialogs
-    // Instead, redirect all VTK errors and warnings to a log file
-    vtkOutputWindow::SetGlobalWarningDisplay(0);  // Disable error popups
-    auto fileOutputWindow = vtkFileOutputWindow::New();
-    fileOutputWindow->SetFileName("vtk_errors.log");  // Log file for VTK errors
-    vtkOutputWindow::SetInstance(fileOutputWindow);
-    fileOutputWindow->Delete();
+    configureVtk();
 
     // Apply modern Fusion style for consistent cross-platform appearance
     app.setStyle(QStyleFactory::create("Fusion"));